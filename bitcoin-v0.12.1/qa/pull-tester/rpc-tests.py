@@ -88,6 +88,7 @@ testScripts = [
     'mempool_reorg.py',
     'mempool_limit.py',
     'httpbasics.py',
+    'rpcbatch.py',
     'multi_rpc.py',
     'zapwallettxes.py',
     'proxy_test.py',
@@ -111,8 +111,25 @@ class ListTransactionsTest(BitcoinTestFramework):
                            {"category":"receive","amount":Decimal("0.1")},
                            {"txid":txid, "account" : "watchonly"} )
 
+        # Paging back with the cursor lists the same entries, also when a page
+        # ends inside the sendmany transaction above
+        for count in (1, 4, 5):
+            self.check_paging(self.nodes[1], count)
+
         self.run_rbf_opt_in_test()
 
+    def check_paging(self, node, count):
+        entries = node.listtransactions("*", 1000)
+        paged = node.listtransactions("*", count)
+        while True:
+            first = paged[0]["orderpos"]
+            seen = len([entry for entry in paged if entry["orderpos"] == first])
+            page = node.listtransactions("*", count, seen, False, first)
+            if not page:
+                break
+            paged = page + paged
+        assert_equal(paged, entries)
+
     # Check that the opt-in-rbf flag works properly, for sent and received
     # transactions.
     def run_rbf_opt_in_test(self):
@@ -193,14 +193,15 @@ class RESTTest (BitcoinTestFramework):
         response = http_post_call(url.hostname, url.port, '/rest/getutxos/checkmempool'+self.FORMAT_SEPARATOR+'bin', '', True)
         assert_equal(response.status, 500) #must be a 500 because we send a invalid bin request
 
-        #test limits
-        json_request = '/checkmempool/'
-        for x in range(0, 20):
-            json_request += txid+'-'+str(n)+'/'
-        json_request = json_request.rstrip("/")
-        response = http_post_call(url.hostname, url.port, '/rest/getutxos'+json_request+self.FORMAT_SEPARATOR+'json', '', True)
+        #test limits (that many outpoints do not fit in the URI, so post them)
+        json_request = json.dumps({"checkmempool": True, "outpoints": [{"txid": txid, "vout": n}] * 10001})
+        response = http_post_call(url.hostname, url.port, '/rest/getutxos'+self.FORMAT_SEPARATOR+'json', json_request, True)
         assert_equal(response.status, 500) #must be a 500 because we exceeding the limits
 
+        json_request = json.dumps({"checkmempool": True, "outpoints": [{"txid": txid, "vout": n}] * 10000})
+        response = http_post_call(url.hostname, url.port, '/rest/getutxos'+self.FORMAT_SEPARATOR+'json', json_request, True)
+        assert_equal(response.status, 200)
+
         json_request = '/checkmempool/'
         for x in range(0, 15):
             json_request += txid+'-'+str(n)+'/'
@@ -0,0 +1,94 @@
+#!/usr/bin/env python2
+# Copyright (c) 2016 The Bitcoin Core developers
+# Distributed under the MIT software license, see the accompanying
+# file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#
+# Test JSON-RPC batches: read-only calls run in parallel, but replies
+# keep request order and calls after a write see its effects
+#
+
+from test_framework.test_framework import BitcoinTestFramework
+from test_framework.util import *
+import base64
+import json
+
+try:
+    import http.client as httplib
+except ImportError:
+    import httplib
+try:
+    import urllib.parse as urlparse
+except ImportError:
+    import urlparse
+
+def call(method, params, id):
+    return {"version": "1.1", "method": method, "params": params, "id": id}
+
+class RPCBatchTest (BitcoinTestFramework):
+    def setup_chain(self):
+        print("Initializing test directory "+self.options.tmpdir)
+        initialize_chain(self.options.tmpdir)
+
+    def setup_network(self, split=False):
+        # node1 has no helper threads, so it runs every batch element in turn
+        self.nodes = start_nodes(2, self.options.tmpdir, [[], ["-rpcthreads=1"]])
+        self.is_network_split = False
+
+    def post_batch(self, node, batch):
+        url = urlparse.urlparse(node.url)
+        authpair = url.username + ':' + url.password
+        headers = {"Authorization": "Basic " + base64.b64encode(authpair)}
+        conn = httplib.HTTPConnection(url.hostname, url.port)
+        conn.connect()
+        conn.request('POST', '/', json.dumps(batch), headers)
+        response = conn.getresponse()
+        assert_equal(response.status, 200)
+        out = response.read()
+        conn.close()
+        return out
+
+    def run_test(self):
+        # A long run of read-only calls, with a reply larger than one chunk
+        hashes = [self.nodes[0].getblockhash(i) for i in range(201)]
+        batch = []
+        for i in range(201):
+            batch.append(call("getblockhash", [i], i))
+            batch.append(call("getblock", [hashes[i]], "block%d" % i))
+        batch.append(call("nosuchmethod", [], "unknown"))
+        batch.append(call("getblockcount", [], "count"))
+
+        out = self.post_batch(self.nodes[0], batch)
+        assert(len(out) > 64 * 1024)
+        replies = json.loads(out)
+        assert_equal(len(replies), len(batch))
+        for i in range(201):
+            assert_equal(replies[2 * i]["id"], i)
+            assert_equal(replies[2 * i]["result"], hashes[i])
+            assert_equal(replies[2 * i + 1]["id"], "block%d" % i)
+            assert_equal(replies[2 * i + 1]["result"]["height"], i)
+        assert_equal(replies[-2]["id"], "unknown")
+        assert_equal(replies[-2]["error"]["code"], -32601)
+        assert_equal(replies[-1]["result"], 200)
+
+        # Without helper threads the reply is the same
+        assert_equal(self.post_batch(self.nodes[1], batch), out)
+
+        # A write splits the runs of read-only calls, and the calls after it see its effect
+        for node in self.nodes:
+            address = node.getnewaddress()
+            batch = [call("getaccount", [address], "before%d" % i) for i in range(10)]
+            batch.append(call("setaccount", [address, "batch"], "set"))
+            batch += [call("getaccount", [address], "after%d" % i) for i in range(10)]
+            batch.append(call("settxfee", [0.0005], "fee"))
+            batch.append(call("getwalletinfo", [], "info"))
+            replies = json.loads(self.post_batch(node, batch), parse_float=Decimal)
+            assert_equal([reply["id"] for reply in replies], [request["id"] for request in batch])
+            assert_equal([reply["result"] for reply in replies[:10]], [""] * 10)
+            assert_equal(replies[10]["error"], None)
+            assert_equal([reply["result"] for reply in replies[11:21]], ["batch"] * 10)
+            assert_equal(replies[21]["result"], True)
+            assert_equal(replies[22]["result"]["paytxfee"], Decimal("0.0005"))
+
+if __name__ == '__main__':
+    RPCBatchTest ().main ()
@@ -0,0 +1,69 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "random.h"
+#include "wallet/wallet.h"
+
+#include <set>
+
+#include <boost/foreach.hpp>
+
+// Add nCoins mature coins of random values between 0.001 and 1 BTC
+static void AddCoins(CWallet& wallet, std::vector<COutput>& vCoins, int nCoins)
+{
+    for (int i = 0; i < nCoins; i++) {
+        CMutableTransaction tx;
+        tx.nLockTime = i; // so all transactions get different hashes
+        tx.vout.resize(1);
+        tx.vout[0].nValue = COIN / 1000 + GetRand(COIN - COIN / 1000);
+        vCoins.push_back(COutput(new CWalletTx(&wallet, tx), 0, 6 * 24, true));
+    }
+}
+
+static void FreeCoins(std::vector<COutput>& vCoins)
+{
+    BOOST_FOREACH(const COutput& output, vCoins)
+        delete output.tx;
+    vCoins.clear();
+}
+
+// Select from a wallet of 100k coins, sorting the candidates each time
+static void CoinSelection(benchmark::State& state)
+{
+    CWallet wallet;
+    std::vector<COutput> vCoins;
+    AddCoins(wallet, vCoins, 100000);
+
+    LOCK(wallet.cs_wallet);
+    std::set<std::pair<const CWalletTx*, unsigned int> > setCoinsRet;
+    CAmount nValueRet;
+    while (state.KeepRunning()) {
+        wallet.SelectCoinsMinConf(25 * COIN + 12345, 1, 6, vCoins, setCoinsRet, nValueRet);
+    }
+    FreeCoins(vCoins);
+}
+
+// Select again for a changed fee from the same candidates, as CreateTransaction does
+static void CoinSelectionCached(benchmark::State& state)
+{
+    CWallet wallet;
+    std::vector<COutput> vCoins;
+    AddCoins(wallet, vCoins, 100000);
+
+    LOCK(wallet.cs_wallet);
+    CSelectionCandidates candidates;
+    candidates.Set(vCoins, 1, 6);
+    std::set<std::pair<const CWalletTx*, unsigned int> > setCoinsRet;
+    CAmount nValueRet;
+    CAmount nFee = 0;
+    while (state.KeepRunning()) {
+        wallet.SelectCoinsMinConf(25 * COIN + 12345 + nFee, candidates, setCoinsRet, nValueRet);
+        nFee = (nFee + 1000) % 100000;
+    }
+    FreeCoins(vCoins);
+}
+
+BENCHMARK(CoinSelection);
+BENCHMARK(CoinSelectionCached);
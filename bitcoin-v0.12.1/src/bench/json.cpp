@@ -0,0 +1,83 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "bench.h"
+#include "tinyformat.h"
+
+#include <univalue.h>
+
+// A sendmany style object: many address/amount pairs
+static std::string MakeSendManyJSON(int nOutputs)
+{
+    std::string strJson = "{";
+    for (int i = 0; i < nOutputs; i++)
+        strJson += strprintf("%s\"1BitcoinEaterAddressDontSend%05d\":%d.%08d", i ? "," : "", i, i % 21, i);
+    return strJson + "}";
+}
+
+// A getblock style array of transaction objects with nested arrays
+static std::string MakeTransactionsJSON(int nTransactions)
+{
+    UniValue txs(UniValue::VARR);
+    for (int i = 0; i < nTransactions; i++) {
+        UniValue tx(UniValue::VOBJ);
+        tx.push_back(Pair("txid", strprintf("%064x", i)));
+        tx.push_back(Pair("size", 226));
+        UniValue vin(UniValue::VARR);
+        for (int j = 0; j < 2; j++) {
+            UniValue in(UniValue::VOBJ);
+            in.push_back(Pair("txid", strprintf("%064x", i + j)));
+            in.push_back(Pair("vout", j));
+            in.push_back(Pair("scriptSig", std::string(212, 'a')));
+            vin.push_back(in);
+        }
+        tx.push_back(Pair("vin", vin));
+        tx.push_back(Pair("value", 12.5));
+        txs.push_back(tx);
+    }
+    return txs.write();
+}
+
+static void JSONParseSendMany(benchmark::State& state)
+{
+    const std::string strJson = MakeSendManyJSON(2000);
+    while (state.KeepRunning()) {
+        UniValue v;
+        v.read(strJson);
+    }
+}
+
+static void JSONLookupSendMany(benchmark::State& state)
+{
+    UniValue v;
+    v.read(MakeSendManyJSON(2000));
+    const std::vector<std::string> keys = v.getKeys();
+    while (state.KeepRunning()) {
+        for (unsigned int i = 0; i < keys.size(); i++)
+            v[keys[i]];
+    }
+}
+
+static void JSONParseTransactions(benchmark::State& state)
+{
+    const std::string strJson = MakeTransactionsJSON(1000);
+    while (state.KeepRunning()) {
+        UniValue v;
+        v.read(strJson);
+    }
+}
+
+static void JSONWriteTransactions(benchmark::State& state)
+{
+    UniValue v;
+    v.read(MakeTransactionsJSON(1000));
+    while (state.KeepRunning()) {
+        v.write();
+    }
+}
+
+BENCHMARK(JSONParseSendMany);
+BENCHMARK(JSONLookupSendMany);
+BENCHMARK(JSONParseTransactions);
+BENCHMARK(JSONWriteTransactions);
@@ -0,0 +1,339 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+
+#include "crypto/common.h"
+#include "hash.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "streams.h"
+#include "undo.h"
+#include "version.h"
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/foreach.hpp>
+
+namespace {
+
+/** Writes bits, most significant first, to the end of a byte vector. */
+class BitWriter
+{
+private:
+    std::vector<unsigned char>& vch;
+    uint8_t nBuffer;
+    int nOffset; //!< Number of bits already used in nBuffer
+
+public:
+    BitWriter(std::vector<unsigned char>& vchIn) : vch(vchIn), nBuffer(0), nOffset(0) {}
+
+    /** Write the nBits least significant bits of data (nBits <= 64). */
+    void Write(uint64_t data, int nBits)
+    {
+        while (nBits > 0) {
+            int nBitsNow = std::min(8 - nOffset, nBits);
+            // Left-align the remaining bits, then move the next nBitsNow of
+            // them to the free part of the buffer.
+            nBuffer |= (data << (64 - nBits)) >> (64 - 8 + nOffset);
+            nOffset += nBitsNow;
+            nBits -= nBitsNow;
+            if (nOffset == 8)
+                Flush();
+        }
+    }
+
+    /** Pad a partially filled byte with zero bits and append it. */
+    void Flush()
+    {
+        if (nOffset == 0)
+            return;
+        vch.push_back(nBuffer);
+        nBuffer = 0;
+        nOffset = 0;
+    }
+};
+
+/** Reads bits, most significant first, from a byte range. */
+class BitReader
+{
+private:
+    const std::vector<unsigned char>& vch;
+    size_t nPos;
+    uint8_t nBuffer;
+    int nOffset; //!< Number of bits already consumed from nBuffer
+
+public:
+    BitReader(const std::vector<unsigned char>& vchIn, size_t nPosIn) : vch(vchIn), nPos(nPosIn), nBuffer(0), nOffset(8) {}
+
+    uint64_t Read(int nBits)
+    {
+        uint64_t data = 0;
+        while (nBits > 0) {
+            if (nOffset == 8) {
+                if (nPos >= vch.size())
+                    throw std::ios_base::failure("GCS filter: end of data");
+                nBuffer = vch[nPos++];
+                nOffset = 0;
+            }
+            int nBitsNow = std::min(8 - nOffset, nBits);
+            data <<= nBitsNow;
+            data |= static_cast<uint8_t>(nBuffer << nOffset) >> (8 - nBitsNow);
+            nOffset += nBitsNow;
+            nBits -= nBitsNow;
+        }
+        return data;
+    }
+
+    /** Whether every byte has been consumed (the last one possibly partially). */
+    bool AtEnd() const { return nPos == vch.size(); }
+};
+
+void GolombRiceEncode(BitWriter& writer, uint8_t nP, uint64_t x)
+{
+    // Write quotient as unary-encoded: q 1's followed by one 0.
+    uint64_t q = x >> nP;
+    while (q > 0) {
+        int nBits = q <= 64 ? static_cast<int>(q) : 64;
+        writer.Write(~0ULL, nBits);
+        q -= nBits;
+    }
+    writer.Write(0, 1);
+
+    // Write the remainder in P bits. Since the remainder is just the bottom
+    // P bits of x, there is no need to mask first.
+    writer.Write(x, nP);
+}
+
+uint64_t GolombRiceDecode(BitReader& reader, uint8_t nP)
+{
+    // Read unary-encoded quotient: q 1's followed by one 0.
+    uint64_t q = 0;
+    while (reader.Read(1) == 1)
+        ++q;
+
+    uint64_t r = reader.Read(nP);
+
+    return (q << nP) + r;
+}
+
+/** Map x uniformly into [0, n), as (x * n) >> 64. */
+uint64_t MapIntoRange(uint64_t x, uint64_t n)
+{
+#ifdef __SIZEOF_INT128__
+    return static_cast<uint64_t>((static_cast<unsigned __int128>(x) * static_cast<unsigned __int128>(n)) >> 64);
+#else
+    // To perform the calculation on 64-bit numbers without losing the
+    // result to overflow, split the numbers into the most significant and
+    // least significant 32 bits and perform multiplication piece-wise.
+    uint64_t x_hi = x >> 32;
+    uint64_t x_lo = x & 0xFFFFFFFF;
+    uint64_t n_hi = n >> 32;
+    uint64_t n_lo = n & 0xFFFFFFFF;
+
+    uint64_t ac = x_hi * n_hi;
+    uint64_t ad = x_hi * n_lo;
+    uint64_t bc = x_lo * n_hi;
+    uint64_t bd = x_lo * n_lo;
+
+    uint64_t mid34 = (bd >> 32) + (bc & 0xFFFFFFFF) + (ad & 0xFFFFFFFF);
+    uint64_t upper64 = ac + (bc >> 32) + (ad >> 32) + (mid34 >> 32);
+    return upper64;
+#endif
+}
+
+} // anon namespace
+
+GCSFilter::GCSFilter(uint64_t nSipHashK0In, uint64_t nSipHashK1In, uint8_t nPIn, uint32_t nMIn) :
+    nSipHashK0(nSipHashK0In), nSipHashK1(nSipHashK1In), nP(nPIn), nM(nMIn), nN(0), nF(0)
+{
+    // An empty filter is the compact size 0 with no data
+    vEncoded.push_back(0);
+}
+
+GCSFilter::GCSFilter(uint64_t nSipHashK0In, uint64_t nSipHashK1In, uint8_t nPIn, uint32_t nMIn,
+                     const std::vector<unsigned char>& vEncodedIn) :
+    nSipHashK0(nSipHashK0In), nSipHashK1(nSipHashK1In), nP(nPIn), nM(nMIn), vEncoded(vEncodedIn)
+{
+    CDataStream stream(vEncoded, SER_NETWORK, PROTOCOL_VERSION);
+    uint64_t nN64 = ReadCompactSize(stream);
+    if (nN64 > std::numeric_limits<uint32_t>::max())
+        throw std::ios_base::failure("N must be <2^32");
+    nN = static_cast<uint32_t>(nN64);
+    nF = static_cast<uint64_t>(nN) * nM;
+
+    // Verify that the encoded filter contains exactly N elements. If it has
+    // too much or too little data, a std::ios_base::failure exception will be
+    // raised.
+    BitReader reader(vEncoded, vEncoded.size() - stream.size());
+    for (uint64_t i = 0; i < nN; ++i)
+        GolombRiceDecode(reader, nP);
+    if (!reader.AtEnd())
+        throw std::ios_base::failure("encoded_filter contains excess data");
+}
+
+GCSFilter::GCSFilter(uint64_t nSipHashK0In, uint64_t nSipHashK1In, uint8_t nPIn, uint32_t nMIn,
+                     const ElementSet& elements) :
+    nSipHashK0(nSipHashK0In), nSipHashK1(nSipHashK1In), nP(nPIn), nM(nMIn)
+{
+    if (elements.size() > std::numeric_limits<uint32_t>::max())
+        throw std::invalid_argument("N must be <2^32");
+    nN = static_cast<uint32_t>(elements.size());
+    nF = static_cast<uint64_t>(nN) * nM;
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(stream, nN);
+    vEncoded.assign(stream.begin(), stream.end());
+
+    if (elements.empty())
+        return;
+
+    BitWriter writer(vEncoded);
+
+    uint64_t nLastValue = 0;
+    std::vector<uint64_t> vHashes = BuildHashedSet(elements);
+    BOOST_FOREACH(uint64_t value, vHashes) {
+        uint64_t nDelta = value - nLastValue;
+        GolombRiceEncode(writer, nP, nDelta);
+        nLastValue = value;
+    }
+
+    writer.Flush();
+}
+
+uint64_t GCSFilter::HashToRange(const Element& element) const
+{
+    uint64_t hash = CSipHasher(nSipHashK0, nSipHashK1)
+        .Write(element.empty() ? NULL : &element[0], element.size())
+        .Finalize();
+    return MapIntoRange(hash, nF);
+}
+
+std::vector<uint64_t> GCSFilter::BuildHashedSet(const ElementSet& elements) const
+{
+    std::vector<uint64_t> vHashes;
+    vHashes.reserve(elements.size());
+    BOOST_FOREACH(const Element& element, elements)
+        vHashes.push_back(HashToRange(element));
+    std::sort(vHashes.begin(), vHashes.end());
+    return vHashes;
+}
+
+bool GCSFilter::MatchInternal(const uint64_t* pElementHashes, size_t nSize) const
+{
+    CDataStream stream(vEncoded, SER_NETWORK, PROTOCOL_VERSION);
+
+    // Seek forward by size of N
+    uint64_t nN64 = ReadCompactSize(stream);
+    assert(nN64 == nN);
+
+    BitReader reader(vEncoded, vEncoded.size() - stream.size());
+    uint64_t nValue = 0;
+    size_t nHashesIndex = 0;
+    for (uint32_t i = 0; i < nN; ++i) {
+        uint64_t nDelta = GolombRiceDecode(reader, nP);
+        nValue += nDelta;
+
+        while (true) {
+            if (nHashesIndex == nSize)
+                return false;
+            else if (pElementHashes[nHashesIndex] == nValue)
+                return true;
+            else if (pElementHashes[nHashesIndex] > nValue)
+                break;
+
+            nHashesIndex++;
+        }
+    }
+
+    return false;
+}
+
+bool GCSFilter::Match(const Element& element) const
+{
+    if (nN == 0)
+        return false;
+    uint64_t query = HashToRange(element);
+    return MatchInternal(&query, 1);
+}
+
+bool GCSFilter::MatchAny(const ElementSet& elements) const
+{
+    if (nN == 0 || elements.empty())
+        return false;
+    const std::vector<uint64_t> vQueries = BuildHashedSet(elements);
+    return MatchInternal(&vQueries[0], vQueries.size());
+}
+
+static GCSFilter::ElementSet BasicFilterElements(const CBlock& block, const CBlockUndo& blockUndo)
+{
+    GCSFilter::ElementSet elements;
+
+    BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+        BOOST_FOREACH(const CTxOut& txout, tx.vout) {
+            const CScript& script = txout.scriptPubKey;
+            if (script.empty() || script[0] == OP_RETURN)
+                continue;
+            elements.insert(GCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+
+    BOOST_FOREACH(const CTxUndo& txundo, blockUndo.vtxundo) {
+        BOOST_FOREACH(const CTxInUndo& prevout, txundo.vprevout) {
+            const CScript& script = prevout.txout.scriptPubKey;
+            if (script.empty())
+                continue;
+            elements.insert(GCSFilter::Element(script.begin(), script.end()));
+        }
+    }
+
+    return elements;
+}
+
+CBlockFilter::CBlockFilter(BlockFilterType filterTypeIn, const uint256& blockHashIn,
+                           const std::vector<unsigned char>& vEncodedFilter) :
+    filterType(filterTypeIn), blockHash(blockHashIn)
+{
+    switch (filterType) {
+    case BLOCK_FILTER_BASIC:
+        filter = GCSFilter(ReadLE64(blockHash.begin()), ReadLE64(blockHash.begin() + 8),
+                           BASIC_FILTER_P, BASIC_FILTER_M, vEncodedFilter);
+        break;
+
+    default:
+        throw std::invalid_argument("unknown filter_type");
+    }
+}
+
+CBlockFilter::CBlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo) :
+    filterType(filterTypeIn), blockHash(block.GetHash())
+{
+    switch (filterType) {
+    case BLOCK_FILTER_BASIC:
+        filter = GCSFilter(ReadLE64(blockHash.begin()), ReadLE64(blockHash.begin() + 8),
+                           BASIC_FILTER_P, BASIC_FILTER_M,
+                           BasicFilterElements(block, blockUndo));
+        break;
+
+    default:
+        throw std::invalid_argument("unknown filter_type");
+    }
+}
+
+uint256 CBlockFilter::GetHash() const
+{
+    const std::vector<unsigned char>& data = GetEncodedFilter();
+    return Hash(data.begin(), data.end());
+}
+
+uint256 CBlockFilter::ComputeHeader(const uint256& prevHeader) const
+{
+    return ComputeBlockFilterHeader(GetHash(), prevHeader);
+}
+
+uint256 ComputeBlockFilterHeader(const uint256& filterHash, const uint256& prevHeader)
+{
+    return Hash(filterHash.begin(), filterHash.end(), prevHeader.begin(), prevHeader.end());
+}
@@ -0,0 +1,117 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILTER_H
+#define BITCOIN_BLOCKFILTER_H
+
+#include "uint256.h"
+
+#include <set>
+#include <stdint.h>
+#include <vector>
+
+class CBlock;
+class CBlockUndo;
+
+/**
+ * This implements a Golomb-coded set as defined in BIP 158. It is a
+ * compact, probabilistic data structure for testing set membership.
+ */
+class GCSFilter
+{
+public:
+    typedef std::vector<unsigned char> Element;
+    typedef std::set<Element> ElementSet;
+
+private:
+    uint64_t nSipHashK0;
+    uint64_t nSipHashK1;
+    uint8_t nP;  //!< Golomb-Rice coding parameter
+    uint32_t nM; //!< Inverse false positive rate
+    uint32_t nN; //!< Number of elements in the filter
+    uint64_t nF; //!< Range of element hashes, F = N * M
+    std::vector<unsigned char> vEncoded;
+
+    /** Hash a data element to an integer in the range [0, N * M). */
+    uint64_t HashToRange(const Element& element) const;
+
+    std::vector<uint64_t> BuildHashedSet(const ElementSet& elements) const;
+
+    /** Helper method used to implement Match and MatchAny */
+    bool MatchInternal(const uint64_t* pElementHashes, size_t nSize) const;
+
+public:
+    /** Constructs an empty filter. */
+    GCSFilter(uint64_t nSipHashK0In = 0, uint64_t nSipHashK1In = 0, uint8_t nPIn = 0, uint32_t nMIn = 0);
+
+    /** Reconstructs an already-created filter from an encoding. Throws std::ios_base::failure if it is malformed. */
+    GCSFilter(uint64_t nSipHashK0In, uint64_t nSipHashK1In, uint8_t nPIn, uint32_t nMIn,
+              const std::vector<unsigned char>& vEncodedIn);
+
+    /** Builds a new filter from the params and set of elements. */
+    GCSFilter(uint64_t nSipHashK0In, uint64_t nSipHashK1In, uint8_t nPIn, uint32_t nMIn,
+              const ElementSet& elements);
+
+    uint32_t GetN() const { return nN; }
+    const std::vector<unsigned char>& GetEncoded() const { return vEncoded; }
+
+    /**
+     * Checks if the element may be in the set. False positives are possible
+     * with probability 1/M.
+     */
+    bool Match(const Element& element) const;
+
+    /**
+     * Checks if any of the given elements may be in the set. False positives
+     * are possible with probability 1/M per element checked. This is more
+     * efficient than checking Match on multiple elements separately.
+     */
+    bool MatchAny(const ElementSet& elements) const;
+};
+
+static const uint8_t BASIC_FILTER_P = 19;
+static const uint32_t BASIC_FILTER_M = 784931;
+
+enum BlockFilterType
+{
+    BLOCK_FILTER_BASIC = 0,
+};
+
+/**
+ * A block filter as defined in BIP 157/158: the filter type, the hash of the
+ * block it commits to and the GCS filter itself.
+ */
+class CBlockFilter
+{
+private:
+    BlockFilterType filterType;
+    uint256 blockHash;
+    GCSFilter filter;
+
+public:
+    CBlockFilter() : filterType(BLOCK_FILTER_BASIC) {}
+
+    /** Reconstruct a block filter from parts. Throws std::ios_base::failure if the encoding is malformed. */
+    CBlockFilter(BlockFilterType filterTypeIn, const uint256& blockHashIn,
+                 const std::vector<unsigned char>& vEncodedFilter);
+
+    /** Construct a new block filter of the specified type from a block and the outputs it spends. */
+    CBlockFilter(BlockFilterType filterTypeIn, const CBlock& block, const CBlockUndo& blockUndo);
+
+    BlockFilterType GetFilterType() const { return filterType; }
+    const uint256& GetBlockHash() const { return blockHash; }
+    const GCSFilter& GetFilter() const { return filter; }
+    const std::vector<unsigned char>& GetEncodedFilter() const { return filter.GetEncoded(); }
+
+    /** Compute the filter hash. */
+    uint256 GetHash() const;
+
+    /** Compute the filter header given the previous one. */
+    uint256 ComputeHeader(const uint256& prevHeader) const;
+};
+
+/** Compute a filter header from the filter hash and the previous header. */
+uint256 ComputeBlockFilterHeader(const uint256& filterHash, const uint256& prevHeader);
+
+#endif // BITCOIN_BLOCKFILTER_H
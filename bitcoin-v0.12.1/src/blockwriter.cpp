@@ -0,0 +1,207 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockwriter.h"
+
+#include "main.h"
+#include "util.h"
+
+#include <algorithm>
+
+#include <boost/foreach.hpp>
+#include <boost/thread/thread.hpp>
+
+bool CBlockFileWriter::CWrite::operator<(const CWrite& other) const
+{
+    if (fUndo != other.fUndo)
+        return fUndo < other.fUndo;
+    if (pos.nFile != other.pos.nFile)
+        return pos.nFile < other.pos.nFile;
+    if (pos.nPos != other.pos.nPos)
+        return pos.nPos < other.pos.nPos;
+    // Allocate before writing at the same position
+    return vData.empty() && !other.vData.empty();
+}
+
+CBlockFileWriter::CBlockFileWriter() : nQueuedBytes(0), fRunning(false), fFailed(false)
+{
+}
+
+bool CBlockFileWriter::Write(const std::list<CWrite>& listWrites)
+{
+    std::vector<const CWrite*> vWrites;
+    vWrites.reserve(listWrites.size());
+    BOOST_FOREACH(const CWrite& write, listWrites)
+        vWrites.push_back(&write);
+    std::stable_sort(vWrites.begin(), vWrites.end(), CompareWrites);
+
+    bool fOk = true;
+    FILE* file = NULL;
+    const CWrite* pprev = NULL;
+    long nFilePos = -1; // where the next write goes without seeking, -1 if unknown
+    BOOST_FOREACH(const CWrite* pwrite, vWrites) {
+        const CWrite& write = *pwrite;
+        // Keep one handle open for all writes to the same file
+        if (!pprev || write.fUndo != pprev->fUndo || write.pos.nFile != pprev->pos.nFile) {
+            if (file && fclose(file) != 0) {
+                LogPrintf("%s: fclose failed for %s%05u.dat\n", __func__, pprev->fUndo ? "rev" : "blk", pprev->pos.nFile);
+                fOk = false;
+            }
+            file = write.fUndo ? OpenUndoFile(write.pos) : OpenBlockFile(write.pos);
+            nFilePos = write.pos.nPos;
+        }
+        pprev = pwrite;
+        if (!file) {
+            fOk = false;
+            continue;
+        }
+
+        if (write.vData.empty()) {
+            LogPrintf("Pre-allocating up to position 0x%x in %s%05u.dat\n", write.pos.nPos + write.nAllocateLength, write.fUndo ? "rev" : "blk", write.pos.nFile);
+            fflush(file);
+            AllocateFileRange(file, write.pos.nPos, write.nAllocateLength);
+            nFilePos = -1;
+            continue;
+        }
+
+        if (nFilePos != (long)write.pos.nPos && fseek(file, write.pos.nPos, SEEK_SET) != 0) {
+            LogPrintf("%s: fseek failed for %s in %s%05u.dat\n", __func__, write.pos.ToString(), write.fUndo ? "rev" : "blk", write.pos.nFile);
+            fOk = false;
+            nFilePos = -1;
+            continue;
+        }
+        if (fwrite(&write.vData[0], 1, write.vData.size(), file) != write.vData.size()) {
+            LogPrintf("%s: fwrite failed for %s in %s%05u.dat\n", __func__, write.pos.ToString(), write.fUndo ? "rev" : "blk", write.pos.nFile);
+            fOk = false;
+            nFilePos = -1;
+            continue;
+        }
+        nFilePos = write.pos.nPos + write.vData.size();
+    }
+    if (file && fclose(file) != 0) {
+        LogPrintf("%s: fclose failed for %s%05u.dat\n", __func__, pprev->fUndo ? "rev" : "blk", pprev->pos.nFile);
+        fOk = false;
+    }
+    return fOk;
+}
+
+bool CBlockFileWriter::Find(const std::list<CWrite>& listWrites, bool fUndo, const CDiskBlockPos& pos, CDataStream& ss)
+{
+    BOOST_FOREACH(const CWrite& write, listWrites) {
+        if (write.fUndo != fUndo || write.pos.nFile != pos.nFile || write.vData.empty())
+            continue;
+        if (pos.nPos < write.pos.nPos || pos.nPos >= write.pos.nPos + write.vData.size())
+            continue;
+        size_t nOffset = pos.nPos - write.pos.nPos;
+        ss.write(&write.vData[nOffset], write.vData.size() - nOffset);
+        return true;
+    }
+    return false;
+}
+
+bool CBlockFileWriter::Push(CWrite& write)
+{
+    boost::this_thread::disable_interruption di; // callers are in the middle of storing a block
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (fFailed)
+        return false;
+    // Bound the memory used by queued data; always admit a write to an empty queue
+    while (fRunning && nQueuedBytes > 0 && nQueuedBytes + write.vData.size() > BLOCKFILE_WRITE_QUEUE_SIZE)
+        condWritten.wait(lock);
+    if (fFailed)
+        return false;
+
+    std::list<CWrite> listWrite(1);
+    CWrite& queued = listWrite.back();
+    queued.fUndo = write.fUndo;
+    queued.pos = write.pos;
+    queued.vData.swap(write.vData);
+    queued.nAllocateLength = write.nAllocateLength;
+    if (!fRunning) {
+        if (!Write(listWrite)) {
+            fFailed = true;
+            return false;
+        }
+        return true;
+    }
+    nQueuedBytes += queued.vData.size();
+    listQueued.splice(listQueued.end(), listWrite);
+    condQueued.notify_one();
+    return true;
+}
+
+bool CBlockFileWriter::QueueWrite(bool fUndo, const CDiskBlockPos& pos, const CDataStream& ssData)
+{
+    CWrite write;
+    write.fUndo = fUndo;
+    write.pos = pos;
+    write.vData.assign(ssData.begin(), ssData.end());
+    write.nAllocateLength = 0;
+    return Push(write);
+}
+
+void CBlockFileWriter::QueueAllocate(bool fUndo, const CDiskBlockPos& pos, unsigned int nLength)
+{
+    CWrite write;
+    write.fUndo = fUndo;
+    write.pos = pos;
+    write.nAllocateLength = nLength;
+    Push(write); // advisory, like AllocateFileRange
+}
+
+bool CBlockFileWriter::ReadQueued(bool fUndo, const CDiskBlockPos& pos, CDataStream& ss)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    return Find(listQueued, fUndo, pos, ss) || Find(listWriting, fUndo, pos, ss);
+}
+
+bool CBlockFileWriter::Flush()
+{
+    boost::this_thread::disable_interruption di;
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (!listQueued.empty() || !listWriting.empty())
+        condWritten.wait(lock);
+    return !fFailed;
+}
+
+void CBlockFileWriter::ThreadWrite()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fRunning = true;
+    }
+    try {
+        while (true) {
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (listQueued.empty())
+                    condQueued.wait(lock);
+                listWriting.splice(listWriting.end(), listQueued);
+            }
+            // Readers may still find the data in listWriting until the files are closed
+            bool fOk = Write(listWriting);
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                BOOST_FOREACH(const CWrite& write, listWriting)
+                    nQueuedBytes -= write.vData.size();
+                listWriting.clear();
+                if (!fOk)
+                    fFailed = true;
+            }
+            condWritten.notify_all();
+        }
+    } catch (const boost::thread_interrupted&) {
+        // Write what is left; callers write by themselves from now on
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            fRunning = false;
+            if (!Write(listQueued))
+                fFailed = true;
+            listQueued.clear();
+            nQueuedBytes = 0;
+        }
+        condWritten.notify_all();
+        throw;
+    }
+}
@@ -0,0 +1,86 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKWRITER_H
+#define BITCOIN_BLOCKWRITER_H
+
+#include "chain.h"
+#include "streams.h"
+
+#include <list>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+/** Bytes of block and undo data that may wait for the writer before new writes block */
+static const size_t BLOCKFILE_WRITE_QUEUE_SIZE = 32 * 1024 * 1024;
+
+/**
+ * Writes block (blk?????.dat) and undo (rev?????.dat) data on a thread of its
+ * own, so that validation does not wait for the disk. Writes are queued in
+ * memory; the writer takes everything queued at once, orders it by file and
+ * position and writes each file through a single handle. Pre-allocation of
+ * file chunks is queued the same way. Files are not synced by the writer:
+ * callers Flush() before committing them, see FlushBlockFile().
+ *
+ * Data still queued is served to readers from memory. While the thread is
+ * not running, writes are done right away by the caller.
+ */
+class CBlockFileWriter
+{
+private:
+    struct CWrite
+    {
+        bool fUndo;
+        CDiskBlockPos pos;              //! where the data starts
+        std::vector<char> vData;        //! empty for an allocation
+        unsigned int nAllocateLength;   //! bytes to pre-allocate from pos
+
+        bool operator<(const CWrite& other) const;
+    };
+
+    static bool CompareWrites(const CWrite* a, const CWrite* b) { return *a < *b; }
+
+    boost::mutex cs;
+    boost::condition_variable condQueued;
+    boost::condition_variable condWritten;
+    //! writes not yet taken by the writer
+    std::list<CWrite> listQueued;
+    //! writes being done by the writer; only the writer may change them
+    std::list<CWrite> listWriting;
+    size_t nQueuedBytes;
+    bool fRunning;
+    bool fFailed;
+
+    /** Queue a write, or do it right away if the thread is not running */
+    bool Push(CWrite& write);
+    /** Do writes in file and position order; returns false if one failed */
+    static bool Write(const std::list<CWrite>& listWrites);
+    /** Find queued data of file fUndo covering pos, and copy the rest of it into ss */
+    static bool Find(const std::list<CWrite>& listWrites, bool fUndo, const CDiskBlockPos& pos, CDataStream& ss);
+
+public:
+    CBlockFileWriter();
+
+    /**
+     * Queue raw data (message start, size and payload) to be written at pos.
+     * Returns false if an earlier write failed.
+     */
+    bool QueueWrite(bool fUndo, const CDiskBlockPos& pos, const CDataStream& ssData);
+
+    /** Queue pre-allocating nLength bytes of file space from pos */
+    void QueueAllocate(bool fUndo, const CDiskBlockPos& pos, unsigned int nLength);
+
+    /** If data at pos is still queued, copy it from pos onwards into ss */
+    bool ReadQueued(bool fUndo, const CDiskBlockPos& pos, CDataStream& ss);
+
+    /** Wait until everything queued so far is written. Returns false if any write failed. */
+    bool Flush();
+
+    /** Write queued data until interrupted, then write what is left and return */
+    void ThreadWrite();
+};
+
+#endif // BITCOIN_BLOCKWRITER_H
@@ -133,7 +133,149 @@ bool CBloomFilter::IsWithinSizeConstraints() const
     return vData.size() <= MAX_BLOOM_FILTER_SIZE && nHashFuncs <= MAX_HASH_FUNCS;
 }
 
-bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
+CBloomTxKeys::CBloomTxKeys(const CTransaction& tx) :
+    hash(tx.GetHash()),
+    vHash(hash.begin(), hash.end()),
+    vOutputs(tx.vout.size()),
+    vInputs(tx.vin.size())
+{
+    vector<unsigned char> data;
+    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    {
+        const CScript& scriptPubKey = tx.vout[i].scriptPubKey;
+        COutputKeys& output = vOutputs[i];
+        CScript::const_iterator pc = scriptPubKey.begin();
+        while (pc < scriptPubKey.end())
+        {
+            opcodetype opcode;
+            if (!scriptPubKey.GetOp(pc, opcode, data))
+                break;
+            if (data.size() != 0)
+                output.vPushes.push_back(data);
+        }
+        txnouttype type;
+        vector<vector<unsigned char> > vSolutions;
+        output.fPayToPubKey = !output.vPushes.empty() && Solver(scriptPubKey, type, vSolutions) &&
+            (type == TX_PUBKEY || type == TX_MULTISIG);
+    }
+
+    for (unsigned int i = 0; i < tx.vin.size(); i++)
+    {
+        const CTxIn& txin = tx.vin[i];
+        CInputKeys& input = vInputs[i];
+        CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+        stream << txin.prevout;
+        input.vPrevout.assign(stream.begin(), stream.end());
+        CScript::const_iterator pc = txin.scriptSig.begin();
+        while (pc < txin.scriptSig.end())
+        {
+            opcodetype opcode;
+            if (!txin.scriptSig.GetOp(pc, opcode, data))
+                break;
+            if (data.size() != 0)
+                input.vPushes.push_back(data);
+        }
+    }
+}
+
+namespace {
+
+/** Walks the non-empty data pushes of a script, up to the first unparsable opcode */
+class CScriptPushes
+{
+private:
+    const CScript& script;
+    CScript::const_iterator pc;
+    vector<unsigned char> data;
+
+public:
+    explicit CScriptPushes(const CScript& scriptIn) : script(scriptIn), pc(scriptIn.begin()) {}
+
+    const vector<unsigned char>* Next()
+    {
+        while (pc < script.end())
+        {
+            opcodetype opcode;
+            if (!script.GetOp(pc, opcode, data))
+            {
+                pc = script.end();
+                break;
+            }
+            if (data.size() != 0)
+                return &data;
+        }
+        return NULL;
+    }
+};
+
+/** Walks data pushes already extracted into a CBloomTxKeys */
+class CExtractedPushes
+{
+private:
+    const vector<vector<unsigned char> >& vPushes;
+    size_t nNext;
+
+public:
+    explicit CExtractedPushes(const vector<vector<unsigned char> >& vPushesIn) : vPushes(vPushesIn), nNext(0) {}
+
+    const vector<unsigned char>* Next()
+    {
+        return nNext < vPushes.size() ? &vPushes[nNext++] : NULL;
+    }
+};
+
+/** What CBloomFilter::MatchAndUpdate needs of a transaction, parsed only as far as the matching goes */
+class CBloomTxParser
+{
+private:
+    const CTransaction& tx;
+
+public:
+    typedef CScriptPushes Pushes;
+
+    explicit CBloomTxParser(const CTransaction& txIn) : tx(txIn) {}
+
+    const uint256& GetHash() const { return tx.GetHash(); }
+    bool HashMatches(const CBloomFilter& filter) const { return filter.contains(tx.GetHash()); }
+    unsigned int OutputCount() const { return tx.vout.size(); }
+    Pushes OutputPushes(unsigned int i) const { return Pushes(tx.vout[i].scriptPubKey); }
+    bool IsPayToPubKey(unsigned int i) const
+    {
+        txnouttype type;
+        vector<vector<unsigned char> > vSolutions;
+        return Solver(tx.vout[i].scriptPubKey, type, vSolutions) &&
+            (type == TX_PUBKEY || type == TX_MULTISIG);
+    }
+    unsigned int InputCount() const { return tx.vin.size(); }
+    bool PrevoutMatches(const CBloomFilter& filter, unsigned int i) const { return filter.contains(tx.vin[i].prevout); }
+    Pushes InputPushes(unsigned int i) const { return Pushes(tx.vin[i].scriptSig); }
+};
+
+/** The same, from keys extracted up front */
+class CBloomTxKeysReader
+{
+private:
+    const CBloomTxKeys& keys;
+
+public:
+    typedef CExtractedPushes Pushes;
+
+    explicit CBloomTxKeysReader(const CBloomTxKeys& keysIn) : keys(keysIn) {}
+
+    const uint256& GetHash() const { return keys.hash; }
+    bool HashMatches(const CBloomFilter& filter) const { return filter.contains(keys.vHash); }
+    unsigned int OutputCount() const { return keys.vOutputs.size(); }
+    Pushes OutputPushes(unsigned int i) const { return Pushes(keys.vOutputs[i].vPushes); }
+    bool IsPayToPubKey(unsigned int i) const { return keys.vOutputs[i].fPayToPubKey; }
+    unsigned int InputCount() const { return keys.vInputs.size(); }
+    bool PrevoutMatches(const CBloomFilter& filter, unsigned int i) const { return filter.contains(keys.vInputs[i].vPrevout); }
+    Pushes InputPushes(unsigned int i) const { return Pushes(keys.vInputs[i].vPushes); }
+};
+
+} // anon namespace
+
+template <typename TxReader>
+bool CBloomFilter::MatchAndUpdate(const TxReader& tx)
 {
     bool fFound = false;
     // Match if the filter contains the hash of tx
@@ -143,36 +285,25 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     if (isEmpty)
         return false;
     const uint256& hash = tx.GetHash();
-    if (contains(hash))
+    if (tx.HashMatches(*this))
         fFound = true;
 
-    for (unsigned int i = 0; i < tx.vout.size(); i++)
+    for (unsigned int i = 0; i < tx.OutputCount(); i++)
     {
-        const CTxOut& txout = tx.vout[i];
         // Match if the filter contains any arbitrary script data element in any scriptPubKey in tx
         // If this matches, also add the specific output that was matched.
         // This means clients don't have to update the filter themselves when a new relevant tx 
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
-        CScript::const_iterator pc = txout.scriptPubKey.begin();
-        vector<unsigned char> data;
-        while (pc < txout.scriptPubKey.end())
+        typename TxReader::Pushes pushes = tx.OutputPushes(i);
+        while (const vector<unsigned char>* pdata = pushes.Next())
         {
-            opcodetype opcode;
-            if (!txout.scriptPubKey.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
+            if (contains(*pdata))
             {
                 fFound = true;
                 if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
                     insert(COutPoint(hash, i));
-                else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY)
-                {
-                    txnouttype type;
-                    vector<vector<unsigned char> > vSolutions;
-                    if (Solver(txout.scriptPubKey, type, vSolutions) &&
-                            (type == TX_PUBKEY || type == TX_MULTISIG))
-                        insert(COutPoint(hash, i));
-                }
+                else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY && tx.IsPayToPubKey(i))
+                    insert(COutPoint(hash, i));
                 break;
             }
         }
@@ -181,21 +312,17 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     if (fFound)
         return true;
 
-    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    for (unsigned int i = 0; i < tx.InputCount(); i++)
     {
         // Match if the filter contains an outpoint tx spends
-        if (contains(txin.prevout))
+        if (tx.PrevoutMatches(*this, i))
             return true;
 
         // Match if the filter contains any arbitrary script data element in any scriptSig in tx
-        CScript::const_iterator pc = txin.scriptSig.begin();
-        vector<unsigned char> data;
-        while (pc < txin.scriptSig.end())
+        typename TxReader::Pushes pushes = tx.InputPushes(i);
+        while (const vector<unsigned char>* pdata = pushes.Next())
         {
-            opcodetype opcode;
-            if (!txin.scriptSig.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
+            if (contains(*pdata))
                 return true;
         }
     }
@@ -203,6 +330,16 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
     return false;
 }
 
+bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
+{
+    return MatchAndUpdate(CBloomTxParser(tx));
+}
+
+bool CBloomFilter::IsRelevantAndUpdate(const CBloomTxKeys& keys)
+{
+    return MatchAndUpdate(CBloomTxKeysReader(keys));
+}
+
 void CBloomFilter::UpdateEmptyFull()
 {
     bool full = true;
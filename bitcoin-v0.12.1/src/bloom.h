@@ -6,12 +6,12 @@
 #define BITCOIN_BLOOM_H
 
 #include "serialize.h"
+#include "uint256.h"
 
 #include <vector>
 
 class COutPoint;
 class CTransaction;
-class uint256;
 
 //! 20,000 items with fp rate < 0.1% or 10,000 items and <0.0001%
 static const unsigned int MAX_BLOOM_FILTER_SIZE = 36000; // bytes
@@ -30,6 +30,43 @@ enum bloomflags
     BLOOM_UPDATE_MASK = 3,
 };
 
+/**
+ * The data elements of a transaction that a bloom filter is probed with: the
+ * txid, the serialized prevouts and the data pushes of every script.
+ *
+ * Extracting them parses every script in the transaction. The bit positions
+ * they map to depend on each filter's tweak, but the elements themselves do
+ * not, so when one transaction is matched against many filters (relaying to
+ * SPV peers, or serving the same filtered block to each of them) they are
+ * extracted once and shared.
+ */
+class CBloomTxKeys
+{
+public:
+    struct COutputKeys
+    {
+        //! Non-empty data pushes of the scriptPubKey, up to the first unparsable opcode
+        std::vector<std::vector<unsigned char> > vPushes;
+        //! Whether the output is pay-to-pubkey or bare multisig (for BLOOM_UPDATE_P2PUBKEY_ONLY)
+        bool fPayToPubKey;
+    };
+
+    struct CInputKeys
+    {
+        //! The serialized prevout
+        std::vector<unsigned char> vPrevout;
+        //! Non-empty data pushes of the scriptSig, up to the first unparsable opcode
+        std::vector<std::vector<unsigned char> > vPushes;
+    };
+
+    uint256 hash;
+    std::vector<unsigned char> vHash;
+    std::vector<COutputKeys> vOutputs;
+    std::vector<CInputKeys> vInputs;
+
+    explicit CBloomTxKeys(const CTransaction& tx);
+};
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide
  * so that we can filter the transactions we send them.
@@ -53,6 +90,10 @@ private:
 
     unsigned int Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const;
 
+    //! The matching behind both IsRelevantAndUpdate overloads, over a CTransaction or its CBloomTxKeys
+    template <typename TxReader>
+    bool MatchAndUpdate(const TxReader& tx);
+
     // Private constructor for CRollingBloomFilter, no restrictions on size
     CBloomFilter(unsigned int nElements, double nFPRate, unsigned int nTweak);
     friend class CRollingBloomFilter;
@@ -97,6 +138,8 @@ public:
 
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+    //! Same as above, from keys already extracted from the transaction
+    bool IsRelevantAndUpdate(const CBloomTxKeys& keys);
 
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
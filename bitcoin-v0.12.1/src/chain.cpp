@@ -110,3 +110,24 @@ void CBlockIndex::BuildSkip()
     if (pprev)
         pskip = pprev->GetAncestor(GetSkipHeight(nHeight));
 }
+
+void* CBlockIndexArena::Allocate()
+{
+    if (nUsed == BLOCK_INDEX_ARENA_CHUNK_SIZE) {
+        vChunks.push_back(static_cast<CBlockIndex*>(::operator new(BLOCK_INDEX_ARENA_CHUNK_SIZE * sizeof(CBlockIndex))));
+        nUsed = 0;
+    }
+    return vChunks.back() + nUsed++;
+}
+
+void CBlockIndexArena::Clear()
+{
+    for (size_t i = 0; i < vChunks.size(); i++) {
+        size_t nEntries = i + 1 == vChunks.size() ? nUsed : BLOCK_INDEX_ARENA_CHUNK_SIZE;
+        for (size_t j = 0; j < nEntries; j++)
+            vChunks[i][j].~CBlockIndex();
+        ::operator delete(vChunks[i]);
+    }
+    vChunks.clear();
+    nUsed = BLOCK_INDEX_ARENA_CHUNK_SIZE;
+}
@@ -12,6 +12,7 @@
 #include "tinyformat.h"
 #include "uint256.h"
 
+#include <new>
 #include <vector>
 
 struct CDiskBlockPos // λ
@@ -280,6 +281,41 @@ public:
     const CBlockIndex* GetAncestor(int height) const;
 };
 
+/** Number of block index entries allocated at once by CBlockIndexArena */
+static const size_t BLOCK_INDEX_ARENA_CHUNK_SIZE = 4096;
+
+/**
+ * Allocates block index entries in chunks rather than one at a time, which
+ * saves the overhead of an allocation per entry and keeps entries created
+ * together (such as those loaded at startup) next to each other in memory.
+ * Entries are never freed one by one; Clear() destroys all of them.
+ */ // ķֿ
+class CBlockIndexArena
+{
+private:
+    std::vector<CBlockIndex*> vChunks;
+    //! entries used in the last chunk
+    size_t nUsed;
+
+    CBlockIndexArena(const CBlockIndexArena&);
+    void operator=(const CBlockIndexArena&);
+
+    //! storage for one more entry
+    void* Allocate();
+
+public:
+    CBlockIndexArena() : nUsed(BLOCK_INDEX_ARENA_CHUNK_SIZE) {}
+    ~CBlockIndexArena() { Clear(); }
+
+    CBlockIndex* New() { return new (Allocate()) CBlockIndex(); }
+    CBlockIndex* New(const CBlockHeader& block) { return new (Allocate()) CBlockIndex(block); }
+
+    //! destroy all entries and release their memory
+    void Clear();
+
+    size_t Size() const { return vChunks.empty() ? 0 : (vChunks.size() - 1) * BLOCK_INDEX_ARENA_CHUNK_SIZE + nUsed; }
+};
+
 /** Used to marshal pointers into hashes for db storage. */ // ڰָΪݿ洢Ĺϣֵ
 class CDiskBlockIndex : public CBlockIndex
 {
@@ -0,0 +1,72 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainsnapshot.h"
+
+#include "chain.h"
+#include "sync.h"
+
+#include <algorithm>
+
+CChainSnapshot::CChainSnapshot() : nHeight(-1), pindexBestHeader(NULL)
+{
+}
+
+CChainSnapshot::CChainSnapshot(const CChainSnapshot* pprev, const CChain& chain, CBlockIndex* pindexBestHeaderIn) :
+    nHeight(chain.Height()), pindexBestHeader(pindexBestHeaderIn)
+{
+    const int nChunks = (nHeight + CHAIN_SNAPSHOT_CHUNK_SIZE) / CHAIN_SNAPSHOT_CHUNK_SIZE;
+    vChunks.reserve(nChunks);
+    for (int i = 0; i < nChunks; i++) {
+        const int nStart = i * CHAIN_SNAPSHOT_CHUNK_SIZE;
+        const int nEnd = std::min(nStart + CHAIN_SNAPSHOT_CHUNK_SIZE, nHeight + 1);
+
+        // A full chunk whose last block is unchanged is unchanged as a whole,
+        // as every block index links to its predecessor.
+        if (pprev && nEnd - nStart == CHAIN_SNAPSHOT_CHUNK_SIZE && nEnd - 1 <= pprev->nHeight &&
+            (*pprev)[nEnd - 1] == chain[nEnd - 1]) {
+            vChunks.push_back(pprev->vChunks[i]);
+            continue;
+        }
+
+        boost::shared_ptr<Chunk> chunk(new Chunk());
+        chunk->reserve(nEnd - nStart);
+        for (int nHeightChunk = nStart; nHeightChunk < nEnd; nHeightChunk++)
+            chunk->push_back(chain[nHeightChunk]);
+        vChunks.push_back(chunk);
+    }
+}
+
+bool CChainSnapshot::Contains(const CBlockIndex* pindex) const
+{
+    return (*this)[pindex->nHeight] == pindex;
+}
+
+CBlockIndex* CChainSnapshot::Next(const CBlockIndex* pindex) const
+{
+    if (Contains(pindex))
+        return (*this)[pindex->nHeight + 1];
+    return NULL;
+}
+
+static CCriticalSection cs_chainSnapshot;
+static boost::shared_ptr<const CChainSnapshot> pchainSnapshot;
+
+void PublishChainSnapshot(const CChain& chain, CBlockIndex* pindexBestHeader)
+{
+    boost::shared_ptr<const CChainSnapshot> pnew(new CChainSnapshot(GetChainSnapshot().get(), chain, pindexBestHeader));
+    {
+        LOCK(cs_chainSnapshot);
+        pchainSnapshot.swap(pnew);
+    }
+    // The previous snapshot is released here, outside of the lock
+}
+
+boost::shared_ptr<const CChainSnapshot> GetChainSnapshot()
+{
+    LOCK(cs_chainSnapshot);
+    if (!pchainSnapshot)
+        return boost::shared_ptr<const CChainSnapshot>(new CChainSnapshot());
+    return pchainSnapshot;
+}
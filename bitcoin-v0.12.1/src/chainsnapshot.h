@@ -0,0 +1,65 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CHAINSNAPSHOT_H
+#define BITCOIN_CHAINSNAPSHOT_H
+
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+class CBlockIndex;
+class CChain;
+
+/** Number of block index pointers per chunk of a chain snapshot */
+static const int CHAIN_SNAPSHOT_CHUNK_SIZE = 2048;
+
+/**
+ * An immutable copy of the active chain and the best header, which can be
+ * used without holding cs_main. A new snapshot is published whenever the
+ * tip or the best header changes; readers keep using the one they got.
+ *
+ * Only the fields of CBlockIndex that never change once it is part of the
+ * chain (hash, header fields, height, pprev, chain work, nChainTx) may be
+ * read through a snapshot. Full chunks of the height index are shared
+ * between consecutive snapshots, so publishing one is cheap.
+ */
+class CChainSnapshot
+{
+private:
+    typedef std::vector<CBlockIndex*> Chunk;
+    std::vector<boost::shared_ptr<const Chunk> > vChunks;
+    int nHeight;
+    CBlockIndex* pindexBestHeader;
+
+public:
+    /** An empty snapshot */
+    CChainSnapshot();
+
+    /** Snapshot chain and pindexBestHeaderIn, sharing unchanged chunks with pprev (which may be NULL) */
+    CChainSnapshot(const CChainSnapshot* pprev, const CChain& chain, CBlockIndex* pindexBestHeaderIn);
+
+    int Height() const { return nHeight; }
+
+    CBlockIndex* operator[](int nHeightIn) const {
+        if (nHeightIn < 0 || nHeightIn > nHeight)
+            return NULL;
+        return (*vChunks[nHeightIn / CHAIN_SNAPSHOT_CHUNK_SIZE])[nHeightIn % CHAIN_SNAPSHOT_CHUNK_SIZE];
+    }
+
+    CBlockIndex* Genesis() const { return (*this)[0]; }
+    CBlockIndex* Tip() const { return (*this)[nHeight]; }
+    CBlockIndex* BestHeader() const { return pindexBestHeader; }
+
+    bool Contains(const CBlockIndex* pindex) const;
+    CBlockIndex* Next(const CBlockIndex* pindex) const;
+};
+
+/** Publish a snapshot of chain and pindexBestHeader. Callers must hold cs_main. */
+void PublishChainSnapshot(const CChain& chain, CBlockIndex* pindexBestHeader);
+
+/** The most recently published snapshot; an empty one before the first */
+boost::shared_ptr<const CChainSnapshot> GetChainSnapshot();
+
+#endif // BITCOIN_CHAINSNAPSHOT_H
@@ -2,18 +2,30 @@
 // Distributed under the MIT software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#if defined(HAVE_CONFIG_H)
+#include "config/bitcoin-config.h"
+#endif
+
 #include "dbwrapper.h"
 
 #include "util.h"
 #include "random.h"
+#include "utiltime.h"
+
+#include <algorithm>
+#include <set>
+#include <sstream>
 
+#include <boost/atomic.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/foreach.hpp>
 
 #include <leveldb/cache.h>
 #include <leveldb/env.h>
 #include <leveldb/filter_policy.h>
 #include <memenv.h>
 #include <stdint.h>
+#include <stdio.h>
 
 void HandleError(const leveldb::Status& status) throw(dbwrapper_error)
 {
@@ -29,14 +41,101 @@ void HandleError(const leveldb::Status& status) throw(dbwrapper_error)
     throw dbwrapper_error("Unknown database error");
 }
 
-static leveldb::Options GetOptions(size_t nCacheSize)
+//                                              name            cache% buffer% files bloom compress
+const CDBProfile DB_PROFILE_DEFAULT          = {"default",       50,    25,     64,   10,   false};
+// Coins are looked up at random and rewritten on every flush: favour write buffers
+const CDBProfile DB_PROFILE_CHAINSTATE       = {"chainstate",    30,    35,     1000, 10,   false};
+const CDBProfile DB_PROFILE_BLOCK_INDEX      = {"blockindex",    50,    25,     500,  10,   false};
+// Filters are incompressible and mostly written once
+const CDBProfile DB_PROFILE_BLOCK_FILTER     = {"blockfilter",   25,    25,     250,  10,   false};
+// Index keys share long script hash prefixes and compress well
+const CDBProfile DB_PROFILE_ADDRESS_INDEX    = {"addressindex",  50,    25,     500,  10,   true};
+
+static int nMaxOpenFilesLimit = 0;
+
+void SetDBMaxOpenFilesLimit(int nLimit)
+{
+    nMaxOpenFilesLimit = nLimit;
+}
+
+/**
+ * Block cache that counts how many lookups it could serve from memory. Every
+ * read of the database goes through Lookup, so the counters are atomics
+ * rather than guarded by a lock; they are only statistics, so relaxed
+ * ordering is enough.
+ */
+class CDBCountingCache : public leveldb::Cache
+{
+private:
+    leveldb::Cache* pcache;
+    boost::atomic<uint64_t> nHits;
+    boost::atomic<uint64_t> nMisses;
+
+public:
+    CDBCountingCache(size_t nCapacity) : pcache(leveldb::NewLRUCache(nCapacity)), nHits(0), nMisses(0) {}
+    ~CDBCountingCache() { delete pcache; }
+
+    Handle* Insert(const leveldb::Slice& key, void* value, size_t charge, void (*deleter)(const leveldb::Slice& key, void* value))
+    {
+        return pcache->Insert(key, value, charge, deleter);
+    }
+
+    Handle* Lookup(const leveldb::Slice& key)
+    {
+        Handle* handle = pcache->Lookup(key);
+        if (handle)
+            nHits.fetch_add(1, boost::memory_order_relaxed);
+        else
+            nMisses.fetch_add(1, boost::memory_order_relaxed);
+        return handle;
+    }
+
+    void Release(Handle* handle) { pcache->Release(handle); }
+    void* Value(Handle* handle) { return pcache->Value(handle); }
+    void Erase(const leveldb::Slice& key) { pcache->Erase(key); }
+    uint64_t NewId() { return pcache->NewId(); }
+
+    void GetCounts(uint64_t& nHitsOut, uint64_t& nMissesOut) const
+    {
+        nHitsOut = nHits.load(boost::memory_order_relaxed);
+        nMissesOut = nMisses.load(boost::memory_order_relaxed);
+    }
+};
+
+//! number of levels of a LevelDB database (config::kNumLevels)
+static const int NUM_LEVELS = 7;
+
+/** Databases currently open, for GetDBStats() */
+static boost::mutex csOpenDatabases;
+static std::set<const CDBWrapper*> setOpenDatabases;
+
+std::vector<CDBStats> GetDBStats()
+{
+    std::vector<CDBStats> vStats;
+    boost::mutex::scoped_lock lock(csOpenDatabases);
+    BOOST_FOREACH(const CDBWrapper* pdbw, setOpenDatabases) {
+        vStats.push_back(CDBStats());
+        pdbw->GetStats(vStats.back());
+    }
+    return vStats;
+}
+
+static leveldb::Options GetOptions(size_t nCacheSize, const CDBProfile& profile, CDBCountingCache*& pcache, size_t& nBlockCacheSize)
 {
     leveldb::Options options;
-    options.block_cache = leveldb::NewLRUCache(nCacheSize / 2);
-    options.write_buffer_size = nCacheSize / 4; // up to two write buffers may be held in memory simultaneously
-    options.filter_policy = leveldb::NewBloomFilterPolicy(10);
+    nBlockCacheSize = nCacheSize * profile.nBlockCachePercent / 100;
+    pcache = new CDBCountingCache(nBlockCacheSize);
+    options.block_cache = pcache;
+    options.write_buffer_size = nCacheSize * profile.nWriteBufferPercent / 100; // up to two write buffers may be held in memory simultaneously
+    options.filter_policy = profile.nBloomFilterBits > 0 ? leveldb::NewBloomFilterPolicy(profile.nBloomFilterBits) : NULL;
+#ifdef USE_SNAPPY
+    options.compression = profile.fCompress ? leveldb::kSnappyCompression : leveldb::kNoCompression;
+#else
     options.compression = leveldb::kNoCompression;
-    options.max_open_files = 64;
+#endif
+    options.max_open_files = profile.nMaxOpenFiles;
+    if (nMaxOpenFilesLimit > 0)
+        options.max_open_files = std::min(options.max_open_files, nMaxOpenFilesLimit);
     if (leveldb::kMajorVersion > 1 || (leveldb::kMajorVersion == 1 && leveldb::kMinorVersion >= 16)) {
         // LevelDB versions before 1.16 consider short writes to be corruption. Only trigger error
         // on corruption in later versions.
@@ -45,14 +144,15 @@ static leveldb::Options GetOptions(size_t nCacheSize)
     return options;
 }
 
-CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate)
+CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory, bool fWipe, bool obfuscate, const CDBProfile& profileIn) :
+    profile(profileIn), strPath(path.string()), nWrites(0), nWriteBytes(0), nWriteMicros(0), nMaxWriteMicros(0)
 {
     penv = NULL;
     readoptions.verify_checksums = true;
     iteroptions.verify_checksums = true;
     iteroptions.fill_cache = false;
     syncoptions.sync = true;
-    options = GetOptions(nCacheSize);
+    options = GetOptions(nCacheSize, profile, pcache, nBlockCacheSize);
     options.create_if_missing = true;
     if (fMemory) {
         penv = leveldb::NewMemEnv(leveldb::Env::Default());
@@ -64,7 +164,7 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
             HandleError(result);
         }
         TryCreateDirectory(path);
-        LogPrintf("Opening LevelDB in %s\n", path.string());
+        LogPrintf("Opening LevelDB in %s (%s profile, %d open files)\n", path.string(), profile.name, options.max_open_files);
     }
     leveldb::Status status = leveldb::DB::Open(options, path.string(), &pdb);
     HandleError(status);
@@ -88,10 +188,17 @@ CDBWrapper::CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, b
     }
 
     LogPrintf("Using obfuscation key for %s: %s\n", path.string(), GetObfuscateKeyHex());
+
+    boost::mutex::scoped_lock lock(csOpenDatabases);
+    setOpenDatabases.insert(this);
 }
 
 CDBWrapper::~CDBWrapper()
 {
+    {
+        boost::mutex::scoped_lock lock(csOpenDatabases);
+        setOpenDatabases.erase(this);
+    }
     delete pdb;
     pdb = NULL;
     delete options.filter_policy;
@@ -104,11 +211,61 @@ CDBWrapper::~CDBWrapper()
 
 bool CDBWrapper::WriteBatch(CDBBatch& batch, bool fSync) throw(dbwrapper_error)
 {
+    int64_t nTimeStart = GetTimeMicros();
     leveldb::Status status = pdb->Write(fSync ? syncoptions : writeoptions, &batch.batch); // pdb Ϊ leveldb ݿָ
+    int64_t nTime = GetTimeMicros() - nTimeStart; //  LevelDB ѹ϶ʱ
+    {
+        boost::mutex::scoped_lock lock(csWriteStats);
+        nWrites++;
+        nWriteBytes += batch.SizeEstimate();
+        nWriteMicros += nTime;
+        nMaxWriteMicros = std::max(nMaxWriteMicros, nTime);
+    }
     HandleError(status);
     return true;
 }
 
+void CDBWrapper::GetStats(CDBStats& stats) const
+{
+    stats.strName = profile.name;
+    stats.strPath = strPath;
+    stats.nBlockCacheSize = nBlockCacheSize;
+    stats.nWriteBufferSize = options.write_buffer_size;
+    stats.nMaxOpenFiles = options.max_open_files;
+    stats.nBloomFilterBits = profile.nBloomFilterBits;
+    stats.fCompress = options.compression == leveldb::kSnappyCompression;
+    pcache->GetCounts(stats.nCacheHits, stats.nCacheMisses);
+    {
+        boost::mutex::scoped_lock lock(csWriteStats);
+        stats.nWrites = nWrites;
+        stats.nWriteBytes = nWriteBytes;
+        stats.nWriteMicros = nWriteMicros;
+        stats.nMaxWriteMicros = nMaxWriteMicros;
+    }
+
+    stats.vLevels.assign(NUM_LEVELS, CDBLevelStats());
+    std::string strValue;
+    for (int nLevel = 0; nLevel < NUM_LEVELS; nLevel++) {
+        if (pdb->GetProperty("leveldb.num-files-at-level" + itostr(nLevel), &strValue))
+            stats.vLevels[nLevel].nFiles = atoi(strValue);
+    }
+    // The compaction table of "leveldb.stats" lists the levels that have files or were compacted:
+    // Level  Files Size(MB) Time(sec) Read(MB) Write(MB)
+    if (pdb->GetProperty("leveldb.stats", &strValue)) {
+        std::istringstream ss(strValue);
+        std::string strLine;
+        while (std::getline(ss, strLine)) {
+            int nLevel, nFiles;
+            CDBLevelStats level;
+            if (sscanf(strLine.c_str(), "%d %d %lf %lf %lf %lf", &nLevel, &nFiles, &level.dSizeMB, &level.dCompactionSeconds,
+                       &level.dCompactionReadMB, &level.dCompactionWriteMB) != 6 || nLevel < 0 || nLevel >= NUM_LEVELS)
+                continue;
+            level.nFiles = nFiles;
+            stats.vLevels[nLevel] = level;
+        }
+    }
+}
+
 // Prefixed with null character to avoid collisions with other keys
 //
 // We must use a string constructor which specifies length so that we copy
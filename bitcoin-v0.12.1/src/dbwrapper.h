@@ -13,6 +13,7 @@
 #include "version.h"
 
 #include <boost/filesystem/path.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include <leveldb/db.h>
 #include <leveldb/write_batch.h>
@@ -25,6 +26,69 @@ public:
 
 void HandleError(const leveldb::Status& status) throw(dbwrapper_error);
 
+/**
+ * How a database divides its cache and which LevelDB features it uses, chosen
+ * to suit the way the database is accessed.
+ */ // ݿ LevelDB ÷
+struct CDBProfile
+{
+    //! name under which getdbstats reports the database
+    const char* name;
+    //! share of the cache, in percent, holding uncompressed table blocks
+    int nBlockCachePercent;
+    //! share of the cache, in percent, for each write buffer; up to two may be in memory
+    int nWriteBufferPercent;
+    //! table files kept open, see SetDBMaxOpenFilesLimit()
+    int nMaxOpenFiles;
+    //! bits per key of the bloom filter that saves disk reads for missing keys, 0 for none
+    int nBloomFilterBits;
+    //! compress tables with Snappy, if LevelDB was built with it (--with-snappy)
+    bool fCompress;
+};
+
+extern const CDBProfile DB_PROFILE_DEFAULT;
+extern const CDBProfile DB_PROFILE_CHAINSTATE;
+extern const CDBProfile DB_PROFILE_BLOCK_INDEX;
+extern const CDBProfile DB_PROFILE_BLOCK_FILTER;
+extern const CDBProfile DB_PROFILE_ADDRESS_INDEX;
+
+/** Cap the table files each database opened from now on keeps open; 0 for no cap */
+void SetDBMaxOpenFilesLimit(int nLimit);
+
+/** Compaction statistics of one LevelDB level */
+struct CDBLevelStats
+{
+    int nFiles;
+    double dSizeMB;
+    double dCompactionSeconds;
+    double dCompactionReadMB;
+    double dCompactionWriteMB;
+
+    CDBLevelStats() : nFiles(0), dSizeMB(0), dCompactionSeconds(0), dCompactionReadMB(0), dCompactionWriteMB(0) {}
+};
+
+/** Configuration and usage statistics of an open database */
+struct CDBStats
+{
+    std::string strName;
+    std::string strPath;
+    size_t nBlockCacheSize;
+    size_t nWriteBufferSize;
+    int nMaxOpenFiles;
+    int nBloomFilterBits;
+    bool fCompress;         //! whether tables are actually compressed
+    uint64_t nCacheHits;    //! block cache lookups served from memory
+    uint64_t nCacheMisses;  //! block cache lookups that read from disk
+    uint64_t nWrites;
+    uint64_t nWriteBytes;
+    int64_t nWriteMicros;   //! total time spent in writes, including LevelDB write throttling
+    int64_t nMaxWriteMicros;
+    std::vector<CDBLevelStats> vLevels;
+};
+
+/** Collect the statistics of every open database */
+std::vector<CDBStats> GetDBStats();
+
 /** Batch of changes queued to be written to a CDBWrapper */
 class CDBBatch // Ŷӵȴд CDBWrapper 
 {
@@ -33,12 +97,13 @@ class CDBBatch // 
 private:
     leveldb::WriteBatch batch;
     const std::vector<unsigned char> *obfuscate_key;
+    size_t size_estimate; // дļֵֽ
 
 public:
     /**
      * @param[in] obfuscate_key    If passed, XOR data with this key.
      */
-    CDBBatch(const std::vector<unsigned char> *obfuscate_key) : obfuscate_key(obfuscate_key) { };
+    CDBBatch(const std::vector<unsigned char> *obfuscate_key) : obfuscate_key(obfuscate_key), size_estimate(0) { };
 
     template <typename K, typename V>
     void Write(const K& key, const V& value)
@@ -55,6 +120,7 @@ public:
         leveldb::Slice slValue(&ssValue[0], ssValue.size());
 
         batch.Put(slKey, slValue);
+        size_estimate += ssKey.size() + ssValue.size();
     }
 
     template <typename K>
@@ -66,7 +132,10 @@ public:
         leveldb::Slice slKey(&ssKey[0], ssKey.size());
 
         batch.Delete(slKey);
+        size_estimate += ssKey.size();
     }
+
+    size_t SizeEstimate() const { return size_estimate; }
 };
 
 class CDBIterator // ݿ
@@ -132,6 +201,8 @@ public:
 
 };
 
+class CDBCountingCache;
+
 class CDBWrapper // 飩ݿװ leveldb
 {
 private:
@@ -156,6 +227,23 @@ private:
     //! the database itself
     leveldb::DB* pdb;
 
+    //! the profile the database was opened with
+    const CDBProfile& profile;
+
+    //! location of the database, or its name for in-memory databases
+    std::string strPath;
+
+    //! block cache counting its hits, same as options.block_cache
+    CDBCountingCache* pcache;
+    size_t nBlockCacheSize;
+
+    //! write statistics, protected by csWriteStats
+    mutable boost::mutex csWriteStats;
+    uint64_t nWrites;
+    uint64_t nWriteBytes;
+    int64_t nWriteMicros;
+    int64_t nMaxWriteMicros;
+
     //! a key used for optional XOR-obfuscation of the database
     std::vector<unsigned char> obfuscate_key;
 
@@ -175,8 +263,9 @@ public:
      * @param[in] fWipe       If true, remove all existing data.
      * @param[in] obfuscate   If true, store data obfuscated via simple XOR. If false, XOR
      *                        with a zero'd byte array.
+     * @param[in] profile     How to divide the cache and which LevelDB features to use.
      */
-    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false);
+    CDBWrapper(const boost::filesystem::path& path, size_t nCacheSize, bool fMemory = false, bool fWipe = false, bool obfuscate = false, const CDBProfile& profile = DB_PROFILE_DEFAULT);
     ~CDBWrapper();
 
     template <typename K, typename V>
@@ -259,11 +348,36 @@ public:
         return new CDBIterator(pdb->NewIterator(iteroptions), &obfuscate_key);
     }
 
+    /**
+     * Take a snapshot of the current state of the database. Reads through it
+     * are not affected by later writes. Release it with ReleaseSnapshot().
+     */
+    const leveldb::Snapshot* GetSnapshot() const
+    {
+        return pdb->GetSnapshot();
+    }
+
+    void ReleaseSnapshot(const leveldb::Snapshot* psnapshot) const
+    {
+        pdb->ReleaseSnapshot(psnapshot);
+    }
+
+    /** Iterate over the database as of psnapshot. */
+    CDBIterator *NewIterator(const leveldb::Snapshot* psnapshot) const
+    {
+        leveldb::ReadOptions options = iteroptions;
+        options.snapshot = psnapshot; // ӿնȡ
+        return new CDBIterator(pdb->NewIterator(options), &obfuscate_key);
+    }
+
     /**
      * Return true if the database managed by this class contains no entries.
      */
     bool IsEmpty();
 
+    /** Fill in the configuration and usage statistics of the database */
+    void GetStats(CDBStats& stats) const;
+
     /**
      * Accessor for obfuscate_key.
      */
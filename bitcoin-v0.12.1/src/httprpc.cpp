@@ -3,6 +3,7 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "httpserver.h"
+#include "jsonstream.h"
 #include "rpcprotocol.h"
 #include "rpcserver.h"
 #include "random.h"
@@ -15,7 +16,9 @@
 #include "utilstrencodings.h"
 
 #include <boost/algorithm/string.hpp> // boost::trim
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp> //BOOST_FOREACH
+#include <boost/shared_ptr.hpp>
 
 /** WWW-Authenticate to present with 401 Unauthorized response */
 static const char* WWW_AUTH_HEADER_DATA = "Basic realm=\"jsonrpc\"";
@@ -56,12 +59,207 @@ private:
     struct event_base* base;
 };
 
+/** Amount of batch reply data to collect before sending it to the client */
+static const size_t BATCH_REPLY_CHUNK_SIZE = 64 * 1024;
+
+/**
+ * A run of consecutive read-only elements [nBegin, nEnd) of a JSON-RPC
+ * batch. Elements are claimed one at a time, both by the worker serving the
+ * batch and by helpers it queued for the other HTTP workers, so the run
+ * completes even if none of the helpers gets to run.
+ */ // ֻɶ HTTP ִ̲߳
+class JSONRPCBatchJob
+{
+private:
+    const UniValue& vReq; //!< Only accessed for claimed elements, which the serving worker waits for
+    const size_t nBegin;
+    const size_t nEnd;
+
+    CWaitableCriticalSection cs;
+    CConditionVariable cond;
+    size_t nNext; //!< First element not claimed yet
+    std::vector<std::string> vReply; //!< Serialized replies, relative to nBegin
+    std::vector<bool> vDone;
+
+public:
+    JSONRPCBatchJob(const UniValue& vReqIn, size_t nBeginIn, size_t nEndIn) :
+        vReq(vReqIn), nBegin(nBeginIn), nEnd(nEndIn), nNext(nBeginIn),
+        vReply(nEndIn - nBeginIn), vDone(nEndIn - nBeginIn, false)
+    {
+    }
+
+    /** Execute the next unclaimed element. Returns false if there is none left. */
+    bool RunOne()
+    {
+        size_t i;
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            if (nNext == nEnd)
+                return false;
+            i = nNext++;
+        }
+        std::string strReply = JSONRPCExecOne(vReq[i]).write();
+        {
+            boost::unique_lock<boost::mutex> lock(cs);
+            vReply[i - nBegin].swap(strReply);
+            vDone[i - nBegin] = true;
+        }
+        cond.notify_all();
+        return true;
+    }
+
+    bool IsDone(size_t i)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        return vDone[i - nBegin];
+    }
+
+    /** Wait for element i to be executed and take its reply. */
+    std::string TakeReply(size_t i)
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (!vDone[i - nBegin])
+            cond.wait(lock);
+        std::string strReply;
+        strReply.swap(vReply[i - nBegin]);
+        return strReply;
+    }
+};
+
+/** Work item helping to execute a JSONRPCBatchJob on another HTTP worker */
+class JSONRPCBatchHelper : public HTTPClosure
+{
+public:
+    JSONRPCBatchHelper(const boost::shared_ptr<JSONRPCBatchJob>& jobIn) : job(jobIn)
+    {
+    }
+    void operator()()
+    {
+        while (job->RunOne()) {}
+    }
+
+private:
+    boost::shared_ptr<JSONRPCBatchJob> job;
+};
+
+/**
+ * Execute a JSON-RPC batch, streaming the reply array to the client in
+ * request order. Runs of consecutive read-only calls are spread over the
+ * HTTP worker threads; any other call runs by itself, after everything
+ * before it, so that the calls following it see its effects.
+ */ // JSONRPC ִУԷֿӦ˳ͽ
+static void JSONRPCExecBatch(HTTPRequest* req, const UniValue& vReq)
+{
+    int nHelpers = std::max((int)GetArg("-rpcthreads", DEFAULT_HTTP_THREADS), 1) - 1; // Э߳
+
+    req->WriteHeader("Content-Type", "application/json");
+    req->StartReply(HTTP_OK);
+
+    std::string strChunk = "[";
+    for (size_t i = 0; i < vReq.size(); ) {
+        // Find the run of read-only calls starting here // ҵ￪ʼֻ
+        size_t nEnd = i + 1;
+        if (nHelpers > 0 && JSONRPCIsReadOnly(vReq[i])) {
+            while (nEnd < vReq.size() && JSONRPCIsReadOnly(vReq[nEnd]))
+                nEnd++;
+        }
+
+        if (nEnd - i == 1) {
+            if (i > 0)
+                strChunk += ",";
+            strChunk += JSONRPCExecOne(vReq[i]).write();
+        } else {
+            boost::shared_ptr<JSONRPCBatchJob> job(new JSONRPCBatchJob(vReq, i, nEnd));
+            for (size_t n = 0; n < std::min((size_t)nHelpers, nEnd - i - 1); n++) {
+                std::auto_ptr<JSONRPCBatchHelper> helper(new JSONRPCBatchHelper(job));
+                if (!HTTPQueueWork(helper.get()))
+                    break; // зæʣಿԼִ
+                helper.release();
+            }
+
+            // Do our share of the work, passing on replies in order as they become available
+            for (size_t j = i; j < nEnd; j++) {
+                while (!job->IsDone(j) && job->RunOne()) {}
+                if (j > 0)
+                    strChunk += ",";
+                strChunk += job->TakeReply(j);
+                if (strChunk.size() >= BATCH_REPLY_CHUNK_SIZE) {
+                    req->WriteReplyChunk(strChunk);
+                    strChunk.clear();
+                }
+            }
+        }
+        i = nEnd;
+
+        if (strChunk.size() >= BATCH_REPLY_CHUNK_SIZE) {
+            req->WriteReplyChunk(strChunk);
+            strChunk.clear();
+        }
+    }
+    strChunk += "]\n";
+    req->WriteReplyChunk(strChunk);
+    req->EndReply();
+}
+
 
 /* Pre-base64-encoded authentication token */
 static std::string strRPCUserColonPass; // base64 Ԥ֤
 /* Stored RPC timer interface (for unregistration) */ // 洢 RPC ʱӿڣڽעᣩ
 static HTTPRPCTimerInterface* httpRPCTimerInterface = 0;
 
+/**
+ * End a streamed reply whose result failed after part of it was sent. The
+ * HTTP status can no longer change, so the partial result is closed and the
+ * error goes into the reply object, where JSON-RPC clients look for it.
+ */ // ֽѷͺرĽӦд
+static void JSONRPCStreamError(HTTPRequest* req, CJSONStreamWriter& writer, const JSONRequest& jreq, const UniValue& objError)
+{
+    LogPrintf("%s: %s failed after part of its result was sent\n", __func__, SanitizeString(jreq.strMethod));
+    writer.CloseTo(1);
+    writer.KeyValue("error", objError);
+    writer.KeyValue("id", jreq.id);
+    writer.EndObject();
+    writer.WriteRaw("\n");
+    writer.Flush();
+    req->EndReply();
+}
+
+/**
+ * Execute a singleton request whose result can be streamed, sending the
+ * reply as the result is produced. Small results still go out as one reply.
+ */ // ִпʽĵ󣬱ɱ߷Ӧ
+static void JSONRPCExecStream(HTTPRequest* req, const JSONRequest& jreq)
+{
+    CJSONStreamWriter writer(boost::bind(&WriteJSONReplyChunk, req, _1));
+    writer.BeginObject();
+    writer.Key("result");
+    try {
+        tableRPC.executeStream(jreq.strMethod, jreq.params, writer);
+    } catch (const UniValue& objError) {
+        if (!writer.HasFlushed())
+            throw; // nothing was sent yet, reply with the error as usual // δκݣճظ
+        JSONRPCStreamError(req, writer, jreq, objError);
+        return;
+    } catch (const std::exception& e) {
+        if (!writer.HasFlushed())
+            throw;
+        JSONRPCStreamError(req, writer, jreq, JSONRPCError(RPC_MISC_ERROR, e.what()));
+        return;
+    }
+    writer.KeyValue("error", NullUniValue);
+    writer.KeyValue("id", jreq.id);
+    writer.EndObject();
+    writer.WriteRaw("\n");
+
+    if (writer.HasFlushed()) {
+        writer.Flush();
+        req->EndReply();
+    } else {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, writer.GetBuffer());
+    }
+}
+
 static void JSONErrorReply(HTTPRequest* req, const UniValue& objError, const UniValue& id)
 {
     // Send error reply from json-rpc error object
@@ -180,15 +378,21 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &) // HTTP 
         if (valRequest.isObject()) { // һ
             jreq.parse(valRequest); // 󣬷 JSON 
 
+            if (tableRPC.canStream(jreq.strMethod)) { // ܽϴʽ
+                JSONRPCExecStream(req, jreq);
+                return true;
+            }
+
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params); // ӦĲִзȡӦ
 
             // Send reply // Ӧ
             strReply = JSONRPCReply(result, NullUniValue, jreq.id); // װΪ JSONRPC Ӧַ
 
         // array of requests // 
-        } else if (valRequest.isArray()) // 4.2.
-            strReply = JSONRPCExecBatch(valRequest.get_array()); // ȡӦַ
-        else
+        } else if (valRequest.isArray()) { // 4.2.
+            JSONRPCExecBatch(req, valRequest.get_array()); // ֿ鷢͸Ӧ
+            return true;
+        } else
             throw JSONRPCError(RPC_PARSE_ERROR, "Top-level object parse error");
 
         req->WriteHeader("Content-Type", "application/json"); // 5.дӦͷ
@@ -111,11 +111,11 @@ public:
             queue.pop_front();
         }
     }
-    /** Enqueue a work item */
-    bool Enqueue(WorkItem* item)
+    /** Enqueue a work item, leaving room for at least nReserve more */
+    bool Enqueue(WorkItem* item, size_t nReserve = 0)
     {
         boost::unique_lock<boost::mutex> lock(cs);
-        if (queue.size() >= maxDepth) {
+        if (queue.size() + nReserve >= maxDepth) {
             return false;
         }
         queue.push_back(item);
@@ -162,6 +162,12 @@ public:
         boost::unique_lock<boost::mutex> lock(cs);
         return queue.size();
     }
+
+    /** Return the maximum depth of the queue */
+    size_t MaxDepth() const
+    {
+        return maxDepth;
+    }
 };
 
 struct HTTPPathHandler
@@ -513,6 +519,13 @@ struct event_base* EventBase()
     return eventBase;
 }
 
+bool HTTPQueueWork(HTTPClosure* item)
+{
+    assert(workQueue);
+    // Keep half of the queue free for incoming requests // ΪµһĶ
+    return workQueue->Enqueue(item, workQueue->MaxDepth() / 2);
+}
+
 static void httpevent_callback_fn(evutil_socket_t, short, void* data)
 {
     // Static handler: simply call inner handler
@@ -540,12 +553,15 @@ void HTTPEvent::trigger(struct timeval* tv)
         evtimer_add(ev, tv); // trigger after timeval passed // ڹȥ timeval 󴥷
 }
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
+                                                       replyStarted(false),
                                                        replySent(false)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (replyStarted && !replySent) { // ѿʼֿӦ
+        EndReply();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -610,6 +626,132 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread // л߳
 }
 
+/** Chunks of a reply on their way from a worker to the client, see WriteReplyChunk */
+class HTTPReplyBacklog
+{
+public:
+    HTTPReplyBacklog() : nQueued(0), nUnflushed(0), fClosed(false) {}
+
+    CWaitableCriticalSection cs;
+    CConditionVariable cond;
+    //! Chunks queued as events that the event thread has not handed to evhttp yet
+    int nQueued;
+    //! Chunks handed to evhttp that are still in the connection's output buffer
+    int nUnflushed;
+    //! Whether the connection went away, after which chunks are dropped
+    bool fClosed;
+};
+
+/** Recheck a reply that is waiting for its chunks to be sent. Runs in the event thread. */
+static void http_probe_reply(struct evhttp_request* req, boost::shared_ptr<HTTPReplyBacklog> backlog)
+{
+    // libevent detaches the request from a failed connection until the reply is ended
+    if (evhttp_request_get_connection(req) == NULL) {
+        boost::lock_guard<boost::mutex> lock(backlog->cs);
+        backlog->fClosed = true;
+    }
+    backlog->cond.notify_all();
+}
+
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+/** Called by evhttp when the connection's output buffer has been written out */
+static void http_reply_flushed(struct evhttp_connection* evcon, void* arg)
+{
+    HTTPReplyBacklog* backlog = static_cast<HTTPReplyBacklog*>(arg);
+    {
+        boost::lock_guard<boost::mutex> lock(backlog->cs);
+        backlog->nUnflushed = 0;
+    }
+    backlog->cond.notify_all();
+}
+#endif
+
+static void http_send_reply_chunk(struct evhttp_request* req, struct evbuffer* evb, boost::shared_ptr<HTTPReplyBacklog> backlog)
+{
+    bool fClosed = evhttp_request_get_connection(req) == NULL;
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+    // The backlog outlives the callback: EndReply's event holds it until evhttp replaces the callback
+    evhttp_send_reply_chunk_with_cb(req, evb, http_reply_flushed, backlog.get()); // Ƴ evb е
+#else
+    // Older libevent cannot tell when the output buffer is written out, so only the queue is bounded
+    evhttp_send_reply_chunk(req, evb);
+#endif
+    evbuffer_free(evb);
+    {
+        boost::lock_guard<boost::mutex> lock(backlog->cs);
+        backlog->nQueued--;
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+        if (!fClosed)
+            backlog->nUnflushed++;
+#endif
+        backlog->fClosed |= fClosed;
+    }
+    backlog->cond.notify_all();
+}
+
+static void http_send_reply_end(struct evhttp_request* req, boost::shared_ptr<HTTPReplyBacklog> backlog)
+{
+    evhttp_send_reply_end(req);
+}
+
+void HTTPRequest::StartReply(int nStatus)
+{
+    assert(!replyStarted && !replySent && req);
+    // Chunks are queued as events behind this one, so they go out in order // ֿΪ¼󣬰˳
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(evhttp_send_reply_start, req, nStatus, (const char*)NULL));
+    ev->trigger(0);
+    backlog.reset(new HTTPReplyBacklog());
+    replyStarted = true;
+}
+
+void HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(replyStarted && !replySent && req);
+    if (strChunk.empty()) // an empty chunk would end the reply
+        return;
+    {
+        boost::unique_lock<boost::mutex> lock(backlog->cs);
+        while (!backlog->fClosed && backlog->nQueued + backlog->nUnflushed >= MAX_HTTP_REPLY_CHUNKS_IN_FLIGHT) {
+            // Nothing wakes us up if the connection fails while its buffer is full, so look now and then;
+            // the server timeout closes connections that stop reading
+            if (!backlog->cond.timed_wait(lock, boost::posix_time::microsec_clock::universal_time() + boost::posix_time::seconds(1))) {
+                HTTPEvent* ev = new HTTPEvent(eventBase, true, boost::bind(http_probe_reply, req, backlog));
+                ev->trigger(0);
+            }
+        }
+        if (backlog->fClosed)
+            return;
+        backlog->nQueued++;
+    }
+    struct evbuffer* evb = evbuffer_new(); // ¼̷߳ͺͷ
+    assert(evb);
+    evbuffer_add(evb, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_send_reply_chunk, req, evb, backlog));
+    ev->trigger(0);
+}
+
+void HTTPRequest::EndReply()
+{
+    assert(replyStarted && !replySent && req);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_send_reply_end, req, backlog));
+    ev->trigger(0);
+    backlog.reset();
+    replySent = true;
+    req = 0; // transferred back to main thread // л߳
+}
+
+void WriteJSONReplyChunk(HTTPRequest* req, const std::string& strChunk)
+{
+    if (!req->ReplyStarted()) {
+        req->WriteHeader("Content-Type", "application/json");
+        req->StartReply(HTTP_OK);
+    }
+    req->WriteReplyChunk(strChunk);
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
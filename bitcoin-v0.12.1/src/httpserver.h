@@ -9,16 +9,20 @@
 #include <stdint.h>
 #include <boost/thread.hpp>
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/function.hpp>
 
 static const int DEFAULT_HTTP_THREADS=4; // HTTP RPC ߳ĬΪ 4
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** Chunks of a reply that may be on their way to the client before WriteReplyChunk waits */
+static const int MAX_HTTP_REPLY_CHUNKS_IN_FLIGHT=4;
 
 struct evhttp_request;
 struct event_base;
 class CService;
 class HTTPRequest;
+class HTTPReplyBacklog;
 
 /** Initialize HTTP server.
  * Call this before RegisterHTTPHandler or EventBase().
@@ -49,6 +53,14 @@ void UnregisterHTTPHandler(const std::string &prefix, bool exactMatch);
  */
 struct event_base* EventBase();
 
+class HTTPClosure;
+
+/** Run a closure on one of the HTTP worker threads, as long as that leaves
+ * room in the work queue for incoming requests. The queue takes ownership of
+ * item only if this returns true.
+ */ //  HTTP ߳񣬷 false ʾûиռ
+bool HTTPQueueWork(HTTPClosure* item);
+
 /** In-flight HTTP request.
  * Thin C++ wrapper around evhttp_request.
  */ // ڽе HTTP evhttp_request  C++ װװ
@@ -56,7 +68,9 @@ class HTTPRequest
 {
 private:
     struct evhttp_request* req;
+    bool replyStarted;
     bool replySent;
+    boost::shared_ptr<HTTPReplyBacklog> backlog;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -112,8 +126,39 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */ // д HTTP ӦnStatus  HTTP ͵״̬롣strReply Ӧ塣Ϊһ׼Ϣ
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply with status nStatus. Follow with any number
+     * of WriteReplyChunk calls and one EndReply, instead of WriteReply.
+     *
+     * @note Call WriteHeader before this, as the headers are sent with it.
+     */ // ʼֿ鷢 HTTP ӦƴӦĴӦ
+    void StartReply(int nStatus);
+
+    /**
+     * Send the next part of a reply started with StartReply. This waits while
+     * MAX_HTTP_REPLY_CHUNKS_IN_FLIGHT earlier chunks have not been sent, so a
+     * slow client holds up the producer instead of filling memory; do not hold
+     * locks other threads need while calling it.
+     */
+    void WriteReplyChunk(const std::string& strChunk);
+
+    /** Whether StartReply has been called. */
+    bool ReplyStarted() const { return replyStarted; }
+
+    /**
+     * Finish a reply started with StartReply. Like WriteReply, this gives
+     * the request back to the main thread.
+     */
+    void EndReply();
 };
 
+/**
+ * Send part of a chunked "200 OK" JSON reply, starting the reply on the
+ * first call. Meant as the sink of a CJSONStreamWriter.
+ */ // ͷֿ JSON Ӧһ֣״εʱʼӦ
+void WriteJSONReplyChunk(HTTPRequest* req, const std::string& strChunk);
+
 /** Event handler closure.
  */ // ¼ر
 class HTTPClosure // HTTP ر
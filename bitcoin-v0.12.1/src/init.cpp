@@ -11,6 +11,7 @@
 
 #include "addrman.h"
 #include "amount.h"
+#include "blockwriter.h"
 #include "chain.h"
 #include "chainparams.h"
 #include "checkpoints.h"
@@ -158,7 +159,6 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller. // д벻ҪƵıΪʧɵߴġ
 };
 
-static CCoinsViewDB *pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher *pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle; // ָ STL  std::unique_ptr 
 
@@ -224,6 +224,10 @@ void Shutdown()
         pcoinsdbview = NULL;
         delete pblocktree; // ɾݿ
         pblocktree = NULL;
+        delete pblockfilterdb; // ɾݿ
+        pblockfilterdb = NULL;
+        delete paddressindexdb; // ɾַݿ
+        paddressindexdb = NULL;
     }
 #ifdef ENABLE_WALLET
     if (pwalletMain)
@@ -317,7 +321,9 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-?", _("This help message"));
     strUsage += HelpMessageOpt("-version", _("Print version and exit"));
     strUsage += HelpMessageOpt("-alerts", strprintf(_("Receive and display P2P network alerts (default: %u)"), DEFAULT_ALERTS));
+    strUsage += HelpMessageOpt("-addressindex", strprintf(_("Maintain an index of the outputs and spends of every scriptPubKey, used by the getaddress* RPC calls (default: %u)"), DEFAULT_ADDRESSINDEX));
     strUsage += HelpMessageOpt("-alertnotify=<cmd>", _("Execute command when a relevant alert is received or we see a really long fork (%s in cmd is replaced by message)"));
+    strUsage += HelpMessageOpt("-blockfilterindex", strprintf(_("Maintain an index of compact block filters (BIP 157/158) and serve them to light clients (default: %u)"), DEFAULT_BLOCKFILTERINDEX));
     strUsage += HelpMessageOpt("-blocknotify=<cmd>", _("Execute command when the best block changes (%s in cmd is replaced by block hash)"));
     if (showDebug)
         strUsage += HelpMessageOpt("-blocksonly", strprintf(_("Whether to operate in a blocks only mode (default: %u)"), DEFAULT_BLOCKSONLY));
@@ -332,6 +338,8 @@ std::string HelpMessage(HelpMessageMode mode)
     }
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
+    if (showDebug)
+        strUsage += HelpMessageOpt("-feefilter", strprintf("Tell other nodes to filter invs to us by our mempool min fee (default: %u)", DEFAULT_FEEFILTER));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file on startup"));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-maxmempool=<n>", strprintf(_("Keep the transaction memory pool below <n> megabytes (default: %u)"), DEFAULT_MAX_MEMPOOL_SIZE));
@@ -341,14 +349,14 @@ std::string HelpMessage(HelpMessageMode mode)
 #ifndef WIN32
     strUsage += HelpMessageOpt("-pid=<file>", strprintf(_("Specify pid file (default: %s)"), BITCOIN_PID_FILENAME));
 #endif
-    strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by pruning (deleting) old blocks. This mode is incompatible with -txindex and -rescan. "
+    strUsage += HelpMessageOpt("-prune=<n>", strprintf(_("Reduce storage requirements by pruning (deleting) old blocks. This mode is incompatible with -txindex, -blockfilterindex, -addressindex and -rescan. "
             "Warning: Reverting this setting requires re-downloading the entire blockchain. "
             "(default: 0 = disable pruning blocks, >%u = target size in MiB to use for block files)"), MIN_DISK_SPACE_FOR_BLOCK_FILES / 1024 / 1024));
     strUsage += HelpMessageOpt("-reindex", _("Rebuild block chain index from current blk000??.dat files on startup"));
 #ifndef WIN32
     strUsage += HelpMessageOpt("-sysperms", _("Create new files with system default permissions, instead of umask 077 (only effective with disabled wallet functionality)"));
 #endif
-    strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call (default: %u)"), DEFAULT_TXINDEX));
+    strUsage += HelpMessageOpt("-txindex", strprintf(_("Maintain a full transaction index, used by the getrawtransaction rpc call; when first enabled it is built in the background (default: %u)"), DEFAULT_TXINDEX));
 
     strUsage += HelpMessageGroup(_("Connection options:"));
     strUsage += HelpMessageOpt("-addnode=<ip>", _("Add a node to connect to and attempt to keep the connection open"));
@@ -850,6 +858,10 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler) // [P]3.1
     if (GetArg("-prune", 0)) { // ޼ģʽýĬϹر
         if (GetBoolArg("-txindex", DEFAULT_TXINDEX)) // ޼ģʽݣĬϹر
             return InitError(_("Prune mode is incompatible with -txindex.")); // ݵԭ޼ģʽֻͷǽ txid
+        if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) // ʱȡͳݣ
+            return InitError(_("Prune mode is incompatible with -blockfilterindex."));
+        if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) // ַͻعʱȡͳݣ
+            return InitError(_("Prune mode is incompatible with -addressindex."));
 #ifdef ENABLE_WALLET // Ǯ
         if (GetBoolArg("-rescan", false)) { // ɨ裨޼ģʽ²ʹãʹ -reindex ٴĬϹر
             return InitError(_("Rescans are not possible in pruned mode. You will need to use -reindex which will download the whole blockchain again."));
@@ -862,12 +874,32 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler) // [P]3.1
     int nUserMaxConnections = GetArg("-maxconnections", DEFAULT_MAX_PEER_CONNECTIONS); // Ĭ 125
     nMaxConnections = std::max(nUserMaxConnections, 0); // ¼ĬΪ 125
 
+    // LevelDB keeps table files open too, and each of them pushes the socket descriptors up like a connection does.
+    // Every database keeps at least DB_PROFILE_DEFAULT.nMaxOpenFiles of them open: MIN_CORE_FILEDESCRIPTORS covers
+    // that for the chainstate and the block index, and each optional index adds as much to the core descriptors.
+    int nDatabases = 2; // ״̬ݿ
+    int nDBFiles = DB_PROFILE_CHAINSTATE.nMaxOpenFiles + DB_PROFILE_BLOCK_INDEX.nMaxOpenFiles;
+    if (GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX)) {
+        nDatabases++;
+        nDBFiles += DB_PROFILE_BLOCK_FILTER.nMaxOpenFiles;
+    }
+    if (GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX)) {
+        nDatabases++;
+        nDBFiles += DB_PROFILE_ADDRESS_INDEX.nMaxOpenFiles;
+    }
+    const int nCoreFD = MIN_CORE_FILEDESCRIPTORS + (nDatabases - 2) * DB_PROFILE_DEFAULT.nMaxOpenFiles;
+    nDBFiles -= nDatabases * DB_PROFILE_DEFAULT.nMaxOpenFiles; // files the profiles want beyond the core ones
+
     // Trim requested connection counts, to fit into system limitations // ޼Ӧϵͳ
-    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - MIN_CORE_FILEDESCRIPTORS)), 0); // Linux һͬʱ򿪵ļΪ 1024ʹ ulimit -a/-n 鿴
-    int nFD = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS); // windows ֱӷ 2048linux ·سɹֵ nMaxConnections + MIN_CORE_FILEDESCRIPTORS
-    if (nFD < MIN_CORE_FILEDESCRIPTORS) // ܵ 0
+    nMaxConnections = std::max(std::min(nMaxConnections, (int)(FD_SETSIZE - nBind - nCoreFD)), 0); // Linux һͬʱ򿪵ļΪ 1024ʹ ulimit -a/-n 鿴
+    // The databases only get what the connections leave under FD_SETSIZE, up to what their profiles want
+    nDBFiles = std::max(std::min(nDBFiles, (int)FD_SETSIZE - nBind - nCoreFD - nMaxConnections), 0);
+    int nFD = RaiseFileDescriptorLimit(nMaxConnections + nCoreFD + nBind + nDBFiles); // windows ֱӷ 2048linux ·سɹֵ
+    if (nFD < nCoreFD) // ܵ 0
         return InitError(_("Not enough file descriptors available."));
-    nMaxConnections = std::min(nFD - MIN_CORE_FILEDESCRIPTORS, nMaxConnections); // ѡȡǰС
+    nMaxConnections = std::max(std::min(nFD - nCoreFD - nBind, nMaxConnections), 0); // ѡȡǰС
+    nDBFiles = std::max(std::min(nFD, (int)FD_SETSIZE) - nCoreFD - nBind - nMaxConnections, 0);
+    SetDBMaxOpenFilesLimit(DB_PROFILE_DEFAULT.nMaxOpenFiles + nDBFiles / nDatabases); // ÿݿɴ򿪵ıļ
 
     if (nMaxConnections < nUserMaxConnections) //  125 棬ϵͳƵµ
         InitWarning(strprintf(_("Reducing -maxconnections from %d to %d, because of system limitations."), nUserMaxConnections, nMaxConnections));
@@ -1028,6 +1060,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler) // [P]3.1
     if (GetBoolArg("-peerbloomfilters", true))
         nLocalServices |= NODE_BLOOM;
 
+    fBlockFilterIndex = GetBoolArg("-blockfilterindex", DEFAULT_BLOCKFILTERINDEX); // ĬϹر
+    if (fBlockFilterIndex)
+        nLocalServices |= NODE_COMPACT_FILTERS;
+    fAddressIndex = GetBoolArg("-addressindex", DEFAULT_ADDRESSINDEX); // ַĬϹر
+
     fEnableReplacement = GetBoolArg("-mempoolreplacement", DEFAULT_ENABLE_REPLACEMENT);
     if ((!fEnableReplacement) && mapArgs.count("-mempoolreplacement")) {
         // Minimal effort at forwards compatibility // ǰԵСŬ
@@ -1096,6 +1133,9 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler) // [P]3.1
     CScheduler::Function serviceLoop = boost::bind(&CScheduler::serviceQueue, &scheduler); // 8.1.Function/bind Ա serviceQueue  serviceLoop
     threadGroup.create_thread(boost::bind(&TraceThread<CScheduler::Function>, "scheduler", serviceLoop)); // 8.2.߳ threadGroup һ߳
 
+    // Start the block file writer before any block is stored // 8.3.ļд߳
+    threadGroup.create_thread(boost::bind(&TraceThread<boost::function<void()> >, "blkwriter", boost::function<void()>(boost::bind(&CBlockFileWriter::ThreadWrite, &blockFileWriter))));
+
     /* Start the RPC server already.  It will be started in "warmup" mode
      * and not really process calls already (but it will signify connections
      * that the server is there and will be ready later).  Warmup mode will
@@ -1298,11 +1338,25 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler) // [P]3.1
     if (nBlockTreeDBCache > (1 << 21) && !GetBoolArg("-txindex", DEFAULT_TXINDEX))
         nBlockTreeDBCache = (1 << 21); // block tree db cache shouldn't be larger than 2 MiB
     nTotalCache -= nBlockTreeDBCache;
+    int64_t nBlockFilterDBCache = 0; // ݿ⻺С
+    if (fBlockFilterIndex) {
+        nBlockFilterDBCache = std::min(nTotalCache / 8, (int64_t)(1 << 23)); // filters are mostly read back once, when served
+        nTotalCache -= nBlockFilterDBCache;
+    }
+    int64_t nAddressIndexDBCache = 0; // ַݿ⻺С
+    if (fAddressIndex) {
+        nAddressIndexDBCache = std::min(nTotalCache / 8, (int64_t)(1 << 26)); // spends look up the unspent entries of their outputs
+        nTotalCache -= nAddressIndexDBCache;
+    }
     int64_t nCoinDBCache = std::min(nTotalCache / 2, (nTotalCache / 4) + (1 << 23)); // use 25%-50% of the remainder for disk cache // ݿ⻺С
     nTotalCache -= nCoinDBCache;
     nCoinCacheUsage = nTotalCache; // the rest goes to in-memory cache // Ȼ
     LogPrintf("Cache configuration:\n");
     LogPrintf("* Using %.1fMiB for block index database\n", nBlockTreeDBCache * (1.0 / 1024 / 1024));
+    if (fBlockFilterIndex)
+        LogPrintf("* Using %.1fMiB for block filter index database\n", nBlockFilterDBCache * (1.0 / 1024 / 1024));
+    if (fAddressIndex)
+        LogPrintf("* Using %.1fMiB for address index database\n", nAddressIndexDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for chain state database\n", nCoinDBCache * (1.0 / 1024 / 1024));
     LogPrintf("* Using %.1fMiB for in-memory UTXO set\n", nCoinCacheUsage * (1.0 / 1024 / 1024));
 
@@ -1321,8 +1375,16 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler) // [P]3.1
                 delete pcoinsdbview;
                 delete pcoinscatcher;
                 delete pblocktree;
+                delete pblockfilterdb;
+                pblockfilterdb = NULL;
+                delete paddressindexdb;
+                paddressindexdb = NULL;
 
                 pblocktree = new CBlockTreeDB(nBlockTreeDBCache, false, fReindex); // 
+                if (fBlockFilterIndex)
+                    pblockfilterdb = new CBlockFilterDB(nBlockFilterDBCache, false, fReindex); // 
+                if (fAddressIndex)
+                    paddressindexdb = new CAddressIndexDB(nAddressIndexDBCache, false, fReindex); // ַ
                 pcoinsdbview = new CCoinsViewDB(nCoinDBCache, false, fReindex);
                 pcoinscatcher = new CCoinsViewErrorCatcher(pcoinsdbview);
                 pcoinsTip = new CCoinsViewCache(pcoinscatcher);
@@ -1352,8 +1414,14 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler) // [P]3.1
 
                 // Check for changed -txindex state //  -txindex ı״̬
                 if (fTxIndex != GetBoolArg("-txindex", DEFAULT_TXINDEX)) { //  fTxIndex ־ LoadBlockIndex пܱı
-                    strLoadError = _("You need to rebuild the database using -reindex to change -txindex");
-                    break;
+                    // A newly enabled index is built from the genesis block by ThreadTxIndex; // õɺ̴̨߳Ӵ鿪ʼ
+                    // a disabled one keeps its entries until the next -reindex // õĿֱ´
+                    fTxIndex = !fTxIndex;
+                    if (!pblocktree->WriteTxIndexBestBlock(CBlockLocator()) || !pblocktree->WriteFlag("txindex", fTxIndex)) {
+                        strLoadError = _("Error writing to the block database");
+                        break;
+                    }
+                    LogPrintf("Transaction index %s\n", fTxIndex ? "enabled, building it in the background" : "disabled");
                 }
 
                 // Check for changed -prune state.  What we are concerned about is a user who has pruned blocks //  -prune ı״̬ǹעʱȥ޼飬
@@ -1620,6 +1688,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler) // [P]3.1
             MilliSleep(10); // ˯ 10ms ȴ߳ɹ
     }
 
+    if (fBlockFilterIndex) // Ϊǰӵ鲹
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "blkfilter", &ThreadBlockFilterIndex));
+    if (fTxIndex) // ǰĽ
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "txindex", &ThreadTxIndex));
+    if (fAddressIndex) // عֱַ뼤һ
+        threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "addrindex", &ThreadAddressIndex));
+
     // ********************************************************* Step 11: start node // ڵ񣬼 P2P ڿ߳
 
     if (!CheckDiskSpace()) // 1.ӲʣռǷ㣨 50MBڽղ洢
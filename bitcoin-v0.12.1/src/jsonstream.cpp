@@ -0,0 +1,117 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonstream.h"
+
+#include <assert.h>
+
+#include <univalue.h>
+
+CJSONStreamWriter::CJSONStreamWriter(const Sink& sinkIn, size_t nFlushSizeIn) :
+    sink(sinkIn), nFlushSize(nFlushSizeIn), fFlushed(false), fAfterKey(false)
+{
+    strBuffer.reserve(nFlushSize);
+}
+
+void CJSONStreamWriter::BeginValue()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (!vHasElements.empty()) {
+        if (vHasElements.back())
+            strBuffer += ",";
+        vHasElements.back() = true;
+    }
+}
+
+void CJSONStreamWriter::EndValue()
+{
+    if (strBuffer.size() >= nFlushSize)
+        Flush();
+}
+
+void CJSONStreamWriter::BeginObject()
+{
+    BeginValue();
+    strBuffer += "{";
+    vHasElements.push_back(false);
+    strClosers += "}";
+}
+
+void CJSONStreamWriter::EndObject()
+{
+    assert(!vHasElements.empty() && !fAfterKey && *strClosers.rbegin() == '}');
+    vHasElements.pop_back();
+    strClosers.erase(strClosers.size() - 1);
+    strBuffer += "}";
+    EndValue();
+}
+
+void CJSONStreamWriter::BeginArray()
+{
+    BeginValue();
+    strBuffer += "[";
+    vHasElements.push_back(false);
+    strClosers += "]";
+}
+
+void CJSONStreamWriter::EndArray()
+{
+    assert(!vHasElements.empty() && !fAfterKey && *strClosers.rbegin() == ']');
+    vHasElements.pop_back();
+    strClosers.erase(strClosers.size() - 1);
+    strBuffer += "]";
+    EndValue();
+}
+
+void CJSONStreamWriter::Key(const std::string& key)
+{
+    assert(!vHasElements.empty() && !fAfterKey);
+    BeginValue();
+    strBuffer += UniValue(key).write();
+    strBuffer += ":";
+    fAfterKey = true;
+}
+
+void CJSONStreamWriter::Value(const UniValue& val)
+{
+    BeginValue();
+    strBuffer += val.write();
+    EndValue();
+}
+
+void CJSONStreamWriter::KeyValue(const std::string& key, const UniValue& val)
+{
+    Key(key);
+    Value(val);
+}
+
+void CJSONStreamWriter::WriteRaw(const std::string& str)
+{
+    strBuffer += str;
+    EndValue();
+}
+
+void CJSONStreamWriter::CloseTo(size_t nDepth)
+{
+    if (fAfterKey)
+        Value(NullUniValue);
+    while (vHasElements.size() > nDepth) {
+        if (*strClosers.rbegin() == '}')
+            EndObject();
+        else
+            EndArray();
+    }
+}
+
+void CJSONStreamWriter::Flush()
+{
+    if (strBuffer.empty())
+        return;
+    sink(strBuffer);
+    strBuffer.clear();
+    fFlushed = true;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_JSONSTREAM_H
+#define BITCOIN_JSONSTREAM_H
+
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+class UniValue;
+
+/** Amount of output CJSONStreamWriter collects before passing it on */
+static const size_t DEFAULT_JSON_STREAM_FLUSH_SIZE = 64 * 1024;
+
+/**
+ * Writes JSON text incrementally to a sink, for results that are too large
+ * to first build as a UniValue tree. The output is the same as that of
+ * UniValue::write() without indentation. Small parts of the result can be
+ * written as complete UniValues.
+ */
+class CJSONStreamWriter
+{
+public:
+    typedef boost::function<void(const std::string&)> Sink;
+
+    CJSONStreamWriter(const Sink& sinkIn, size_t nFlushSizeIn = DEFAULT_JSON_STREAM_FLUSH_SIZE);
+
+    void BeginObject();
+    void EndObject();
+    void BeginArray();
+    void EndArray();
+
+    /** Write the key of the next value in the current object. */
+    void Key(const std::string& key);
+
+    /** Write a complete value. */
+    void Value(const UniValue& val);
+
+    /** Write a complete key/value pair of the current object. */
+    void KeyValue(const std::string& key, const UniValue& val);
+
+    /** Write text as is, e.g. a newline after the outermost value. */
+    void WriteRaw(const std::string& str);
+
+    /** Number of objects and arrays that are currently open. */
+    size_t Depth() const { return vHasElements.size(); }
+
+    /**
+     * Close open objects and arrays until nDepth are left, e.g. to end output
+     * that was cut short by an error. A key still waiting for its value gets
+     * null.
+     */
+    void CloseTo(size_t nDepth);
+
+    /** Pass all output collected so far to the sink. */
+    void Flush();
+
+    /** Whether any output has been passed to the sink yet. */
+    bool HasFlushed() const { return fFlushed; }
+
+    /** Output that has not been passed to the sink yet. */
+    const std::string& GetBuffer() const { return strBuffer; }
+
+private:
+    Sink sink;
+    size_t nFlushSize;
+    std::string strBuffer;
+    bool fFlushed;
+
+    //! For each open container, whether it already has an element
+    std::vector<bool> vHasElements;
+    //! For each open container, the character that closes it
+    std::string strClosers;
+    //! Whether a key was written that still needs its value
+    bool fAfterKey;
+
+    void BeginValue();
+    void EndValue();
+};
+
+#endif // BITCOIN_JSONSTREAM_H
@@ -8,7 +8,11 @@
 #include "addrman.h"
 #include "alert.h"
 #include "arith_uint256.h"
+#include "blockencodings.h"
+#include "blockfilter.h"
+#include "blockwriter.h"
 #include "chainparams.h"
+#include "chainsnapshot.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
 #include "consensus/consensus.h"
@@ -39,6 +43,7 @@
 #include <sstream>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/math/distributions/poisson.hpp>
@@ -57,6 +62,10 @@ using namespace std;
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex; // 
+/** Held (besides cs_main) while modifying mapBlockIndex, so that LookupBlockIndex can do without cs_main */
+static CCriticalSection cs_mapBlockIndex;
+/** Owns the entries of mapBlockIndex (protected by cs_main) */
+static CBlockIndexArena blockIndexArena; // Ŀķֿ
 CChain chainActive; // ǰӵ
 CBlockIndex *pindexBestHeader = NULL;
 int64_t nTimeBestReceived = 0;
@@ -66,6 +75,8 @@ int nScriptCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = false;
+bool fBlockFilterIndex = false;
+bool fAddressIndex = false;
 bool fHavePruned = false;
 bool fPruneMode = false;
 bool fIsBareMultisigStd = DEFAULT_PERMIT_BAREMULTISIG;
@@ -194,9 +205,23 @@ namespace {
         uint256 hash;
         CBlockIndex* pindex;     //!< Optional.
         bool fValidatedHeaders;  //!< Whether this block has validated headers at the time of request.
+        int64_t nTime;           //!< Time (in microseconds) the block was requested.
+        int nRequests;           //!< Number of peers the block has been requested from in turn.
+        boost::shared_ptr<PartiallyDownloadedBlock> partialBlock;  //!< Optional, used for CMPCTBLOCK downloads
     };
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> > mapBlocksInFlight;
 
+    /** Stack of nodes which we have set to announce using compact blocks. Protected by cs_main. */
+    list<NodeId> lNodesAnnouncingHeaderAndIDs; // Ϊʹ֪ͨĽڵб
+
+    /**
+     * Bloom filter keys of the last block served as a merkleblock. SPV peers
+     * mostly ask for the same recent blocks, so the keys are extracted once
+     * and probed against each peer's filter. Protected by cs_main.
+     */ // ĬṩĲ³ķ SPV Զ˹
+    uint256 hashFilteredBlockKeys;
+    std::vector<CBloomTxKeys> vFilteredBlockKeys;
+
     /** Number of preferable block download peers. */
     int nPreferredDownload = 0; // ȥصĶԶ
 
@@ -259,10 +284,24 @@ struct CNodeState { // 
     int64_t nDownloadingSince; // ؿʼʱ
     int nBlocksInFlight;
     int nBlocksInFlightValidHeaders;
+    //! Current limit on nBlocksInFlight, sized from the measurements below. // ǰޣĲֵ
+    int nBlocksInFlightMax;
+    //! When the last requested block from this peer arrived (in microseconds), or 0. // öԶһ鵽ʱ䣨΢룩Ϊ 0
+    int64_t nLastBlockReceived;
+    //! Moving average of the time from requesting a block to receiving it (in microseconds), or 0. // 鵽յʱƶƽֵ΢룩Ϊ 0
+    int64_t nBlockLatencyAvg;
+    //! Moving average of the time between back-to-back block deliveries (in microseconds), or 0. // 齻ƶƽֵ΢룩Ϊ 0
+    int64_t nBlockIntervalAvg;
+    //! Moving average of the serialized size of delivered blocks. // ѽлСƶƽֵ
+    int64_t nBlockBytesAvg;
     //! Whether we consider this a preferred download peer.
     bool fPreferredDownload; // ǷΪѡضԶ
     //! Whether this peer wants invs or headers (when possible) for block announcements.
     bool fPreferHeaders; // öԶǷҪ֪ͨ invs ͷ
+    //! Whether this peer wants invs or cmpctblocks (when possible) for block announcements.
+    bool fPreferHeaderAndIDs; // öԶǷҪ֪ͨ
+    //! Whether this peer will send us cmpctblocks if we request them
+    bool fProvidesHeaderAndIDs; // öԶǷʱ
 
     CNodeState() {
         fCurrentlyConnected = false;
@@ -277,8 +316,15 @@ struct CNodeState { // 
         nDownloadingSince = 0;
         nBlocksInFlight = 0;
         nBlocksInFlightValidHeaders = 0;
+        nBlocksInFlightMax = MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+        nLastBlockReceived = 0;
+        nBlockLatencyAvg = 0;
+        nBlockIntervalAvg = 0;
+        nBlockBytesAvg = 0;
         fPreferredDownload = false;
         fPreferHeaders = false;
+        fPreferHeaderAndIDs = false;
+        fProvidesHeaderAndIDs = false;
     }
 };
 
@@ -331,6 +377,7 @@ void FinalizeNode(NodeId nodeid) {
         mapBlocksInFlight.erase(entry.hash);
     }
     EraseOrphansFor(nodeid);
+    lNodesAnnouncingHeaderAndIDs.remove(nodeid); // ֪ͨڵбƳ
     nPreferredDownload -= state->fPreferredDownload;
     nPeersWithValidatedDownloads -= (state->nBlocksInFlightValidHeaders != 0);
     assert(nPeersWithValidatedDownloads >= 0);
@@ -345,12 +392,32 @@ void FinalizeNode(NodeId nodeid) {
     }
 }
 
+/** Fold a delivered block into the download statistics of the peer it was requested from. */ // ѽĶԶ˵ͳ
+// Requires cs_main.
+void UpdateBlockDownloadStats(CNodeState *state, const QueuedBlock& queued, unsigned int nBytes) {
+    int64_t nNow = GetTimeMicros();
+    int64_t nLatency = std::max<int64_t>(nNow - queued.nTime, 1);
+    state->nBlockLatencyAvg = state->nBlockLatencyAvg ? (state->nBlockLatencyAvg * 7 + nLatency) / 8 : nLatency;
+    // Only blocks that were already queued when the previous one arrived say
+    // anything about throughput; otherwise the gap is mostly our own request latency.
+    if (state->nLastBlockReceived && queued.nTime <= state->nLastBlockReceived) {
+        int64_t nInterval = std::max<int64_t>(nNow - state->nLastBlockReceived, 1);
+        state->nBlockIntervalAvg = state->nBlockIntervalAvg ? (state->nBlockIntervalAvg * 7 + nInterval) / 8 : nInterval;
+    }
+    state->nBlockBytesAvg = state->nBlockBytesAvg ? (state->nBlockBytesAvg * 7 + nBytes) / 8 : nBytes;
+    state->nLastBlockReceived = nNow;
+}
+
 // Requires cs_main.
 // Returns a bool indicating whether we requested this block.
-bool MarkBlockAsReceived(const uint256& hash) {
+// nBytes is the size of the block if nodeFrom actually delivered it, 0 otherwise.
+// Only the peer that delivers the block it was asked for is credited with it.
+bool MarkBlockAsReceived(const uint256& hash, NodeId nodeFrom = -1, unsigned int nBytes = 0) {
     map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
     if (itInFlight != mapBlocksInFlight.end()) {
         CNodeState *state = State(itInFlight->second.first);
+        if (nBytes && itInFlight->second.first == nodeFrom)
+            UpdateBlockDownloadStats(state, *itInFlight->second.second, nBytes);
         state->nBlocksInFlightValidHeaders -= itInFlight->second.second->fValidatedHeaders;
         if (state->nBlocksInFlightValidHeaders == 0 && itInFlight->second.second->fValidatedHeaders) {
             // Last validated block on the queue was received.
@@ -374,10 +441,14 @@ void MarkBlockAsInFlight(NodeId nodeid, const uint256& hash, const Consensus::Pa
     CNodeState *state = State(nodeid);
     assert(state != NULL);
 
-    // Make sure it's not listed somewhere already.
+    // Make sure it's not listed somewhere already, but keep count of the requests.
+    int nRequests = 1;
+    map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator itInFlight = mapBlocksInFlight.find(hash);
+    if (itInFlight != mapBlocksInFlight.end())
+        nRequests += itInFlight->second.second->nRequests;
     MarkBlockAsReceived(hash);
 
-    QueuedBlock newentry = {hash, pindex, pindex != NULL};
+    QueuedBlock newentry = {hash, pindex, pindex != NULL, GetTimeMicros(), nRequests};
     list<QueuedBlock>::iterator it = state->vBlocksInFlight.insert(state->vBlocksInFlight.end(), newentry);
     state->nBlocksInFlight++;
     state->nBlocksInFlightValidHeaders += newentry.fValidatedHeaders;
@@ -440,6 +511,60 @@ bool PeerHasHeader(CNodeState *state, CBlockIndex *pindex)
     return false;
 }
 
+/** Return the bloom filter keys of block, reusing them if it was the last one asked for. */ // ȡĲ³ķ
+// Requires cs_main
+const std::vector<CBloomTxKeys>& GetFilteredBlockKeys(const CBlock& block)
+{
+    const uint256 hash = block.GetHash();
+    if (hash != hashFilteredBlockKeys) { // ϴε鲻ͬȡ
+        vFilteredBlockKeys.clear();
+        vFilteredBlockKeys.reserve(block.vtx.size());
+        BOOST_FOREACH(const CTransaction& tx, block.vtx)
+            vFilteredBlockKeys.push_back(CBloomTxKeys(tx));
+        hashFilteredBlockKeys = hash;
+    }
+    return vFilteredBlockKeys;
+}
+
+/**
+ * Ask pfrom to announce new blocks to us with cmpctblock messages, keeping at
+ * most MAX_CMPCTBLOCK_ANNOUNCING_PEERS such peers; the one that was asked
+ * longest ago is switched back to regular announcements.
+ */ //  pfrom ֪ͨ飬ౣ MAX_CMPCTBLOCK_ANNOUNCING_PEERS ĶԶ
+// Requires cs_main
+void MaybeSetPeerAsAnnouncingHeaderAndIDs(const CNodeState* nodestate, CNode* pfrom)
+{
+    if (!nodestate->fProvidesHeaderAndIDs)
+        return;
+    for (list<NodeId>::iterator it = lNodesAnnouncingHeaderAndIDs.begin(); it != lNodesAnnouncingHeaderAndIDs.end(); ++it) {
+        if (*it == pfrom->GetId()) { // бУƵĩβ
+            lNodesAnnouncingHeaderAndIDs.erase(it);
+            lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+            return;
+        }
+    }
+    bool fAnnounceUsingCMPCTBLOCK = false;
+    uint64_t nCMPCTBLOCKVersion = 1;
+    if (lNodesAnnouncingHeaderAndIDs.size() >= MAX_CMPCTBLOCK_ANNOUNCING_PEERS) {
+        // As per BIP152, we only get 3 of our peers to announce
+        // blocks using compact encodings. // ֪ͨĶԶ˸Ļ֪ͨͨʽ
+        NodeId nodeid = lNodesAnnouncingHeaderAndIDs.front();
+        {
+            LOCK(cs_vNodes);
+            BOOST_FOREACH(CNode* pnode, vNodes) {
+                if (pnode->GetId() == nodeid) {
+                    pnode->PushMessage(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion);
+                    break;
+                }
+            }
+        }
+        lNodesAnnouncingHeaderAndIDs.pop_front();
+    }
+    fAnnounceUsingCMPCTBLOCK = true;
+    pfrom->PushMessage(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion);
+    lNodesAnnouncingHeaderAndIDs.push_back(pfrom->GetId());
+}
+
 /** Find the last common ancestor two blocks have.
  *  Both pa and pb must be non-NULL. */
 CBlockIndex* LastCommonAncestor(CBlockIndex* pa, CBlockIndex* pb) {
@@ -460,8 +585,9 @@ CBlockIndex* LastCommonAncestor(CBlockIndex* pa, CBlockIndex* pb) {
 }
 
 /** Update pindexLastCommonBlock and add not-in-flight missing successors to vBlocks, until it has
- *  at most count entries. */
-void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBlockIndex*>& vBlocks, NodeId& nodeStaller) {
+ *  at most count entries. If the download window ends before that, pindexWaitingFor is set to the
+ *  first block that is in flight from another peer, as it is what keeps the window from moving. */
+void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBlockIndex*>& vBlocks, NodeId& nodeStaller, CBlockIndex*& pindexWaitingFor) {
     if (count == 0)
         return;
 
@@ -497,6 +623,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
     int nWindowEnd = state->pindexLastCommonBlock->nHeight + BLOCK_DOWNLOAD_WINDOW;
     int nMaxHeight = std::min<int>(state->pindexBestKnownBlock->nHeight, nWindowEnd + 1);
     NodeId waitingfor = -1;
+    CBlockIndex *pindexFirstInFlight = NULL;
     while (pindexWalk->nHeight < nMaxHeight) {
         // Read up to 128 (or more, if more blocks than that are needed) successors of pindexWalk (towards
         // pindexBestKnownBlock) into vToFetch. We fetch 128, because CBlockIndex::GetAncestor may be as expensive
@@ -525,6 +652,8 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
                 // The block is not already downloaded, and not yet in flight.
                 if (pindex->nHeight > nWindowEnd) {
                     // We reached the end of the window.
+                    if (waitingfor != nodeid)
+                        pindexWaitingFor = pindexFirstInFlight;
                     if (vBlocks.size() == 0 && waitingfor != nodeid) {
                         // We aren't able to fetch anything, but we would be if the download window was one larger.
                         nodeStaller = waitingfor;
@@ -538,6 +667,7 @@ void FindNextBlocksToDownload(NodeId nodeid, unsigned int count, std::vector<CBl
             } else if (waitingfor == -1) {
                 // This is the first already-in-flight block.
                 waitingfor = mapBlocksInFlight[pindex->GetBlockHash()].first;
+                pindexFirstInFlight = pindex;
             }
         }
     }
@@ -557,9 +687,22 @@ bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats) {
         if (queue.pindex)
             stats.vHeightInFlight.push_back(queue.pindex->nHeight);
     }
+    stats.nBlocksInFlightMax = state->nBlocksInFlightMax;
+    stats.nBlockLatency = state->nBlockLatencyAvg;
+    stats.nBlockBytesPerSec = state->nBlockIntervalAvg ? state->nBlockBytesAvg * 1000000 / state->nBlockIntervalAvg : 0;
     return true;
 }
 
+int GetBlockDownloadWindow(int64_t nRoundTripTime, int64_t nBlockInterval)
+{
+    if (nRoundTripTime <= 0 || nBlockInterval <= 0)
+        return MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    // Keep two round trips' worth of deliveries queued at the peer, so its
+    // pipe doesn't drain while our next getdata is on its way.
+    int64_t nWindow = 2 * (nRoundTripTime / nBlockInterval + 1);
+    return std::max<int64_t>(MIN_BLOCKS_IN_TRANSIT_PER_PEER, std::min<int64_t>(nWindow, MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE));
+}
+
 void RegisterNodeSignals(CNodeSignals& nodeSignals)
 {
     nodeSignals.GetHeight.connect(&GetHeight); // ȡ߶
@@ -593,8 +736,12 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
     return chain.Genesis();
 }
 
+CCoinsViewDB *pcoinsdbview = NULL; // ״̬ݿ
 CCoinsViewCache *pcoinsTip = NULL;
 CBlockTreeDB *pblocktree = NULL; // ݿָ
+CBlockFileWriter blockFileWriter; // ͳļĺ̨д
+CBlockFilterDB *pblockfilterdb = NULL; // ݿָ
+CAddressIndexDB *paddressindexdb = NULL; // ַݿָ
 
 //////////////////////////////////////////////////////////////////////////////
 //
@@ -1450,19 +1597,30 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::P
         return true;
     }
 
-    if (fTxIndex) {
+    if (fTxIndex) { // ڽʱδҵĽףĲ
         CDiskTxPos postx;
         if (pblocktree->ReadTxIndex(hash, postx)) {
-            CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
-            if (file.IsNull())
-                return error("%s: OpenBlockFile failed", __func__);
             CBlockHeader header;
-            try {
-                file >> header;
-                fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
-                file >> txOut;
-            } catch (const std::exception& e) {
-                return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+            CDataStream ssQueued(SER_DISK, CLIENT_VERSION);
+            if (blockFileWriter.ReadQueued(false, postx, ssQueued)) { // дУڴȡ
+                try {
+                    ssQueued >> header;
+                    ssQueued.ignore(postx.nTxOffset);
+                    ssQueued >> txOut;
+                } catch (const std::exception& e) {
+                    return error("%s: Deserialize error - %s", __func__, e.what());
+                }
+            } else {
+                CAutoFile file(OpenBlockFile(postx, true), SER_DISK, CLIENT_VERSION);
+                if (file.IsNull())
+                    return error("%s: OpenBlockFile failed", __func__);
+                try {
+                    file >> header;
+                    fseek(file.Get(), postx.nTxOffset, SEEK_CUR);
+                    file >> txOut;
+                } catch (const std::exception& e) {
+                    return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+                }
             }
             hashBlock = header.GetHash();
             if (txOut.GetHash() != hash)
@@ -1499,6 +1657,76 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::P
     return false;
 }
 
+bool GetUnspentOutputs(const std::vector<COutPoint>& vOutPoints, bool fCheckMemPool, std::vector<CUnspentOutput>& vOutputs, uint256& hashBlock, int& nHeight)
+{
+    std::vector<uint256> vTxids; // ѯĽףȥ
+    vTxids.reserve(vOutPoints.size());
+    BOOST_FOREACH(const COutPoint& outpoint, vOutPoints)
+        vTxids.push_back(outpoint.hash);
+    std::sort(vTxids.begin(), vTxids.end());
+    vTxids.erase(std::unique(vTxids.begin(), vTxids.end()), vTxids.end());
+
+    std::vector<CCoins> vCoins(vTxids.size());
+    std::vector<uint256> vTxidsDB; // ҪݿȡĽ
+    std::vector<unsigned int> vIndexDB;
+    std::vector<bool> vSpentInMemPool(vOutPoints.size(), false);
+    const leveldb::Snapshot* psnapshot = NULL;
+    {
+        LOCK2(cs_main, mempool.cs); // ֻڻȡһµĿʱ
+        if (!pcoinsdbview || !chainActive.Tip())
+            return false;
+        hashBlock = chainActive.Tip()->GetBlockHash();
+        nHeight = chainActive.Height();
+
+        for (unsigned int i = 0; i < vTxids.size(); i++) {
+            CTransaction tx;
+            if (fCheckMemPool && mempool.lookup(vTxids[i], tx)) { // ڴеĽ
+                vCoins[i] = CCoins(tx, MEMPOOL_HEIGHT);
+            } else if (pcoinsTip->HaveCoinsInCache(vTxids[i])) { // еĿݿ
+                const CCoins* pcoins = pcoinsTip->AccessCoins(vTxids[i]);
+                if (pcoins)
+                    vCoins[i] = *pcoins;
+            } else {
+                vTxidsDB.push_back(vTxids[i]);
+                vIndexDB.push_back(i);
+            }
+        }
+        if (fCheckMemPool) {
+            for (unsigned int i = 0; i < vOutPoints.size(); i++)
+                vSpentInMemPool[i] = mempool.mapNextTx.count(vOutPoints[i]) > 0; // ѱڴؽ׻
+        }
+        // The database only changes when pcoinsTip is flushed under cs_main, so
+        // a snapshot taken now matches the cache contents examined above.
+        if (!vTxidsDB.empty())
+            psnapshot = pcoinsdbview->GetSnapshot();
+    }
+
+    if (psnapshot) { // ȡݿ
+        std::vector<CCoins> vCoinsDB;
+        bool fRead = pcoinsdbview->GetCoinsSorted(vTxidsDB, psnapshot, vCoinsDB);
+        pcoinsdbview->ReleaseSnapshot(psnapshot);
+        if (!fRead)
+            return false;
+        for (unsigned int i = 0; i < vIndexDB.size(); i++)
+            vCoins[vIndexDB[i]].swap(vCoinsDB[i]);
+    }
+
+    vOutputs.clear();
+    vOutputs.resize(vOutPoints.size());
+    for (unsigned int i = 0; i < vOutPoints.size(); i++) {
+        const CCoins& coins = vCoins[std::lower_bound(vTxids.begin(), vTxids.end(), vOutPoints[i].hash) - vTxids.begin()];
+        if (vSpentInMemPool[i] || !coins.IsAvailable(vOutPoints[i].n))
+            continue;
+        CUnspentOutput& output = vOutputs[i];
+        output.fUnspent = true;
+        output.nVersion = coins.nVersion;
+        output.nHeight = coins.nHeight;
+        output.fCoinBase = coins.fCoinBase;
+        output.out = coins.vout[vOutPoints[i].n];
+    }
+    return true;
+}
+
 
 
 
@@ -1511,21 +1739,17 @@ bool GetTransaction(const uint256 &hash, CTransaction &txOut, const Consensus::P
 
 bool WriteBlockToDisk(const CBlock& block, CDiskBlockPos& pos, const CMessageHeader::MessageStartChars& messageStart)
 {
-    // Open history file to append
-    CAutoFile fileout(OpenBlockFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("WriteBlockToDisk: OpenBlockFile failed");
-
-    // Write index header
-    unsigned int nSize = fileout.GetSerializeSize(block);
-    fileout << FLATDATA(messageStart) << nSize;
-
-    // Write block
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0)
-        return error("WriteBlockToDisk: ftell failed");
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << block;
+    // Serialize index header and block, to be written by the block file writer
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    unsigned int nSize = ss.GetSerializeSize(block);
+    ss.reserve(sizeof(messageStart) + sizeof(nSize) + nSize);
+    ss << FLATDATA(messageStart) << nSize; // ϢͷС
+    CDiskBlockPos posHeader = pos;
+    pos.nPos += ss.size(); // ݽ
+    ss << block;
+
+    if (!blockFileWriter.QueueWrite(false, posHeader, ss))
+        return error("WriteBlockToDisk: writing block files failed");
 
     return true;
 }
@@ -1534,17 +1758,28 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos, const Consensus:
 {
     block.SetNull();
 
-    // Open history file to read // 򿪲ʷļ
-    CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull()) // ȡ״̬
-        return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
+    // Blocks not written yet are read from the queue of the block file writer
+    CDataStream ssQueued(SER_DISK, CLIENT_VERSION);
+    if (blockFileWriter.ReadQueued(false, pos, ssQueued)) {
+        try {
+            ssQueued >> block;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s at %s", __func__, e.what(), pos.ToString());
+        }
+    } else {
+        // Open history file to read // 򿪲ʷļ
+        CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull()) // ȡ״̬
+            return error("ReadBlockFromDisk: OpenBlockFile failed for %s", pos.ToString());
 
-    // Read block
-    try {
-        filein >> block; // 
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        // Read block
+        try {
+            filein >> block; // 
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s at %s", __func__, e.what(), pos.ToString());
+        }
     }
 
     // Check the header // ͷ
@@ -1892,46 +2127,52 @@ namespace {
 
 bool UndoWriteToDisk(const CBlockUndo& blockundo, CDiskBlockPos& pos, const uint256& hashBlock, const CMessageHeader::MessageStartChars& messageStart)
 {
-    // Open history file to append
-    CAutoFile fileout(OpenUndoFile(pos), SER_DISK, CLIENT_VERSION);
-    if (fileout.IsNull())
-        return error("%s: OpenUndoFile failed", __func__);
-
-    // Write index header
-    unsigned int nSize = fileout.GetSerializeSize(blockundo);
-    fileout << FLATDATA(messageStart) << nSize;
-
-    // Write undo data
-    long fileOutPos = ftell(fileout.Get());
-    if (fileOutPos < 0)
-        return error("%s: ftell failed", __func__);
-    pos.nPos = (unsigned int)fileOutPos;
-    fileout << blockundo;
+    // Serialize index header and undo data, to be written by the block file writer
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    unsigned int nSize = ss.GetSerializeSize(blockundo);
+    ss << FLATDATA(messageStart) << nSize;
+    CDiskBlockPos posHeader = pos;
+    pos.nPos += ss.size();
+    ss << blockundo;
 
     // calculate & write checksum
     CHashWriter hasher(SER_GETHASH, PROTOCOL_VERSION);
     hasher << hashBlock;
     hasher << blockundo;
-    fileout << hasher.GetHash();
+    ss << hasher.GetHash();
+
+    if (!blockFileWriter.QueueWrite(true, posHeader, ss))
+        return error("%s: writing undo files failed", __func__);
 
     return true;
 }
 
 bool UndoReadFromDisk(CBlockUndo& blockundo, const CDiskBlockPos& pos, const uint256& hashBlock)
 {
-    // Open history file to read
-    CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
-    if (filein.IsNull())
-        return error("%s: OpenBlockFile failed", __func__);
-
-    // Read block
     uint256 hashChecksum;
-    try {
-        filein >> blockundo;
-        filein >> hashChecksum;
-    }
-    catch (const std::exception& e) {
-        return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+    CDataStream ssQueued(SER_DISK, CLIENT_VERSION);
+    if (blockFileWriter.ReadQueued(true, pos, ssQueued)) { // д
+        try {
+            ssQueued >> blockundo;
+            ssQueued >> hashChecksum;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize error - %s", __func__, e.what());
+        }
+    } else {
+        // Open history file to read
+        CAutoFile filein(OpenUndoFile(pos, true), SER_DISK, CLIENT_VERSION);
+        if (filein.IsNull())
+            return error("%s: OpenBlockFile failed", __func__);
+
+        // Read block
+        try {
+            filein >> blockundo;
+            filein >> hashChecksum;
+        }
+        catch (const std::exception& e) {
+            return error("%s: Deserialize or I/O error - %s", __func__, e.what());
+        }
     }
 
     // Verify checksum
@@ -2067,6 +2308,9 @@ bool DisconnectBlock(const CBlock& block, CValidationState& state, const CBlockI
 
 void static FlushBlockFile(bool fFinalize = false)
 {
+    // Queued writes must reach the files before they are committed; failures are reported by FlushStateToDisk
+    blockFileWriter.Flush(); // ȴ̨дд
+
     LOCK(cs_LastBlockFile);
 
     CDiskBlockPos posOld(nLastBlockFile, 0); // λö
@@ -2097,6 +2341,333 @@ void ThreadScriptCheck() {
     scriptcheckqueue.Thread(); // 2.ִ̹߳
 }
 
+/**
+ * Add the basic compact filter of a block to the filter index. Filter headers
+ * chain, so a block is only added once the parent's filter has been indexed;
+ * blocks for which that is not yet the case are left to ThreadBlockFilterIndex.
+ * Returns false only if writing to the index failed.
+ */
+static bool WriteBlockFilterIndex(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex)
+{
+    uint256 hashPrevFilter, hashPrevHeader; // ǰһͷΪȫ
+    if (pindex->pprev && !pblockfilterdb->ReadFilterHeader(pindex->pprev->GetBlockHash(), hashPrevFilter, hashPrevHeader))
+        return true; // Ĺδ̨߳
+
+    CBlockFilter filter(BLOCK_FILTER_BASIC, block, blockundo); // 鼰仨ѵ
+    uint256 hashFilter = filter.GetHash();
+    return pblockfilterdb->WriteFilter(pindex->GetBlockHash(), filter.GetEncodedFilter(), hashFilter, ComputeBlockFilterHeader(hashFilter, hashPrevHeader));
+}
+
+void ThreadBlockFilterIndex()
+{
+    const CChainParams& chainparams = Params();
+    int64_t nStart = GetTimeMillis();
+    int nIndexed = 0;
+
+    // A block is only indexed once its parent is, so the indexed blocks of the
+    // active chain form a prefix of it. Find where that prefix ends.
+    int nHeight; // һûй߶
+    {
+        LOCK(cs_main);
+        int nLow = 0, nHigh = chainActive.Height() + 1;
+        while (nLow < nHigh) {
+            int nMid = (nLow + nHigh) / 2;
+            if (pblockfilterdb->HaveFilter(chainActive[nMid]->GetBlockHash()))
+                nLow = nMid + 1;
+            else
+                nHigh = nMid;
+        }
+        nHeight = nLow;
+    }
+    LogPrintf("%s: building compact block filters from height %d\n", __func__, nHeight);
+
+    // Once caught up, keep watching the tip: a reorg can connect blocks whose // ׷۲⣺Ӹ޹飬
+    // parents were never indexed, and ConnectBlock leaves those to this thread. // ConnectBlock Щ߳
+    bool fSynced = false, fIdle = false;
+    while (true) {
+        if (fIdle) {
+            MilliSleep(1000); // ׷⣬ȴ
+            fIdle = false;
+        }
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            return;
+
+        CBlockIndex* pindex;
+        CDiskBlockPos posUndo;
+        uint256 hashPrevHeader;
+        {
+            LOCK(cs_main);
+            pindex = chainActive[nHeight];
+            if (pindex == NULL) {
+                if (chainActive.Tip() && !pblockfilterdb->HaveFilter(chainActive.Tip()->GetBlockHash())) {
+                    nHeight = chainActive.Height(); // ûй»˵Ĳ
+                    continue;
+                }
+                if (!fSynced) {
+                    LogPrintf("%s: compact block filter index synced, %d blocks indexed in %dms\n", __func__, nIndexed, GetTimeMillis() - nStart);
+                    fSynced = true;
+                }
+                nHeight = chainActive.Height() + 1;
+                fIdle = true;
+                continue;
+            }
+            if (pblockfilterdb->HaveFilter(pindex->GetBlockHash())) {
+                nHeight++; // ѱ ConnectBlock 
+                continue;
+            }
+            uint256 hashPrevFilter;
+            if (pindex->pprev && !pblockfilterdb->ReadFilterHeader(pindex->pprev->GetBlockHash(), hashPrevFilter, hashPrevHeader)) {
+                nHeight--; // ·飬˵Ĳ
+                continue;
+            }
+            posUndo = pindex->GetUndoPos();
+        }
+
+        CBlock block;
+        CBlockUndo blockundo;
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus())) {
+            LogPrintf("%s: failed to read block %s from disk, giving up\n", __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+        if (pindex->pprev && (posUndo.IsNull() || !UndoReadFromDisk(blockundo, posUndo, pindex->pprev->GetBlockHash()))) {
+            LogPrintf("%s: failed to read undo data of block %s, giving up\n", __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+
+        CBlockFilter filter(BLOCK_FILTER_BASIC, block, blockundo);
+        uint256 hashFilter = filter.GetHash();
+        if (!pblockfilterdb->WriteFilter(pindex->GetBlockHash(), filter.GetEncodedFilter(), hashFilter, ComputeBlockFilterHeader(hashFilter, hashPrevHeader))) {
+            LogPrintf("%s: failed to write the filter of block %s, giving up\n", __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+        nHeight++;
+        if (++nIndexed % 10000 == 0)
+            LogPrintf("%s: compact block filters built up to height %d\n", __func__, nHeight - 1);
+    }
+}
+
+/**
+ * Add a newly connected block to the address index. The index is only extended
+ * while it is in step with the chain; otherwise ThreadAddressIndex catches up.
+ * ConnectBlock is also run while verifying blocks that are already indexed,
+ * which the same check skips. pvSpent are the spent outputs as ConnectBlock
+ * found them in the coins view, so that none has to be read back from the index.
+ */
+static bool WriteAddressIndex(const CBlock& block, const CBlockUndo& blockundo, const CBlockIndex* pindex, const std::vector<CAddressIndexValue>* pvSpent)
+{
+    uint256 hashBest; // 飬ȫʾ
+    paddressindexdb->ReadBestBlock(hashBest);
+    if (hashBest != (pindex->pprev ? pindex->pprev->GetBlockHash() : uint256()))
+        return true;
+    return paddressindexdb->ConnectBlock(block, blockundo, pindex, pvSpent);
+}
+
+/** Remove a block disconnected from the active chain from the address index, if it is indexed */
+static bool DisconnectAddressIndex(const CBlock& block, const CBlockIndex* pindex)
+{
+    uint256 hashBest;
+    if (!paddressindexdb->ReadBestBlock(hashBest) || hashBest != pindex->GetBlockHash())
+        return true; // δ
+    CBlockUndo blockundo;
+    CDiskBlockPos pos = pindex->GetUndoPos();
+    if (pos.IsNull() || !UndoReadFromDisk(blockundo, pos, pindex->pprev->GetBlockHash()))
+        return error("%s: failure reading undo data", __func__);
+    return paddressindexdb->DisconnectBlock(block, blockundo, pindex);
+}
+
+void ThreadAddressIndex()
+{
+    const CChainParams& chainparams = Params();
+    int64_t nStart = GetTimeMillis();
+    int nIndexed = 0;
+
+    while (true) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            return;
+
+        // Pick the next step: undo the indexed tip if the active chain has
+        // left it (after a reorganisation or an unclean shutdown), otherwise
+        // index the block following it.
+        uint256 hashBest;
+        CBlockIndex* pindex;
+        bool fConnect;
+        CDiskBlockPos posUndo;
+        {
+            LOCK(cs_main);
+            CBlockIndex* pindexBest = NULL;
+            if (paddressindexdb->ReadBestBlock(hashBest)) {
+                BlockMap::iterator mi = mapBlockIndex.find(hashBest);
+                if (mi == mapBlockIndex.end()) {
+                    LogPrintf("%s: indexed block %s is unknown, restart with -reindex to rebuild the address index\n", __func__, hashBest.ToString());
+                    return;
+                }
+                pindexBest = mi->second;
+            }
+            fConnect = pindexBest == NULL || chainActive.Contains(pindexBest);
+            pindex = fConnect ? (pindexBest ? chainActive.Next(pindexBest) : chainActive.Genesis()) : pindexBest;
+            if (pindex == NULL)
+                break; // ׷⣬֮ ConnectBlock  DisconnectTip ά
+            posUndo = pindex->GetUndoPos();
+        }
+
+        CBlock block;
+        CBlockUndo blockundo;
+        if (!ReadBlockFromDisk(block, pindex, chainparams.GetConsensus())) {
+            LogPrintf("%s: failed to read block %s from disk, giving up\n", __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+        if (pindex->pprev && (posUndo.IsNull() || !UndoReadFromDisk(blockundo, posUndo, pindex->pprev->GetBlockHash()))) {
+            LogPrintf("%s: failed to read undo data of block %s, giving up\n", __func__, pindex->GetBlockHash().ToString());
+            return;
+        }
+
+        {
+            LOCK(cs_main); //  ConnectBlock  DisconnectTip ظ
+            uint256 hashBestNow;
+            paddressindexdb->ReadBestBlock(hashBestNow);
+            if (hashBestNow != hashBest)
+                continue; // ѱ ConnectBlock  DisconnectTip ƽѡ
+            if (!(fConnect ? paddressindexdb->ConnectBlock(block, blockundo, pindex) : paddressindexdb->DisconnectBlock(block, blockundo, pindex))) {
+                LogPrintf("%s: failed to update the address index at block %s, giving up\n", __func__, pindex->GetBlockHash().ToString());
+                return;
+            }
+        }
+        if (++nIndexed % 10000 == 0)
+            LogPrintf("%s: address index built up to height %d\n", __func__, fConnect ? pindex->nHeight : pindex->nHeight - 1);
+    }
+
+    LogPrintf("%s: address index synced, %d blocks processed in %dms\n", __func__, nIndexed, GetTimeMillis() - nStart);
+}
+
+/** Number of blocks ThreadTxIndex reads before committing their index entries */
+static const unsigned int TXINDEX_BATCH_SIZE = 128;
+/** Maximum number of threads reading blocks for ThreadTxIndex */
+static const int MAX_TXINDEX_READ_THREADS = 8;
+
+/** Whether the transaction index covers the active chain (protected by cs_main) */
+static bool fTxIndexSynced = false;
+
+/**
+ * Once the transaction index has caught up, ConnectBlock maintains it. This
+ * records how far it got whenever the chain state is flushed, so a restart
+ * only has to index the blocks connected since.
+ */
+class CTxIndexBestChain : public CValidationInterface
+{
+protected:
+    void SetBestChain(const CBlockLocator& locator)
+    {
+        pblocktree->WriteTxIndexBestBlock(locator);
+    }
+};
+static CTxIndexBestChain txIndexBestChain;
+
+bool IsTxIndexSynced()
+{
+    LOCK(cs_main);
+    return fTxIndexSynced;
+}
+
+/** Read every nStep-th block of vBlockPos, starting at nStart, and compute the index positions of its transactions */
+static void ReadTxIndexPositions(const std::vector<CDiskBlockPos>* pvBlockPos, std::vector<std::vector<std::pair<uint256, CDiskTxPos> > >* pvPos, std::vector<char>* pvFailed, unsigned int nStart, unsigned int nStep)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    for (unsigned int i = nStart; i < pvBlockPos->size(); i += nStep) {
+        CBlock block;
+        if (!ReadBlockFromDisk(block, (*pvBlockPos)[i], consensusParams)) {
+            (*pvFailed)[i] = true;
+            continue;
+        }
+        std::vector<std::pair<uint256, CDiskTxPos> >& vPos = (*pvPos)[i];
+        vPos.reserve(block.vtx.size());
+        CDiskTxPos pos((*pvBlockPos)[i], GetSizeOfCompactSize(block.vtx.size())); // ͬ ConnectBlock еļ
+        BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+            vPos.push_back(std::make_pair(tx.GetHash(), pos));
+            pos.nTxOffset += ::GetSerializeSize(tx, SER_DISK, CLIENT_VERSION);
+        }
+    }
+}
+
+void ThreadTxIndex()
+{
+    int64_t nStart = GetTimeMillis();
+    size_t nIndexed = 0;
+    const int nThreads = std::max(1, std::min(GetNumCores(), MAX_TXINDEX_READ_THREADS));
+
+    const CBlockIndex* pindexLast; // һ飬NULL ʾδκ
+    {
+        LOCK(cs_main);
+        CBlockLocator locator;
+        if (!pblocktree->ReadTxIndexBestBlock(locator))
+            pindexLast = chainActive.Tip(); // ¼һֱ ConnectBlock ά
+        else if (locator.IsNull())
+            pindexLast = NULL; // õӴ鿪ʼ
+        else
+            pindexLast = FindForkInGlobalIndex(chainActive, locator);
+    }
+    LogPrintf("%s: building the transaction index from height %d using %d threads\n", __func__, pindexLast ? pindexLast->nHeight + 1 : 0, nThreads);
+
+    while (true) {
+        boost::this_thread::interruption_point();
+        if (ShutdownRequested())
+            return;
+
+        // Blocks connected from now on are indexed by ConnectBlock; the ones
+        // up to the tip are taken in batches.
+        std::vector<CDiskBlockPos> vBlockPos;
+        const CBlockIndex* pindexBatchEnd = NULL;
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexFork = pindexLast ? chainActive.FindFork(pindexLast) : NULL; // 
+            CBlockIndex* pindex = pindexFork ? chainActive.Next(pindexFork) : chainActive.Genesis();
+            if (pindex == NULL) {
+                fTxIndexSynced = true;
+                pblocktree->WriteTxIndexBestBlock(chainActive.GetLocator());
+                RegisterValidationInterface(&txIndexBestChain); // ֮״̬ˢʱ¼
+                break;
+            }
+            for (; pindex && vBlockPos.size() < TXINDEX_BATCH_SIZE; pindex = chainActive.Next(pindex)) {
+                vBlockPos.push_back(pindex->GetBlockPos());
+                pindexBatchEnd = pindex;
+            }
+        }
+
+        std::vector<std::vector<std::pair<uint256, CDiskTxPos> > > vPos(vBlockPos.size());
+        std::vector<char> vFailed(vBlockPos.size(), false);
+        ParallelFor(nThreads, boost::bind(&ReadTxIndexPositions, &vBlockPos, &vPos, &vFailed, _1, _2)); // жȡ
+
+        std::vector<std::pair<uint256, CDiskTxPos> > vBatch;
+        for (unsigned int i = 0; i < vPos.size(); i++) {
+            if (vFailed[i]) {
+                LogPrintf("%s: failed to read block at %s from disk, giving up\n", __func__, vBlockPos[i].ToString());
+                return;
+            }
+            vBatch.insert(vBatch.end(), vPos[i].begin(), vPos[i].end());
+        }
+        {
+            // Commit under cs_main: ConnectBlock indexes the blocks of a reorg
+            // itself, so a batch whose blocks have left the active chain since
+            // they were read would overwrite newer positions, and is read again.
+            LOCK(cs_main);
+            if (!chainActive.Contains(pindexBatchEnd))
+                continue;
+            CBlockLocator locator = chainActive.GetLocator(pindexBatchEnd);
+            if (!pblocktree->WriteTxIndex(vBatch, &locator)) { // һύжϺɴӴ˴
+                LogPrintf("%s: failed to write the transaction index, giving up\n", __func__);
+                return;
+            }
+        }
+        pindexLast = pindexBatchEnd;
+        if ((nIndexed + vBlockPos.size()) / 10000 != nIndexed / 10000)
+            LogPrintf("%s: transaction index built up to height %d\n", __func__, pindexLast->nHeight);
+        nIndexed += vBlockPos.size();
+    }
+
+    LogPrintf("%s: transaction index synced, %d blocks indexed in %dms\n", __func__, nIndexed, GetTimeMillis() - nStart);
+}
+
 //
 // Called periodically asynchronously; alerts if it smells like
 // we're being fed a bad chain (blocks being generated much
@@ -2230,8 +2801,13 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     // Special case for the genesis block, skipping connection of its transactions
     // (its coinbase is unspendable)
     if (block.GetHash() == chainparams.GetConsensus().hashGenesisBlock) {
-        if (!fJustCheck)
+        if (!fJustCheck) {
             view.SetBestBlock(pindex->GetBlockHash());
+            if (fBlockFilterIndex && !WriteBlockFilterIndex(block, CBlockUndo(), pindex)) // ûлκ
+                return AbortNode(state, "Failed to write block filter index");
+            if (fAddressIndex && !WriteAddressIndex(block, CBlockUndo(), pindex, NULL))
+                return AbortNode(state, "Failed to write address index");
+        }
         return true;
     }
 
@@ -2315,6 +2891,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     CCheckQueueControl<CScriptCheck> control(fScriptChecks && nScriptCheckThreads ? &scriptcheckqueue : NULL);
 
     std::vector<int> prevheights;
+    std::vector<CAddressIndexValue> vAddressSpent; // outputs spent by the block, for the address index
     CAmount nFees = 0;
     int nInputs = 0;
     unsigned int nSigOps = 0;
@@ -2343,7 +2920,10 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
             // be in ConnectBlock because they require the UTXO set
             prevheights.resize(tx.vin.size());
             for (size_t j = 0; j < tx.vin.size(); j++) {
-                prevheights[j] = view.AccessCoins(tx.vin[j].prevout.hash)->nHeight;
+                const CCoins* coins = view.AccessCoins(tx.vin[j].prevout.hash);
+                prevheights[j] = coins->nHeight;
+                if (fAddressIndex && !fJustCheck)
+                    vAddressSpent.push_back(CAddressIndexValue(coins->vout[tx.vin[j].prevout.n].nValue, coins->nHeight, coins->IsCoinBase()));
             }
 
             if (!SequenceLocks(tx, nLockTimeFlags, &prevheights, *pindex)) {
@@ -2422,6 +3002,12 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return AbortNode(state, "Failed to write transaction index");
 
+    if (fBlockFilterIndex && !WriteBlockFilterIndex(block, blockundo, pindex)) // ޹̴̨߳
+        return AbortNode(state, "Failed to write block filter index");
+
+    if (fAddressIndex && !WriteAddressIndex(block, blockundo, pindex, &vAddressSpent))
+        return AbortNode(state, "Failed to write address index");
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2500,6 +3086,8 @@ bool static FlushStateToDisk(CValidationState &state, FlushStateMode mode) {
         if (!CheckDiskSpace(0)) // 鵱ǰĴ̿ռ
             return state.Error("out of disk space");
         // First make sure all block and undo data is flushed to disk. // ״ȷȫͻָݱˢµ
+        if (!blockFileWriter.Flush()) // ָδд
+            return AbortNode(state, "Failed to write to block files");
         FlushBlockFile(); // ˢļ
         // Then update all block file information (which may refer to block and undo files). // ȻȫļϢܲͻָļ
         {
@@ -2564,6 +3152,7 @@ void PruneAndFlush() {
 void static UpdateTip(CBlockIndex *pindexNew) {
     const CChainParams& chainParams = Params();
     chainActive.SetTip(pindexNew);
+    PublishChainSnapshot(chainActive, pindexBestHeader); // µ
 
     // New best block
     nTimeBestReceived = GetTime();
@@ -2635,6 +3224,8 @@ bool static DisconnectTip(CValidationState& state, const Consensus::Params& cons
             return error("DisconnectTip(): DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
         assert(view.Flush());
     }
+    if (fAddressIndex && !DisconnectAddressIndex(block, pindexDelete))
+        return AbortNode(state, "Failed to update address index");
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
     // Write the chain state to disk, if necessary. // Ҫ״̬д
     if (!FlushStateToDisk(state, FLUSH_STATE_IF_NEEDED)) // ˢ״̬
@@ -3044,25 +3635,31 @@ CBlockIndex* AddToBlockIndex(const CBlockHeader& block)
         return it->second; // ֱӷظ
 
     // Construct new block index object // µ
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.New(block);
     // We assign the sequence id to blocks only when the full data is available, // ֻݿʱк
     // to avoid miners withholding blocks but broadcasting headers, to get a // 󹤿ֻ㲥ͷ
     // competitive advantage. // Իȡơ
     pindexNew->nSequenceId = 0;
-    BlockMap::iterator mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first; // ӳбȡȡ
-    pindexNew->phashBlock = &((*mi).first); // ȡϣ
-    BlockMap::iterator miPrev = mapBlockIndex.find(block.hashPrevBlock); // ӳбвǰһ
-    if (miPrev != mapBlockIndex.end()) // ҵ
     {
-        pindexNew->pprev = (*miPrev).second; // ȡΪǰǰһ
-        pindexNew->nHeight = pindexNew->pprev->nHeight + 1; // 㵱ǰĸ߶ȣǰһ߶ȼ 1
-        pindexNew->BuildSkip(); // 
+        // LookupBlockIndex only takes cs_mapBlockIndex, so the entry must be // LookupBlockIndex ֻ cs_mapBlockIndex
+        // complete before the lock is released. // ͷŸǰĿ
+        LOCK(cs_mapBlockIndex);
+        BlockMap::iterator mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first; // ӳбȡ
+        pindexNew->phashBlock = &((*mi).first); // ȡϣ
+        BlockMap::iterator miPrev = mapBlockIndex.find(block.hashPrevBlock); // ӳбвǰһ
+        if (miPrev != mapBlockIndex.end()) // ҵ
+        {
+            pindexNew->pprev = (*miPrev).second; // ȡΪǰǰһ
+            pindexNew->nHeight = pindexNew->pprev->nHeight + 1; // 㵱ǰĸ߶ȣǰһ߶ȼ 1
+            pindexNew->BuildSkip(); // 
+        }
+        pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew); // 㵱ǰ
+        pindexNew->RaiseValidity(BLOCK_VALID_TREE); // Чȼ
     }
-    pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew); // 㵱ǰ
-    pindexNew->RaiseValidity(BLOCK_VALID_TREE); // Чȼ
-    if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork) // ͷΪգСڵǰ
+    if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork) { // ͷΪգСڵǰ
         pindexBestHeader = pindexNew; // ǰΪµͷ
+        PublishChainSnapshot(chainActive, pindexBestHeader); // µ
+    }
 
     setDirtyBlockIndex.insert(pindexNew); // 
 
@@ -3156,12 +3753,7 @@ bool FindBlockPos(CValidationState &state, CDiskBlockPos &pos, unsigned int nAdd
             if (fPruneMode)
                 fCheckForPruning = true;
             if (CheckDiskSpace(nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos)) {
-                FILE *file = OpenBlockFile(pos);
-                if (file) {
-                    LogPrintf("Pre-allocating up to position 0x%x in blk%05u.dat\n", nNewChunks * BLOCKFILE_CHUNK_SIZE, pos.nFile);
-                    AllocateFileRange(file, pos.nPos, nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos);
-                    fclose(file);
-                }
+                blockFileWriter.QueueAllocate(false, pos, nNewChunks * BLOCKFILE_CHUNK_SIZE - pos.nPos); // ɺ̨дԤ
             }
             else
                 return state.Error("out of disk space");
@@ -3189,12 +3781,7 @@ bool FindUndoPos(CValidationState &state, int nFile, CDiskBlockPos &pos, unsigne
         if (fPruneMode)
             fCheckForPruning = true;
         if (CheckDiskSpace(nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos)) {
-            FILE *file = OpenUndoFile(pos);
-            if (file) {
-                LogPrintf("Pre-allocating up to position 0x%x in rev%05u.dat\n", nNewChunks * UNDOFILE_CHUNK_SIZE, pos.nFile);
-                AllocateFileRange(file, pos.nPos, nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos);
-                fclose(file);
-            }
+            blockFileWriter.QueueAllocate(true, pos, nNewChunks * UNDOFILE_CHUNK_SIZE - pos.nPos);
         }
         else
             return state.Error("out of disk space");
@@ -3498,7 +4085,7 @@ bool ProcessNewBlock(CValidationState& state, const CChainParams& chainparams, c
 
     {
         LOCK(cs_main);
-        bool fRequested = MarkBlockAsReceived(pblock->GetHash()); // Ϊյ
+        bool fRequested = MarkBlockAsReceived(pblock->GetHash(), pfrom ? pfrom->GetId() : -1, ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION)); // ΪյС뽻ĶԶ˵ͳ
         fRequested |= fForceProcessing; // true
         if (!checked) {
             return error("%s: CheckBlock FAILED", __func__);
@@ -3699,6 +4286,13 @@ boost::filesystem::path GetBlockPosFilename(const CDiskBlockPos &pos, const char
     return GetDataDir() / "blocks" / strprintf("%s%05u.dat", prefix, pos.nFile); // ƴ 2 ǰ׺ļ·
 }
 
+CBlockIndex* LookupBlockIndex(const uint256& hash)
+{
+    LOCK(cs_mapBlockIndex);
+    BlockMap::const_iterator it = mapBlockIndex.find(hash); // ӳбв
+    return it == mapBlockIndex.end() ? NULL : it->second;
+}
+
 CBlockIndex * InsertBlockIndex(uint256 hash)
 {
     if (hash.IsNull()) // ϣǿ
@@ -3709,16 +4303,55 @@ CBlockIndex * InsertBlockIndex(uint256 hash)
     if (mi != mapBlockIndex.end()) // ڸùϣ
         return (*mi).second; // ֱӷضӦ
 
-    // Create new // µ
-    CBlockIndex* pindexNew = new CBlockIndex(); // ½
-    if (!pindexNew)
-        throw runtime_error("LoadBlockIndex(): new CBlockIndex failed");
-    mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first; // ϣԺӳбȡӦλõĵ
-    pindexNew->phashBlock = &((*mi).first); // ȡϣֵ
+    // Create new. The remaining fields are filled in by LoadBlockIndexGuts and // µġֶ LoadBlockIndexGuts  LoadBlockIndexDB 䣬
+    // LoadBlockIndexDB, before RPC and REST leave warmup. //  RPC  REST Ԥ֮ǰ
+    CBlockIndex* pindexNew = blockIndexArena.New(); // ½
+    {
+        LOCK(cs_mapBlockIndex);
+        mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first; // ϣԺӳбȡӦλõĵ
+        pindexNew->phashBlock = &((*mi).first); // ȡϣֵ
+    }
 
     return pindexNew; // µ
 }
 
+typedef std::vector<std::pair<int, CBlockIndex*> > HeightIndexVector;
+
+/** Sort every nStep-th slice of v, starting at nStart; slice i is [vBounds[i], vBounds[i + 1]) */
+static void SortHeightIndexSlices(HeightIndexVector* pv, const std::vector<size_t>* pvBounds, unsigned int nStart, unsigned int nStep)
+{
+    for (size_t i = nStart; i + 1 < pvBounds->size(); i += nStep)
+        std::sort(pv->begin() + (*pvBounds)[i], pv->begin() + (*pvBounds)[i + 1]);
+}
+
+/** Merge every nStep-th pair of adjacent runs of nWidth sorted slices, starting at pair nStart */
+static void MergeHeightIndexSlices(HeightIndexVector* pv, const std::vector<size_t>* pvBounds, size_t nWidth, unsigned int nStart, unsigned int nStep)
+{
+    const size_t nSlices = pvBounds->size() - 1;
+    for (size_t i = nStart * 2 * nWidth; i + nWidth < nSlices; i += nStep * 2 * nWidth)
+        std::inplace_merge(pv->begin() + (*pvBounds)[i], pv->begin() + (*pvBounds)[i + nWidth], pv->begin() + (*pvBounds)[std::min(i + 2 * nWidth, nSlices)]);
+}
+
+/** Sort by height on one thread per core: slices are sorted concurrently, then merged pairwise */
+static void SortByHeight(HeightIndexVector& v)
+{
+    static const size_t MIN_SLICE_SIZE = 16384; // ÿ߳Ŀ
+    size_t nSlices = std::min((size_t)std::max(GetNumCores(), 1), v.size() / MIN_SLICE_SIZE);
+    if (nSlices <= 1) {
+        std::sort(v.begin(), v.end());
+        return;
+    }
+
+    std::vector<size_t> vBounds; // Ƭ㣬յ
+    for (size_t i = 0; i <= nSlices; i++)
+        vBounds.push_back(v.size() * i / nSlices);
+    ParallelFor(nSlices, boost::bind(&SortHeightIndexSlices, &v, &vBounds, _1, _2));
+    for (size_t nWidth = 1; nWidth < nSlices; nWidth *= 2) { // ϲ
+        size_t nPairs = (nSlices - nWidth + 2 * nWidth - 1) / (2 * nWidth); // ϲĶ
+        ParallelFor(nPairs, boost::bind(&MergeHeightIndexSlices, &v, &vBounds, nWidth, _1, _2));
+    }
+}
+
 bool static LoadBlockIndexDB()
 {
     const CChainParams& chainparams = Params(); // ȡ
@@ -3728,14 +4361,14 @@ bool static LoadBlockIndexDB()
     boost::this_thread::interruption_point(); // ϵ
 
     // Calculate nChainWork // 
-    vector<pair<int, CBlockIndex*> > vSortedByHeight; // ͨ߶߶ӳб
+    HeightIndexVector vSortedByHeight; // ͨ߶߶ӳб
     vSortedByHeight.reserve(mapBlockIndex.size()); // ԤӳбȴĿռ
     BOOST_FOREACH(const PAIRTYPE(uint256, CBlockIndex*)& item, mapBlockIndex) // ӳб
     {
         CBlockIndex* pindex = item.second; // ȡ
         vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex)); // ߶Լб
     }
-    sort(vSortedByHeight.begin(), vSortedByHeight.end()); // ߶
+    SortByHeight(vSortedByHeight); // ߶
     BOOST_FOREACH(const PAIRTYPE(int, CBlockIndex*)& item, vSortedByHeight) // ӳб
     {
         CBlockIndex* pindex = item.second; // ȡ
@@ -3818,6 +4451,7 @@ bool static LoadBlockIndexDB()
     if (it == mapBlockIndex.end()) // δҵ
         return true; // ֱӷ true
     chainActive.SetTip(it->second); // ڣøΪ⣨бУ
+    PublishChainSnapshot(chainActive, pindexBestHeader); // 
 
     PruneBlockIndexCandidates(); // ޼ѡ
 
@@ -3924,6 +4558,7 @@ void UnloadBlockIndex()
     chainActive.SetTip(NULL);
     pindexBestInvalid = NULL;
     pindexBestHeader = NULL;
+    PublishChainSnapshot(chainActive, pindexBestHeader); // յ
     mempool.clear();
     mapOrphanTransactions.clear();
     mapOrphanTransactionsByPrev.clear();
@@ -3944,11 +4579,14 @@ void UnloadBlockIndex()
         warningcache[b].clear();
     }
 
-    BOOST_FOREACH(BlockMap::value_type& entry, mapBlockIndex) {
-        delete entry.second;
+    {
+        LOCK(cs_mapBlockIndex);
+        mapBlockIndex.clear(); // ӳ
+        blockIndexArena.Clear(); // ͷȫ
     }
-    mapBlockIndex.clear(); // ӳ
     fHavePruned = false;
+    fTxIndexSynced = false;
+    UnregisterValidationInterface(&txIndexBestChain);
 }
 
 bool LoadBlockIndex()
@@ -4400,6 +5038,25 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
 
     vector<CInv> vNotFound; // δҵб
 
+    // Recently relayed transactions are answered straight from the relay // м̵ĽֱӴм̻Ӧ
+    // cache, which does not need cs_main. Stop at the first request that // ⲻҪ cs_main
+    // does, so replies still go out in the order they were asked for. // ׸Ҫ cs_main ֹͣԱ֤Ӧ˳˳һ
+    while (it != pfrom->vRecvGetData.end() && it->type == MSG_TX) { // ջȡݶпͷĽ
+        if (pfrom->nSendSize >= SendBufferSize()) // ͻǰСﵽֵ
+            break; // ֱ
+        CRelayCache::DataPtr pdata = relayCache.Find(*it); // м̻вҸÿĿ
+        if (!pdata) // δҵ
+            break; //  cs_main ·
+        boost::this_thread::interruption_point(); // ϵ
+        pfrom->PushMessage(it->GetCommand(), *pdata); // ͶӦݵԶ
+        GetMainSignals().Inventory(it->hash); // ӿĴ
+        it++; // 
+    }
+    pfrom->vRecvGetData.erase(pfrom->vRecvGetData.begin(), it); // ͵
+    if (pfrom->vRecvGetData.empty()) // ȫӦ
+        return; // ֱӷ
+    it = pfrom->vRecvGetData.begin(); // õ
+
     LOCK(cs_main); // 
 
     while (it != pfrom->vRecvGetData.end()) { // ջȡб
@@ -4412,7 +5069,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             boost::this_thread::interruption_point(); // ϵ
             it++; // 
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) // ϢΪ˵
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK) // ϢΪ顢˵
             {
                 bool send = false; // ͱ־ʼ false
                 BlockMap::iterator mi = mapBlockIndex.find(inv.hash); // ӳблȡ
@@ -4454,12 +5111,12 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                         assert(!"cannot load block from disk");
                     if (inv.type == MSG_BLOCK) // ĿΪ
                         pfrom->PushMessage(NetMsgType::BLOCK, block); // ͸鵽Զ
-                    else // MSG_FILTERED_BLOCK) // Ϊ˵
+                    else if (inv.type == MSG_FILTERED_BLOCK) // ˵
                     {
                         LOCK(pfrom->cs_filter); // 
                         if (pfrom->pfilter) // ³ķ
                         {
-                            CMerkleBlock merkleBlock(block, *pfrom->pfilter);
+                            CMerkleBlock merkleBlock(block, GetFilteredBlockKeys(block), *pfrom->pfilter);
                             pfrom->PushMessage(NetMsgType::MERKLEBLOCK, merkleBlock);
                             // CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
                             // This avoids hurting performance by pointlessly requiring a round-trip
@@ -4474,6 +5131,18 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                         // else // 
                             // no response // Ӧ
                     }
+                    else if (inv.type == MSG_CMPCT_BLOCK) // 
+                    {
+                        // If a peer is asking for old blocks, we're almost guaranteed
+                        // they won't have a useful mempool to match against a compact block,
+                        // and we don't feel like constructing the object for them, so
+                        // instead we respond with the full, non-compact block. // ھ飬ֱӷ
+                        if (mi->second->nHeight >= chainActive.Height() - MAX_CMPCTBLOCK_DEPTH) {
+                            CBlockHeaderAndShortTxIDs cmpctblock(block);
+                            pfrom->PushMessage(NetMsgType::CMPCTBLOCK, cmpctblock);
+                        } else
+                            pfrom->PushMessage(NetMsgType::BLOCK, block);
+                    }
 
                     // Trigger the peer node to send a getblocks request for the next batch of inventory // Զ˽ڵ㷢һһ getblocks 
                     if (inv.hash == pfrom->hashContinue) // ÿĿΪһ׸ϣ
@@ -4493,10 +5162,9 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
                 // Send stream from relay memory // мڴз
                 bool pushed = false; // ͱ־ʼΪ false
                 {
-                    LOCK(cs_mapRelay); // мӳб
-                    map<CInv, CDataStream>::iterator mi = mapRelay.find(inv); // мӳбвҸÿĿ
-                    if (mi != mapRelay.end()) { // ҵ
-                        pfrom->PushMessage(inv.GetCommand(), (*mi).second); // ͶӦݵԶ
+                    CRelayCache::DataPtr pdata = relayCache.Find(inv); // м̻вҸÿĿ
+                    if (pdata) { // ҵ
+                        pfrom->PushMessage(inv.GetCommand(), *pdata); // ͶӦݵԶ
                         pushed = true; // ͱ־ true
                     }
                 }
@@ -4518,7 +5186,7 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
             // Track requests for our stuff. // Ƕ
             GetMainSignals().Inventory(inv.hash); // ӿĴ
 
-            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) // ĿΪ˵
+            if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK || inv.type == MSG_CMPCT_BLOCK) // ĿΪ顢˵
                 break; // 
         }
     }
@@ -4537,6 +5205,72 @@ void static ProcessGetData(CNode* pfrom, const Consensus::Params& consensusParam
     }
 }
 
+/**
+ * Hand a block received from pfrom, either in full or reconstructed from a
+ * compact block, to ProcessNewBlock and report the outcome to the peer.
+ */ // ӶԶյģؽģ飬Զ˷
+void static ProcessBlockFromPeer(CNode* pfrom, const CBlock& block, bool fForceProcessing, const CChainParams& chainparams)
+{
+    CValidationState state;
+    ProcessNewBlock(state, chainparams, pfrom, &block, fForceProcessing, NULL);
+    int nDoS;
+    if (state.IsInvalid(nDoS)) {
+        assert (state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
+        pfrom->PushMessage(NetMsgType::REJECT, string(NetMsgType::BLOCK), (unsigned char)state.GetRejectCode(),
+                           state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), block.GetHash());
+        if (nDoS > 0) {
+            LOCK(cs_main);
+            Misbehaving(pfrom->GetId(), nDoS);
+        }
+    } else if (!IsInitialBlockDownload()) {
+        // The peer delivered our new tip; let it announce future blocks to us
+        // with compact blocks. // öԶṩǵ⣬Ժ֪ͨ
+        LOCK(cs_main);
+        if (chainActive.Tip()->GetBlockHash() == block.GetHash())
+            MaybeSetPeerAsAnnouncingHeaderAndIDs(State(pfrom->GetId()), pfrom);
+    }
+}
+
+/**
+ * Validate a getcfilters/getcfheaders/getcfcheckpt request and look up its
+ * stop block. Peers asking for filters we do not serve are disconnected, as
+ * BIP 157 requires. Returns false if the request should be ignored.
+ */
+static bool PrepareBlockFilterRequest(CNode* pfrom, uint8_t nFilterType, uint32_t nStartHeight, const uint256& stopHash,
+                                      uint32_t nMaxHeightDiff, const CBlockIndex*& pindexStop)
+{
+    AssertLockHeld(cs_main);
+
+    if (!fBlockFilterIndex || nFilterType != BLOCK_FILTER_BASIC) { // ֵ֧Ĺ
+        LogPrint("net", "peer %d requested unsupported block filter type: %d\n", pfrom->id, nFilterType);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+
+    BlockMap::iterator mi = mapBlockIndex.find(stopHash);
+    if (mi == mapBlockIndex.end() || !mi->second->IsValid(BLOCK_VALID_SCRIPTS)) { // ֻΪȫ֤ṩ
+        LogPrint("net", "peer %d requested compact filters for unknown block %s\n", pfrom->id, stopHash.ToString());
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    pindexStop = mi->second;
+
+    uint32_t nStopHeight = pindexStop->nHeight;
+    if (nStartHeight > nStopHeight) {
+        LogPrint("net", "peer %d sent invalid compact filter request with start height %d > stop height %d\n",
+                 pfrom->id, nStartHeight, nStopHeight);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    if (nStopHeight - nStartHeight >= nMaxHeightDiff) {
+        LogPrint("net", "peer %d requested too many compact filters/headers: %d / %d\n",
+                 pfrom->id, nStopHeight - nStartHeight + 1, nMaxHeightDiff);
+        pfrom->fDisconnect = true;
+        return false;
+    }
+    return true;
+}
+
 bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv, int64_t nTimeReceived) // Σڵ㣬ݣʱ
 {
     const CChainParams& chainparams = Params(); // ȡ
@@ -4712,6 +5446,16 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
             // nodes)
             pfrom->PushMessage(NetMsgType::SENDHEADERS); // ظ SENDHEADERS Ϣʶڵʹͷģʽͬ
         }
+        if (pfrom->nVersion >= SHORT_IDS_BLOCKS_VERSION) { // Э汾ڵ 70014
+            // Tell our peer we are willing to provide version-1 cmpctblocks.
+            // However, we do not request new block announcements using
+            // cmpctblock messages.
+            // We send this to non-NODE NETWORK peers as well, because
+            // they may wish to request compact blocks from us // ֪Զǿṩ飬Ҫ֪ͨ
+            bool fAnnounceUsingCMPCTBLOCK = false;
+            uint64_t nCMPCTBLOCKVersion = 1;
+            pfrom->PushMessage(NetMsgType::SENDCMPCT, fAnnounceUsingCMPCTBLOCK, nCMPCTBLOCKVersion);
+        }
     }
 
 
@@ -4787,6 +5531,31 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
         State(pfrom->GetId())->fPreferHeaders = true; // ͷģʽ
     }
 
+    else if (strCommand == NetMsgType::FEEFILTER && pfrom->nVersion >= FEEFILTER_VERSION) // ʹϢ
+    {
+        CAmount newFeeFilter = 0;
+        vRecv >> newFeeFilter;
+        if (MoneyRange(newFeeFilter)) { // ԳΧķ
+            {
+                LOCK(pfrom->cs_feeFilter);
+                pfrom->minFeeFilter = newFeeFilter; // øöԶ˵ķʹ
+            }
+            LogPrint("net", "received: feefilter of %s from peer=%d\n", CFeeRate(newFeeFilter).ToString(), pfrom->id);
+        }
+    }
+
+    else if (strCommand == NetMsgType::SENDCMPCT) // ģʽϢ
+    {
+        bool fAnnounceUsingCMPCTBLOCK = false;
+        uint64_t nCMPCTBLOCKVersion = 1;
+        vRecv >> fAnnounceUsingCMPCTBLOCK >> nCMPCTBLOCKVersion;
+        if (nCMPCTBLOCKVersion == 1) { // ְֻ֧汾 1汾
+            LOCK(cs_main);
+            State(pfrom->GetId())->fProvidesHeaderAndIDs = true; // öԶ˿ṩ
+            State(pfrom->GetId())->fPreferHeaderAndIDs = fAnnounceUsingCMPCTBLOCK; // öԶǷҪ֪ͨ
+        }
+    }
+
 
     else if (strCommand == NetMsgType::INV) // ϢڷͱڵĽ׺б
     {
@@ -5208,6 +5977,13 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                             pindexLast->GetBlockHash().ToString(), pindexLast->nHeight);
                 }
                 if (vGetData.size() > 0) {
+                    if (nodestate->fProvidesHeaderAndIDs && vGetData.size() == 1 && mapBlocksInFlight.size() == 1 && pindexLast->pprev->IsValid(BLOCK_VALID_CHAIN)) {
+                        // We seem to be rather well-synced, so it appears pfrom was the first to provide us
+                        // with this block! Let's get them to announce using compact blocks in the future.
+                        MaybeSetPeerAsAnnouncingHeaderAndIDs(nodestate, pfrom);
+                        // In any case, we want to download using a compact block, not a regular one // ķʽ
+                        vGetData[0] = CInv(MSG_CMPCT_BLOCK, vGetData[0].hash);
+                    }
                     pfrom->PushMessage(NetMsgType::GETDATA, vGetData);
                 }
             }
@@ -5226,24 +6002,214 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 
         pfrom->AddInventoryKnown(inv);
 
-        CValidationState state;
         // Process all blocks from whitelisted peers, even if not requested,
         // unless we're still syncing with the network.
         // Such an unrequested block may still be processed, subject to the
         // conditions in AcceptBlock().
         bool forceProcessing = pfrom->fWhitelisted && !IsInitialBlockDownload();
-        ProcessNewBlock(state, chainparams, pfrom, &block, forceProcessing, NULL);
-        int nDoS;
-        if (state.IsInvalid(nDoS)) {
-            assert (state.GetRejectCode() < REJECT_INTERNAL); // Blocks are never rejected with internal reject codes
-            pfrom->PushMessage(NetMsgType::REJECT, strCommand, (unsigned char)state.GetRejectCode(),
-                               state.GetRejectReason().substr(0, MAX_REJECT_MESSAGE_LENGTH), inv.hash);
-            if (nDoS > 0) {
-                LOCK(cs_main);
-                Misbehaving(pfrom->GetId(), nDoS);
+        ProcessBlockFromPeer(pfrom, block, forceProcessing, chainparams);
+    }
+
+
+    else if (strCommand == NetMsgType::CMPCTBLOCK && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        CBlockHeaderAndShortTxIDs cmpctblock;
+        vRecv >> cmpctblock;
+
+        CBlock block; // ؽ
+        bool fBlockReconstructed = false;
+        {
+        LOCK(cs_main);
+
+        if (mapBlockIndex.find(cmpctblock.header.hashPrevBlock) == mapBlockIndex.end()) {
+            // Doesn't connect (or is genesis), instead of DoSing in AcceptBlockHeader, request deeper headers // ޷ӣͷ
+            if (!IsInitialBlockDownload())
+                pfrom->PushMessage(NetMsgType::GETHEADERS, chainActive.GetLocator(pindexBestHeader), uint256());
+            return true;
+        }
+
+        CBlockIndex *pindex = NULL;
+        CValidationState state;
+        if (!AcceptBlockHeader(cmpctblock.header, state, chainparams, &pindex)) {
+            int nDoS;
+            if (state.IsInvalid(nDoS)) {
+                if (nDoS > 0)
+                    Misbehaving(pfrom->GetId(), nDoS);
+                LogPrintf("Peer %d sent us invalid header via cmpctblock\n", pfrom->id);
+                return true;
+            }
+        }
+
+        // If AcceptBlockHeader returned true, it set pindex
+        assert(pindex);
+        UpdateBlockAvailability(pfrom->GetId(), pindex->GetBlockHash());
+
+        map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator blockInFlightIt = mapBlocksInFlight.find(pindex->GetBlockHash());
+        bool fAlreadyInFlight = blockInFlightIt != mapBlocksInFlight.end();
+
+        if (pindex->nStatus & BLOCK_HAVE_DATA) // Nothing to do here // и
+            return true;
+
+        if (pindex->nChainWork <= chainActive.Tip()->nChainWork || // We know something better
+                pindex->nTx != 0) { // We had this block at some point, but pruned it
+            if (fAlreadyInFlight) {
+                // We requested this block for some reason, but our mempool will probably be useless
+                // so we just grab the block via normal getdata
+                std::vector<CInv> vInv(1);
+                vInv[0] = CInv(MSG_BLOCK, cmpctblock.header.GetHash());
+                pfrom->PushMessage(NetMsgType::GETDATA, vInv);
+            }
+            return true;
+        }
+
+        // If we're not close to tip yet, give up and let parallel block fetch work its magic
+        if (!fAlreadyInFlight && !CanDirectFetch(chainparams.GetConsensus()))
+            return true;
+
+        CNodeState *nodestate = State(pfrom->GetId());
+
+        // We want to be a bit conservative just to be extra careful about DoS
+        // possibilities in compact block processing... // ֻ
+        if (pindex->nHeight <= chainActive.Height() + 2) {
+            if ((!fAlreadyInFlight && nodestate->nBlocksInFlight < nodestate->nBlocksInFlightMax) ||
+                    (fAlreadyInFlight && blockInFlightIt->second.first == pfrom->GetId())) {
+                if (!fAlreadyInFlight)
+                    MarkBlockAsInFlight(pfrom->GetId(), pindex->GetBlockHash(), chainparams.GetConsensus(), pindex);
+                QueuedBlock& queuedBlock = *mapBlocksInFlight[pindex->GetBlockHash()].second;
+                if (queuedBlock.partialBlock) // Already requested the missing transactions // ȱʧĽ
+                    return true;
+                queuedBlock.partialBlock.reset(new PartiallyDownloadedBlock(&mempool));
+                PartiallyDownloadedBlock& partialBlock = *queuedBlock.partialBlock;
+                ReadStatus status = partialBlock.InitData(cmpctblock); // Ԥ佻׺ڴؽ׳ʼ
+                if (status == READ_STATUS_INVALID) {
+                    MarkBlockAsReceived(pindex->GetBlockHash()); // Reset in-flight state in case of whitelist
+                    Misbehaving(pfrom->GetId(), 100);
+                    LogPrintf("Peer %d sent us invalid compact block\n", pfrom->id);
+                    return true;
+                } else if (status == READ_STATUS_FAILED) {
+                    // Duplicate txindexes, the block is now in-flight, so just request it // ֱ
+                    std::vector<CInv> vInv(1);
+                    vInv[0] = CInv(MSG_BLOCK, cmpctblock.header.GetHash());
+                    pfrom->PushMessage(NetMsgType::GETDATA, vInv);
+                    return true;
+                }
+
+                BlockTransactionsRequest req;
+                for (size_t i = 0; i < cmpctblock.BlockTxCount(); i++) {
+                    if (!partialBlock.IsTxAvailable(i))
+                        req.indexes.push_back(i); // ¼ȱʧ׵
+                }
+                if (req.indexes.empty()) { // н׶Ѿֱؽ
+                    status = partialBlock.FillBlock(block, std::vector<CTransaction>());
+                    if (status != READ_STATUS_OK) {
+                        // Short ID collision, fall back to the full block
+                        std::vector<CInv> vInv(1);
+                        vInv[0] = CInv(MSG_BLOCK, cmpctblock.header.GetHash());
+                        pfrom->PushMessage(NetMsgType::GETDATA, vInv);
+                        return true;
+                    }
+                    fBlockReconstructed = true;
+                } else {
+                    req.blockhash = pindex->GetBlockHash();
+                    pfrom->PushMessage(NetMsgType::GETBLOCKTXN, req); // ȱʧĽ
+                }
+            }
+        } else if (fAlreadyInFlight) {
+            // We requested this block, but it's far into the future, so our
+            // mempool will probably be useless - request the block normally
+            std::vector<CInv> vInv(1);
+            vInv[0] = CInv(MSG_BLOCK, cmpctblock.header.GetHash());
+            pfrom->PushMessage(NetMsgType::GETDATA, vInv);
+            return true;
+        }
+        // Otherwise the header is treated like a headers announcement and the
+        // block is left to the regular download logic in SendMessages.
+        } // cs_main
+
+        if (fBlockReconstructed)
+            ProcessBlockFromPeer(pfrom, block, false, chainparams);
+    }
+
+
+    else if (strCommand == NetMsgType::GETBLOCKTXN) // ȡ齻Ϣ
+    {
+        BlockTransactionsRequest req;
+        vRecv >> req;
+
+        LOCK(cs_main);
+
+        BlockMap::iterator it = mapBlockIndex.find(req.blockhash);
+        if (it == mapBlockIndex.end() || !(it->second->nStatus & BLOCK_HAVE_DATA)) {
+            LogPrint("net", "Peer %d sent us a getblocktxn for a block we don't have\n", pfrom->id);
+            return true;
+        }
+
+        if (it->second->nHeight < chainActive.Height() - MAX_BLOCKTXN_DEPTH) {
+            // If an older block is requested (should never happen in practice,
+            // but can happen in tests) send a block response instead of a
+            // blocktxn response. Sending a full block response instead of a
+            // small blocktxn response is preferable in the case where a peer
+            // might maliciously send lots of getblocktxn requests to trigger
+            // expensive disk reads, because it will require the peer to
+            // actually receive all the data read from disk over the network. // ھ飬ظ
+            LogPrint("net", "Peer %d sent us a getblocktxn for a block > %i deep\n", pfrom->id, MAX_BLOCKTXN_DEPTH);
+            pfrom->vRecvGetData.push_back(CInv(MSG_BLOCK, req.blockhash));
+            ProcessGetData(pfrom, chainparams.GetConsensus());
+            return true;
+        }
+
+        CBlock block;
+        if (!ReadBlockFromDisk(block, it->second, chainparams.GetConsensus()))
+            assert(!"cannot load block from disk");
+
+        BlockTransactions resp(req);
+        for (size_t i = 0; i < req.indexes.size(); i++) {
+            if (req.indexes[i] >= block.vtx.size()) {
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us a getblocktxn with out-of-bounds tx indices\n", pfrom->id);
+                return true;
             }
+            resp.txn[i] = block.vtx[req.indexes[i]];
         }
+        pfrom->PushMessage(NetMsgType::BLOCKTXN, resp); // ظĽ
+    }
+
+
+    else if (strCommand == NetMsgType::BLOCKTXN && !fImporting && !fReindex) // Ignore blocks received while importing
+    {
+        BlockTransactions resp;
+        vRecv >> resp;
+
+        CBlock block; // ؽ
+        bool fBlockRead = false;
+        {
+            LOCK(cs_main);
 
+            map<uint256, pair<NodeId, list<QueuedBlock>::iterator> >::iterator it = mapBlocksInFlight.find(resp.blockhash);
+            if (it == mapBlocksInFlight.end() || !it->second.second->partialBlock ||
+                    it->second.first != pfrom->GetId()) {
+                LogPrint("net", "Peer %d sent us block transactions for block we weren't expecting\n", pfrom->id);
+                return true;
+            }
+
+            PartiallyDownloadedBlock& partialBlock = *it->second.second->partialBlock;
+            ReadStatus status = partialBlock.FillBlock(block, resp.txn); // յĽײȫ
+            if (status == READ_STATUS_INVALID) {
+                MarkBlockAsReceived(resp.blockhash); // Reset in-flight state in case of whitelist
+                Misbehaving(pfrom->GetId(), 100);
+                LogPrintf("Peer %d sent us invalid compact block/non-matching block transactions\n", pfrom->id);
+                return true;
+            } else if (status == READ_STATUS_FAILED) {
+                // Might have collided, fall back to getdata now :( // ܷ ID ײΪ
+                std::vector<CInv> invs;
+                invs.push_back(CInv(MSG_BLOCK, resp.blockhash));
+                pfrom->PushMessage(NetMsgType::GETDATA, invs);
+            } else
+                fBlockRead = true;
+        } // cs_main
+
+        if (fBlockRead)
+            ProcessBlockFromPeer(pfrom, block, false, chainparams);
     }
 
 
@@ -5451,6 +6417,102 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
+    else if (strCommand == NetMsgType::GETCFILTERS) // ȡϢ
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 stopHash;
+        vRecv >> nFilterType >> nStartHeight >> stopHash;
+
+        std::vector<uint256> vBlockHashes; // Χڵϣ߶
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexStop = NULL;
+            if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, stopHash, MAX_GETCFILTERS_SIZE, pindexStop))
+                return true;
+            vBlockHashes.resize(pindexStop->nHeight - nStartHeight + 1);
+            for (const CBlockIndex* pindex = pindexStop; pindex && pindex->nHeight >= (int)nStartHeight; pindex = pindex->pprev)
+                vBlockHashes[pindex->nHeight - nStartHeight] = pindex->GetBlockHash();
+        }
+
+        BOOST_FOREACH(const uint256& hashBlock, vBlockHashes) {
+            std::vector<unsigned char> vEncodedFilter;
+            if (!pblockfilterdb->ReadFilter(hashBlock, vEncodedFilter)) { // ڽ
+                LogPrint("net", "compact filter for block %s requested by peer %d is not yet available\n", hashBlock.ToString(), pfrom->id);
+                break;
+            }
+            pfrom->PushMessage(NetMsgType::CFILTER, nFilterType, hashBlock, vEncodedFilter);
+        }
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFHEADERS) // ȡͷϢ
+    {
+        uint8_t nFilterType;
+        uint32_t nStartHeight;
+        uint256 stopHash;
+        vRecv >> nFilterType >> nStartHeight >> stopHash;
+
+        std::vector<uint256> vBlockHashes;
+        uint256 hashPrevBlock; // ʼĸ飬Ϊ
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexStop = NULL;
+            if (!PrepareBlockFilterRequest(pfrom, nFilterType, nStartHeight, stopHash, MAX_GETCFHEADERS_SIZE, pindexStop))
+                return true;
+            vBlockHashes.resize(pindexStop->nHeight - nStartHeight + 1);
+            for (const CBlockIndex* pindex = pindexStop; pindex && pindex->nHeight >= (int)nStartHeight; pindex = pindex->pprev)
+                vBlockHashes[pindex->nHeight - nStartHeight] = pindex->GetBlockHash();
+            if (nStartHeight > 0)
+                hashPrevBlock = pindexStop->GetAncestor(nStartHeight - 1)->GetBlockHash();
+        }
+
+        uint256 hashPrevFilter, hashPrevHeader;
+        if (!hashPrevBlock.IsNull() && !pblockfilterdb->ReadFilterHeader(hashPrevBlock, hashPrevFilter, hashPrevHeader)) {
+            LogPrint("net", "compact filter headers requested by peer %d are not yet available\n", pfrom->id);
+            return true;
+        }
+        std::vector<uint256> vFilterHashes(vBlockHashes.size());
+        for (size_t i = 0; i < vBlockHashes.size(); i++) {
+            uint256 hashHeader;
+            if (!pblockfilterdb->ReadFilterHeader(vBlockHashes[i], vFilterHashes[i], hashHeader)) {
+                LogPrint("net", "compact filter headers requested by peer %d are not yet available\n", pfrom->id);
+                return true;
+            }
+        }
+        pfrom->PushMessage(NetMsgType::CFHEADERS, nFilterType, stopHash, hashPrevHeader, vFilterHashes); // ظǰһͷϣ
+    }
+
+
+    else if (strCommand == NetMsgType::GETCFCHECKPT) // ȡϢ
+    {
+        uint8_t nFilterType;
+        uint256 stopHash;
+        vRecv >> nFilterType >> stopHash;
+
+        std::vector<uint256> vBlockHashes; // ÿ CFCHECKPT_INTERVAL ļ
+        {
+            LOCK(cs_main);
+            const CBlockIndex* pindexStop = NULL;
+            if (!PrepareBlockFilterRequest(pfrom, nFilterType, 0, stopHash, std::numeric_limits<uint32_t>::max(), pindexStop))
+                return true;
+            vBlockHashes.resize(pindexStop->nHeight / CFCHECKPT_INTERVAL);
+            for (size_t i = 0; i < vBlockHashes.size(); i++)
+                vBlockHashes[i] = pindexStop->GetAncestor((i + 1) * CFCHECKPT_INTERVAL)->GetBlockHash();
+        }
+
+        std::vector<uint256> vHeaders(vBlockHashes.size());
+        for (size_t i = 0; i < vBlockHashes.size(); i++) {
+            uint256 hashFilter;
+            if (!pblockfilterdb->ReadFilterHeader(vBlockHashes[i], hashFilter, vHeaders[i])) {
+                LogPrint("net", "compact filter checkpoints requested by peer %d are not yet available\n", pfrom->id);
+                return true;
+            }
+        }
+        pfrom->PushMessage(NetMsgType::CFCHECKPT, nFilterType, stopHash, vHeaders);
+    }
+
+
     else if (strCommand == NetMsgType::REJECT) // ܾϢڸ֪Է͵Ϣ	
     {
         if (fDebug) { // debug ģʽ¿
@@ -5703,8 +6765,10 @@ bool SendMessages(CNode* pto) // 
         state.rejects.clear(); // վܾб
 
         // Start block sync // ʼͬ
-        if (pindexBestHeader == NULL)
+        if (pindexBestHeader == NULL) {
             pindexBestHeader = chainActive.Tip(); // ȡǰָ
+            PublishChainSnapshot(chainActive, pindexBestHeader); // 
+        }
         bool fFetch = state.fPreferredDownload || (nPreferredDownload == 0 && !pto->fClient && !pto->fOneShot); // Download if this is a nice peer, or we have no nice peers and this one might do.
         if (!state.fSyncStarted && !pto->fClient && !fImporting && !fReindex) {
             // Only actively request headers from a single peer, unless we're close to today.
@@ -5747,7 +6811,7 @@ bool SendMessages(CNode* pto) // 
             // add all to the inv queue.
             LOCK(pto->cs_inventory); // 
             vector<CBlock> vHeaders; // ͷб
-            bool fRevertToInv = (!state.fPreferHeaders || pto->vBlockHashesToAnnounce.size() > MAX_BLOCKS_TO_ANNOUNCE);
+            bool fRevertToInv = ((!state.fPreferHeaders && !state.fPreferHeaderAndIDs) || pto->vBlockHashesToAnnounce.size() > MAX_BLOCKS_TO_ANNOUNCE);
             CBlockIndex *pBestIndex = NULL; // last header queued for delivery
             ProcessBlockAvailability(pto->id); // ensure pindexBestKnownBlock is up-to-date
 
@@ -5784,6 +6848,10 @@ bool SendMessages(CNode* pto) // 
                         break; // 
                     }
                 }
+                // Peers that only asked for cmpctblock announcements get a
+                // single new block that way, anything longer is an inv. // ֻҪ֪ͨĶԶˣһʱ inv
+                if (!state.fPreferHeaders && vHeaders.size() > 1)
+                    fRevertToInv = true;
             }
             if (fRevertToInv) { // ˻صʹ invֻ inv ⡣
                 // If falling back to using an inv, just try to inv the tip.
@@ -5812,6 +6880,17 @@ bool SendMessages(CNode* pto) // 
                             pto->id, hashToAnnounce.ToString());
                     }
                 }
+            } else if (vHeaders.size() == 1 && state.fPreferHeaderAndIDs) { // ֻһҶԶҪ֪ͨ
+                // We only send up to 1 block as header-and-ids, as otherwise
+                // it probably means we're doing an initial-ish-sync or they're slow
+                LogPrint("net", "%s: sending header-and-ids %s to peer=%d\n", __func__,
+                        vHeaders.front().GetHash().ToString(), pto->id);
+                CBlock block;
+                if (!ReadBlockFromDisk(block, pBestIndex, consensusParams)) // Ӵ϶ȡ
+                    assert(!"cannot load block from disk");
+                CBlockHeaderAndShortTxIDs cmpctblock(block);
+                pto->PushMessage(NetMsgType::CMPCTBLOCK, cmpctblock); // 鵽Զ
+                state.pindexBestHeaderSent = pBestIndex;
             } else if (!vHeaders.empty()) { // ͷбǿ
                 if (vHeaders.size() > 1) { // ͷбԪظ 1
                     LogPrint("net", "%s: %u headers, range (%s, %s), to peer=%d\n", __func__,
@@ -5839,6 +6918,11 @@ bool SendMessages(CNode* pto) // 
                 fSendTrickle = true; // ͱ־Ϊ true
                 pto->nNextInvSend = PoissonNextSend(nNow, AVG_INVENTORY_BROADCAST_INTERVAL);
             }
+            CAmount filterrate = 0; // Զ˵ķʹ
+            {
+                LOCK(pto->cs_feeFilter);
+                filterrate = pto->minFeeFilter;
+            }
             LOCK(pto->cs_inventory); // 
             vInv.reserve(std::min<size_t>(1000, pto->vInventoryToSend.size())); // Ԥ 1000 ĿĿռ
             vInvWait.reserve(pto->vInventoryToSend.size()); // ȴбԤٺʹͿбһĿռ
@@ -5847,6 +6931,14 @@ bool SendMessages(CNode* pto) // 
                 if (inv.type == MSG_TX && pto->filterInventoryKnown.contains(inv.hash)) // ĿΪ  ֪Ŀкд˽
                     continue; // 
 
+                // Don't announce transactions below the peer's fee filter // ͨʵڶԶ˹Ľ
+                if (inv.type == MSG_TX && filterrate) {
+                    LOCK(mempool.cs);
+                    CTxMemPool::txiter it = mempool.mapTx.find(inv.hash);
+                    if (it != mempool.mapTx.end() && CFeeRate(it->GetFee(), it->GetTxSize()).GetFeePerK() < filterrate)
+                        continue;
+                }
+
                 // trickle out tx inv to protect privacy // Ŀ˽
                 if (inv.type == MSG_TX && !fSendTrickle) // Ϊ  ͱ־Ϊ false
                 {
@@ -5906,10 +6998,25 @@ bool SendMessages(CNode* pto) // 
         // Message: getdata (blocks) // Ϣgetdata飩
         //
         vector<CInv> vGetData; // ȡĿб
-        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < MAX_BLOCKS_IN_TRANSIT_PER_PEER) { // ڵδϿ  ǿͻ˱־  
+        int64_t nRoundTripTime = pto->nMinPingUsecTime == std::numeric_limits<int64_t>::max() ? 0 : pto->nMinPingUsecTime; // С ping ʱ䣬δΪ 0
+        state.nBlocksInFlightMax = GetBlockDownloadWindow(nRoundTripTime, state.nBlockIntervalAvg); // ʱͽöԶ˵ķд
+        if (!pto->fDisconnect && !pto->fClient && (fFetch || !IsInitialBlockDownload()) && state.nBlocksInFlight < state.nBlocksInFlightMax) { // ڵδϿ  ǿͻ˱־  еСڸöԶ˵Ĵ
             vector<CBlockIndex*> vToDownload;
             NodeId staller = -1;
-            FindNextBlocksToDownload(pto->GetId(), MAX_BLOCKS_IN_TRANSIT_PER_PEER - state.nBlocksInFlight, vToDownload, staller);
+            CBlockIndex *pindexWaitingFor = NULL; // شڵ
+            FindNextBlocksToDownload(pto->GetId(), state.nBlocksInFlightMax - state.nBlocksInFlight, vToDownload, staller, pindexWaitingFor);
+            // If the window is held up by a block another peer is slow to deliver, // شڱһԶ˳ٳδ
+            // and this peer has room and a track record, ask it instead. // ҸöԶпռʷ¼öԶ
+            // A block is moved a bounded number of times, so two slow peers // һ鱻תƵĴޣ
+            // can't keep passing it back and forth. // ٶԶת
+            if (pindexWaitingFor && state.nBlockLatencyAvg && (int)vToDownload.size() < state.nBlocksInFlightMax - state.nBlocksInFlight) {
+                const QueuedBlock &queued = *mapBlocksInFlight[pindexWaitingFor->GetBlockHash()].second;
+                if (queued.nRequests <= MAX_BLOCK_REREQUESTS && nNow - queued.nTime > 2 * state.nBlockLatencyAvg) { // ڶԷķʱ䳬ƽӳٵ 2 δ
+                    LogPrint("net", "Re-requesting block %s (%d) from peer=%d, slow at peer=%d\n", pindexWaitingFor->GetBlockHash().ToString(),
+                        pindexWaitingFor->nHeight, pto->id, mapBlocksInFlight[pindexWaitingFor->GetBlockHash()].first);
+                    vToDownload.insert(vToDownload.begin(), pindexWaitingFor); // 
+                }
+            }
             BOOST_FOREACH(CBlockIndex *pindex, vToDownload) {
                 vGetData.push_back(CInv(MSG_BLOCK, pindex->GetBlockHash()));
                 MarkBlockAsInFlight(pto->GetId(), pindex->GetBlockHash(), consensusParams, pindex);
@@ -5949,6 +7056,28 @@ bool SendMessages(CNode* pto) // 
         if (!vGetData.empty()) // ȡĿбǿ
             pto->PushMessage(NetMsgType::GETDATA, vGetData); // ٴη͸бԶ
 
+        //
+        // Message: feefilter // Ϣʹ
+        //
+        // We don't want white listed peers to filter txs to us if we have -whitelistforcerelay
+        if (pto->nVersion >= FEEFILTER_VERSION && GetBoolArg("-feefilter", DEFAULT_FEEFILTER) &&
+            !(pto->fWhitelisted && GetBoolArg("-whitelistforcerelay", DEFAULT_WHITELISTFORCERELAY))) {
+            CAmount currentFilter = std::max(mempool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000).GetFeePerK(), ::minRelayTxFee.GetFeePerK()); // ǽܵͷ
+            int64_t timeNow = GetTimeMicros();
+            if (timeNow > pto->nextSendTimeFeeFilter) {
+                if (currentFilter != pto->lastSentFeeFilter) {
+                    pto->PushMessage(NetMsgType::FEEFILTER, currentFilter);
+                    pto->lastSentFeeFilter = currentFilter;
+                }
+                pto->nextSendTimeFeeFilter = PoissonNextSend(timeNow, AVG_FEEFILTER_BROADCAST_INTERVAL);
+            }
+            // If the fee filter has changed substantially and it's still more than MAX_FEEFILTER_CHANGE_DELAY // 仯Ҿ´ηͻг
+            // until scheduled broadcast, then move the broadcast to within MAX_FEEFILTER_CHANGE_DELAY. // MAX_FEEFILTER_CHANGE_DELAYѷǰӳ
+            else if (timeNow + MAX_FEEFILTER_CHANGE_DELAY * 1000000 < pto->nextSendTimeFeeFilter &&
+                     (currentFilter < 3 * pto->lastSentFeeFilter / 4 || currentFilter > 4 * pto->lastSentFeeFilter / 3)) {
+                pto->nextSendTimeFeeFilter = timeNow + (insecure_rand() % MAX_FEEFILTER_CHANGE_DELAY) * 1000000;
+            }
+        }
     }
     return true;
 }
@@ -5969,10 +7098,8 @@ public:
     CMainCleanup() {}
     ~CMainCleanup() {
         // block headers // ͷ
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++) // ӳб
-            delete (*it1).second; // ɾ
         mapBlockIndex.clear(); // ӳб
+        blockIndexArena.Clear(); // ͷȫ
 
         // orphan transactions // ¶
         mapOrphanTransactions.clear(); // չ¶ӳб
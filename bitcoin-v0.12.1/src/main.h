@@ -30,9 +30,13 @@
 #include <boost/unordered_map.hpp>
 
 class CBlockIndex;
+class CAddressIndexDB;
+class CBlockFileWriter;
+class CBlockFilterDB;
 class CBlockTreeDB;
 class CBloomFilter;
 class CChainParams;
+class CCoinsViewDB;
 class CInv;
 class CScriptCheck;
 class CTxMemPool;
@@ -75,6 +79,12 @@ static const int MAX_SCRIPTCHECK_THREADS = 16;
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16; // κʱӵԶ
+/** Bounds for the per-peer limit during block download, which adapts to each peer's measured
+ *  latency and throughput. MAX_BLOCKS_IN_TRANSIT_PER_PEER is used until there are measurements. */
+static const int MIN_BLOCKS_IN_TRANSIT_PER_PEER = 4; // ʱԶӦڵ
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE = 64; // ʱԶӦڵ
+/** Number of times a block that holds back the download window may be moved to a faster peer. */
+static const int MAX_BLOCK_REREQUESTS = 2; // شڵɱתƵԶ˵Ĵ
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
 static const unsigned int BLOCK_STALLING_TIMEOUT = 2; // Ϊλĳʱʱ䣬ڶϿ֮ǰԷֹͣؽȡ
 /** Number of headers sent in one getheaders result. We rely on the assumption that if a peer sends
@@ -98,6 +108,10 @@ static const unsigned int AVG_ADDRESS_BROADCAST_INTERVAL = 30;
 /** Average delay between trickled inventory broadcasts in seconds.
  *  Blocks, whitelisted receivers, and a random 25% of transactions bypass this. */ // ΪλĿ㲥ƽӳ١飬Ľߣһ 25% Ľƹһ㡣
 static const unsigned int AVG_INVENTORY_BROADCAST_INTERVAL = 5; // 5s
+/** Average delay between feefilter broadcasts in seconds. */ // Ϊλķʹ㲥ƽӳ
+static const unsigned int AVG_FEEFILTER_BROADCAST_INTERVAL = 10 * 60;
+/** Maximum feefilter broadcast delay after significant change. */ // 仯ʹ㲥ӳ
+static const unsigned int MAX_FEEFILTER_CHANGE_DELAY = 5 * 60;
 /** Block download timeout base, expressed in millionths of the block interval (i.e. 10 min) */ // سʱİ֮һʾ 10 ӣ
 static const int64_t BLOCK_DOWNLOAD_TIMEOUT_BASE = 1000000;
 /** Additional block download timeout per parallel downloading peer (i.e. 5 min) */ // ÿͬĶسʱ 5 ӣ
@@ -106,11 +120,25 @@ static const int64_t BLOCK_DOWNLOAD_TIMEOUT_PER_PEER = 500000;
 static const unsigned int DEFAULT_LIMITFREERELAY = 15;
 static const bool DEFAULT_RELAYPRIORITY = true;
 
+/** Default for -feefilter */ //  -feefilter ѡĬֵ
+static const bool DEFAULT_FEEFILTER = true;
+
 /** Default for -permitbaremultisig */ //  -permitbaremultisig ѡĬֵ
 static const bool DEFAULT_PERMIT_BAREMULTISIG = true;
 static const unsigned int DEFAULT_BYTES_PER_SIGOP = 20;
 static const bool DEFAULT_CHECKPOINTS_ENABLED = true;
 static const bool DEFAULT_TXINDEX = false; // ĬϹر
+static const bool DEFAULT_BLOCKFILTERINDEX = false; // ĬϹر
+static const bool DEFAULT_ADDRESSINDEX = false; // ַĬϹر
+/** Default and maximum number of entries returned by one address index query */
+static const unsigned int DEFAULT_ADDRESS_QUERY_COUNT = 100;
+static const unsigned int MAX_ADDRESS_QUERY_COUNT = 1000;
+/** Maximum number of compact filters that may be requested with one getcfilters. See BIP 157. */
+static const int MAX_GETCFILTERS_SIZE = 1000;
+/** Maximum number of cf hashes that may be requested with one getcfheaders. See BIP 157. */
+static const int MAX_GETCFHEADERS_SIZE = 2000;
+/** Interval between compact filter checkpoints. See BIP 157. */
+static const int CFCHECKPT_INTERVAL = 1000;
 static const unsigned int DEFAULT_BANSCORE_THRESHOLD = 100;
 
 static const bool DEFAULT_TESTSAFEMODE = false;
@@ -119,6 +147,12 @@ static const bool DEFAULT_ENABLE_REPLACEMENT = true; // 
 
 /** Maximum number of headers to announce when relaying blocks with headers message.*/
 static const unsigned int MAX_BLOCKS_TO_ANNOUNCE = 8; // ʹͷϢмʱڹ㲥ͷĿ
+/** Maximum number of peers asked to announce new blocks to us with cmpctblock messages. */
+static const unsigned int MAX_CMPCTBLOCK_ANNOUNCING_PEERS = 3; // ֪ͨԶ
+/** Maximum depth of blocks we're willing to serve as compact blocks to peers when requested. */
+static const int MAX_CMPCTBLOCK_DEPTH = 5; // ʽṩ
+/** Maximum depth of blocks we're willing to respond to getblocktxn requests for. */
+static const int MAX_BLOCKTXN_DEPTH = 10; // Ӧ getblocktxn 
 
 struct BlockHasher // ϣĺ
 {
@@ -139,6 +173,8 @@ extern bool fImporting;
 extern bool fReindex; // ־ĬϹر
 extern int nScriptCheckThreads;
 extern bool fTxIndex;
+extern bool fBlockFilterIndex;
+extern bool fAddressIndex;
 extern bool fIsBareMultisigStd;
 extern bool fRequireStandard;
 extern unsigned int nBytesPerSigOp;
@@ -222,6 +258,14 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck(); // һű̵߳ʵ
+/** Build compact filters for active chain blocks connected before -blockfilterindex was enabled */
+void ThreadBlockFilterIndex(); // Ϊǰӵ齨չ
+/** Bring the address index up to the active chain when it falls behind, e.g. after -addressindex was enabled */
+void ThreadAddressIndex(); // ַͬ
+/** Index the transactions of active chain blocks connected while -txindex was off */
+void ThreadTxIndex(); // ں̨
+/** Whether the transaction index covers the whole active chain, so that lookups missing it are authoritative */
+bool IsTxIndexSynced();
 /** Try to detect Partition (network isolation) attacks against us */
 void PartitionCheck(bool (*initialDownloadCheck)(), CCriticalSection& cs, const CBlockIndex *const &bestHeader, int64_t nPowTargetSpacing);
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
@@ -236,6 +280,26 @@ bool IsInitialBlockDownload(); // 
 std::string GetWarnings(const std::string& strFor);
 /** Retrieve a transaction (from memory pool, or from disk, if possible) */
 bool GetTransaction(const uint256 &hash, CTransaction &tx, const Consensus::Params& params, uint256 &hashBlock, bool fAllowSlow = false);
+/** An output as looked up by GetUnspentOutputs */
+struct CUnspentOutput
+{
+    bool fUnspent;
+    int nVersion;
+    unsigned int nHeight; //!< MEMPOOL_HEIGHT for outputs of mempool transactions
+    bool fCoinBase;
+    CTxOut out;
+
+    CUnspentOutput() : fUnspent(false), nVersion(0), nHeight(0), fCoinBase(false) {}
+};
+/** Maximum number of outputs looked up by one REST getutxos or RPC gettxouts call */
+static const size_t MAX_GETUTXOS_OUTPOINTS = 10000; // βѯ
+/**
+ * Look up many outputs in the UTXO set, and optionally the mempool, at once.
+ * cs_main is only held while taking a consistent snapshot; the chainstate
+ * database is read after releasing it. hashBlock and nHeight are set to the
+ * tip the result belongs to.
+ */
+bool GetUnspentOutputs(const std::vector<COutPoint>& vOutPoints, bool fCheckMemPool, std::vector<CUnspentOutput>& vOutputs, uint256& hashBlock, int& nHeight);
 /** Find the best known block, and make it the tip of the block chain */ // ҵѵ֪飬ʹΪ
 bool ActivateBestChain(CValidationState& state, const CChainParams& chainparams, const CBlock* pblock = NULL);
 CAmount GetBlockSubsidy(int nHeight, const Consensus::Params& consensusParams);
@@ -266,6 +330,9 @@ void UnlinkPrunedFiles(std::set<int>& setFilesToPrune);
 CBlockIndex * InsertBlockIndex(uint256 hash); // ڿϣһµĿ
 /** Get statistics from node state */ // ӽڵ״̬ȡͳϢ
 bool GetNodeStateStats(NodeId nodeid, CNodeStateStats &stats);
+/** Number of blocks to keep in flight from a peer with the given round-trip time and
+ *  block delivery interval (both in microseconds, 0 if not measured yet). */
+int GetBlockDownloadWindow(int64_t nRoundTripTime, int64_t nBlockInterval);
 /** Increase a node's misbehavior score. */
 void Misbehaving(NodeId nodeid, int howmuch);
 /** Flush all state, indexes and buffers to disk. */
@@ -288,6 +355,9 @@ struct CNodeStateStats {
     int nSyncHeight;
     int nCommonHeight;
     std::vector<int> vHeightInFlight;
+    int nBlocksInFlightMax;
+    int64_t nBlockLatency;
+    int64_t nBlockBytesPerSec;
 };
 
 struct CDiskTxPos : public CDiskBlockPos
@@ -511,6 +581,8 @@ public:
     bool VerifyDB(const CChainParams& chainparams, CCoinsView *coinsview, int nCheckLevel, int nCheckDepth); // ֤ݿ
 };
 
+/** Find a block index by hash. Unlike mapBlockIndex, this may be used without holding cs_main. */
+CBlockIndex* LookupBlockIndex(const uint256& hash);
 /** Find the last common block between the parameter chain and a locator. */
 CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& locator);
 
@@ -526,9 +598,21 @@ extern CChain chainActive; // 
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache *pcoinsTip; // ָ򼤻 CCoinsView ȫֱ
 
+/** Global variable that points to the chainstate database below pcoinsTip */
+extern CCoinsViewDB *pcoinsdbview;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB *pblocktree;
 
+/** Writes block and undo files in the background, see FlushBlockFile() */
+extern CBlockFileWriter blockFileWriter;
+
+/** Global variable that points to the compact block filter index, or NULL if -blockfilterindex is off */
+extern CBlockFilterDB *pblockfilterdb;
+
+/** Global variable that points to the address index, or NULL if -addressindex is off */
+extern CAddressIndexDB *paddressindexdb;
+
 /**
  * Return the spend height, which is one more than the inputs.GetBestBlock().
  * While checking, GetBestBlock() refers to the parent block. (protected by cs_main)
@@ -139,6 +139,13 @@ public:
      */
     CMerkleBlock(const CBlock& block, CBloomFilter& filter);
 
+    /**
+     * Same as above, using filter keys extracted beforehand from every
+     * transaction of the block (vTxKeys[i] for block.vtx[i]), so that one
+     * extraction can serve many filters.
+     */
+    CMerkleBlock(const CBlock& block, const std::vector<CBloomTxKeys>& vTxKeys, CBloomFilter& filter);
+
     // Create from a CBlock, matching the txids in the set
     CMerkleBlock(const CBlock& block, const std::set<uint256>& txids);
 
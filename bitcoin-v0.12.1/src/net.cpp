@@ -34,6 +34,7 @@
 #endif
 
 #include <boost/filesystem.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread.hpp>
 
 #include <math.h>
@@ -89,9 +90,7 @@ std::string strSubVersion;
 
 vector<CNode*> vNodes; // ɹӵĽڵб
 CCriticalSection cs_vNodes;
-map<CInv, CDataStream> mapRelay; // мӳб
-deque<pair<int64_t, CInv> > vRelayExpiration; // м̵ڶ <ʱ䣬ϢĿм̣>
-CCriticalSection cs_mapRelay; // мӳб
+CRelayCache relayCache; // м̻棨ƬϣʱͰڣ
 limitedmap<CInv, int64_t> mapAlreadyAskedFor(MAX_INV_SZ);
 
 static deque<string> vOneShots; // ַ˫˶
@@ -2060,19 +2059,13 @@ void RelayTransaction(const CTransaction& tx)
 void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
 {
     CInv inv(MSG_TX, tx.GetHash()); // ݽ׹ϣ inv 
-    {
-        LOCK(cs_mapRelay); // мӳб
-        // Expire old relay messages // ʹɵмݹ
-        while (!vRelayExpiration.empty() && vRelayExpiration.front().first < GetTime())
-        { // м̵ڶзǿ  м̹ڶжͷԪعʱСڵǰʱ䣨ʾѹڣ
-            mapRelay.erase(vRelayExpiration.front().second); // мӳбвм̹ڶеĶͷ
-            vRelayExpiration.pop_front(); // м̹ڶг
-        }
-
-        // Save original serialized message so newer versions are preserved // ԭʼлϢԱ㱣°汾
-        mapRelay.insert(std::make_pair(inv, ss)); // Ѹýײмӳб
-        vRelayExpiration.push_back(std::make_pair(GetTime() + 15 * 60, inv)); //  15min Ĺʱ䣬ڶ
-    }
+    // Save original serialized message so newer versions are preserved; // ԭʼлϢԱ㱣°汾
+    // old entries are expired by the cache itself. // ɵмɻ
+    relayCache.Insert(inv, CRelayCache::DataPtr(new CDataStream(ss))); // Ѹý׵Ĺм̻
+    // The first filtering peer is probed directly, which stops at the first match; // һʹùĶԶֱӼ飬״ƥʱֹͣ
+    // only when there are more are the filter keys extracted and shared // ֻжԶʱȡ
+    bool fFirstFilter = true;
+    boost::scoped_ptr<const CBloomTxKeys> pkeys;
     LOCK(cs_vNodes); // ѽӵĽڵб
     BOOST_FOREACH(CNode* pnode, vNodes) // ǰѽӵĽڵб
     {
@@ -2081,7 +2074,16 @@ void RelayTransaction(const CTransaction& tx, const CDataStream& ss)
         LOCK(pnode->cs_filter);
         if (pnode->pfilter) // ³ķ
         {
-            if (pnode->pfilter->IsRelevantAndUpdate(tx))
+            bool fRelevant;
+            if (fFirstFilter) {
+                fFirstFilter = false;
+                fRelevant = pnode->pfilter->IsRelevantAndUpdate(tx);
+            } else {
+                if (!pkeys)
+                    pkeys.reset(new CBloomTxKeys(tx));
+                fRelevant = pnode->pfilter->IsRelevantAndUpdate(*pkeys);
+            }
+            if (fRelevant)
                 pnode->PushInventory(inv);
         } else // ûʹ bloom filter
             pnode->PushInventory(inv); // ֱ inv Ϣýڵ
@@ -2381,6 +2383,9 @@ CNode::CNode(SOCKET hSocketIn, const CAddress& addrIn, const std::string& addrNa
     nPingUsecTime = 0;
     fPingQueued = false;
     nMinPingUsecTime = std::numeric_limits<int64_t>::max();
+    minFeeFilter = 0;
+    lastSentFeeFilter = 0;
+    nextSendTimeFeeFilter = 0;
 
     {
         LOCK(cs_nLastNodeId);
@@ -6,12 +6,14 @@
 #ifndef BITCOIN_NET_H
 #define BITCOIN_NET_H
 
+#include "amount.h"
 #include "bloom.h"
 #include "compat.h"
 #include "limitedmap.h"
 #include "netbase.h"
 #include "protocol.h"
 #include "random.h"
+#include "relaycache.h"
 #include "streams.h"
 #include "sync.h"
 #include "uint256.h"
@@ -161,9 +163,7 @@ extern int nMaxConnections; // ͬʱ
 
 extern std::vector<CNode*> vNodes; // ѽӵĽڵб
 extern CCriticalSection cs_vNodes; // ڵб
-extern std::map<CInv, CDataStream> mapRelay; // мӳб
-extern std::deque<std::pair<int64_t, CInv> > vRelayExpiration; // м̹ڶ
-extern CCriticalSection cs_mapRelay; // мӳб
+extern CRelayCache relayCache; // м̻
 extern limitedmap<CInv, int64_t> mapAlreadyAskedFor;
 
 extern std::vector<std::string> vAddedNodes; // ӵĽڵб
@@ -410,6 +410,12 @@ public:
     int64_t nMinPingUsecTime;
     // Whether a ping is requested.
     bool fPingQueued; // Ƿһ ping
+    // Minimum fee rate with which to filter inv's to this node // ýڵͨ潻׵ͷ
+    CAmount minFeeFilter;
+    CCriticalSection cs_feeFilter;
+    // The fee filter we last sent this node, and when we may send the next one // ͸ýڵķʹ´η͵ʱ
+    CAmount lastSentFeeFilter;
+    int64_t nextSendTimeFeeFilter;
 
     CNode(SOCKET hSocketIn, const CAddress &addrIn, const std::string &addrNameIn = "", bool fInboundIn = false);
     ~CNode();
@@ -35,6 +35,17 @@ const char *FILTERADD="filteradd";
 const char *FILTERCLEAR="filterclear";
 const char *REJECT="reject";
 const char *SENDHEADERS="sendheaders";
+const char *FEEFILTER="feefilter";
+const char *SENDCMPCT="sendcmpct";
+const char *CMPCTBLOCK="cmpctblock";
+const char *GETBLOCKTXN="getblocktxn";
+const char *BLOCKTXN="blocktxn";
+const char *GETCFILTERS="getcfilters";
+const char *CFILTER="cfilter";
+const char *GETCFHEADERS="getcfheaders";
+const char *CFHEADERS="cfheaders";
+const char *GETCFCHECKPT="getcfcheckpt";
+const char *CFCHECKPT="cfcheckpt";
 };
 
 static const char* ppszTypeName[] =
@@ -42,7 +53,8 @@ static const char* ppszTypeName[] =
     "ERROR", // Should never occur
     NetMsgType::TX,
     NetMsgType::BLOCK,
-    "filtered block" // Should never occur
+    "filtered block", // Should never occur
+    NetMsgType::CMPCTBLOCK
 };
 
 /** All known message types. Keep this in the same order as the list of
@@ -70,7 +82,18 @@ const static std::string allNetMessageTypes[] = {
     NetMsgType::FILTERADD, //  bloom filter
     NetMsgType::FILTERCLEAR, //  bloom filter
     NetMsgType::REJECT, // ֪ԷڵһϢܾ
-    NetMsgType::SENDHEADERS // ָʾڵ headers Ϣ inv Ϣ¿֪ͨ BIP130Bitcoin Core 0.12.0protocol version 70012
+    NetMsgType::SENDHEADERS, // ָʾڵ headers Ϣ inv Ϣ¿֪ͨ BIP130Bitcoin Core 0.12.0protocol version 70012
+    NetMsgType::FEEFILTER, // ֪ԷҪͨʵֵָĽס BIP133protocol version 70013
+    NetMsgType::SENDCMPCT, // ָʾڵԸͨ cmpctblock Ϣṩ顣 BIP152protocol version 70014
+    NetMsgType::CMPCTBLOCK, // 飺ͷ̽ id бԤĽ
+    NetMsgType::GETBLOCKTXN, // ȱʧĽ
+    NetMsgType::BLOCKTXN, // ظ getblocktxn ϢȱʧĽ
+    NetMsgType::GETCFILTERS, // һ鷶ΧĽչ BIP157
+    NetMsgType::CFILTER, // ظ getcfilters ϢÿϢһ
+    NetMsgType::GETCFHEADERS, // һ鷶ΧĹͷ͹ϣ
+    NetMsgType::CFHEADERS, // ظ getcfheaders Ϣ
+    NetMsgType::GETCFCHECKPT, // ȼĹͷ
+    NetMsgType::CFCHECKPT // ظ getcfcheckpt Ϣ
 };
 const static std::vector<std::string> allNetMessageTypesVec(allNetMessageTypes, allNetMessageTypes+ARRAYLEN(allNetMessageTypes));
 
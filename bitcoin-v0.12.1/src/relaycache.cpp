@@ -0,0 +1,96 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "relaycache.h"
+
+#include "utiltime.h"
+
+#include <assert.h>
+
+#include <algorithm>
+
+CRelayCache::CRelayCache(int64_t nLifetimeIn, int64_t nBucketIntervalIn) :
+    nBucketInterval(nBucketIntervalIn),
+    nBuckets(nLifetimeIn / nBucketIntervalIn + 1),
+    nHeadBucket(0)
+{
+    assert(nBucketInterval > 0 && nLifetimeIn >= nBucketInterval);
+    vBucketEntries.resize(nBuckets);
+}
+
+void CRelayCache::AdvanceTo(int64_t nBucket)
+{
+    AssertLockHeld(cs_buckets);
+    // Each slot visited here holds the bucket that is exactly nBuckets older
+    // than the one about to reuse it. Jumps larger than the ring clear it once.
+    int64_t nLast = std::min(nBucket, nHeadBucket + nBuckets);
+    for (int64_t b = nHeadBucket + 1; b <= nLast; b++) {
+        std::vector<uint256>& vSlot = vBucketEntries[b % nBuckets];
+        const int64_t nExpired = b - nBuckets;
+        for (std::vector<uint256>::const_iterator it = vSlot.begin(); it != vSlot.end(); ++it) {
+            CShard& shard = GetShard(*it);
+            LOCK(shard.cs);
+            EntryMap::iterator mi = shard.map.find(*it);
+            if (mi != shard.map.end() && mi->second.nBucket <= nExpired)
+                shard.map.erase(mi);
+        }
+        vSlot.clear();
+    }
+    if (nBucket > nHeadBucket)
+        nHeadBucket = nBucket;
+}
+
+bool CRelayCache::Insert(const CInv& inv, const DataPtr& pdata)
+{
+    LOCK(cs_buckets);
+    AdvanceTo(GetTime() / nBucketInterval);
+
+    {
+        CShard& shard = GetShard(inv.hash);
+        LOCK(shard.cs);
+        CEntry entry;
+        entry.type = inv.type;
+        entry.nBucket = nHeadBucket;
+        entry.pdata = pdata;
+        if (!shard.map.insert(std::make_pair(inv.hash, entry)).second)
+            return false;
+    }
+    vBucketEntries[nHeadBucket % nBuckets].push_back(inv.hash);
+    return true;
+}
+
+CRelayCache::DataPtr CRelayCache::Find(const CInv& inv) const
+{
+    const CShard& shard = GetShard(inv.hash);
+    LOCK(shard.cs);
+    EntryMap::const_iterator mi = shard.map.find(inv.hash);
+    if (mi == shard.map.end() || mi->second.type != inv.type)
+        return DataPtr();
+    // Expiry only runs on insertion; don't hand out entries that are past
+    // their lifetime just because nothing was relayed since.
+    if (mi->second.nBucket + nBuckets <= GetTime() / nBucketInterval)
+        return DataPtr();
+    return mi->second.pdata;
+}
+
+size_t CRelayCache::size() const
+{
+    size_t nSize = 0;
+    for (unsigned int i = 0; i < RELAY_CACHE_SHARDS; i++) {
+        LOCK(vShards[i].cs);
+        nSize += vShards[i].map.size();
+    }
+    return nSize;
+}
+
+void CRelayCache::Clear()
+{
+    LOCK(cs_buckets);
+    for (unsigned int i = 0; i < RELAY_CACHE_SHARDS; i++) {
+        LOCK(vShards[i].cs);
+        vShards[i].map.clear();
+    }
+    for (size_t i = 0; i < vBucketEntries.size(); i++)
+        vBucketEntries[i].clear();
+}
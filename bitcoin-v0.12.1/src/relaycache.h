@@ -0,0 +1,101 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_RELAYCACHE_H
+#define BITCOIN_RELAYCACHE_H
+
+#include "protocol.h"
+#include "streams.h"
+#include "sync.h"
+#include "uint256.h"
+
+#include <stdint.h>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/unordered_map.hpp>
+
+/** How long (in seconds) relayed inventory stays available for getdata. */
+static const int64_t RELAY_CACHE_LIFETIME = 15 * 60;
+/** Granularity (in seconds) of the expiry buckets. */
+static const int64_t RELAY_CACHE_BUCKET_INTERVAL = 60;
+/** Number of independently locked shards. */
+static const unsigned int RELAY_CACHE_SHARDS = 16;
+
+/**
+ * Cache of recently relayed inventory, kept in serialized form so that
+ * getdata requests can be answered without re-serializing and without
+ * holding cs_main.
+ *
+ * Entries are spread over RELAY_CACHE_SHARDS hash maps, each with its own
+ * lock, so concurrent lookups rarely contend. Expiry uses a ring of coarse
+ * time buckets: every new entry is appended to the bucket covering its
+ * insertion time, and when a bucket leaves the retention window all of its
+ * entries are dropped at once. Expiring an entry is therefore O(1) and never
+ * requires walking the maps.
+ *
+ * Lock order is cs_buckets before any shard lock; lookups only take the
+ * lock of a single shard.
+ */
+class CRelayCache
+{
+public:
+    typedef boost::shared_ptr<const CDataStream> DataPtr;
+
+    CRelayCache(int64_t nLifetimeIn = RELAY_CACHE_LIFETIME, int64_t nBucketIntervalIn = RELAY_CACHE_BUCKET_INTERVAL);
+
+    /**
+     * Add serialized data for inv, expiring old entries first. Like the map
+     * this replaces, an existing entry for the same inv is left untouched.
+     * Returns false if the entry was already present.
+     */
+    bool Insert(const CInv& inv, const DataPtr& pdata);
+
+    /** Look up inv, returning an empty pointer if it is unknown or expired. */
+    DataPtr Find(const CInv& inv) const;
+
+    size_t size() const;
+    void Clear();
+
+private:
+    struct CacheHasher
+    {
+        size_t operator()(const uint256& hash) const { return hash.GetCheapHash(); }
+    };
+
+    struct CEntry
+    {
+        int type;
+        int64_t nBucket;
+        DataPtr pdata;
+    };
+
+    typedef boost::unordered_map<uint256, CEntry, CacheHasher> EntryMap;
+
+    struct CShard
+    {
+        mutable CCriticalSection cs;
+        EntryMap map;
+    };
+
+    const int64_t nBucketInterval;
+    //! Number of buckets in the ring; an entry lives for at least nLifetime seconds.
+    const int64_t nBuckets;
+
+    CShard vShards[RELAY_CACHE_SHARDS];
+
+    mutable CCriticalSection cs_buckets;
+    //! Hashes added in each bucket, indexed by bucket number modulo nBuckets.
+    std::vector<std::vector<uint256> > vBucketEntries;
+    //! Absolute number of the newest bucket seen so far.
+    int64_t nHeadBucket;
+
+    CShard& GetShard(const uint256& hash) { return vShards[(hash.GetCheapHash() >> 32) % RELAY_CACHE_SHARDS]; }
+    const CShard& GetShard(const uint256& hash) const { return vShards[(hash.GetCheapHash() >> 32) % RELAY_CACHE_SHARDS]; }
+
+    /** Drop every bucket that falls out of the window ending at nBucket. */
+    void AdvanceTo(int64_t nBucket);
+};
+
+#endif // BITCOIN_RELAYCACHE_H
@@ -5,26 +5,28 @@
 
 #include "chain.h"
 #include "chainparams.h"
+#include "chainsnapshot.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "main.h"
 #include "httpserver.h"
+#include "jsonstream.h"
 #include "rpcserver.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "utilstrencodings.h"
 #include "version.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/dynamic_bitset.hpp>
 
 #include <univalue.h>
 
 using namespace std;
 
-static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
-
 enum RetFormat {
     RF_UNDEF,
     RF_BINARY,
@@ -60,10 +62,15 @@ struct CCoin {
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
 extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, CJSONStreamWriter& writer);
 extern UniValue mempoolInfoToJSON();
 extern UniValue mempoolToJSON(bool fVerbose = false);
+extern void mempoolToJSON(CJSONStreamWriter& writer);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
-extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
+extern UniValue blockheaderToJSON(const CBlockIndex* blockindex, const CChainSnapshot& chain);
+extern bool ParseAddressIndexScript(const std::string& strAddress, uint160& hashScript);
+extern bool addressHistoryToJSON(const uint160& hashScript, size_t nSkip, size_t nCount, UniValue& result);
+extern bool addressUnspentToJSON(const uint160& hashScript, size_t nSkip, size_t nCount, UniValue& result);
 
 static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, string message)
 {
@@ -72,6 +79,33 @@ static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, string message
     return false;
 }
 
+/**
+ * Reply with a JSON object that is streamed as it is produced. If producing
+ * it fails before anything was sent, reply with a plain error; afterwards the
+ * HTTP status can no longer change, so the partial output is closed and the
+ * outermost object gets an "error" member instead of the reply being cut off.
+ */
+static bool RESTStreamJSON(HTTPRequest* req, const boost::function<void(CJSONStreamWriter&)>& fn)
+{
+    CJSONStreamWriter writer(boost::bind(&WriteJSONReplyChunk, req, _1));
+    try {
+        fn(writer);
+    } catch (const std::exception& e) {
+        if (!writer.HasFlushed())
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, e.what());
+        LogPrintf("%s: %s failed after part of the reply was sent: %s\n", __func__, SanitizeString(req->GetURI()), e.what());
+        if (writer.Depth() > 0) {
+            writer.CloseTo(1);
+            writer.KeyValue("error", e.what());
+            writer.EndObject();
+        }
+    }
+    writer.WriteRaw("\n");
+    writer.Flush();
+    req->EndReply();
+    return true;
+}
+
 static enum RetFormat ParseDataFormat(std::string& param, const std::string& strReq)
 {
     const std::string::size_type pos = strReq.rfind('.');
@@ -150,16 +184,13 @@ static bool rest_headers(HTTPRequest* req,
 
     std::vector<const CBlockIndex *> headers;
     headers.reserve(count);
-    {
-        LOCK(cs_main);
-        BlockMap::const_iterator it = mapBlockIndex.find(hash);
-        const CBlockIndex *pindex = (it != mapBlockIndex.end()) ? it->second : NULL;
-        while (pindex != NULL && chainActive.Contains(pindex)) {
-            headers.push_back(pindex);
-            if (headers.size() == (unsigned long)count)
-                break;
-            pindex = chainActive.Next(pindex);
-        }
+    boost::shared_ptr<const CChainSnapshot> chain = GetChainSnapshot();
+    const CBlockIndex *pindex = LookupBlockIndex(hash);
+    while (pindex != NULL && chain->Contains(pindex)) {
+        headers.push_back(pindex);
+        if (headers.size() == (unsigned long)count)
+            break;
+        pindex = chain->Next(pindex);
     }
 
     CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
@@ -184,7 +215,7 @@ static bool rest_headers(HTTPRequest* req,
     case RF_JSON: {
         UniValue jsonHeaders(UniValue::VARR);
         BOOST_FOREACH(const CBlockIndex *pindex, headers) {
-            jsonHeaders.push_back(blockheaderToJSON(pindex));
+            jsonHeaders.push_back(blockheaderToJSON(pindex, *chain));
         }
         string strJSON = jsonHeaders.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
@@ -247,6 +278,10 @@ static bool rest_block(HTTPRequest* req,
     }
 
     case RF_JSON: {
+        if (showTxDetails) {
+            // Send the transactions as they are serialized // лױ߷
+            return RESTStreamJSON(req, boost::bind((void (*)(const CBlock&, const CBlockIndex*, CJSONStreamWriter&))&blockToJSON, boost::cref(block), pblockindex, _1));
+        }
         UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
         string strJSON = objBlock.write() + "\n";
         req->WriteHeader("Content-Type", "application/json");
@@ -273,6 +308,150 @@ static bool rest_block_notxdetails(HTTPRequest* req, const std::string& strURIPa
     return rest_block(req, strURIPart, false);
 }
 
+static bool rest_block_filter(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    vector<string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/blockfilter/<filtertype>/<blockhash>.<ext>.");
+    if (path[0] != "basic")
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filtertype " + path[0]);
+    if (!fBlockFilterIndex)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block filters are not available (start with -blockfilterindex)");
+
+    uint256 hash;
+    if (!ParseHashStr(path[1], hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[1]);
+
+    std::vector<unsigned char> vEncodedFilter;
+    uint256 hashFilter, hashHeader;
+    if (!pblockfilterdb->ReadFilter(hash, vEncodedFilter) || !pblockfilterdb->ReadFilterHeader(hash, hashFilter, hashHeader))
+        return RESTERR(req, HTTP_NOT_FOUND, path[1] + " not found");
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryFilter(vEncodedFilter.begin(), vEncodedFilter.end());
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryFilter);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(vEncodedFilter.begin(), vEncodedFilter.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue objFilter(UniValue::VOBJ);
+        objFilter.push_back(Pair("filter", HexStr(vEncodedFilter.begin(), vEncodedFilter.end())));
+        objFilter.push_back(Pair("header", hashHeader.GetHex()));
+        string strJSON = objFilter.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_block_filter_headers(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    vector<string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    if (path.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/blockfilterheaders/<filtertype>/<count>/<blockhash>.<ext>.");
+    if (path[0] != "basic")
+        return RESTERR(req, HTTP_BAD_REQUEST, "Unknown filtertype " + path[0]);
+    if (!fBlockFilterIndex)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block filters are not available (start with -blockfilterindex)");
+
+    long count = strtol(path[1].c_str(), NULL, 10);
+    if (count < 1 || count > MAX_GETCFHEADERS_SIZE)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Header count out of range: " + path[1]);
+
+    uint256 hash;
+    if (!ParseHashStr(path[2], hash))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + path[2]);
+
+    std::vector<uint256> vBlockHashes;
+    vBlockHashes.reserve(count);
+    boost::shared_ptr<const CChainSnapshot> chain = GetChainSnapshot();
+    const CBlockIndex *pindex = LookupBlockIndex(hash);
+    while (pindex != NULL && chain->Contains(pindex)) {
+        vBlockHashes.push_back(pindex->GetBlockHash());
+        if (vBlockHashes.size() == (unsigned long)count)
+            break;
+        pindex = chain->Next(pindex);
+    }
+
+    // Stop at the first block the index has not reached yet
+    std::vector<uint256> vHeaders;
+    vHeaders.reserve(vBlockHashes.size());
+    BOOST_FOREACH(const uint256& hashBlock, vBlockHashes) {
+        uint256 hashFilter, hashHeader;
+        if (!pblockfilterdb->ReadFilterHeader(hashBlock, hashFilter, hashHeader))
+            break;
+        vHeaders.push_back(hashHeader);
+    }
+
+    CDataStream ssHeader(SER_NETWORK, PROTOCOL_VERSION);
+    BOOST_FOREACH(const uint256& hashHeader, vHeaders) {
+        ssHeader << hashHeader;
+    }
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryHeader = ssHeader.str();
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryHeader);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex = HexStr(ssHeader.begin(), ssHeader.end()) + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        UniValue jsonHeaders(UniValue::VARR);
+        BOOST_FOREACH(const uint256& hashHeader, vHeaders) {
+            jsonHeaders.push_back(hashHeader.GetHex());
+        }
+        string strJSON = jsonHeaders.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static bool rest_chaininfo(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -332,12 +511,7 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return RESTStreamJSON(req, boost::bind((void (*)(CJSONStreamWriter&))&mempoolToJSON, _1));
     }
     default: {
         return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
@@ -481,6 +655,37 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     }
 
     case RF_JSON: {
+        //deserialize only if user sent a request: {"checkmempool": bool, "outpoints": [{"txid": "hex", "vout": n}, ...]}
+        if (strRequestMutable.size() > 0)
+        {
+            if (fInputParsed) //don't allow sending input over URI and HTTP RAW DATA
+                return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Combination of URI scheme inputs and raw post data is not allowed");
+
+            UniValue valRequest;
+            if (!valRequest.read(strRequestMutable) || !valRequest.isObject() || !valRequest["outpoints"].isArray())
+                return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Parse error");
+            if (valRequest.exists("checkmempool")) {
+                if (!valRequest["checkmempool"].isBool())
+                    return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Parse error");
+                fCheckMemPool = valRequest["checkmempool"].get_bool();
+            }
+
+            const UniValue& outpoints = valRequest["outpoints"];
+            if (outpoints.size() > MAX_GETUTXOS_OUTPOINTS)
+                return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, strprintf("Error: max outpoints exceeded (max: %d, tried: %d)", MAX_GETUTXOS_OUTPOINTS, outpoints.size()));
+            vOutPoints.reserve(outpoints.size());
+            for (unsigned int i = 0; i < outpoints.size(); i++) {
+                const UniValue& txid = outpoints[i]["txid"];
+                const UniValue& vout = outpoints[i]["vout"];
+                if (!txid.isStr() || !IsHex(txid.get_str()) || !vout.isNum())
+                    return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Parse error");
+                int32_t nOutput;
+                if (!ParseInt32(vout.getValStr(), &nOutput) || nOutput < 0)
+                    return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Parse error");
+                vOutPoints.push_back(COutPoint(uint256S(txid.get_str()), (uint32_t)nOutput));
+            }
+            fInputParsed = true;
+        }
         if (!fInputParsed)
             return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Error: empty request");
         break;
@@ -494,43 +699,30 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     if (vOutPoints.size() > MAX_GETUTXOS_OUTPOINTS)
         return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, strprintf("Error: max outpoints exceeded (max: %d, tried: %d)", MAX_GETUTXOS_OUTPOINTS, vOutPoints.size()));
 
+    // look up all outpoints at once; cs_main is only held to take a snapshot
+    vector<CUnspentOutput> vOutputs;
+    uint256 hashTip;
+    int nTipHeight;
+    if (!GetUnspentOutputs(vOutPoints, fCheckMemPool, vOutputs, hashTip, nTipHeight))
+        return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Error: unable to read the UTXO set");
+
     // check spentness and form a bitmap (as well as a JSON capable human-readable string representation)
     vector<unsigned char> bitmap;
     vector<CCoin> outs;
     std::string bitmapStringRepresentation;
     boost::dynamic_bitset<unsigned char> hits(vOutPoints.size());
-    {
-        LOCK2(cs_main, mempool.cs);
-
-        CCoinsView viewDummy;
-        CCoinsViewCache view(&viewDummy);
-
-        CCoinsViewCache& viewChain = *pcoinsTip;
-        CCoinsViewMemPool viewMempool(&viewChain, mempool);
-
-        if (fCheckMemPool)
-            view.SetBackend(viewMempool); // switch cache backend to db+mempool in case user likes to query mempool
-
-        for (size_t i = 0; i < vOutPoints.size(); i++) {
-            CCoins coins;
-            uint256 hash = vOutPoints[i].hash;
-            if (view.GetCoins(hash, coins)) {
-                mempool.pruneSpent(hash, coins);
-                if (coins.IsAvailable(vOutPoints[i].n)) {
-                    hits[i] = true;
-                    // Safe to index into vout here because IsAvailable checked if it's off the end of the array, or if
-                    // n is valid but points to an already spent output (IsNull).
-                    CCoin coin;
-                    coin.nTxVer = coins.nVersion;
-                    coin.nHeight = coins.nHeight;
-                    coin.out = coins.vout.at(vOutPoints[i].n);
-                    assert(!coin.out.IsNull());
-                    outs.push_back(coin);
-                }
-            }
-
-            bitmapStringRepresentation.append(hits[i] ? "1" : "0"); // form a binary string representation (human-readable for json output)
+    for (size_t i = 0; i < vOutPoints.size(); i++) {
+        if (vOutputs[i].fUnspent) {
+            hits[i] = true;
+            CCoin coin;
+            coin.nTxVer = vOutputs[i].nVersion;
+            coin.nHeight = vOutputs[i].nHeight;
+            coin.out = vOutputs[i].out;
+            assert(!coin.out.IsNull());
+            outs.push_back(coin);
         }
+
+        bitmapStringRepresentation.append(hits[i] ? "1" : "0"); // form a binary string representation (human-readable for json output)
     }
     boost::to_block_range(hits, std::back_inserter(bitmap));
 
@@ -539,7 +731,7 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
         // serialize data
         // use exact same output as mentioned in Bip64
         CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
-        ssGetUTXOResponse << chainActive.Height() << chainActive.Tip()->GetBlockHash() << bitmap << outs;
+        ssGetUTXOResponse << nTipHeight << hashTip << bitmap << outs;
         string ssGetUTXOResponseString = ssGetUTXOResponse.str();
 
         req->WriteHeader("Content-Type", "application/octet-stream");
@@ -549,7 +741,7 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 
     case RF_HEX: {
         CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
-        ssGetUTXOResponse << chainActive.Height() << chainActive.Tip()->GetBlockHash() << bitmap << outs;
+        ssGetUTXOResponse << nTipHeight << hashTip << bitmap << outs;
         string strHex = HexStr(ssGetUTXOResponse.begin(), ssGetUTXOResponse.end()) + "\n";
 
         req->WriteHeader("Content-Type", "text/plain");
@@ -562,8 +754,8 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 
         // pack in some essentials
         // use more or less the same output as mentioned in Bip64
-        objGetUTXOResponse.push_back(Pair("chainHeight", chainActive.Height()));
-        objGetUTXOResponse.push_back(Pair("chaintipHash", chainActive.Tip()->GetBlockHash().GetHex()));
+        objGetUTXOResponse.push_back(Pair("chainHeight", nTipHeight));
+        objGetUTXOResponse.push_back(Pair("chaintipHash", hashTip.GetHex()));
         objGetUTXOResponse.push_back(Pair("bitmap", bitmapStringRepresentation));
 
         UniValue utxos(UniValue::VARR);
@@ -596,6 +788,64 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+static bool rest_address(HTTPRequest* req,
+                         const std::string& strURIPart,
+                         bool fUnspent)
+{
+    if (!CheckWarmup(req))
+        return false;
+    std::string param;
+    const RetFormat rf = ParseDataFormat(param, strURIPart);
+    vector<string> path;
+    boost::split(path, param, boost::is_any_of("/"));
+
+    const std::string strName = fUnspent ? "addressutxos" : "addresshistory";
+    if (path.size() != 3)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid URI format. Expected /rest/" + strName + "/<skip>/<count>/<address>.<ext>.");
+
+    if (!fAddressIndex)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Address index not available (start with -addressindex)");
+
+    // Same bounds as getaddresshistory and getaddressutxos //  RPC ͬȡֵΧ
+    int32_t skip, count;
+    if (!ParseInt32(path[0], &skip) || skip < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid skip: " + path[0]);
+    if (!ParseInt32(path[1], &count) || count < 0 || count > (int32_t)MAX_ADDRESS_QUERY_COUNT)
+        return RESTERR(req, HTTP_BAD_REQUEST, strprintf("Invalid count, must be between 0 and %u: ", MAX_ADDRESS_QUERY_COUNT) + path[1]);
+
+    uint160 hashScript;
+    if (!ParseAddressIndexScript(path[2], hashScript))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid address or script: " + path[2]);
+
+    switch (rf) {
+    case RF_JSON: {
+        UniValue result;
+        if (!(fUnspent ? addressUnspentToJSON(hashScript, skip, count, result) : addressHistoryToJSON(hashScript, skip, count, result)))
+            return RESTERR(req, HTTP_INTERNAL_SERVER_ERROR, "Unable to read the address index");
+        string strJSON = result.write() + "\n";
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, strJSON);
+        return true;
+    }
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
+static bool rest_address_history(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address(req, strURIPart, false);
+}
+
+static bool rest_address_utxos(HTTPRequest* req, const std::string& strURIPart)
+{
+    return rest_address(req, strURIPart, true);
+}
+
 static const struct {
     const char* prefix; // ǰ׺ַ
     bool (*handler)(HTTPRequest* req, const std::string& strReq); // HTTP ص
@@ -607,7 +857,11 @@ static const struct {
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
+      {"/rest/blockfilter/", rest_block_filter},
+      {"/rest/blockfilterheaders/", rest_block_filter_headers},
       {"/rest/getutxos", rest_getutxos},
+      {"/rest/addresshistory/", rest_address_history},
+      {"/rest/addressutxos/", rest_address_utxos},
 };
 
 bool StartREST()
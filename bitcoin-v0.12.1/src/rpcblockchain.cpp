@@ -4,25 +4,33 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "amount.h"
+#include "base58.h"
 #include "chain.h"
 #include "chainparams.h"
+#include "chainsnapshot.h"
 #include "checkpoints.h"
 #include "coins.h"
 #include "consensus/validation.h"
+#include "jsonstream.h"
 #include "main.h"
 #include "policy/policy.h"
 #include "primitives/transaction.h"
 #include "rpcserver.h"
+#include "script/standard.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "util.h"
 #include "utilstrencodings.h"
+#include "versionbits.h"
 
 #include <stdint.h>
 
 #include <univalue.h>
 
+#include <boost/assign/list_of.hpp>
+
 using namespace std;
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
@@ -34,10 +42,9 @@ double GetDifficulty(const CBlockIndex* blockindex)
     // minimum difficulty = 1.0. // СѶ = 1.0
     if (blockindex == NULL)
     {
-        if (chainActive.Tip() == NULL) // Ϊ
+        blockindex = GetChainSnapshot()->Tip(); // ȡ
+        if (blockindex == NULL) // Ϊ
             return 1.0; // СѶ
-        else
-            blockindex = chainActive.Tip(); // ȡ
     }
 
     int nShift = (blockindex->nBits >> 24) & 0xff; // ȡ nBits ĸ 8 λ 2 
@@ -59,14 +66,14 @@ double GetDifficulty(const CBlockIndex* blockindex)
     return dDiff; // Ѷ
 }
 
-UniValue blockheaderToJSON(const CBlockIndex* blockindex)
+UniValue blockheaderToJSON(const CBlockIndex* blockindex, const CChainSnapshot& chain)
 {
     UniValue result(UniValue::VOBJ);
     result.push_back(Pair("hash", blockindex->GetBlockHash().GetHex())); // ϣ
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
-    if (chainActive.Contains(blockindex))
-        confirmations = chainActive.Height() - blockindex->nHeight + 1; // ȷ
+    if (chain.Contains(blockindex))
+        confirmations = chain.Height() - blockindex->nHeight + 1; // ȷ
     result.push_back(Pair("confirmations", confirmations)); // ȷ
     result.push_back(Pair("height", blockindex->nHeight)); // ߶
     result.push_back(Pair("version", blockindex->nVersion)); // 汾
@@ -80,7 +87,7 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
 
     if (blockindex->pprev) // һĹϣ
         result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
-    CBlockIndex *pnext = chainActive.Next(blockindex);
+    CBlockIndex *pnext = chain.Next(blockindex);
     if (pnext) // һĹϣ
         result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
     return result;
@@ -127,6 +134,32 @@ UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool tx
     return result; // ؽ
 }
 
+/** Stream the same JSON as blockToJSON(block, blockindex, true), one transaction at a time */
+void blockToJSON(const CBlock& block, const CBlockIndex* blockindex, CJSONStreamWriter& writer)
+{
+    // Only the transaction details are large; take the rest from blockToJSON // ֻнϸڽϴֶȡ blockToJSON
+    UniValue result = blockToJSON(block, blockindex, false);
+    const std::vector<std::string>& keys = result.getKeys();
+    const std::vector<UniValue>& values = result.getValues();
+    writer.BeginObject();
+    for (size_t i = 0; i < keys.size(); i++) {
+        if (keys[i] != "tx") {
+            writer.KeyValue(keys[i], values[i]);
+            continue;
+        }
+        writer.Key("tx");
+        writer.BeginArray();
+        BOOST_FOREACH(const CTransaction& tx, block.vtx)
+        {
+            UniValue objTx(UniValue::VOBJ);
+            TxToJSON(tx, uint256(), objTx);
+            writer.Value(objTx);
+        }
+        writer.EndArray();
+    }
+    writer.EndObject();
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0) // ûв
@@ -140,8 +173,7 @@ UniValue getblockcount(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockcount", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Height(); // ؼ߶
+    return GetChainSnapshot()->Height(); // ؼ߶
 }
 
 UniValue getbestblockhash(const UniValue& params, bool fHelp)
@@ -157,8 +189,7 @@ UniValue getbestblockhash(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getbestblockhash", "")
         );
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex(); // 2.ؼϣ 16 
+    return GetChainSnapshot()->Tip()->GetBlockHash().GetHex(); // 2.ؼϣ 16 
 }
 
 UniValue getdifficulty(const UniValue& params, bool fHelp)
@@ -174,10 +205,43 @@ UniValue getdifficulty(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getdifficulty", "")
         );
 
-    LOCK(cs_main); // 
     return GetDifficulty(); // ػȡѶֵ
 }
 
+/** Describe one mempool entry. mempool.cs must be held. */
+static UniValue mempoolEntryToJSON(const CTxMemPoolEntry& e)
+{
+    AssertLockHeld(mempool.cs);
+
+    UniValue info(UniValue::VOBJ);
+    info.push_back(Pair("size", (int)e.GetTxSize())); // ״С
+    info.push_back(Pair("fee", ValueFromAmount(e.GetFee()))); // ׷
+    info.push_back(Pair("modifiedfee", ValueFromAmount(e.GetModifiedFee()))); // ޸ĵĽ׷
+    info.push_back(Pair("time", e.GetTime())); // ǰʱ
+    info.push_back(Pair("height", (int)e.GetHeight())); // ǰ߶
+    info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight()))); // ʼȼͨ߶ȣ
+    info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height()))); // ǰȼ
+    info.push_back(Pair("descendantcount", e.GetCountWithDescendants())); // 
+    info.push_back(Pair("descendantsize", e.GetSizeWithDescendants())); // С
+    info.push_back(Pair("descendantfees", e.GetModFeesWithDescendants())); // 
+    const CTransaction& tx = e.GetTx();
+    set<string> setDepends; // 
+    BOOST_FOREACH(const CTxIn& txin, tx.vin)
+    {
+        if (mempool.exists(txin.prevout.hash)) // ѯϣڴǷ
+            setDepends.insert(txin.prevout.hash.ToString()); // 
+    }
+
+    UniValue depends(UniValue::VARR);
+    BOOST_FOREACH(const string& dep, setDepends) // Ŀ
+    {
+        depends.push_back(dep);
+    }
+
+    info.push_back(Pair("depends", depends)); // 뽻
+    return info;
+}
+
 UniValue mempoolToJSON(bool fVerbose = false)
 {
     if (fVerbose)
@@ -187,33 +251,7 @@ UniValue mempoolToJSON(bool fVerbose = false)
         BOOST_FOREACH(const CTxMemPoolEntry& e, mempool.mapTx)
         { // ȡ׳еĽĿ
             const uint256& hash = e.GetTx().GetHash();
-            UniValue info(UniValue::VOBJ);
-            info.push_back(Pair("size", (int)e.GetTxSize())); // ״С
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee()))); // ׷
-            info.push_back(Pair("modifiedfee", ValueFromAmount(e.GetModifiedFee()))); // ޸ĵĽ׷
-            info.push_back(Pair("time", e.GetTime())); // ǰʱ
-            info.push_back(Pair("height", (int)e.GetHeight())); // ǰ߶
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight()))); // ʼȼͨ߶ȣ
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height()))); // ǰȼ
-            info.push_back(Pair("descendantcount", e.GetCountWithDescendants())); // 
-            info.push_back(Pair("descendantsize", e.GetSizeWithDescendants())); // С
-            info.push_back(Pair("descendantfees", e.GetModFeesWithDescendants())); // 
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends; // 
-            BOOST_FOREACH(const CTxIn& txin, tx.vin)
-            {
-                if (mempool.exists(txin.prevout.hash)) // ѯϣڴǷ
-                    setDepends.insert(txin.prevout.hash.ToString()); // 
-            }
-
-            UniValue depends(UniValue::VARR);
-            BOOST_FOREACH(const string& dep, setDepends) // Ŀ
-            {
-                depends.push_back(dep);
-            }
-
-            info.push_back(Pair("depends", depends)); // 뽻
-            o.push_back(Pair(hash.ToString(), info)); //   Ϣ 
+            o.push_back(Pair(hash.ToString(), mempoolEntryToJSON(e))); //   Ϣ 
         }
         return o;
     }
@@ -230,6 +268,38 @@ UniValue mempoolToJSON(bool fVerbose = false)
     }
 }
 
+/** Entries mempoolToJSON(writer) describes per lock */
+static const size_t MEMPOOL_JSON_BATCH_SIZE = 100;
+
+/**
+ * Stream the same JSON as mempoolToJSON(true). The locks are held while a batch
+ * of entries is described, not while it is written to a possibly slow client,
+ * so transactions that leave the pool in the meantime are skipped.
+ */
+void mempoolToJSON(CJSONStreamWriter& writer)
+{
+    vector<uint256> vtxid;
+    mempool.queryHashes(vtxid);
+
+    writer.BeginObject();
+    for (size_t i = 0; i < vtxid.size(); i += MEMPOOL_JSON_BATCH_SIZE)
+    {
+        vector<pair<string, UniValue> > vEntries;
+        {
+            LOCK2(cs_main, mempool.cs);
+            for (size_t j = i; j < std::min(vtxid.size(), i + MEMPOOL_JSON_BATCH_SIZE); j++)
+            {
+                CTxMemPool::txiter it = mempool.mapTx.find(vtxid[j]);
+                if (it != mempool.mapTx.end())
+                    vEntries.push_back(make_pair(vtxid[j].ToString(), mempoolEntryToJSON(*it)));
+            }
+        }
+        for (size_t j = 0; j < vEntries.size(); j++)
+            writer.KeyValue(vEntries[j].first, vEntries[j].second);
+    }
+    writer.EndObject();
+}
+
 UniValue getrawmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1) // Ϊ 1 
@@ -275,6 +345,16 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     return mempoolToJSON(fVerbose); // ڴؽ״Ϊ JSON ʽ
 }
 
+void getrawmempool_stream(const UniValue& params, CJSONStreamWriter& writer)
+{
+    if (params.size() != 1 || !params[0].get_bool()) { // ֻϸҪʽ
+        writer.Value(getrawmempool(params, false));
+        return;
+    }
+
+    mempoolToJSON(writer); // takes the locks per batch of entries
+}
+
 UniValue getblockhash(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1) // ֻ 1 
@@ -290,13 +370,13 @@ UniValue getblockhash(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockhash", "1000")
         );
 
-    LOCK(cs_main); // 
+    boost::shared_ptr<const CChainSnapshot> chain = GetChainSnapshot(); // ȡգ cs_main
 
     int nHeight = params[0].get_int(); // ȡָΪ߶
-    if (nHeight < 0 || nHeight > chainActive.Height()) // ָ߶Ƿڸ߶ȷΧ
+    if (nHeight < 0 || nHeight > chain->Height()) // ָ߶Ƿڸ߶ȷΧ
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Block height out of range");
 
-    CBlockIndex* pblockindex = chainActive[nHeight]; // ȡӦ߶ȵ
+    CBlockIndex* pblockindex = (*chain)[nHeight]; // ȡӦ߶ȵ
     return pblockindex->GetBlockHash().GetHex(); // ȡӦϣתΪ 16 Ʋ
 }
 
@@ -333,8 +413,6 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockheader", "\"00000000c937983704a73af28acdec37b049d214adbda81d7e2a3dd146f6ed09\"")
         );
 
-    LOCK(cs_main); // 
-
     std::string strHash = params[0].get_str(); // ȡϣַ
     uint256 hash(uint256S(strHash)); //  uint256 ֲ
 
@@ -342,11 +420,10 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     if (params.size() > 1)
         fVerbose = params[1].get_bool(); // ȡǷʾϸϢ
 
-    if (mapBlockIndex.count(hash) == 0) // жϹϣӦǷӳ
+    CBlockIndex* pblockindex = LookupBlockIndex(hash); // ȡָϣ cs_main
+    if (!pblockindex) // жϹϣӦǷӳ
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
 
-    CBlockIndex* pblockindex = mapBlockIndex[hash]; // ȡָϣ
-
     if (!fVerbose) // false
     {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION); // л
@@ -355,7 +432,7 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
         return strHex; // 
     }
 
-    return blockheaderToJSON(pblockindex); // װͷϢΪ JSON ʽ
+    return blockheaderToJSON(pblockindex, *GetChainSnapshot()); // װͷϢΪ JSON ʽ
 }
 
 UniValue getblock(const UniValue& params, bool fHelp)
@@ -466,6 +543,97 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
     return ret; // ؽ
 }
 
+UniValue getdbstats(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1) //  1 
+        throw runtime_error( // 
+            "getdbstats ( \"name\" )\n"
+            "\nReturns the configuration and usage statistics of the open LevelDB databases.\n"
+            "\nArguments:\n"
+            "1. \"name\"    (string, optional) Only report this database: chainstate, blockindex, blockfilter or addressindex\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"name\" : \"name\",          (string) the database\n"
+            "    \"path\" : \"path\",          (string) where it is stored\n"
+            "    \"block_cache\" : n,        (numeric) bytes of table blocks cached in memory\n"
+            "    \"write_buffer\" : n,       (numeric) bytes of writes buffered before they go to a table\n"
+            "    \"max_open_files\" : n,     (numeric) table files kept open\n"
+            "    \"bloom_filter_bits\" : n,  (numeric) bits per key of the bloom filters\n"
+            "    \"compression\" : \"type\",   (string) snappy or none\n"
+            "    \"cache_hits\" : n,         (numeric) block lookups served from the cache\n"
+            "    \"cache_misses\" : n,       (numeric) block lookups that read from disk\n"
+            "    \"cache_hit_rate\" : x.xxx, (numeric) share of the lookups served from the cache\n"
+            "    \"writes\" : n,             (numeric) write batches written\n"
+            "    \"write_bytes\" : n,        (numeric) bytes of keys and values written\n"
+            "    \"write_time\" : x.xxx,     (numeric) seconds spent writing\n"
+            "    \"max_write_time\" : x.xxx, (numeric) seconds of the slowest write. Writes are delayed while level 0\n"
+            "                                 has 8 files and stall at 12, until compaction catches up\n"
+            "    \"levels\" : [              (array) the levels that hold files or were compacted\n"
+            "      {\n"
+            "        \"level\" : n,          (numeric) the level\n"
+            "        \"files\" : n,          (numeric) table files in the level\n"
+            "        \"size\" : x.xxx,       (numeric) MiB stored in the level\n"
+            "        \"compaction_time\" : x.xxx,  (numeric) seconds spent compacting into the level\n"
+            "        \"compaction_read\" : x.xxx,  (numeric) MiB read by those compactions\n"
+            "        \"compaction_write\" : x.xxx  (numeric) MiB written by those compactions\n"
+            "      }, ...\n"
+            "    ]\n"
+            "  }, ...\n"
+            "]\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getdbstats", "")
+            + HelpExampleCli("getdbstats", "\"chainstate\"")
+            + HelpExampleRpc("getdbstats", "\"chainstate\"")
+        );
+
+    std::string strName;
+    if (params.size() > 0)
+        strName = params[0].get_str(); // ݿ
+
+    UniValue ret(UniValue::VARR);
+    std::vector<CDBStats> vStats = GetDBStats(); // ȡѴݿͳϢ
+    BOOST_FOREACH(const CDBStats& stats, vStats) {
+        if (!strName.empty() && stats.strName != strName)
+            continue;
+        UniValue db(UniValue::VOBJ);
+        db.push_back(Pair("name", stats.strName));
+        db.push_back(Pair("path", stats.strPath));
+        db.push_back(Pair("block_cache", (uint64_t)stats.nBlockCacheSize));
+        db.push_back(Pair("write_buffer", (uint64_t)stats.nWriteBufferSize));
+        db.push_back(Pair("max_open_files", stats.nMaxOpenFiles));
+        db.push_back(Pair("bloom_filter_bits", stats.nBloomFilterBits));
+        db.push_back(Pair("compression", stats.fCompress ? "snappy" : "none"));
+        uint64_t nLookups = stats.nCacheHits + stats.nCacheMisses;
+        db.push_back(Pair("cache_hits", stats.nCacheHits));
+        db.push_back(Pair("cache_misses", stats.nCacheMisses));
+        db.push_back(Pair("cache_hit_rate", nLookups ? (double)stats.nCacheHits / nLookups : 0.0)); // 
+        db.push_back(Pair("writes", stats.nWrites));
+        db.push_back(Pair("write_bytes", stats.nWriteBytes));
+        db.push_back(Pair("write_time", stats.nWriteMicros * 0.000001));
+        db.push_back(Pair("max_write_time", stats.nMaxWriteMicros * 0.000001)); // һд룬ɷӳдͣ
+        UniValue levels(UniValue::VARR);
+        for (size_t nLevel = 0; nLevel < stats.vLevels.size(); nLevel++) {
+            const CDBLevelStats& level = stats.vLevels[nLevel];
+            if (level.nFiles == 0 && level.dCompactionSeconds == 0 && level.dCompactionWriteMB == 0)
+                continue;
+            UniValue entry(UniValue::VOBJ);
+            entry.push_back(Pair("level", (int)nLevel));
+            entry.push_back(Pair("files", level.nFiles));
+            entry.push_back(Pair("size", level.dSizeMB));
+            entry.push_back(Pair("compaction_time", level.dCompactionSeconds));
+            entry.push_back(Pair("compaction_read", level.dCompactionReadMB));
+            entry.push_back(Pair("compaction_write", level.dCompactionWriteMB));
+            levels.push_back(entry);
+        }
+        db.push_back(Pair("levels", levels));
+        ret.push_back(db);
+    }
+    if (!strName.empty() && ret.empty())
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "No open database named " + strName);
+    return ret;
+}
+
 UniValue gettxout(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 2 || params.size() > 3) // Ϊ 2  3 
@@ -546,6 +714,318 @@ UniValue gettxout(const UniValue& params, bool fHelp)
     return ret;
 }
 
+UniValue gettxouts(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 2) // Ϊ 1  2 
+        throw runtime_error( // 
+            "gettxouts [{\"txid\":\"id\",\"vout\":n},...] ( includemempool )\n"
+            "\nReturns details about many transaction outputs at once, as gettxout does for one.\n"
+            "\nArguments:\n"
+            "1. \"outpoints\"    (string, required) A json array of at most " + strprintf("%u", MAX_GETUTXOS_OUTPOINTS) + " json objects\n"
+            "     [\n"
+            "       {\n"
+            "         \"txid\":\"id\",  (string, required) The transaction id\n"
+            "         \"vout\":n        (numeric, required) The output number\n"
+            "       }\n"
+            "       ,...\n"
+            "     ]\n"
+            "2. includemempool  (boolean, optional, default=true) Whether to include the mem pool\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"bestblock\" : \"hash\",    (string) the block hash\n"
+            "  \"height\" : n,              (numeric) the block height\n"
+            "  \"txouts\" : [               (array) one entry per outpoint, in the same order\n"
+            "    null,                     (null) if the output is spent or unknown\n"
+            "    {\n"
+            "      \"confirmations\" : n,   (numeric) The number of confirmations\n"
+            "      \"value\" : x.xxx,       (numeric) The transaction value in " + CURRENCY_UNIT + "\n"
+            "      \"scriptPubKey\" : {...}, (json object) as in gettxout\n"
+            "      \"version\" : n,         (numeric) The version\n"
+            "      \"coinbase\" : true|false (boolean) Coinbase or not\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("gettxouts", "\"[{\\\"txid\\\":\\\"myid\\\",\\\"vout\\\":0}]\"")
+            + HelpExampleRpc("gettxouts", "[{\"txid\":\"myid\",\"vout\":0}], true")
+        );
+
+    RPCTypeCheck(params, boost::assign::list_of(UniValue::VARR)(UniValue::VBOOL), true);
+
+    const UniValue& outpoints = params[0].get_array();
+    if (outpoints.size() > MAX_GETUTXOS_OUTPOINTS)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid parameter, max outpoints exceeded (max: %u, tried: %u)", MAX_GETUTXOS_OUTPOINTS, outpoints.size()));
+    std::vector<COutPoint> vOutPoints;
+    vOutPoints.reserve(outpoints.size());
+    for (unsigned int i = 0; i < outpoints.size(); i++) { // б
+        const UniValue& o = outpoints[i].get_obj();
+        uint256 txid = ParseHashO(o, "txid");
+        const UniValue& vout = find_value(o, "vout");
+        if (!vout.isNum())
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, missing vout key");
+        int nOutput = vout.get_int();
+        if (nOutput < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, vout must be positive");
+        vOutPoints.push_back(COutPoint(txid, nOutput));
+    }
+    bool fMempool = true; // ĬϰڴеĽ
+    if (params.size() > 1)
+        fMempool = params[1].get_bool();
+
+    std::vector<CUnspentOutput> vOutputs;
+    uint256 hashTip;
+    int nTipHeight;
+    if (!GetUnspentOutputs(vOutPoints, fMempool, vOutputs, hashTip, nTipHeight)) // ѯֻڻȡʱ cs_main
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the UTXO set");
+
+    UniValue txouts(UniValue::VARR);
+    BOOST_FOREACH(const CUnspentOutput& output, vOutputs) {
+        if (!output.fUnspent) {
+            txouts.push_back(NullUniValue);
+            continue;
+        }
+        UniValue entry(UniValue::VOBJ);
+        if (output.nHeight == MEMPOOL_HEIGHT) // ڴеĽ
+            entry.push_back(Pair("confirmations", 0));
+        else
+            entry.push_back(Pair("confirmations", nTipHeight - (int)output.nHeight + 1)); // ȡȷ
+        entry.push_back(Pair("value", ValueFromAmount(output.out.nValue))); // 
+        UniValue o(UniValue::VOBJ);
+        ScriptPubKeyToJSON(output.out.scriptPubKey, o, true); // ԿűתΪ JSON ʽ
+        entry.push_back(Pair("scriptPubKey", o));
+        entry.push_back(Pair("version", output.nVersion)); // 汾
+        entry.push_back(Pair("coinbase", output.fCoinBase)); // ǷΪҽ
+        txouts.push_back(entry);
+    }
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("bestblock", hashTip.GetHex()));
+    ret.push_back(Pair("height", nTipHeight));
+    ret.push_back(Pair("txouts", txouts));
+    return ret;
+}
+
+/** Parse an address, or a hex-encoded scriptPubKey, into the script hash the address index is keyed by */
+bool ParseAddressIndexScript(const std::string& strAddress, uint160& hashScript)
+{
+    CScript script;
+    CBitcoinAddress address(strAddress);
+    if (address.IsValid()) {
+        script = GetScriptForDestination(address.Get());
+    } else if (!strAddress.empty() && IsHex(strAddress)) {
+        std::vector<unsigned char> vch(ParseHex(strAddress));
+        script = CScript(vch.begin(), vch.end());
+    } else {
+        return false;
+    }
+    hashScript = Hash160(script.begin(), script.end());
+    return true;
+}
+
+/** Height of the block the address index is at, or -1 if it is empty */
+static int AddressIndexHeight(const uint256& hashBest)
+{
+    CBlockIndex* pindex = hashBest.IsNull() ? NULL : LookupBlockIndex(hashBest);
+    return pindex ? pindex->nHeight : -1;
+}
+
+bool addressHistoryToJSON(const uint160& hashScript, size_t nSkip, size_t nCount, UniValue& result)
+{
+    std::vector<CAddressHistoryEntry> vEntries;
+    uint256 hashBest;
+    if (!paddressindexdb->ReadAddressHistory(hashScript, nSkip, nCount, vEntries, hashBest)) //  cs_mainݿ϶ȡ
+        return false;
+
+    UniValue history(UniValue::VARR);
+    BOOST_FOREACH(const CAddressHistoryEntry& entry, vEntries) {
+        UniValue o(UniValue::VOBJ);
+        o.push_back(Pair("txid", entry.first.txid.GetHex()));
+        o.push_back(Pair("height", (int)entry.first.nHeight));
+        o.push_back(Pair(entry.first.fSpending ? "vin" : "vout", (int)entry.first.nIndex)); // ¼ţ¼
+        o.push_back(Pair("value", ValueFromAmount(entry.second.nValue)));
+        history.push_back(o);
+    }
+
+    result = UniValue(UniValue::VOBJ);
+    result.push_back(Pair("bestblock", hashBest.GetHex()));
+    result.push_back(Pair("height", AddressIndexHeight(hashBest)));
+    result.push_back(Pair("history", history));
+    return true;
+}
+
+bool addressUnspentToJSON(const uint160& hashScript, size_t nSkip, size_t nCount, UniValue& result)
+{
+    std::vector<CAddressUnspentEntry> vEntries;
+    uint256 hashBest;
+    if (!paddressindexdb->ReadAddressUnspent(hashScript, nSkip, nCount, vEntries, hashBest))
+        return false;
+    int nHeight = AddressIndexHeight(hashBest);
+
+    UniValue utxos(UniValue::VARR);
+    BOOST_FOREACH(const CAddressUnspentEntry& entry, vEntries) {
+        UniValue o(UniValue::VOBJ);
+        o.push_back(Pair("txid", entry.first.txid.GetHex()));
+        o.push_back(Pair("vout", (int)entry.first.nIndex));
+        o.push_back(Pair("value", ValueFromAmount(entry.second.nValue)));
+        o.push_back(Pair("height", entry.second.nHeight));
+        o.push_back(Pair("confirmations", nHeight - entry.second.nHeight + 1));
+        o.push_back(Pair("coinbase", entry.second.fCoinBase));
+        utxos.push_back(o);
+    }
+
+    result = UniValue(UniValue::VOBJ);
+    result.push_back(Pair("bestblock", hashBest.GetHex()));
+    result.push_back(Pair("height", nHeight));
+    result.push_back(Pair("utxos", utxos));
+    return true;
+}
+
+/** Parse the address and the optional skip and count arguments shared by the address index calls */
+static void ParseAddressQuery(const UniValue& params, uint160& hashScript, size_t& nSkip, size_t& nCount)
+{
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_MISC_ERROR, "Address index not enabled (start with -addressindex)");
+    if (!ParseAddressIndexScript(params[0].get_str(), hashScript))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address or script");
+    nSkip = 0;
+    nCount = DEFAULT_ADDRESS_QUERY_COUNT;
+    if (params.size() > 1) {
+        if (params[1].get_int() < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Invalid parameter, skip must be positive");
+        nSkip = params[1].get_int();
+    }
+    if (params.size() > 2) {
+        if (params[2].get_int() < 0 || params[2].get_int() > (int)MAX_ADDRESS_QUERY_COUNT)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, strprintf("Invalid parameter, count must be between 0 and %u", MAX_ADDRESS_QUERY_COUNT));
+        nCount = params[2].get_int();
+    }
+}
+
+UniValue getaddresshistory(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3) // Ϊ 1  3 
+        throw runtime_error( // 
+            "getaddresshistory \"address\" ( skip count )\n"
+            "\nReturns the outputs paying to an address and the inputs spending them, oldest first.\n"
+            "Requires -addressindex. The index may lag the active chain while it is being built.\n"
+            "\nArguments:\n"
+            "1. \"address\"    (string, required) The bitcoin address, or a hex-encoded scriptPubKey\n"
+            "2. skip         (numeric, optional, default=0) The number of events to skip\n"
+            "3. count        (numeric, optional, default=" + strprintf("%u", DEFAULT_ADDRESS_QUERY_COUNT) + ", max=" + strprintf("%u", MAX_ADDRESS_QUERY_COUNT) + ") The number of events to return\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"bestblock\" : \"hash\",    (string) the block the index is at\n"
+            "  \"height\" : n,              (numeric) the height of that block\n"
+            "  \"history\" : [\n"
+            "    {\n"
+            "      \"txid\" : \"id\",        (string) The transaction id\n"
+            "      \"height\" : n,         (numeric) The height of the block containing the transaction\n"
+            "      \"vout\" : n,           (numeric) The output paying to the address, for funding events\n"
+            "      \"vin\" : n,            (numeric) The spending input, for spending events\n"
+            "      \"value\" : x.xxx       (numeric) The output value in " + CURRENCY_UNIT + "\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddresshistory", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\" 100 50")
+            + HelpExampleRpc("getaddresshistory", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\", 100, 50")
+        );
+
+    uint160 hashScript;
+    size_t nSkip, nCount;
+    ParseAddressQuery(params, hashScript, nSkip, nCount);
+
+    UniValue result;
+    if (!addressHistoryToJSON(hashScript, nSkip, nCount, result))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the address index");
+    return result;
+}
+
+UniValue getaddressutxos(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3) // Ϊ 1  3 
+        throw runtime_error( // 
+            "getaddressutxos \"address\" ( skip count )\n"
+            "\nReturns the unspent outputs paying to an address.\n"
+            "Requires -addressindex. The index may lag the active chain while it is being built.\n"
+            "\nArguments:\n"
+            "1. \"address\"    (string, required) The bitcoin address, or a hex-encoded scriptPubKey\n"
+            "2. skip         (numeric, optional, default=0) The number of outputs to skip\n"
+            "3. count        (numeric, optional, default=" + strprintf("%u", DEFAULT_ADDRESS_QUERY_COUNT) + ", max=" + strprintf("%u", MAX_ADDRESS_QUERY_COUNT) + ") The number of outputs to return\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"bestblock\" : \"hash\",    (string) the block the index is at\n"
+            "  \"height\" : n,              (numeric) the height of that block\n"
+            "  \"utxos\" : [\n"
+            "    {\n"
+            "      \"txid\" : \"id\",          (string) The transaction id\n"
+            "      \"vout\" : n,             (numeric) The output number\n"
+            "      \"value\" : x.xxx,        (numeric) The output value in " + CURRENCY_UNIT + "\n"
+            "      \"height\" : n,           (numeric) The height of the block containing the transaction\n"
+            "      \"confirmations\" : n,    (numeric) The number of confirmations\n"
+            "      \"coinbase\" : true|false (boolean) Coinbase or not\n"
+            "    }\n"
+            "    ,...\n"
+            "  ]\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressutxos", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"")
+            + HelpExampleRpc("getaddressutxos", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\", 0, 100")
+        );
+
+    uint160 hashScript;
+    size_t nSkip, nCount;
+    ParseAddressQuery(params, hashScript, nSkip, nCount);
+
+    UniValue result;
+    if (!addressUnspentToJSON(hashScript, nSkip, nCount, result))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the address index");
+    return result;
+}
+
+UniValue getaddressbalance(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1) // Ϊ 1 
+        throw runtime_error( // 
+            "getaddressbalance \"address\"\n"
+            "\nReturns the balance of an address and the total it has received.\n"
+            "Requires -addressindex. The index may lag the active chain while it is being built.\n"
+            "\nArguments:\n"
+            "1. \"address\"    (string, required) The bitcoin address, or a hex-encoded scriptPubKey\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"bestblock\" : \"hash\",    (string) the block the index is at\n"
+            "  \"height\" : n,              (numeric) the height of that block\n"
+            "  \"balance\" : x.xxx,         (numeric) The sum of the unspent outputs in " + CURRENCY_UNIT + "\n"
+            "  \"received\" : x.xxx,        (numeric) The sum of all outputs paying to the address in " + CURRENCY_UNIT + "\n"
+            "  \"utxos\" : n                (numeric) The number of unspent outputs\n"
+            "}\n"
+            "\nExamples:\n"
+            + HelpExampleCli("getaddressbalance", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"")
+            + HelpExampleRpc("getaddressbalance", "\"1PSSGeFHDnKNxiEyFrD1wcEaHr9hrQDDWc\"")
+        );
+
+    uint160 hashScript;
+    size_t nSkip, nCount;
+    ParseAddressQuery(params, hashScript, nSkip, nCount);
+
+    CAmount nBalance, nReceived;
+    size_t nUnspent;
+    uint256 hashBest;
+    if (!paddressindexdb->ReadAddressBalance(hashScript, nBalance, nReceived, nUnspent, hashBest))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read the address index");
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("bestblock", hashBest.GetHex()));
+    ret.push_back(Pair("height", AddressIndexHeight(hashBest)));
+    ret.push_back(Pair("balance", ValueFromAmount(nBalance)));
+    ret.push_back(Pair("received", ValueFromAmount(nReceived)));
+    ret.push_back(Pair("utxos", (uint64_t)nUnspent));
+    return ret;
+}
+
 UniValue verifychain(const UniValue& params, bool fHelp)
 {
     int nCheckLevel = GetArg("-checklevel", DEFAULT_CHECKLEVEL); // ȼĬ 3
@@ -604,11 +1084,13 @@ static UniValue SoftForkDesc(const std::string &name, int version, CBlockIndex*
     return rv;
 }
 
-static UniValue BIP9SoftForkDesc(const std::string& name, const Consensus::Params& consensusParams, Consensus::DeploymentPos id)
+static UniValue BIP9SoftForkDesc(const std::string& name, const CBlockIndex* pindex, const Consensus::Params& consensusParams, Consensus::DeploymentPos id)
 {
+    // Use a cache of our own, as versionbitscache may only be used under cs_main
+    VersionBitsCache cache;
     UniValue rv(UniValue::VOBJ);
     rv.push_back(Pair("id", name));
-    switch (VersionBitsTipState(consensusParams, id)) {
+    switch (VersionBitsState(pindex, consensusParams, id, cache)) {
     case THRESHOLD_DEFINED: rv.push_back(Pair("status", "defined")); break;
     case THRESHOLD_STARTED: rv.push_back(Pair("status", "started")); break;
     case THRESHOLD_LOCKED_IN: rv.push_back(Pair("status", "locked_in")); break;
@@ -661,33 +1143,34 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             + HelpExampleRpc("getblockchaininfo", "")
         );
 
-    LOCK(cs_main);
+    boost::shared_ptr<const CChainSnapshot> chain = GetChainSnapshot(); // ȡգ cs_main
+    CBlockIndex* tip = chain->Tip();
 
     UniValue obj(UniValue::VOBJ); // һĿ
     obj.push_back(Pair("chain",                 Params().NetworkIDString())); //  ID  
-    obj.push_back(Pair("blocks",                (int)chainActive.Height())); // ǰ߶
-    obj.push_back(Pair("headers",               pindexBestHeader ? pindexBestHeader->nHeight : -1)); // ǰͷ߶ȣͬ߶
-    obj.push_back(Pair("bestblockhash",         chainActive.Tip()->GetBlockHash().GetHex())); // ϣ16 ƣ
-    obj.push_back(Pair("difficulty",            (double)GetDifficulty())); // ڿѶ
-    obj.push_back(Pair("mediantime",            (int64_t)chainActive.Tip()->GetMedianTimePast())); // ǰʱ
-    obj.push_back(Pair("verificationprogress",  Checkpoints::GuessVerificationProgress(Params().Checkpoints(), chainActive.Tip()))); // ֤ȣй
-    obj.push_back(Pair("chainwork",             chainActive.Tip()->nChainWork.GetHex())); // ǰ16 ƣ
+    obj.push_back(Pair("blocks",                (int)chain->Height())); // ǰ߶
+    obj.push_back(Pair("headers",               chain->BestHeader() ? chain->BestHeader()->nHeight : -1)); // ǰͷ߶ȣͬ߶
+    obj.push_back(Pair("bestblockhash",         tip->GetBlockHash().GetHex())); // ϣ16 ƣ
+    obj.push_back(Pair("difficulty",            (double)GetDifficulty(tip))); // ڿѶ
+    obj.push_back(Pair("mediantime",            (int64_t)tip->GetMedianTimePast())); // ǰʱ
+    obj.push_back(Pair("verificationprogress",  Checkpoints::GuessVerificationProgress(Params().Checkpoints(), tip))); // ֤ȣй
+    obj.push_back(Pair("chainwork",             tip->nChainWork.GetHex())); // ǰ16 ƣ
     obj.push_back(Pair("pruned",                fPruneMode)); // Ƿ޼ģʽ
 
     const Consensus::Params& consensusParams = Params().GetConsensus();
-    CBlockIndex* tip = chainActive.Tip();
     UniValue softforks(UniValue::VARR);
     UniValue bip9_softforks(UniValue::VARR);
     softforks.push_back(SoftForkDesc("bip34", 2, tip, consensusParams));
     softforks.push_back(SoftForkDesc("bip66", 3, tip, consensusParams));
     softforks.push_back(SoftForkDesc("bip65", 4, tip, consensusParams));
-    bip9_softforks.push_back(BIP9SoftForkDesc("csv", consensusParams, Consensus::DEPLOYMENT_CSV));
+    bip9_softforks.push_back(BIP9SoftForkDesc("csv", tip, consensusParams, Consensus::DEPLOYMENT_CSV));
     obj.push_back(Pair("softforks",             softforks)); // ֲ
     obj.push_back(Pair("bip9_softforks", bip9_softforks)); // bip9_ֲ
 
     if (fPruneMode) // ޼ģʽ
     {
-        CBlockIndex *block = chainActive.Tip();
+        LOCK(cs_main); // ״̬ᱻ޼ı
+        CBlockIndex *block = tip;
         while (block && block->pprev && (block->pprev->nStatus & BLOCK_HAVE_DATA))
             block = block->pprev;
 
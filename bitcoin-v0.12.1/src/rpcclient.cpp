@@ -54,6 +54,7 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "listtransactions", 1 },
     { "listtransactions", 2 },
     { "listtransactions", 3 },
+    { "listtransactions", 4 },
     { "listaccounts", 0 },
     { "listaccounts", 1 },
     { "walletpassphrase", 1 },
@@ -83,6 +84,12 @@ static const CRPCConvertParam vRPCConvertParams[] =
     { "fundrawtransaction", 1 },
     { "gettxout", 1 },
     { "gettxout", 2 },
+    { "gettxouts", 0 },
+    { "gettxouts", 1 },
+    { "getaddresshistory", 1 },
+    { "getaddresshistory", 2 },
+    { "getaddressutxos", 1 },
+    { "getaddressutxos", 2 },
     { "gettxoutproof", 0 },
     { "lockunspent", 0 },
     { "lockunspent", 1 },
@@ -110,7 +110,10 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
             "    \"inflight\": [\n"
             "       n,                        (numeric) The heights of blocks we're currently asking from this peer\n"
             "       ...\n"
-            "    ]\n"
+            "    ],\n"
+            "    \"inflightmax\": n,         (numeric) The current limit on blocks in flight from this peer, adapted to its latency and throughput\n"
+            "    \"blocklatency\": n,        (numeric) Average time in seconds from requesting a block to receiving it\n"
+            "    \"blockbytespersec\": n,    (numeric) Measured block download throughput from this peer, in bytes per second\n"
             "  }\n"
             "  ,...\n"
             "]\n"
@@ -162,6 +165,9 @@ UniValue getpeerinfo(const UniValue& params, bool fHelp)
                 heights.push_back(height);
             }
             obj.push_back(Pair("inflight", heights));
+            obj.push_back(Pair("inflightmax", statestats.nBlocksInFlightMax)); // 
+            obj.push_back(Pair("blocklatency", ((double)statestats.nBlockLatency) / 1e6)); // ƽӳ
+            obj.push_back(Pair("blockbytespersec", statestats.nBlockBytesPerSec)); // 
         }
         obj.push_back(Pair("whitelisted", stats.fWhitelisted));
 
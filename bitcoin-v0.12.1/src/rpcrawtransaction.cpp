@@ -188,8 +188,11 @@ UniValue getrawtransaction(const UniValue& params, bool fHelp)
 
     CTransaction tx;
     uint256 hashBlock;
-    if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true)) // ȡ׼ϣ
+    if (!GetTransaction(hash, tx, Params().GetConsensus(), hashBlock, true)) { // ȡ׼ϣ
+        if (fTxIndex && !IsTxIndexSynced()) // δ
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available about transaction (the transaction index is still being built)");
         throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available about transaction");
+    }
 
     string strHex = EncodeHexTx(tx); // 뽻
 
@@ -743,27 +746,39 @@ UniValue signrawtransaction(const UniValue& params, bool fHelp)
     // Script verification errors
     UniValue vErrors(UniValue::VARR); // ͵Ľű֤
 
-    // Sign what we can: // 4.ǩ
+    // Sign what we can, all inputs at once: // 4.ǩһΪȫǩ
+    vector<CScript> vSignPubKeys(mergedTx.vin.size()); // Ҫǩ뻨ѵĽűԿձʾǩ
     for (unsigned int i = 0; i < mergedTx.vin.size(); i++) { // ϲĿɱ佻б
         CTxIn& txin = mergedTx.vin[i]; // ȡһʽ
         const CCoins* coins = view.AccessCoins(txin.prevout.hash); // ȡǰһʽ׵ĹϣӦ CCoins
-        if (coins == NULL || !coins->IsAvailable(txin.prevout.n)) {
-            TxInErrorToJSON(txin, vErrors, "Input not found or already spent");
+        if (coins == NULL || !coins->IsAvailable(txin.prevout.n))
             continue;
-        }
-        const CScript& prevPubKey = coins->vout[txin.prevout.n].scriptPubKey; // ȡǰһʽĽűԿ
 
         txin.scriptSig.clear(); // սĽűǩ
         // Only sign SIGHASH_SINGLE if there's a corresponding output: // Ӧֻǩ SIGHASH_SINGLE
         if (!fHashSingle || (i < mergedTx.vout.size()))
-            SignSignature(keystore, prevPubKey, mergedTx, i, nHashType); // ǩ
+            vSignPubKeys[i] = coins->vout[txin.prevout.n].scriptPubKey; // ȡǰһʽĽűԿ
+    }
+    SignTransaction(keystore, mergedTx, vSignPubKeys, nHashType); // ǩ
+
+    // Signature hashes do not cover scriptSigs, so one copy serves all inputs // ǩϣűǩȫ빲һ
+    const CTransaction txConst(mergedTx);
+    for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
+        CTxIn& txin = mergedTx.vin[i];
+        const CCoins* coins = view.AccessCoins(txin.prevout.hash);
+        if (coins == NULL || !coins->IsAvailable(txin.prevout.n)) {
+            TxInErrorToJSON(txin, vErrors, "Input not found or already spent");
+            continue;
+        }
+        const CScript& prevPubKey = coins->vout[txin.prevout.n].scriptPubKey; // ȡǰһʽĽűԿ
+        TransactionSignatureChecker checker(&txConst, i);
 
         // ... and merge in other signatures: // ... źϲǩ
         BOOST_FOREACH(const CMutableTransaction& txv, txVariants) { // б
-            txin.scriptSig = CombineSignatures(prevPubKey, mergedTx, i, txin.scriptSig, txv.vin[i].scriptSig); // ϲǩ
+            txin.scriptSig = CombineSignatures(prevPubKey, checker, txin.scriptSig, txv.vin[i].scriptSig); // ϲǩ
         }
         ScriptError serror = SCRIPT_ERR_OK;
-        if (!VerifyScript(txin.scriptSig, prevPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, MutableTransactionSignatureChecker(&mergedTx, i), &serror)) { // ֤űǩ
+        if (!VerifyScript(txin.scriptSig, prevPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, checker, &serror)) { // ֤űǩ
             TxInErrorToJSON(txin, vErrors, ScriptErrorString(serror));
         }
     }
@@ -253,129 +253,141 @@ UniValue stop(const UniValue& params, bool fHelp)
  * Call Table
  */ // б
 static const CRPCCommand vRPCCommands[] =
-{ //  category              name                      actor (function)         okSafeMode
-  //  --------------------- ------------------------  -----------------------  ----------
+{ //  category              name                      actor (function)         okSafeMode  readOnly
+  //  --------------------- ------------------------  -----------------------  ----------  --------
     /* Overall control/query calls */
-    { "control",            "getinfo",                &getinfo,                true  }, /* uses wallet if enabled */
-    { "control",            "help",                   &help,                   true  },
-    { "control",            "stop",                   &stop,                   true  },
+    { "control",            "getinfo",                &getinfo,                true,       true  }, /* uses wallet if enabled */
+    { "control",            "help",                   &help,                   true,       true  },
+    { "control",            "stop",                   &stop,                   true,       false },
 
     /* P2P networking */
-    { "network",            "getnetworkinfo",         &getnetworkinfo,         true  },
-    { "network",            "addnode",                &addnode,                true  },
-    { "network",            "disconnectnode",         &disconnectnode,         true  },
-    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true  },
-    { "network",            "getconnectioncount",     &getconnectioncount,     true  },
-    { "network",            "getnettotals",           &getnettotals,           true  },
-    { "network",            "getpeerinfo",            &getpeerinfo,            true  },
-    { "network",            "ping",                   &ping,                   true  },
-    { "network",            "setban",                 &setban,                 true  },
-    { "network",            "listbanned",             &listbanned,             true  },
-    { "network",            "clearbanned",            &clearbanned,            true  },
+    { "network",            "getnetworkinfo",         &getnetworkinfo,         true,       true  },
+    { "network",            "addnode",                &addnode,                true,       false },
+    { "network",            "disconnectnode",         &disconnectnode,         true,       false },
+    { "network",            "getaddednodeinfo",       &getaddednodeinfo,       true,       true  },
+    { "network",            "getconnectioncount",     &getconnectioncount,     true,       true  },
+    { "network",            "getnettotals",           &getnettotals,           true,       true  },
+    { "network",            "getpeerinfo",            &getpeerinfo,            true,       true  },
+    { "network",            "ping",                   &ping,                   true,       false },
+    { "network",            "setban",                 &setban,                 true,       false },
+    { "network",            "listbanned",             &listbanned,             true,       true  },
+    { "network",            "clearbanned",            &clearbanned,            true,       false },
 
     /* Block chain and UTXO */
-    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true  },
-    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true  },
-    { "blockchain",         "getblockcount",          &getblockcount,          true  },
-    { "blockchain",         "getblock",               &getblock,               true  },
-    { "blockchain",         "getblockhash",           &getblockhash,           true  },
-    { "blockchain",         "getblockheader",         &getblockheader,         true  },
-    { "blockchain",         "getchaintips",           &getchaintips,           true  },
-    { "blockchain",         "getdifficulty",          &getdifficulty,          true  },
-    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true  },
-    { "blockchain",         "getrawmempool",          &getrawmempool,          true  },
-    { "blockchain",         "gettxout",               &gettxout,               true  },
-    { "blockchain",         "gettxoutproof",          &gettxoutproof,          true  },
-    { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true  },
-    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true  },
-    { "blockchain",         "verifychain",            &verifychain,            true  },
+    { "blockchain",         "getblockchaininfo",      &getblockchaininfo,      true,       true  },
+    { "blockchain",         "getaddressbalance",      &getaddressbalance,      true,       true  },
+    { "blockchain",         "getaddresshistory",      &getaddresshistory,      true,       true  },
+    { "blockchain",         "getaddressutxos",        &getaddressutxos,        true,       true  },
+    { "blockchain",         "getbestblockhash",       &getbestblockhash,       true,       true  },
+    { "blockchain",         "getblockcount",          &getblockcount,          true,       true  },
+    { "blockchain",         "getblock",               &getblock,               true,       true  },
+    { "blockchain",         "getblockhash",           &getblockhash,           true,       true  },
+    { "blockchain",         "getblockheader",         &getblockheader,         true,       true  },
+    { "blockchain",         "getchaintips",           &getchaintips,           true,       true  },
+    { "blockchain",         "getdbstats",             &getdbstats,             true,       true  },
+    { "blockchain",         "getdifficulty",          &getdifficulty,          true,       true  },
+    { "blockchain",         "getmempoolinfo",         &getmempoolinfo,         true,       true  },
+    { "blockchain",         "getrawmempool",          &getrawmempool,          true,       true  },
+    { "blockchain",         "gettxout",               &gettxout,               true,       true  },
+    { "blockchain",         "gettxouts",              &gettxouts,              true,       true  },
+    { "blockchain",         "gettxoutproof",          &gettxoutproof,          true,       true  },
+    { "blockchain",         "verifytxoutproof",       &verifytxoutproof,       true,       true  },
+    { "blockchain",         "gettxoutsetinfo",        &gettxoutsetinfo,        true,       true  },
+    { "blockchain",         "verifychain",            &verifychain,            true,       true  },
 
     /* Mining */
-    { "mining",             "getblocktemplate",       &getblocktemplate,       true  },
-    { "mining",             "getmininginfo",          &getmininginfo,          true  },
-    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true  },
-    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true  },
-    { "mining",             "submitblock",            &submitblock,            true  },
+    { "mining",             "getblocktemplate",       &getblocktemplate,       true,       false },
+    { "mining",             "getmininginfo",          &getmininginfo,          true,       true  },
+    { "mining",             "getnetworkhashps",       &getnetworkhashps,       true,       true  },
+    { "mining",             "prioritisetransaction",  &prioritisetransaction,  true,       false },
+    { "mining",             "submitblock",            &submitblock,            true,       false },
 
     /* Coin generation */
-    { "generating",         "getgenerate",            &getgenerate,            true  },
-    { "generating",         "setgenerate",            &setgenerate,            true  },
-    { "generating",         "generate",               &generate,               true  },
+    { "generating",         "getgenerate",            &getgenerate,            true,       true  },
+    { "generating",         "setgenerate",            &setgenerate,            true,       false },
+    { "generating",         "generate",               &generate,               true,       false },
 
     /* Raw transactions */
-    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true  },
-    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true  },
-    { "rawtransactions",    "decodescript",           &decodescript,           true  },
-    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true  },
-    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false },
-    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false }, /* uses wallet if enabled */
+    { "rawtransactions",    "createrawtransaction",   &createrawtransaction,   true,       true  },
+    { "rawtransactions",    "decoderawtransaction",   &decoderawtransaction,   true,       true  },
+    { "rawtransactions",    "decodescript",           &decodescript,           true,       true  },
+    { "rawtransactions",    "getrawtransaction",      &getrawtransaction,      true,       true  },
+    { "rawtransactions",    "sendrawtransaction",     &sendrawtransaction,     false,      false },
+    { "rawtransactions",    "signrawtransaction",     &signrawtransaction,     false,      true  }, /* uses wallet if enabled */
 #ifdef ENABLE_WALLET
-    { "rawtransactions",    "fundrawtransaction",     &fundrawtransaction,     false },
+    { "rawtransactions",    "fundrawtransaction",     &fundrawtransaction,     false,      false },
 #endif
 
     /* Utility functions */
-    { "util",               "createmultisig",         &createmultisig,         true  },
-    { "util",               "validateaddress",        &validateaddress,        true  }, /* uses wallet if enabled */
-    { "util",               "verifymessage",          &verifymessage,          true  },
-    { "util",               "estimatefee",            &estimatefee,            true  },
-    { "util",               "estimatepriority",       &estimatepriority,       true  },
-    { "util",               "estimatesmartfee",       &estimatesmartfee,       true  },
-    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true  },
+    { "util",               "createmultisig",         &createmultisig,         true,       true  },
+    { "util",               "validateaddress",        &validateaddress,        true,       true  }, /* uses wallet if enabled */
+    { "util",               "verifymessage",          &verifymessage,          true,       true  },
+    { "util",               "estimatefee",            &estimatefee,            true,       true  },
+    { "util",               "estimatepriority",       &estimatepriority,       true,       true  },
+    { "util",               "estimatesmartfee",       &estimatesmartfee,       true,       true  },
+    { "util",               "estimatesmartpriority",  &estimatesmartpriority,  true,       true  },
 
     /* Not shown in help */
-    { "hidden",             "invalidateblock",        &invalidateblock,        true  },
-    { "hidden",             "reconsiderblock",        &reconsiderblock,        true  },
-    { "hidden",             "setmocktime",            &setmocktime,            true  },
+    { "hidden",             "invalidateblock",        &invalidateblock,        true,       false },
+    { "hidden",             "reconsiderblock",        &reconsiderblock,        true,       false },
+    { "hidden",             "setmocktime",            &setmocktime,            true,       false },
 #ifdef ENABLE_WALLET
-    { "hidden",             "resendwallettransactions", &resendwallettransactions, true},
+    { "hidden",             "resendwallettransactions", &resendwallettransactions, true,       false },
 #endif
 
 #ifdef ENABLE_WALLET
     /* Wallet */
-    { "wallet",             "addmultisigaddress",     &addmultisigaddress,     true  },
-    { "wallet",             "backupwallet",           &backupwallet,           true  },
-    { "wallet",             "dumpprivkey",            &dumpprivkey,            true  },
-    { "wallet",             "dumpwallet",             &dumpwallet,             true  },
-    { "wallet",             "encryptwallet",          &encryptwallet,          true  },
-    { "wallet",             "getaccountaddress",      &getaccountaddress,      true  },
-    { "wallet",             "getaccount",             &getaccount,             true  },
-    { "wallet",             "getaddressesbyaccount",  &getaddressesbyaccount,  true  },
-    { "wallet",             "getbalance",             &getbalance,             false },
-    { "wallet",             "getnewaddress",          &getnewaddress,          true  },
-    { "wallet",             "getrawchangeaddress",    &getrawchangeaddress,    true  },
-    { "wallet",             "getreceivedbyaccount",   &getreceivedbyaccount,   false },
-    { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false },
-    { "wallet",             "gettransaction",         &gettransaction,         false },
-    { "wallet",             "abandontransaction",     &abandontransaction,     false },
-    { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false },
-    { "wallet",             "getwalletinfo",          &getwalletinfo,          false },
-    { "wallet",             "importprivkey",          &importprivkey,          true  },
-    { "wallet",             "importwallet",           &importwallet,           true  },
-    { "wallet",             "importaddress",          &importaddress,          true  },
-    { "wallet",             "importpubkey",           &importpubkey,           true  },
-    { "wallet",             "keypoolrefill",          &keypoolrefill,          true  },
-    { "wallet",             "listaccounts",           &listaccounts,           false },
-    { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false },
-    { "wallet",             "listlockunspent",        &listlockunspent,        false },
-    { "wallet",             "listreceivedbyaccount",  &listreceivedbyaccount,  false },
-    { "wallet",             "listreceivedbyaddress",  &listreceivedbyaddress,  false },
-    { "wallet",             "listsinceblock",         &listsinceblock,         false },
-    { "wallet",             "listtransactions",       &listtransactions,       false },
-    { "wallet",             "listunspent",            &listunspent,            false },
-    { "wallet",             "lockunspent",            &lockunspent,            true  },
-    { "wallet",             "move",                   &movecmd,                false },
-    { "wallet",             "sendfrom",               &sendfrom,               false },
-    { "wallet",             "sendmany",               &sendmany,               false },
-    { "wallet",             "sendtoaddress",          &sendtoaddress,          false },
-    { "wallet",             "setaccount",             &setaccount,             true  },
-    { "wallet",             "settxfee",               &settxfee,               true  },
-    { "wallet",             "signmessage",            &signmessage,            true  },
-    { "wallet",             "walletlock",             &walletlock,             true  },
-    { "wallet",             "walletpassphrasechange", &walletpassphrasechange, true  },
-    { "wallet",             "walletpassphrase",       &walletpassphrase,       true  },
+    { "wallet",             "addmultisigaddress",     &addmultisigaddress,     true,       false },
+    { "wallet",             "backupwallet",           &backupwallet,           true,       false },
+    { "wallet",             "dumpprivkey",            &dumpprivkey,            true,       true  },
+    { "wallet",             "dumpwallet",             &dumpwallet,             true,       false },
+    { "wallet",             "encryptwallet",          &encryptwallet,          true,       false },
+    { "wallet",             "getaccountaddress",      &getaccountaddress,      true,       false },
+    { "wallet",             "getaccount",             &getaccount,             true,       true  },
+    { "wallet",             "getaddressesbyaccount",  &getaddressesbyaccount,  true,       true  },
+    { "wallet",             "getbalance",             &getbalance,             false,      true  },
+    { "wallet",             "getnewaddress",          &getnewaddress,          true,       false },
+    { "wallet",             "getrawchangeaddress",    &getrawchangeaddress,    true,       false },
+    { "wallet",             "getreceivedbyaccount",   &getreceivedbyaccount,   false,      true  },
+    { "wallet",             "getreceivedbyaddress",   &getreceivedbyaddress,   false,      true  },
+    { "wallet",             "gettransaction",         &gettransaction,         false,      true  },
+    { "wallet",             "abandontransaction",     &abandontransaction,     false,      false },
+    { "wallet",             "getunconfirmedbalance",  &getunconfirmedbalance,  false,      true  },
+    { "wallet",             "getwalletinfo",          &getwalletinfo,          false,      true  },
+    { "wallet",             "importprivkey",          &importprivkey,          true,       false },
+    { "wallet",             "importwallet",           &importwallet,           true,       false },
+    { "wallet",             "importaddress",          &importaddress,          true,       false },
+    { "wallet",             "importpubkey",           &importpubkey,           true,       false },
+    { "wallet",             "keypoolrefill",          &keypoolrefill,          true,       false },
+    { "wallet",             "listaccounts",           &listaccounts,           false,      true  },
+    { "wallet",             "listaddressgroupings",   &listaddressgroupings,   false,      true  },
+    { "wallet",             "listlockunspent",        &listlockunspent,        false,      true  },
+    { "wallet",             "listreceivedbyaccount",  &listreceivedbyaccount,  false,      true  },
+    { "wallet",             "listreceivedbyaddress",  &listreceivedbyaddress,  false,      true  },
+    { "wallet",             "listsinceblock",         &listsinceblock,         false,      true  },
+    { "wallet",             "listtransactions",       &listtransactions,       false,      true  },
+    { "wallet",             "listunspent",            &listunspent,            false,      true  },
+    { "wallet",             "lockunspent",            &lockunspent,            true,       false },
+    { "wallet",             "move",                   &movecmd,                false,      false },
+    { "wallet",             "sendfrom",               &sendfrom,               false,      false },
+    { "wallet",             "sendmany",               &sendmany,               false,      false },
+    { "wallet",             "sendtoaddress",          &sendtoaddress,          false,      false },
+    { "wallet",             "setaccount",             &setaccount,             true,       false },
+    { "wallet",             "settxfee",               &settxfee,               true,       false },
+    { "wallet",             "signmessage",            &signmessage,            true,       true  },
+    { "wallet",             "walletlock",             &walletlock,             true,       false },
+    { "wallet",             "walletpassphrasechange", &walletpassphrasechange, true,       false },
+    { "wallet",             "walletpassphrase",       &walletpassphrase,       true,       false },
 #endif // ENABLE_WALLET
 };
 
+static const struct {
+    const char* name;
+    rpcstreamfn_type streamer;
+} vRPCStreamers[] = { // ʽ
+    { "getrawmempool",          &getrawmempool_stream },
+};
+
 CRPCTable::CRPCTable() // ڸļĩβȫֳ󣬵øú RPC ע
 {
     unsigned int vcidx;
@@ -386,6 +398,8 @@ CRPCTable::CRPCTable() // 
         pcmd = &vRPCCommands[vcidx]; // ָһ RPC 
         mapCommands[pcmd->name] = pcmd; // Ѹעᵽ RPC б
     }
+    for (vcidx = 0; vcidx < (sizeof(vRPCStreamers) / sizeof(vRPCStreamers[0])); vcidx++)
+        mapStreamers[vRPCStreamers[vcidx].name] = vRPCStreamers[vcidx].streamer;
 }
 
 const CRPCCommand *CRPCTable::operator[](const std::string &name) const // ص±
@@ -474,7 +488,7 @@ void JSONRequest::parse(const UniValue& valRequest)
         throw JSONRPCError(RPC_INVALID_REQUEST, "Params must be an array"); // ׳
 }
 
-static UniValue JSONRPCExecOne(const UniValue& req)
+UniValue JSONRPCExecOne(const UniValue& req)
 {
     UniValue rpc_result(UniValue::VOBJ); // ͵ JSON 
 
@@ -498,13 +512,15 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result; //  rpc 
 }
 
-std::string JSONRPCExecBatch(const UniValue& vReq)
+bool JSONRPCIsReadOnly(const UniValue& req)
 {
-    UniValue ret(UniValue::VARR); // ͵ JSON 
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++) // 
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx])); // ִһβӦ׷ӵ JSON 
-
-    return ret.write() + "\n"; //  JSON תΪַƴӻз󷵻
+    if (!req.isObject())
+        return true;
+    const UniValue& valMethod = find_value(req.get_obj(), "method");
+    if (!valMethod.isStr())
+        return true;
+    const CRPCCommand *pcmd = tableRPC[valMethod.get_str()]; // δֻ֪᷵ش
+    return pcmd == NULL || pcmd->readOnly;
 }
 
 UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params) const
@@ -536,6 +552,39 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     g_rpcSignals.PostCommand(*pcmd); // 5.źδעᴦ
 }
 
+bool CRPCTable::canStream(const std::string &strMethod) const
+{
+    return mapStreamers.count(strMethod) && mapCommands.count(strMethod);
+}
+
+void CRPCTable::executeStream(const std::string &strMethod, const UniValue &params, CJSONStreamWriter& writer) const
+{
+    // Same checks as execute //  execute ͬļ
+    {
+        LOCK(cs_rpcWarmup);
+        if (fRPCInWarmup)
+            throw JSONRPCError(RPC_IN_WARMUP, rpcWarmupStatus);
+    }
+
+    const CRPCCommand *pcmd = tableRPC[strMethod];
+    std::map<std::string, rpcstreamfn_type>::const_iterator it = mapStreamers.find(strMethod);
+    if (!pcmd || it == mapStreamers.end())
+        throw JSONRPCError(RPC_METHOD_NOT_FOUND, "Method not found");
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try
+    {
+        it->second(params, writer);
+    }
+    catch (const std::exception& e)
+    {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    g_rpcSignals.PostCommand(*pcmd);
+}
+
 std::string HelpExampleCli(const std::string& methodname, const std::string& args)
 {
     return "> bitcoin-cli " + methodname + " " + args + "\n";
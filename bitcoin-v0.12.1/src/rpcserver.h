@@ -113,6 +113,15 @@ void RPCRunLater(const std::string& name, boost::function<void(void)> func, int6
 
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp); // RPC ӦΪĻص
 
+class CJSONStreamWriter;
+
+/**
+ * Alternative implementation of an RPC command for large results, which
+ * writes the result to a JSON stream as it is produced instead of returning
+ * it. It may throw like an actor as long as it has not written anything.
+ */ // ʽ RPC ʵ֣ڽϴĽ
+typedef void(*rpcstreamfn_type)(const UniValue& params, CJSONStreamWriter& writer);
+
 class CRPCCommand // RPC 
 {
 public:
@@ -120,6 +129,7 @@ public:
     std::string name; // 
     rpcfn_type actor; // ӦĺΪ
     bool okSafeMode; // Ƿȫģʽ
+    bool readOnly; // Ƿ񲻸ıڵ״ֻ̬ִУ
 };
 
 /**
@@ -129,6 +139,7 @@ class CRPCTable // RPC 
 {
 private:
     std::map<std::string, const CRPCCommand*> mapCommands; // RPC б
+    std::map<std::string, rpcstreamfn_type> mapStreamers; // ʽ RPC 
 public:
     CRPCTable(); // עж RPC  RPC б
     const CRPCCommand* operator[](const std::string& name) const; // ص±
@@ -142,6 +153,15 @@ public:
      * @throws an exception (UniValue) when an error happens.
      */ // ִһ
     UniValue execute(const std::string &method, const UniValue &params) const;
+
+    /** Whether method can write its result to a stream with executeStream. */
+    bool canStream(const std::string &method) const;
+
+    /**
+     * Execute a method that canStream, writing its result to writer.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    void executeStream(const std::string &method, const UniValue &params, CJSONStreamWriter& writer) const;
 };
 
 extern const CRPCTable tableRPC; //  rpcserver.cpp дһȫֵĳ
@@ -255,11 +275,17 @@ extern UniValue getdifficulty(const UniValue& params, bool fHelp); // 
 extern UniValue settxfee(const UniValue& params, bool fHelp); // ý׷
 extern UniValue getmempoolinfo(const UniValue& params, bool fHelp); // ȡڴϢ
 extern UniValue getrawmempool(const UniValue& params, bool fHelp); // ȡڴԪϢ
+extern void getrawmempool_stream(const UniValue& params, CJSONStreamWriter& writer);
 extern UniValue getblockhash(const UniValue& params, bool fHelp); // ȡָϣ
 extern UniValue getblockheader(const UniValue& params, bool fHelp); // ȡָϣͷϢ
 extern UniValue getblock(const UniValue& params, bool fHelp); // ȡϢ
 extern UniValue gettxoutsetinfo(const UniValue& params, bool fHelp); // ȡϢ
+extern UniValue getdbstats(const UniValue& params, bool fHelp); // ȡ LevelDB ݿúʹͳ
 extern UniValue gettxout(const UniValue& params, bool fHelp); // ȡһʽϻڴУϸ
+extern UniValue gettxouts(const UniValue& params, bool fHelp); // ȡϸ
+extern UniValue getaddresshistory(const UniValue& params, bool fHelp); // ȡַ֧¼Ҫַ
+extern UniValue getaddressutxos(const UniValue& params, bool fHelp); // ȡַδҪַ
+extern UniValue getaddressbalance(const UniValue& params, bool fHelp); // ȡַҪַ
 extern UniValue verifychain(const UniValue& params, bool fHelp); // ֤ݿ
 extern UniValue getchaintips(const UniValue& params, bool fHelp); // ȡϢ
 extern UniValue invalidateblock(const UniValue& params, bool fHelp); // Ч
@@ -268,6 +294,13 @@ extern UniValue reconsiderblock(const UniValue& params, bool fHelp); // 
 bool StartRPC(); //  RPC
 void InterruptRPC();
 void StopRPC(); // ֹͣ RPC
-std::string JSONRPCExecBatch(const UniValue& vReq); // JSONRPC ִ
+/** Execute one JSON-RPC request object, returning its reply object. Errors are reported in the reply. */
+UniValue JSONRPCExecOne(const UniValue& req); // JSONRPC ִе
+/**
+ * Whether a request only reads node state, so that batch elements next to
+ * each other may be run concurrently. Malformed requests count as read-only:
+ * all they produce is an error reply.
+ */
+bool JSONRPCIsReadOnly(const UniValue& req); // JSONRPC Ƿֻ
 
 #endif // BITCOIN_RPCSERVER_H
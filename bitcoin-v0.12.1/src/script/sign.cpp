@@ -11,7 +11,11 @@
 #include "primitives/transaction.h"
 #include "script/standard.h"
 #include "uint256.h"
+#include "util.h"
 
+#include <algorithm>
+
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 
 using namespace std;
@@ -147,6 +151,40 @@ bool SignSignature(const CKeyStore &keystore, const CTransaction& txFrom, CMutab
     return SignSignature(keystore, txout.scriptPubKey, txTo, nIn, nHashType);
 }
 
+/** Sign every nStep-th input, starting at nStart */
+static void SignInputs(const CKeyStore* pkeystore, const CTransaction* ptxTo, const vector<CScript>* pvScriptPubKeys, int nHashType, vector<CScript>* pvScriptSigs, vector<char>* pvSigned, unsigned int nStart, unsigned int nStep)
+{
+    for (unsigned int i = nStart; i < pvScriptPubKeys->size(); i += nStep)
+    {
+        const CScript& scriptPubKey = (*pvScriptPubKeys)[i];
+        if (scriptPubKey.empty())
+            continue;
+        TransactionSignatureCreator creator(pkeystore, ptxTo, i, nHashType);
+        (*pvSigned)[i] = ProduceSignature(creator, scriptPubKey, (*pvScriptSigs)[i]);
+    }
+}
+
+bool SignTransaction(const CKeyStore& keystore, CMutableTransaction& txTo, const vector<CScript>& vScriptPubKeys, int nHashType)
+{
+    assert(vScriptPubKeys.size() == txTo.vin.size());
+    const CTransaction txToConst(txTo);
+    vector<CScript> vScriptSigs(vScriptPubKeys.size());
+    vector<char> vSigned(vScriptPubKeys.size(), false);
+    const int nThreads = std::max(1, std::min(std::min(GetNumCores(), MAX_SIGN_THREADS), (int)vScriptPubKeys.size()));
+    ParallelFor(nThreads, boost::bind(&SignInputs, &keystore, &txToConst, &vScriptPubKeys, nHashType, &vScriptSigs, &vSigned, _1, _2));
+
+    bool fAllSigned = true;
+    for (unsigned int i = 0; i < vScriptPubKeys.size(); i++)
+    {
+        if (vScriptPubKeys[i].empty())
+            continue;
+        txTo.vin[i].scriptSig.swap(vScriptSigs[i]);
+        if (!vSigned[i])
+            fAllSigned = false;
+    }
+    return fAllSigned;
+}
+
 static CScript PushAll(const vector<valtype>& values)
 {
     CScript result;
@@ -15,6 +15,9 @@ class CTransaction;
 
 struct CMutableTransaction;
 
+//! Maximum number of threads signing the inputs of a transaction
+static const int MAX_SIGN_THREADS = 8;
+
 /** Virtual base class for signature creators. */
 class BaseSignatureCreator {
 protected:
@@ -58,6 +61,15 @@ bool ProduceSignature(const BaseSignatureCreator& creator, const CScript& script
 bool SignSignature(const CKeyStore& keystore, const CScript& fromPubKey, CMutableTransaction& txTo, unsigned int nIn, int nHashType=SIGHASH_ALL);
 bool SignSignature(const CKeyStore& keystore, const CTransaction& txFrom, CMutableTransaction& txTo, unsigned int nIn, int nHashType=SIGHASH_ALL);
 
+/**
+ * Produce the script signatures of the inputs of a transaction on several
+ * threads. vScriptPubKeys[i] is the output spent by input i; inputs for which
+ * it is empty are left alone. The transaction is copied once for all inputs,
+ * as signature hashes do not cover the scriptSigs of other inputs.
+ * Returns whether all the other inputs were signed.
+ */ // ߳Ϊ׵ȫǩ
+bool SignTransaction(const CKeyStore& keystore, CMutableTransaction& txTo, const std::vector<CScript>& vScriptPubKeys, int nHashType=SIGHASH_ALL);
+
 /** Combine two script signatures using a generic signature checker, intelligently, possibly with OP_0 placeholders. */ // ܵʹͨǩϲ 2 űǩʹ OP_0 ռλ
 CScript CombineSignatures(const CScript& scriptPubKey, const BaseSignatureChecker& checker, const CScript& scriptSig1, const CScript& scriptSig2);
 
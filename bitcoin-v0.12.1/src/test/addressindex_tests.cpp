@@ -0,0 +1,156 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chainparams.h"
+#include "consensus/validation.h"
+#include "hash.h"
+#include "main.h"
+#include "script/interpreter.h"
+#include "txdb.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addressindex_tests)
+
+static uint160 ScriptHash(const CScript& script)
+{
+    return Hash160(script.begin(), script.end());
+}
+
+BOOST_AUTO_TEST_CASE(addressindex_key_order)
+{
+    // Entries of a script sort by height, then by position in the block
+    uint160 hashScript = ScriptHash(CScript() << OP_TRUE);
+    CDataStream ss1(SER_DISK, CLIENT_VERSION), ss2(SER_DISK, CLIENT_VERSION), ss3(SER_DISK, CLIENT_VERSION);
+    ss1 << CAddressHistoryKey(hashScript, 255, 7, uint256S("0xff"), 3, true);
+    ss2 << CAddressHistoryKey(hashScript, 256, 0, uint256S("0x01"), 0, false);
+    ss3 << CAddressHistoryKey(hashScript, 256, 1, uint256S("0x01"), 0, false);
+    BOOST_CHECK_EQUAL(ss1.size(), CAddressHistoryKey().GetSerializeSize(SER_DISK, CLIENT_VERSION));
+    BOOST_CHECK(ss1.str() < ss2.str());
+    BOOST_CHECK(ss2.str() < ss3.str());
+
+    CAddressHistoryKey key;
+    ss1 >> key;
+    BOOST_CHECK(key.hashScript == hashScript);
+    BOOST_CHECK_EQUAL(key.nHeight, 255U);
+    BOOST_CHECK_EQUAL(key.nTxPos, 7U);
+    BOOST_CHECK(key.txid == uint256S("0xff"));
+    BOOST_CHECK_EQUAL(key.nIndex, 3U);
+    BOOST_CHECK(key.fSpending);
+}
+
+BOOST_FIXTURE_TEST_CASE(addressindex_connect_disconnect, TestChain100Setup)
+{
+    fAddressIndex = true;
+    paddressindexdb = new CAddressIndexDB(1 << 20, true);
+
+    // An index that has not indexed anything yet reads as empty
+    uint256 hashBest = uint256S("0x01");
+    std::vector<CAddressUnspentEntry> vEmpty;
+    BOOST_CHECK(paddressindexdb->ReadAddressUnspent(uint160(), 0, 10, vEmpty, hashBest));
+    BOOST_CHECK(hashBest.IsNull());
+    BOOST_CHECK(vEmpty.empty());
+
+    // Build the index for the blocks connected so far
+    ThreadAddressIndex();
+    BOOST_CHECK(paddressindexdb->ReadBestBlock(hashBest));
+    BOOST_CHECK(hashBest == chainActive.Tip()->GetBlockHash());
+
+    CScript scriptCoinbase = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    uint160 hashCoinbase = ScriptHash(scriptCoinbase);
+    CAmount nBalance, nReceived;
+    size_t nUnspent;
+    BOOST_CHECK(paddressindexdb->ReadAddressBalance(hashCoinbase, nBalance, nReceived, nUnspent, hashBest));
+    BOOST_CHECK_EQUAL(nUnspent, coinbaseTxns.size());
+    BOOST_CHECK_EQUAL(nBalance, (CAmount)coinbaseTxns.size() * coinbaseTxns[0].vout[0].nValue);
+    BOOST_CHECK_EQUAL(nReceived, nBalance);
+
+    // Pages come out in chain order
+    std::vector<CAddressHistoryEntry> vHistory;
+    BOOST_CHECK(paddressindexdb->ReadAddressHistory(hashCoinbase, 95, 10, vHistory, hashBest));
+    BOOST_CHECK_EQUAL(vHistory.size(), 5U);
+    for (unsigned int i = 0; i < vHistory.size(); i++) {
+        BOOST_CHECK_EQUAL(vHistory[i].first.nHeight, 96 + i);
+        BOOST_CHECK(vHistory[i].first.txid == coinbaseTxns[95 + i].GetHash());
+        BOOST_CHECK(!vHistory[i].first.fSpending);
+        BOOST_CHECK(vHistory[i].second.fCoinBase);
+    }
+
+    // A block spending the first coinbase is added to the index as it is connected
+    CScript scriptOther = CScript() << OP_TRUE;
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = COutPoint(coinbaseTxns[0].GetHash(), 0);
+    spend.vout.push_back(CTxOut(coinbaseTxns[0].vout[0].nValue - 1000, scriptOther));
+    std::vector<unsigned char> vchSig;
+    uint256 hash = SignatureHash(scriptCoinbase, spend, 0, SIGHASH_ALL);
+    BOOST_CHECK(coinbaseKey.Sign(hash, vchSig));
+    vchSig.push_back((unsigned char)SIGHASH_ALL);
+    spend.vin[0].scriptSig << vchSig;
+    std::vector<CMutableTransaction> txns;
+    txns.push_back(spend);
+    CBlock block = CreateAndProcessBlock(txns, scriptCoinbase);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == block.GetHash());
+    BOOST_CHECK(paddressindexdb->ReadBestBlock(hashBest));
+    BOOST_CHECK(hashBest == block.GetHash());
+
+    BOOST_CHECK(paddressindexdb->ReadAddressHistory(hashCoinbase, 100, 10, vHistory, hashBest));
+    BOOST_CHECK_EQUAL(vHistory.size(), 2U);
+    BOOST_CHECK(vHistory[0].first.txid == block.vtx[0].GetHash()); // the new coinbase comes first in the block
+    BOOST_CHECK(!vHistory[0].first.fSpending);
+    BOOST_CHECK(vHistory[1].first.txid == spend.GetHash());
+    BOOST_CHECK(vHistory[1].first.fSpending);
+    BOOST_CHECK_EQUAL(vHistory[1].second.nHeight, 1);
+    BOOST_CHECK_EQUAL(vHistory[1].second.nValue, coinbaseTxns[0].vout[0].nValue);
+    BOOST_CHECK(vHistory[1].second.fCoinBase);
+
+    CAmount nBalanceAfter, nReceivedAfter;
+    BOOST_CHECK(paddressindexdb->ReadAddressBalance(hashCoinbase, nBalanceAfter, nReceivedAfter, nUnspent, hashBest));
+    BOOST_CHECK_EQUAL(nUnspent, coinbaseTxns.size());
+    BOOST_CHECK_EQUAL(nBalanceAfter, nBalance - coinbaseTxns[0].vout[0].nValue + block.vtx[0].vout[0].nValue);
+    BOOST_CHECK_EQUAL(nReceivedAfter, nReceived + block.vtx[0].vout[0].nValue);
+
+    std::vector<CAddressUnspentEntry> vUnspent;
+    BOOST_CHECK(paddressindexdb->ReadAddressUnspent(ScriptHash(scriptOther), 0, 10, vUnspent, hashBest));
+    BOOST_CHECK_EQUAL(vUnspent.size(), 1U);
+    BOOST_CHECK(vUnspent[0].first.txid == spend.GetHash());
+    BOOST_CHECK_EQUAL(vUnspent[0].second.nValue, spend.vout[0].nValue);
+    BOOST_CHECK_EQUAL(vUnspent[0].second.nHeight, 101);
+
+    // Disconnecting the block restores the previous state
+    {
+        LOCK(cs_main);
+        CValidationState state;
+        BOOST_CHECK(InvalidateBlock(state, Params().GetConsensus(), chainActive.Tip()));
+    }
+    BOOST_CHECK(paddressindexdb->ReadBestBlock(hashBest));
+    BOOST_CHECK(hashBest == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK(paddressindexdb->ReadAddressUnspent(ScriptHash(scriptOther), 0, 10, vUnspent, hashBest));
+    BOOST_CHECK(vUnspent.empty());
+    BOOST_CHECK(paddressindexdb->ReadAddressBalance(hashCoinbase, nBalanceAfter, nReceivedAfter, nUnspent, hashBest));
+    BOOST_CHECK_EQUAL(nBalanceAfter, nBalance);
+    BOOST_CHECK_EQUAL(nReceivedAfter, nReceived);
+    BOOST_CHECK_EQUAL(nUnspent, coinbaseTxns.size());
+    BOOST_CHECK(paddressindexdb->ReadAddressHistory(hashCoinbase, 0, MAX_ADDRESS_QUERY_COUNT, vHistory, hashBest));
+    BOOST_CHECK_EQUAL(vHistory.size(), coinbaseTxns.size());
+    // The spent coinbase is unspent again, with the height and coinbase flag recorded when it was spent
+    BOOST_CHECK(paddressindexdb->ReadAddressUnspent(hashCoinbase, 0, MAX_ADDRESS_QUERY_COUNT, vUnspent, hashBest));
+    bool fRestored = false;
+    for (unsigned int i = 0; i < vUnspent.size(); i++) {
+        if (vUnspent[i].first.txid != coinbaseTxns[0].GetHash())
+            continue;
+        fRestored = true;
+        BOOST_CHECK_EQUAL(vUnspent[i].second.nHeight, 1);
+        BOOST_CHECK(vUnspent[i].second.fCoinBase);
+    }
+    BOOST_CHECK(fRestored);
+
+    delete paddressindexdb;
+    paddressindexdb = NULL;
+    fAddressIndex = false;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,231 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilter.h"
+#include "core_io.h"
+#include "primitives/block.h"
+#include "script/script.h"
+#include "txdb.h"
+#include "undo.h"
+
+#include "test/data/blockfilters.json.h"
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <univalue.h>
+
+extern UniValue read_json(const std::string& jsondata);
+
+BOOST_FIXTURE_TEST_SUITE(blockfilter_tests, BasicTestingSetup)
+
+BOOST_AUTO_TEST_CASE(gcsfilter_test)
+{
+    GCSFilter::ElementSet included_elements, excluded_elements;
+    for (int i = 0; i < 100; ++i) {
+        GCSFilter::Element element1(32, i);
+        included_elements.insert(element1);
+
+        GCSFilter::Element element2(32, i + 100);
+        excluded_elements.insert(element2);
+    }
+
+    GCSFilter filter(0, 0, 10, 1 << 10, included_elements);
+    BOOST_CHECK_EQUAL(filter.GetN(), 100U);
+    BOOST_FOREACH(const GCSFilter::Element& element, included_elements) {
+        BOOST_CHECK(filter.Match(element));
+
+        GCSFilter::ElementSet single;
+        single.insert(element);
+        BOOST_CHECK(filter.MatchAny(single));
+    }
+    BOOST_CHECK(filter.MatchAny(included_elements));
+
+    // A union with one included element still matches
+    GCSFilter::ElementSet mixed(excluded_elements);
+    mixed.insert(*included_elements.begin());
+    BOOST_CHECK(filter.MatchAny(mixed));
+
+    // Decoding the encoding gives an equivalent filter
+    GCSFilter filter2(0, 0, 10, 1 << 10, filter.GetEncoded());
+    BOOST_CHECK_EQUAL(filter2.GetN(), filter.GetN());
+    BOOST_CHECK(filter2.GetEncoded() == filter.GetEncoded());
+    BOOST_FOREACH(const GCSFilter::Element& element, included_elements)
+        BOOST_CHECK(filter2.Match(element));
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_default_constructor)
+{
+    GCSFilter filter;
+    BOOST_CHECK_EQUAL(filter.GetN(), 0U);
+    BOOST_CHECK_EQUAL(filter.GetEncoded().size(), 1U);
+    BOOST_CHECK(!filter.Match(GCSFilter::Element(32, 0)));
+
+    GCSFilter empty(0, 0, BASIC_FILTER_P, BASIC_FILTER_M, GCSFilter::ElementSet());
+    BOOST_CHECK(empty.GetEncoded() == filter.GetEncoded());
+}
+
+BOOST_AUTO_TEST_CASE(gcsfilter_malformed)
+{
+    GCSFilter::ElementSet elements;
+    for (int i = 0; i < 10; ++i)
+        elements.insert(GCSFilter::Element(20, i));
+    GCSFilter filter(1, 2, BASIC_FILTER_P, BASIC_FILTER_M, elements);
+
+    // Truncated data
+    std::vector<unsigned char> vTruncated(filter.GetEncoded().begin(), filter.GetEncoded().end() - 1);
+    BOOST_CHECK_THROW(GCSFilter(1, 2, BASIC_FILTER_P, BASIC_FILTER_M, vTruncated), std::ios_base::failure);
+
+    // Trailing data
+    std::vector<unsigned char> vExcess(filter.GetEncoded());
+    vExcess.push_back(0);
+    BOOST_CHECK_THROW(GCSFilter(1, 2, BASIC_FILTER_P, BASIC_FILTER_M, vExcess), std::ios_base::failure);
+
+    // Element count claims more than is encoded
+    std::vector<unsigned char> vCount(filter.GetEncoded());
+    vCount[0] = 11;
+    BOOST_CHECK_THROW(GCSFilter(1, 2, BASIC_FILTER_P, BASIC_FILTER_M, vCount), std::ios_base::failure);
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_basic_test)
+{
+    CScript included_scripts[5], excluded_scripts[3];
+
+    // First two are outputs on a single transaction.
+    included_scripts[0] << std::vector<unsigned char>(0, 65) << OP_CHECKSIG;
+    included_scripts[1] << OP_DUP << OP_HASH160 << std::vector<unsigned char>(1, 20) << OP_EQUALVERIFY << OP_CHECKSIG;
+
+    // Third is an output on a second transaction.
+    included_scripts[2] << OP_1 << std::vector<unsigned char>(2, 33) << OP_1 << OP_CHECKMULTISIG;
+
+    // Last two are spent by a single transaction.
+    included_scripts[3] << OP_0 << std::vector<unsigned char>(3, 32);
+    included_scripts[4] << OP_4 << OP_ADD << OP_8 << OP_EQUAL;
+
+    // OP_RETURN output.
+    excluded_scripts[0] << OP_RETURN << std::vector<unsigned char>(4, 40);
+
+    // Script spent by a transaction of the block, but not part of its undo data.
+    excluded_scripts[1] << OP_5 << OP_EQUAL;
+
+    // Unrelated script.
+    excluded_scripts[2] << OP_6 << OP_EQUAL;
+
+    CMutableTransaction tx_1;
+    tx_1.vout.push_back(CTxOut(100, included_scripts[0]));
+    tx_1.vout.push_back(CTxOut(200, included_scripts[1]));
+
+    CMutableTransaction tx_2;
+    tx_2.vout.push_back(CTxOut(300, included_scripts[2]));
+    tx_2.vout.push_back(CTxOut(0, excluded_scripts[0]));
+    tx_2.vout.push_back(CTxOut(400, CScript())); // Empty script is not included
+
+    CBlock block;
+    block.vtx.push_back(tx_1);
+    block.vtx.push_back(tx_2);
+
+    CBlockUndo block_undo;
+    block_undo.vtxundo.push_back(CTxUndo());
+    block_undo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(500, included_scripts[3])));
+    block_undo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(600, included_scripts[4])));
+    block_undo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(700, CScript()))); // Empty script is not included
+
+    CBlockFilter block_filter(BLOCK_FILTER_BASIC, block, block_undo);
+    const GCSFilter& filter = block_filter.GetFilter();
+
+    BOOST_CHECK_EQUAL(filter.GetN(), 5U);
+    for (int i = 0; i < 5; ++i)
+        BOOST_CHECK(filter.Match(GCSFilter::Element(included_scripts[i].begin(), included_scripts[i].end())));
+    for (int i = 0; i < 3; ++i)
+        BOOST_CHECK(!filter.Match(GCSFilter::Element(excluded_scripts[i].begin(), excluded_scripts[i].end())));
+
+    // Test serialization/unserialization.
+    CBlockFilter block_filter2(BLOCK_FILTER_BASIC, block.GetHash(), block_filter.GetEncodedFilter());
+    BOOST_CHECK_EQUAL(block_filter2.GetFilterType(), block_filter.GetFilterType());
+    BOOST_CHECK(block_filter2.GetBlockHash() == block_filter.GetBlockHash());
+    BOOST_CHECK(block_filter2.GetEncodedFilter() == block_filter.GetEncodedFilter());
+    BOOST_CHECK(block_filter2.GetHash() == block_filter.GetHash());
+
+    // The filter keys depend on the block hash.
+    CBlock block2(block);
+    block2.nNonce++;
+    CBlockFilter block_filter3(BLOCK_FILTER_BASIC, block2, block_undo);
+    BOOST_CHECK(block_filter3.GetEncodedFilter() != block_filter.GetEncodedFilter());
+
+    // Filter headers chain.
+    uint256 header1 = block_filter.ComputeHeader(uint256());
+    uint256 header2 = block_filter3.ComputeHeader(header1);
+    BOOST_CHECK(header1 == ComputeBlockFilterHeader(block_filter.GetHash(), uint256()));
+    BOOST_CHECK(header2 == ComputeBlockFilterHeader(block_filter3.GetHash(), header1));
+    BOOST_CHECK(header2 != block_filter3.ComputeHeader(uint256()));
+}
+
+BOOST_AUTO_TEST_CASE(blockfilters_json_test)
+{
+    // Test vectors from BIP 158, followed by blocks built on them that spend inputs
+    UniValue tests = read_json(std::string(json_tests::blockfilters, json_tests::blockfilters + sizeof(json_tests::blockfilters)));
+    for (unsigned int i = 0; i < tests.size(); i++) {
+        const UniValue& test = tests[i];
+        std::string strTest = test.write();
+        if (test.size() == 1)
+            continue; // Comment
+        if (test.size() != 8) {
+            BOOST_ERROR("Bad test: " << strTest);
+            continue;
+        }
+
+        unsigned int pos = 0;
+        /*int block_height =*/ test[pos++].get_int();
+        uint256 block_hash = uint256S(test[pos++].get_str());
+        CBlock block;
+        BOOST_REQUIRE_MESSAGE(DecodeHexBlk(block, test[pos++].get_str()), strTest);
+        BOOST_CHECK(block.GetHash() == block_hash);
+
+        // The previous output scripts are spent by the transactions after the coinbase
+        CBlockUndo block_undo;
+        const UniValue& prev_scripts = test[pos++].get_array();
+        if (block.vtx.size() > 1)
+            block_undo.vtxundo.push_back(CTxUndo());
+        for (unsigned int j = 0; j < prev_scripts.size(); j++) {
+            std::vector<unsigned char> vScript = ParseHex(prev_scripts[j].get_str());
+            block_undo.vtxundo.back().vprevout.push_back(CTxInUndo(CTxOut(0, CScript(vScript.begin(), vScript.end()))));
+        }
+
+        uint256 prev_filter_header = uint256S(test[pos++].get_str());
+        std::vector<unsigned char> filter_basic = ParseHex(test[pos++].get_str());
+        uint256 filter_header_basic = uint256S(test[pos++].get_str());
+
+        CBlockFilter computed_filter_basic(BLOCK_FILTER_BASIC, block, block_undo);
+        BOOST_CHECK_MESSAGE(computed_filter_basic.GetEncodedFilter() == filter_basic, strTest);
+        BOOST_CHECK_MESSAGE(computed_filter_basic.ComputeHeader(prev_filter_header) == filter_header_basic, strTest);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(blockfilter_db_test)
+{
+    CBlockFilterDB db(1 << 20, true);
+
+    GCSFilter::ElementSet elements;
+    elements.insert(GCSFilter::Element(20, 1));
+    GCSFilter filter(0, 0, BASIC_FILTER_P, BASIC_FILTER_M, elements);
+
+    uint256 hashBlock = uint256S("0x01");
+    uint256 hashFilter = uint256S("0x02");
+    uint256 hashHeader = uint256S("0x03");
+    BOOST_CHECK(!db.HaveFilter(hashBlock));
+    BOOST_CHECK(db.WriteFilter(hashBlock, filter.GetEncoded(), hashFilter, hashHeader));
+    BOOST_CHECK(db.HaveFilter(hashBlock));
+
+    std::vector<unsigned char> vEncoded;
+    uint256 hashFilterRead, hashHeaderRead;
+    BOOST_CHECK(db.ReadFilter(hashBlock, vEncoded));
+    BOOST_CHECK(vEncoded == filter.GetEncoded());
+    BOOST_CHECK(db.ReadFilterHeader(hashBlock, hashFilterRead, hashHeaderRead));
+    BOOST_CHECK(hashFilterRead == hashFilter);
+    BOOST_CHECK(hashHeaderRead == hashHeader);
+
+    BOOST_CHECK(!db.ReadFilter(uint256S("0x04"), vEncoded));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,62 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "main.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(blockindex_arena, BasicTestingSetup)
+{
+    CBlockIndexArena arena;
+    BOOST_CHECK_EQUAL(arena.Size(), 0U);
+
+    // Entries are constructed like heap-allocated ones and keep their address across chunks
+    CBlockHeader header;
+    header.nTime = 1234;
+    std::vector<CBlockIndex*> vIndex;
+    for (size_t i = 0; i < 2 * BLOCK_INDEX_ARENA_CHUNK_SIZE + 10; i++) {
+        CBlockIndex* pindex = i % 2 ? arena.New(header) : arena.New();
+        pindex->nHeight = i;
+        vIndex.push_back(pindex);
+    }
+    BOOST_CHECK_EQUAL(arena.Size(), vIndex.size());
+    for (size_t i = 0; i < vIndex.size(); i++) {
+        BOOST_CHECK_EQUAL(vIndex[i]->nHeight, (int)i);
+        BOOST_CHECK_EQUAL(vIndex[i]->nTime, i % 2 ? 1234U : 0U);
+        BOOST_CHECK(vIndex[i]->pprev == NULL);
+    }
+
+    arena.Clear();
+    BOOST_CHECK_EQUAL(arena.Size(), 0U);
+    BOOST_CHECK_EQUAL(arena.New()->nHeight, 0);
+    BOOST_CHECK_EQUAL(arena.Size(), 1U);
+}
+
+BOOST_FIXTURE_TEST_CASE(blockindex_reload, TestChain100Setup)
+{
+    // Unloading and loading the block index again restores the chain
+    FlushStateToDisk();
+    uint256 hashTip = chainActive.Tip()->GetBlockHash();
+    arith_uint256 nChainWork = chainActive.Tip()->nChainWork;
+    size_t nEntries = mapBlockIndex.size();
+    UnloadBlockIndex();
+    BOOST_CHECK(mapBlockIndex.empty());
+
+    BOOST_CHECK(LoadBlockIndex());
+    BOOST_CHECK_EQUAL(mapBlockIndex.size(), nEntries);
+    BOOST_CHECK(chainActive.Tip()->GetBlockHash() == hashTip);
+    BOOST_CHECK(chainActive.Tip()->nChainWork == nChainWork);
+    BOOST_CHECK_EQUAL(chainActive.Height(), 100);
+    for (int nHeight = 1; nHeight <= chainActive.Height(); nHeight++) {
+        BOOST_CHECK(chainActive[nHeight]->pprev == chainActive[nHeight - 1]);
+        BOOST_CHECK(chainActive[nHeight]->nChainTx == chainActive[nHeight - 1]->nChainTx + 1);
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,92 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockwriter.h"
+#include "chainparams.h"
+#include "main.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockwriter_tests)
+
+// Read nSize bytes at pos, from the queue if they are still there
+static std::string ReadData(CBlockFileWriter& writer, bool fUndo, const CDiskBlockPos& pos, size_t nSize)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    if (!writer.ReadQueued(fUndo, pos, ss)) {
+        FILE* file = fUndo ? OpenUndoFile(pos, true) : OpenBlockFile(pos, true);
+        if (!file)
+            return "";
+        std::vector<char> vData(nSize);
+        size_t nRead = fread(&vData[0], 1, nSize, file);
+        fclose(file);
+        return std::string(vData.begin(), vData.begin() + nRead);
+    }
+    return std::string(ss.begin(), ss.begin() + std::min(nSize, ss.size()));
+}
+
+static void QueueString(CBlockFileWriter& writer, bool fUndo, const CDiskBlockPos& pos, const std::string& str)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss.write(str.data(), str.size());
+    BOOST_CHECK(writer.QueueWrite(fUndo, pos, ss));
+}
+
+BOOST_FIXTURE_TEST_CASE(blockwriter_queue, TestingSetup)
+{
+    CBlockFileWriter writer;
+    boost::thread thread(&CBlockFileWriter::ThreadWrite, &writer);
+
+    // Writes to two files, out of order and with a pre-allocation in between
+    QueueString(writer, false, CDiskBlockPos(7, 6), "world");
+    writer.QueueAllocate(false, CDiskBlockPos(7, 11), 1024);
+    QueueString(writer, true, CDiskBlockPos(7, 0), "undo");
+    QueueString(writer, false, CDiskBlockPos(7, 0), "hello ");
+
+    // Queued or not, the data reads back, also from the middle of a write
+    BOOST_CHECK_EQUAL(ReadData(writer, false, CDiskBlockPos(7, 6), 5), "world");
+    BOOST_CHECK_EQUAL(ReadData(writer, false, CDiskBlockPos(7, 2), 4), "llo ");
+    BOOST_CHECK_EQUAL(ReadData(writer, true, CDiskBlockPos(7, 0), 4), "undo");
+
+    BOOST_CHECK(writer.Flush());
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    BOOST_CHECK(!writer.ReadQueued(false, CDiskBlockPos(7, 0), ss));
+    BOOST_CHECK_EQUAL(ReadData(writer, false, CDiskBlockPos(7, 0), 11), "hello world");
+    BOOST_CHECK_EQUAL(ReadData(writer, true, CDiskBlockPos(7, 0), 4), "undo");
+
+    // Once the thread is stopped, callers write by themselves
+    thread.interrupt();
+    thread.join();
+    QueueString(writer, false, CDiskBlockPos(7, 11), "!");
+    BOOST_CHECK(!writer.ReadQueued(false, CDiskBlockPos(7, 11), ss));
+    BOOST_CHECK(writer.Flush());
+    BOOST_CHECK_EQUAL(ReadData(writer, false, CDiskBlockPos(7, 0), 12), "hello world!");
+}
+
+BOOST_FIXTURE_TEST_CASE(blockwriter_blocks, TestChain100Setup)
+{
+    // Blocks connected while the writer runs can be read at once and are on disk after a flush
+    boost::thread thread(&CBlockFileWriter::ThreadWrite, &blockFileWriter);
+    CScript scriptPubKey = CScript() << ToByteVector(coinbaseKey.GetPubKey()) << OP_CHECKSIG;
+    for (int i = 0; i < 5; i++) {
+        CBlock block = CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptPubKey);
+        CBlock blockRead;
+        BOOST_CHECK(ReadBlockFromDisk(blockRead, chainActive.Tip(), Params().GetConsensus()));
+        BOOST_CHECK(blockRead.GetHash() == block.GetHash());
+    }
+    BOOST_CHECK(blockFileWriter.Flush());
+    thread.interrupt();
+    thread.join();
+
+    CBlock block;
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    BOOST_CHECK(!blockFileWriter.ReadQueued(false, chainActive.Tip()->GetBlockPos(), ss));
+    BOOST_CHECK(ReadBlockFromDisk(block, chainActive.Tip(), Params().GetConsensus()));
+    BOOST_CHECK(block.GetHash() == chainActive.Tip()->GetBlockHash());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -259,6 +259,7 @@ BOOST_AUTO_TEST_CASE(merkle_block_2)
     // It also matches the fourth transaction, which spends to the pubkey again
     filter.insert(ParseHex("044a656f065871a353f216ca26cef8dde2f03e8c16202d2e8ad769f02032cb86a5eb5e56842e92e19141d60a01928f8dd2c875a390f67c1f6c94cfc617c0ea45af"));
 
+    CBloomFilter filterShared(filter);
     merkleBlock = CMerkleBlock(block, filter);
     BOOST_CHECK(merkleBlock.header.GetHash() == block.GetHash());
 
@@ -279,6 +280,17 @@ BOOST_AUTO_TEST_CASE(merkle_block_2)
     BOOST_CHECK(vMatched.size() == merkleBlock.vMatchedTxn.size());
     for (unsigned int i = 0; i < vMatched.size(); i++)
         BOOST_CHECK(vMatched[i] == merkleBlock.vMatchedTxn[i].second);
+
+    // Keys extracted up front give the same matches and the same filter updates
+    vector<CBloomTxKeys> vTxKeys;
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+        vTxKeys.push_back(CBloomTxKeys(tx));
+    CMerkleBlock merkleBlockShared(block, vTxKeys, filterShared);
+    BOOST_CHECK(merkleBlockShared.vMatchedTxn == merkleBlock.vMatchedTxn);
+    CDataStream ssFilter(SER_NETWORK, PROTOCOL_VERSION), ssFilterShared(SER_NETWORK, PROTOCOL_VERSION);
+    ssFilter << filter;
+    ssFilterShared << filterShared;
+    BOOST_CHECK(ssFilter.str() == ssFilterShared.str());
 }
 
 BOOST_AUTO_TEST_CASE(merkle_block_2_with_update_none)
@@ -332,6 +344,54 @@ BOOST_AUTO_TEST_CASE(merkle_block_2_with_update_none)
         BOOST_CHECK(vMatched[i] == merkleBlock.vMatchedTxn[i].second);
 }
 
+BOOST_AUTO_TEST_CASE(bloom_match_tx_and_keys)
+{
+    // The block of merkle_block_2: its transactions spend each other's pay-to-pubkey outputs
+    CBlock block;
+    CDataStream stream(ParseHex("0100000075616236cc2126035fadb38deb65b9102cc2c41c09cdf29fc051906800000000fe7d5e12ef0ff901f6050211249919b1c0653771832b3a80c66cea42847f0ae1d4d26e49ffff001d00f0a4410401000000010000000000000000000000000000000000000000000000000000000000000000ffffffff0804ffff001d029105ffffffff0100f2052a010000004341046d8709a041d34357697dfcb30a9d05900a6294078012bf3bb09c6f9b525f1d16d5503d7905db1ada9501446ea00728668fc5719aa80be2fdfc8a858a4dbdd4fbac00000000010000000255605dc6f5c3dc148b6da58442b0b2cd422be385eab2ebea4119ee9c268d28350000000049483045022100aa46504baa86df8a33b1192b1b9367b4d729dc41e389f2c04f3e5c7f0559aae702205e82253a54bf5c4f65b7428551554b2045167d6d206dfe6a2e198127d3f7df1501ffffffff55605dc6f5c3dc148b6da58442b0b2cd422be385eab2ebea4119ee9c268d2835010000004847304402202329484c35fa9d6bb32a55a70c0982f606ce0e3634b69006138683bcd12cbb6602200c28feb1e2555c3210f1dddb299738b4ff8bbe9667b68cb8764b5ac17b7adf0001ffffffff0200e1f505000000004341046a0765b5865641ce08dd39690aade26dfbf5511430ca428a3089261361cef170e3929a68aee3d8d4848b0c5111b0a37b82b86ad559fd2a745b44d8e8d9dfdc0cac00180d8f000000004341044a656f065871a353f216ca26cef8dde2f03e8c16202d2e8ad769f02032cb86a5eb5e56842e92e19141d60a01928f8dd2c875a390f67c1f6c94cfc617c0ea45afac0000000001000000025f9a06d3acdceb56be1bfeaa3e8a25e62d182fa24fefe899d1c17f1dad4c2028000000004847304402205d6058484157235b06028c30736c15613a28bdb768ee628094ca8b0030d4d6eb0220328789c9a2ec27ddaec0ad5ef58efded42e6ea17c2e1ce838f3d6913f5e95db601ffffffff5f9a06d3acdceb56be1bfeaa3e8a25e62d182fa24fefe899d1c17f1dad4c2028010000004a493046022100c45af050d3cea806cedd0ab22520c53ebe63b987b8954146cdca42487b84bdd6022100b9b027716a6b59e640da50a864d6dd8a0ef24c76ce62391fa3eabaf4d2886d2d01ffffffff0200e1f505000000004341046a0765b5865641ce08dd39690aade26dfbf5511430ca428a3089261361cef170e3929a68aee3d8d4848b0c5111b0a37b82b86ad559fd2a745b44d8e8d9dfdc0cac00180d8f000000004341046a0765b5865641ce08dd39690aade26dfbf5511430ca428a3089261361cef170e3929a68aee3d8d4848b0c5111b0a37b82b86ad559fd2a745b44d8e8d9dfdc0cac000000000100000002e2274e5fea1bf29d963914bd301aa63b64daaf8a3e88f119b5046ca5738a0f6b0000000048473044022016e7a727a061ea2254a6c358376aaa617ac537eb836c77d646ebda4c748aac8b0220192ce28bf9f2c06a6467e6531e27648d2b3e2e2bae85159c9242939840295ba501ffffffffe2274e5fea1bf29d963914bd301aa63b64daaf8a3e88f119b5046ca5738a0f6b010000004a493046022100b7a1a755588d4190118936e15cd217d133b0e4a53c3c15924010d5648d8925c9022100aaef031874db2114f2d869ac2de4ae53908fbfea5b2b1862e181626bb9005c9f01ffffffff0200e1f505000000004341044a656f065871a353f216ca26cef8dde2f03e8c16202d2e8ad769f02032cb86a5eb5e56842e92e19141d60a01928f8dd2c875a390f67c1f6c94cfc617c0ea45afac00180d8f000000004341046a0765b5865641ce08dd39690aade26dfbf5511430ca428a3089261361cef170e3929a68aee3d8d4848b0c5111b0a37b82b86ad559fd2a745b44d8e8d9dfdc0cac00000000"), SER_NETWORK, PROTOCOL_VERSION);
+    stream >> block;
+    BOOST_CHECK(block.vtx.size() == 4);
+
+    CScript::const_iterator pc = block.vtx[2].vin[0].scriptSig.begin();
+    opcodetype opcode;
+    vector<unsigned char> vSignature;
+    BOOST_CHECK(block.vtx[2].vin[0].scriptSig.GetOp(pc, opcode, vSignature));
+
+    // Nothing, the hash of the first transaction, a pubkey of a matched output, a prevout, a scriptSig push
+    vector<vector<unsigned char> > vElements;
+    vElements.push_back(vector<unsigned char>());
+    uint256 hashFirst = uint256S("0xe980fe9f792d014e73b95203dc1335c5f9ce19ac537a419e6df5b47aecb93b70");
+    vElements.push_back(vector<unsigned char>(hashFirst.begin(), hashFirst.end()));
+    vElements.push_back(ParseHex("044a656f065871a353f216ca26cef8dde2f03e8c16202d2e8ad769f02032cb86a5eb5e56842e92e19141d60a01928f8dd2c875a390f67c1f6c94cfc617c0ea45af"));
+    CDataStream ssPrevout(SER_NETWORK, PROTOCOL_VERSION);
+    ssPrevout << block.vtx[3].vin[0].prevout;
+    vElements.push_back(vector<unsigned char>(ssPrevout.begin(), ssPrevout.end()));
+    vElements.push_back(vSignature);
+
+    const unsigned char vFlags[] = {BLOOM_UPDATE_NONE, BLOOM_UPDATE_ALL, BLOOM_UPDATE_P2PUBKEY_ONLY};
+    int nMatches = 0;
+    for (unsigned int i = 0; i < sizeof(vFlags); i++) {
+        BOOST_FOREACH(const vector<unsigned char>& vElement, vElements) {
+            CBloomFilter filterTx(10, 0.000001, 0, vFlags[i]);
+            if (!vElement.empty())
+                filterTx.insert(vElement);
+            CBloomFilter filterKeys(filterTx);
+
+            // Both overloads give the same result and leave the same filter, transaction after transaction
+            BOOST_FOREACH(const CTransaction& tx, block.vtx) {
+                bool fMatch = filterTx.IsRelevantAndUpdate(tx);
+                BOOST_CHECK_EQUAL(fMatch, filterKeys.IsRelevantAndUpdate(CBloomTxKeys(tx)));
+                nMatches += fMatch;
+                CDataStream ssFilterTx(SER_NETWORK, PROTOCOL_VERSION), ssFilterKeys(SER_NETWORK, PROTOCOL_VERSION);
+                ssFilterTx << filterTx;
+                ssFilterKeys << filterKeys;
+                BOOST_CHECK(ssFilterTx.str() == ssFilterKeys.str());
+            }
+        }
+    }
+    BOOST_CHECK(nMatches > 0);
+}
+
 BOOST_AUTO_TEST_CASE(merkle_block_3_and_serialize)
 {
     // Random real block (000000000000dab0130bbcc991d3d7ae6b81aa6f50a798888dfe62337458dc45)
@@ -429,6 +489,7 @@ BOOST_AUTO_TEST_CASE(merkle_block_4_test_p2pubkey_only)
     // ...and the output address of the 4th transaction
     filter.insert(ParseHex("b6efd80d99179f4f4ff6f4dd0a007d018c385d21"));
 
+    CBloomFilter filterShared(filter);
     CMerkleBlock merkleBlock(block, filter);
     BOOST_CHECK(merkleBlock.header.GetHash() == block.GetHash());
 
@@ -436,6 +497,14 @@ BOOST_AUTO_TEST_CASE(merkle_block_4_test_p2pubkey_only)
     BOOST_CHECK(filter.contains(COutPoint(uint256S("0x147caa76786596590baa4e98f5d9f48b86c7765e489f7a6ff3360fe5c674360b"), 0)));
     // ... but not the 4th transaction's output (its not pay-2-pubkey)
     BOOST_CHECK(!filter.contains(COutPoint(uint256S("0x02981fa052f0481dbc5868f4fc2166035a10f27a03cfd2de67326471df5bc041"), 0)));
+
+    vector<CBloomTxKeys> vTxKeys;
+    BOOST_FOREACH(const CTransaction& tx, block.vtx)
+        vTxKeys.push_back(CBloomTxKeys(tx));
+    CMerkleBlock merkleBlockShared(block, vTxKeys, filterShared);
+    BOOST_CHECK(merkleBlockShared.vMatchedTxn == merkleBlock.vMatchedTxn);
+    BOOST_CHECK(filterShared.contains(COutPoint(uint256S("0x147caa76786596590baa4e98f5d9f48b86c7765e489f7a6ff3360fe5c674360b"), 0)));
+    BOOST_CHECK(!filterShared.contains(COutPoint(uint256S("0x02981fa052f0481dbc5868f4fc2166035a10f27a03cfd2de67326471df5bc041"), 0)));
 }
 
 BOOST_AUTO_TEST_CASE(merkle_block_4_test_update_none)
@@ -0,0 +1,82 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "chainsnapshot.h"
+
+#include "test/test_bitcoin.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(chainsnapshot_tests, BasicTestingSetup)
+
+static void CheckSnapshot(const CChainSnapshot& snapshot, const CChain& chain)
+{
+    BOOST_CHECK_EQUAL(snapshot.Height(), chain.Height());
+    BOOST_CHECK(snapshot.Tip() == chain.Tip());
+    BOOST_CHECK(snapshot.Genesis() == chain.Genesis());
+    for (int nHeight = -1; nHeight <= chain.Height() + 1; nHeight++)
+        BOOST_CHECK(snapshot[nHeight] == chain[nHeight]);
+}
+
+BOOST_AUTO_TEST_CASE(chainsnapshot_follows_chain)
+{
+    const int nMain = 3 * CHAIN_SNAPSHOT_CHUNK_SIZE + 10;
+    std::vector<CBlockIndex> vBlocksMain(nMain);
+    for (int i = 0; i < nMain; i++) {
+        vBlocksMain[i].nHeight = i;
+        vBlocksMain[i].pprev = i ? &vBlocksMain[i - 1] : NULL;
+    }
+
+    // A branch that splits off in the middle of the second chunk
+    const int nFork = CHAIN_SNAPSHOT_CHUNK_SIZE + 100;
+    std::vector<CBlockIndex> vBlocksSide(2 * CHAIN_SNAPSHOT_CHUNK_SIZE);
+    for (unsigned int i = 0; i < vBlocksSide.size(); i++) {
+        vBlocksSide[i].nHeight = nFork + 1 + i;
+        vBlocksSide[i].pprev = i ? &vBlocksSide[i - 1] : &vBlocksMain[nFork];
+    }
+
+    CChain chain;
+    CChainSnapshot empty;
+    CheckSnapshot(empty, chain);
+    BOOST_CHECK(empty.Tip() == NULL);
+    BOOST_CHECK(empty.BestHeader() == NULL);
+
+    // Grow the chain block by block around a chunk boundary
+    CChainSnapshot snapshot(&empty, chain, NULL);
+    for (int i = CHAIN_SNAPSHOT_CHUNK_SIZE - 3; i < CHAIN_SNAPSHOT_CHUNK_SIZE + 3; i++) {
+        chain.SetTip(&vBlocksMain[i]);
+        CChainSnapshot next(&snapshot, chain, &vBlocksMain.back());
+        CheckSnapshot(next, chain);
+        BOOST_CHECK(next.BestHeader() == &vBlocksMain.back());
+        snapshot = next;
+    }
+
+    chain.SetTip(&vBlocksMain.back());
+    CChainSnapshot snapshotMain(&snapshot, chain, NULL);
+    CheckSnapshot(snapshotMain, chain);
+    BOOST_CHECK(snapshotMain.Contains(&vBlocksMain[nFork + 1]));
+    BOOST_CHECK(snapshotMain.Next(&vBlocksMain[nFork]) == &vBlocksMain[nFork + 1]);
+    BOOST_CHECK(snapshotMain.Next(&vBlocksMain.back()) == NULL);
+
+    // Reorganize to the side branch; the earlier snapshot is unaffected
+    chain.SetTip(&vBlocksSide.back());
+    CChainSnapshot snapshotSide(&snapshotMain, chain, &vBlocksSide.back());
+    CheckSnapshot(snapshotSide, chain);
+    BOOST_CHECK(!snapshotSide.Contains(&vBlocksMain[nFork + 1]));
+    BOOST_CHECK(snapshotSide.Contains(&vBlocksMain[nFork]));
+    BOOST_CHECK(snapshotSide.Next(&vBlocksMain[nFork]) == &vBlocksSide[0]);
+    BOOST_CHECK(snapshotSide.Next(&vBlocksMain[nFork + 1]) == NULL);
+    BOOST_CHECK(snapshotMain[nFork + 1] == &vBlocksMain[nFork + 1]);
+    BOOST_CHECK_EQUAL(snapshotMain.Height(), nMain - 1);
+
+    // And back to a shorter chain
+    chain.SetTip(&vBlocksMain[5]);
+    CChainSnapshot snapshotShort(&snapshotSide, chain, NULL);
+    CheckSnapshot(snapshotShort, chain);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
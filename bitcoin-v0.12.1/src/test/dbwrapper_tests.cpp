@@ -9,6 +9,7 @@
 
 #include <boost/assign/std/vector.hpp> // for 'operator+=()'
 #include <boost/assert.hpp>
+#include <boost/foreach.hpp>
 #include <boost/test/unit_test.hpp>
                     
 using namespace std;
@@ -203,5 +204,44 @@ BOOST_AUTO_TEST_CASE(existing_data_reindex)
     BOOST_CHECK(odbw.Read(key, res3));
     BOOST_CHECK_EQUAL(res3.ToString(), in2.ToString());
 }
+
+// Databases apply their profile and report their statistics while open
+BOOST_AUTO_TEST_CASE(dbwrapper_profile_stats)
+{
+    path ph = temp_directory_path() / unique_path();
+    SetDBMaxOpenFilesLimit(100);
+    CDBWrapper* dbw = new CDBWrapper(ph, (1 << 20), true, false, false, DB_PROFILE_CHAINSTATE);
+    SetDBMaxOpenFilesLimit(0);
+
+    CDBBatch batch(&dbw->GetObfuscateKey());
+    for (char key = 'a'; key <= 'j'; key++)
+        batch.Write(key, GetRandHash());
+    BOOST_CHECK(dbw->WriteBatch(batch));
+    BOOST_CHECK(dbw->Write('k', GetRandHash()));
+
+    bool fFound = false;
+    std::vector<CDBStats> vStats = GetDBStats();
+    BOOST_FOREACH(const CDBStats& stats, vStats) {
+        if (stats.strPath != ph.string())
+            continue;
+        fFound = true;
+        BOOST_CHECK_EQUAL(stats.strName, "chainstate");
+        BOOST_CHECK_EQUAL(stats.nBlockCacheSize, (size_t)(1 << 20) * DB_PROFILE_CHAINSTATE.nBlockCachePercent / 100);
+        BOOST_CHECK_EQUAL(stats.nWriteBufferSize, (size_t)(1 << 20) * DB_PROFILE_CHAINSTATE.nWriteBufferPercent / 100);
+        BOOST_CHECK_EQUAL(stats.nMaxOpenFiles, 100);
+        BOOST_CHECK(!stats.fCompress);
+        BOOST_CHECK_EQUAL(stats.nWrites, 2U);
+        BOOST_CHECK_EQUAL(stats.nWriteBytes, batch.SizeEstimate() + 1 + 32);
+        BOOST_CHECK(stats.nMaxWriteMicros <= stats.nWriteMicros);
+        BOOST_CHECK_EQUAL(stats.vLevels.size(), 7U);
+    }
+    BOOST_CHECK(fFound);
+
+    // Closed databases are no longer reported
+    delete dbw;
+    vStats = GetDBStats();
+    BOOST_FOREACH(const CDBStats& stats, vStats)
+        BOOST_CHECK(stats.strPath != ph.string());
+}
  
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,119 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonstream.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <univalue.h>
+
+BOOST_FIXTURE_TEST_SUITE(jsonstream_tests, BasicTestingSetup)
+
+static void AppendChunk(std::vector<std::string>* pvChunks, const std::string& strChunk)
+{
+    pvChunks->push_back(strChunk);
+}
+
+static std::string Join(const std::vector<std::string>& vChunks)
+{
+    std::string str;
+    BOOST_FOREACH(const std::string& strChunk, vChunks)
+        str += strChunk;
+    return str;
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_matches_univalue)
+{
+    UniValue inner(UniValue::VOBJ);
+    inner.push_back(Pair("a \"quoted\" key", "value\n"));
+    inner.push_back(Pair("n", 42));
+    inner.push_back(Pair("empty", UniValue(UniValue::VARR)));
+
+    UniValue arr(UniValue::VARR);
+    arr.push_back(inner);
+    arr.push_back(NullUniValue);
+    arr.push_back(true);
+
+    UniValue expected(UniValue::VOBJ);
+    expected.push_back(Pair("first", arr));
+    expected.push_back(Pair("second", UniValue(UniValue::VOBJ)));
+    expected.push_back(Pair("third", 1.5));
+
+    std::vector<std::string> vChunks;
+    CJSONStreamWriter writer(boost::bind(&AppendChunk, &vChunks, _1));
+    writer.BeginObject();
+    writer.Key("first");
+    writer.BeginArray();
+    writer.BeginObject();
+    writer.KeyValue("a \"quoted\" key", "value\n");
+    writer.KeyValue("n", 42);
+    writer.Key("empty");
+    writer.BeginArray();
+    writer.EndArray();
+    writer.EndObject();
+    writer.Value(NullUniValue);
+    writer.Value(true);
+    writer.EndArray();
+    writer.Key("second");
+    writer.BeginObject();
+    writer.EndObject();
+    writer.KeyValue("third", 1.5);
+    writer.EndObject();
+
+    // Nothing is passed on before the buffer fills up or it is flushed
+    BOOST_CHECK(!writer.HasFlushed());
+    BOOST_CHECK(vChunks.empty());
+    BOOST_CHECK_EQUAL(writer.GetBuffer(), expected.write());
+
+    writer.Flush();
+    BOOST_CHECK(writer.HasFlushed());
+    BOOST_CHECK_EQUAL(Join(vChunks), expected.write());
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_chunks)
+{
+    UniValue expected(UniValue::VARR);
+    std::vector<std::string> vChunks;
+    CJSONStreamWriter writer(boost::bind(&AppendChunk, &vChunks, _1), 100);
+    writer.BeginArray();
+    for (int i = 0; i < 1000; i++) {
+        UniValue entry(UniValue::VOBJ);
+        entry.push_back(Pair("i", i));
+        expected.push_back(entry);
+        writer.Value(entry);
+    }
+    writer.EndArray();
+    writer.WriteRaw("\n");
+    writer.Flush();
+
+    BOOST_CHECK(vChunks.size() > 10);
+    for (size_t i = 0; i + 1 < vChunks.size(); i++)
+        BOOST_CHECK(vChunks[i].size() >= 100);
+    BOOST_CHECK_EQUAL(Join(vChunks), expected.write() + "\n");
+}
+
+BOOST_AUTO_TEST_CASE(jsonstream_close_to)
+{
+    std::vector<std::string> vChunks;
+    CJSONStreamWriter writer(boost::bind(&AppendChunk, &vChunks, _1));
+    writer.BeginObject();
+    writer.Key("result");
+    writer.BeginArray();
+    writer.BeginObject();
+    writer.Key("cut");
+    BOOST_CHECK_EQUAL(writer.Depth(), 3U);
+
+    // Output cut short inside the result is closed up to the outermost object
+    writer.CloseTo(1);
+    BOOST_CHECK_EQUAL(writer.Depth(), 1U);
+    writer.KeyValue("error", "failed");
+    writer.EndObject();
+    writer.Flush();
+    BOOST_CHECK_EQUAL(Join(vChunks), "{\"result\":[{\"cut\":null}],\"error\":\"failed\"}");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -72,4 +72,21 @@ BOOST_AUTO_TEST_CASE(test_combiner_all)
     Test.disconnect(&ReturnTrue);
     BOOST_CHECK(Test());
 }
+
+BOOST_AUTO_TEST_CASE(block_download_window_test)
+{
+    // Without measurements the static default applies
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(0, 0), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(100000, 0), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(0, 10000), MAX_BLOCKS_IN_TRANSIT_PER_PEER);
+
+    // A slow peer is limited to the minimum
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(50000, 5000000), MIN_BLOCKS_IN_TRANSIT_PER_PEER);
+
+    // 100ms round trip, a block every 10ms: two round trips' worth of blocks
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(100000, 10000), 22);
+
+    // A fast, distant peer is capped
+    BOOST_CHECK_EQUAL(GetBlockDownloadWindow(300000, 1000), MAX_BLOCKS_IN_TRANSIT_PER_PEER_ADAPTIVE);
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -316,5 +316,52 @@ BOOST_AUTO_TEST_CASE(multisig_Sign)
     }
 }
 
+BOOST_AUTO_TEST_CASE(multisig_SignTransaction)
+{
+    // Test SignTransaction(), which signs all inputs of one transaction at once
+    CBasicKeyStore keystore;
+    CKey key[3];
+    for (int i = 0; i < 3; i++)
+    {
+        key[i].MakeNewKey(true);
+        keystore.AddKey(key[i]);
+    }
+    CKey keyMissing;
+    keyMissing.MakeNewKey(true);
+
+    CMutableTransaction txFrom;  // Funding transaction
+    txFrom.vout.resize(20);
+    for (unsigned int i = 0; i < txFrom.vout.size(); i++)
+        txFrom.vout[i].scriptPubKey << OP_2 << ToByteVector(key[i % 3].GetPubKey()) << ToByteVector(key[(i + 1) % 3].GetPubKey()) << OP_2 << OP_CHECKMULTISIG;
+
+    CMutableTransaction txTo;    // Spending transaction
+    std::vector<CScript> vScriptPubKeys;
+    txTo.vin.resize(txFrom.vout.size() + 1);
+    txTo.vout.resize(1);
+    txTo.vout[0].nValue = 1;
+    for (unsigned int i = 0; i < txFrom.vout.size(); i++)
+    {
+        txTo.vin[i].prevout = COutPoint(txFrom.GetHash(), i);
+        vScriptPubKeys.push_back(txFrom.vout[i].scriptPubKey);
+    }
+    // An input not given a script is left alone
+    txTo.vin.back().scriptSig << OP_1;
+    vScriptPubKeys.push_back(CScript());
+
+    BOOST_CHECK(SignTransaction(keystore, txTo, vScriptPubKeys));
+    BOOST_CHECK(txTo.vin.back().scriptSig == CScript() << OP_1);
+    for (unsigned int i = 0; i < txFrom.vout.size(); i++)
+    {
+        ScriptError err;
+        BOOST_CHECK_MESSAGE(VerifyScript(txTo.vin[i].scriptSig, vScriptPubKeys[i], STANDARD_SCRIPT_VERIFY_FLAGS, MutableTransactionSignatureChecker(&txTo, i), &err), strprintf("VerifyScript %d", i));
+    }
+
+    // A missing key fails the transaction but the other inputs stay signed
+    vScriptPubKeys[0] = CScript() << ToByteVector(keyMissing.GetPubKey()) << OP_CHECKSIG;
+    BOOST_CHECK(!SignTransaction(keystore, txTo, vScriptPubKeys));
+    ScriptError err;
+    BOOST_CHECK(VerifyScript(txTo.vin[1].scriptSig, vScriptPubKeys[1], STANDARD_SCRIPT_VERIFY_FLAGS, MutableTransactionSignatureChecker(&txTo, 1), &err));
+}
+
 
 BOOST_AUTO_TEST_SUITE_END()
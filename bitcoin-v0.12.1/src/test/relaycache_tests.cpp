@@ -0,0 +1,95 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "relaycache.h"
+
+#include "utiltime.h"
+#include "version.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_FIXTURE_TEST_SUITE(relaycache_tests, BasicTestingSetup)
+
+static CRelayCache::DataPtr MakeData(int n)
+{
+    CDataStream* pss = new CDataStream(SER_NETWORK, PROTOCOL_VERSION);
+    *pss << n;
+    return CRelayCache::DataPtr(pss);
+}
+
+static uint256 MakeHash(int n)
+{
+    uint256 hash;
+    *(int*)hash.begin() = n;
+    *(int*)(hash.begin() + 4) = n * 7919;
+    return hash;
+}
+
+BOOST_AUTO_TEST_CASE(relaycache_insert_find)
+{
+    SetMockTime(1000000);
+    CRelayCache cache;
+
+    CInv inv(MSG_TX, MakeHash(1));
+    BOOST_CHECK(!cache.Find(inv));
+    BOOST_CHECK(cache.Insert(inv, MakeData(1)));
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+
+    CRelayCache::DataPtr pdata = cache.Find(inv);
+    BOOST_CHECK(pdata);
+    int n = 0;
+    CDataStream ss(*pdata);
+    ss >> n;
+    BOOST_CHECK_EQUAL(n, 1);
+
+    // A second insert for the same inv keeps the original data
+    BOOST_CHECK(!cache.Insert(inv, MakeData(2)));
+    BOOST_CHECK(cache.Find(inv) == pdata);
+
+    // Same hash, different type is a miss
+    BOOST_CHECK(!cache.Find(CInv(MSG_BLOCK, inv.hash)));
+
+    cache.Clear();
+    BOOST_CHECK_EQUAL(cache.size(), 0U);
+    BOOST_CHECK(!cache.Find(inv));
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(relaycache_expiry)
+{
+    int64_t nStart = 1000000 * RELAY_CACHE_BUCKET_INTERVAL;
+    SetMockTime(nStart);
+    CRelayCache cache;
+
+    for (int i = 0; i < 100; i++)
+        cache.Insert(CInv(MSG_TX, MakeHash(i)), MakeData(i));
+    BOOST_CHECK_EQUAL(cache.size(), 100U);
+
+    // Still present right up to the lifetime
+    SetMockTime(nStart + RELAY_CACHE_LIFETIME - 1);
+    cache.Insert(CInv(MSG_TX, MakeHash(1000)), MakeData(1000));
+    BOOST_CHECK_EQUAL(cache.size(), 101U);
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(cache.Find(CInv(MSG_TX, MakeHash(i))));
+
+    // Unreachable once the lifetime plus one bucket has passed, even without an insert
+    SetMockTime(nStart + RELAY_CACHE_LIFETIME + RELAY_CACHE_BUCKET_INTERVAL);
+    BOOST_CHECK(!cache.Find(CInv(MSG_TX, MakeHash(0))));
+    BOOST_CHECK(cache.Find(CInv(MSG_TX, MakeHash(1000))));
+
+    // The next insert drops the expired bucket but keeps the newer entry
+    cache.Insert(CInv(MSG_TX, MakeHash(2000)), MakeData(2000));
+    BOOST_CHECK_EQUAL(cache.size(), 2U);
+
+    // A jump far beyond the window empties the cache
+    SetMockTime(nStart + 100 * RELAY_CACHE_LIFETIME);
+    cache.Insert(CInv(MSG_TX, MakeHash(3000)), MakeData(3000));
+    BOOST_CHECK_EQUAL(cache.size(), 1U);
+    BOOST_CHECK(cache.Find(CInv(MSG_TX, MakeHash(3000))));
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include "rpcclient.h"
 
 #include "base58.h"
+#include "main.h"
 #include "netbase.h"
 
 #include "test/test_bitcoin.h"
@@ -308,4 +309,20 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+BOOST_AUTO_TEST_CASE(rpc_gettxouts)
+{
+    const string strOutPoint = "{\"txid\":\"a3b807410df0b60fcb9736768df5823938b2f838694939ba45f3c0a1bff150ed\",\"vout\":0}";
+    UniValue r;
+    BOOST_CHECK_NO_THROW(r = CallRPC("gettxouts [" + strOutPoint + "]"));
+    BOOST_CHECK_EQUAL(find_value(r.get_obj(), "txouts").size(), 1U);
+    BOOST_CHECK(find_value(r.get_obj(), "txouts")[0].isNull());
+
+    // Same limit as the REST getutxos call
+    string strOutPoints = strOutPoint;
+    for (size_t i = 1; i < MAX_GETUTXOS_OUTPOINTS; i++)
+        strOutPoints += "," + strOutPoint;
+    BOOST_CHECK_NO_THROW(CallRPC("gettxouts [" + strOutPoints + "] false"));
+    BOOST_CHECK_THROW(CallRPC("gettxouts [" + strOutPoints + "," + strOutPoint + "] false"), runtime_error);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
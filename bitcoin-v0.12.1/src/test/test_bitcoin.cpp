@@ -88,6 +88,7 @@ TestingSetup::~TestingSetup()
         UnloadBlockIndex();
         delete pcoinsTip;
         delete pcoinsdbview;
+        pcoinsdbview = NULL;
         delete pblocktree;
 #ifdef ENABLE_WALLET
         bitdb.Flush(true);
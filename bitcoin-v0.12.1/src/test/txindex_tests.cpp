@@ -0,0 +1,50 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chain.h"
+#include "chainparams.h"
+#include "main.h"
+#include "txdb.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(txindex_tests)
+
+BOOST_FIXTURE_TEST_CASE(txindex_background_build, TestChain100Setup)
+{
+    // The chain was connected without an index; enable it the way startup does
+    BOOST_CHECK(!fTxIndex);
+    CDiskTxPos pos;
+    BOOST_CHECK(!pblocktree->ReadTxIndex(coinbaseTxns[0].GetHash(), pos));
+    fTxIndex = true;
+    BOOST_CHECK(pblocktree->WriteTxIndexBestBlock(CBlockLocator()));
+    BOOST_CHECK(!IsTxIndexSynced());
+
+    ThreadTxIndex();
+    BOOST_CHECK(IsTxIndexSynced());
+    CBlockLocator locator;
+    BOOST_CHECK(pblocktree->ReadTxIndexBestBlock(locator));
+    BOOST_CHECK(locator.vHave.front() == chainActive.Tip()->GetBlockHash());
+
+    // Positions match those of the transactions on disk
+    for (unsigned int i = 0; i < coinbaseTxns.size(); i++) {
+        CTransaction tx;
+        uint256 hashBlock;
+        BOOST_CHECK(pblocktree->ReadTxIndex(coinbaseTxns[i].GetHash(), pos));
+        BOOST_CHECK(GetTransaction(coinbaseTxns[i].GetHash(), tx, Params().GetConsensus(), hashBlock, false));
+        BOOST_CHECK(tx.GetHash() == coinbaseTxns[i].GetHash());
+        BOOST_CHECK(hashBlock == chainActive[i + 1]->GetBlockHash());
+    }
+
+    // Blocks connected from now on are indexed by ConnectBlock
+    std::vector<CMutableTransaction> noTxns;
+    CBlock block = CreateAndProcessBlock(noTxns, CScript() << OP_TRUE);
+    BOOST_CHECK(pblocktree->ReadTxIndex(block.vtx[0].GetHash(), pos));
+
+    fTxIndex = false;
+}
+
+BOOST_AUTO_TEST_SUITE_END()
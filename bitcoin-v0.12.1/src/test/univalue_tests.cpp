@@ -7,6 +7,7 @@
 #include <string>
 #include <map>
 #include <univalue.h>
+#include "tinyformat.h"
 #include "test/test_bitcoin.h"
 
 #include <boost/test/unit_test.hpp>
@@ -331,5 +332,37 @@ BOOST_AUTO_TEST_CASE(univalue_readwrite)
     BOOST_CHECK(!v.read("{} 42"));
 }
 
+BOOST_AUTO_TEST_CASE(univalue_large_object)
+{
+    // Parsed objects of this size are looked up through a key index
+    std::string strJson = "{";
+    for (int i = 0; i < 100; i++)
+        strJson += strprintf("\"key%d\":%d,", i, i);
+    strJson += "\"key7\":\"duplicate\",\"esc\\\"aped\":\"a\\nb\"}";
+
+    UniValue v;
+    BOOST_CHECK(v.read(strJson));
+    BOOST_CHECK_EQUAL(v.size(), 102);
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK_EQUAL(v[strprintf("key%d", i)].get_int(), i);
+    BOOST_CHECK_EQUAL(find_value(v, "key42").get_int(), 42);
+    BOOST_CHECK_EQUAL(v["esc\"aped"].get_str(), "a\nb");
+    BOOST_CHECK(v["key100"].isNull());
+    BOOST_CHECK(!v.exists("key"));
+    BOOST_CHECK_EQUAL(v.write(), strJson);
+
+    // The first of duplicate keys wins, as with a linear search
+    BOOST_CHECK(v["key7"].isNum());
+
+    // Copies keep working lookups, appending keys keeps them correct
+    UniValue v2 = v;
+    BOOST_CHECK_EQUAL(v2["key99"].get_int(), 99);
+    v2.pushKV("extra", "value");
+    BOOST_CHECK_EQUAL(v2["extra"].get_str(), "value");
+    BOOST_CHECK_EQUAL(v2["key98"].get_int(), 98);
+    v2.setObject();
+    BOOST_CHECK(v2["key1"].isNull());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -15,6 +15,7 @@
 #include <stdint.h>
 #include <vector>
 
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
 
 using namespace std;
@@ -484,4 +485,33 @@ BOOST_AUTO_TEST_CASE(test_ParseFixedPoint)
     BOOST_CHECK(!ParseFixedPoint("1.", 8, &amount));
 }
 
+static void FillShare(std::vector<unsigned int>* pv, unsigned int nThrowAt, unsigned int nStart, unsigned int nStep)
+{
+    if (nStart == nThrowAt)
+        throw std::runtime_error("share failed");
+    for (unsigned int i = nStart; i < pv->size(); i += nStep)
+        (*pv)[i] = nStart + 1;
+}
+
+BOOST_AUTO_TEST_CASE(util_ParallelFor)
+{
+    std::vector<unsigned int> v(100, 0);
+    ParallelFor(4, boost::bind(&FillShare, &v, 4, _1, _2));
+    for (unsigned int i = 0; i < v.size(); i++)
+        BOOST_CHECK_EQUAL(v[i], i % 4 + 1);
+
+    // A failing share, on another thread or on the caller's, fails the whole run
+    BOOST_CHECK_THROW(ParallelFor(4, boost::bind(&FillShare, &v, 2, _1, _2)), std::runtime_error);
+    BOOST_CHECK_THROW(ParallelFor(4, boost::bind(&FillShare, &v, 0, _1, _2)), std::runtime_error);
+
+    // Without a share for the caller, every share runs on a thread of its own
+    v.assign(10, 0);
+    {
+        CParallelWorkers workers(boost::bind(&FillShare, &v, 3, _1, _2), 3, false);
+        workers.Join();
+    }
+    for (unsigned int i = 0; i < v.size(); i++)
+        BOOST_CHECK_EQUAL(v[i], i % 3 + 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
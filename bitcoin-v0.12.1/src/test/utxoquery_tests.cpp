@@ -0,0 +1,78 @@
+// Copyright (c) 2016 The Bitcoin Core developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "main.h"
+#include "txdb.h"
+#include "txmempool.h"
+
+#include "test/test_bitcoin.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(utxoquery_tests)
+
+static void CheckUnspent(const std::vector<CUnspentOutput>& vOutputs, unsigned int i, const CTxOut& out, unsigned int nHeight)
+{
+    BOOST_CHECK(vOutputs[i].fUnspent);
+    BOOST_CHECK(vOutputs[i].out == out);
+    BOOST_CHECK_EQUAL(vOutputs[i].nHeight, nHeight);
+}
+
+BOOST_FIXTURE_TEST_CASE(getunspentoutputs, TestChain100Setup)
+{
+    std::vector<COutPoint> vOutPoints;
+    vOutPoints.push_back(COutPoint(coinbaseTxns[0].GetHash(), 0));
+    vOutPoints.push_back(COutPoint(coinbaseTxns[1].GetHash(), 0));
+    vOutPoints.push_back(COutPoint(coinbaseTxns[1].GetHash(), 1)); // No such output
+    vOutPoints.push_back(COutPoint(uint256S("0x01"), 0));          // No such transaction
+    vOutPoints.push_back(COutPoint(coinbaseTxns[0].GetHash(), 0)); // Duplicate
+
+    // Answered from the coins cache
+    std::vector<CUnspentOutput> vOutputs;
+    uint256 hashTip;
+    int nTipHeight;
+    BOOST_CHECK(GetUnspentOutputs(vOutPoints, false, vOutputs, hashTip, nTipHeight));
+    BOOST_CHECK(hashTip == chainActive.Tip()->GetBlockHash());
+    BOOST_CHECK_EQUAL(nTipHeight, chainActive.Height());
+    BOOST_CHECK_EQUAL(vOutputs.size(), vOutPoints.size());
+    CheckUnspent(vOutputs, 0, coinbaseTxns[0].vout[0], 1);
+    CheckUnspent(vOutputs, 1, coinbaseTxns[1].vout[0], 2);
+    BOOST_CHECK(!vOutputs[2].fUnspent);
+    BOOST_CHECK(!vOutputs[3].fUnspent);
+    CheckUnspent(vOutputs, 4, coinbaseTxns[0].vout[0], 1);
+    BOOST_CHECK(vOutputs[0].fCoinBase);
+
+    // Answered from the database after flushing the cache
+    BOOST_CHECK(pcoinsTip->Flush());
+    std::vector<CUnspentOutput> vOutputsDB;
+    BOOST_CHECK(GetUnspentOutputs(vOutPoints, false, vOutputsDB, hashTip, nTipHeight));
+    BOOST_CHECK(!pcoinsTip->HaveCoinsInCache(coinbaseTxns[0].GetHash()));
+    for (unsigned int i = 0; i < vOutPoints.size(); i++) {
+        BOOST_CHECK_EQUAL(vOutputsDB[i].fUnspent, vOutputs[i].fUnspent);
+        BOOST_CHECK(vOutputsDB[i].out == vOutputs[i].out);
+        BOOST_CHECK_EQUAL(vOutputsDB[i].nHeight, vOutputs[i].nHeight);
+    }
+
+    // A mempool transaction spending the first output
+    CMutableTransaction spend;
+    spend.vin.resize(1);
+    spend.vin[0].prevout = vOutPoints[0];
+    spend.vout.push_back(CTxOut(coinbaseTxns[0].vout[0].nValue - 1000, CScript() << OP_TRUE));
+    TestMemPoolEntryHelper entry;
+    mempool.addUnchecked(spend.GetHash(), entry.FromTx(spend));
+
+    std::vector<COutPoint> vOutPointsMemPool;
+    vOutPointsMemPool.push_back(vOutPoints[0]);
+    vOutPointsMemPool.push_back(COutPoint(spend.GetHash(), 0));
+    BOOST_CHECK(GetUnspentOutputs(vOutPointsMemPool, true, vOutputs, hashTip, nTipHeight));
+    BOOST_CHECK(!vOutputs[0].fUnspent);
+    CheckUnspent(vOutputs, 1, spend.vout[0], MEMPOOL_HEIGHT);
+
+    BOOST_CHECK(GetUnspentOutputs(vOutPointsMemPool, false, vOutputs, hashTip, nTipHeight));
+    CheckUnspent(vOutputs, 0, coinbaseTxns[0].vout[0], 1);
+    BOOST_CHECK(!vOutputs[1].fUnspent);
+    mempool.clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 #include "main.h"
 #include "pow.h"
 #include "uint256.h"
+#include "undo.h"
 
 #include <stdint.h>
 
@@ -27,9 +28,16 @@ static const char DB_BEST_BLOCK = 'B';
 static const char DB_FLAG = 'F';
 static const char DB_REINDEX_FLAG = 'R';
 static const char DB_LAST_BLOCK = 'l';
+static const char DB_TXINDEX_BEST_BLOCK = 'T';
 
+static const char DB_BLOCK_FILTER = 'f';
+static const char DB_BLOCK_FILTER_HEADER = 'h';
 
-CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true) 
+static const char DB_ADDRESS_HISTORY = 'a';
+static const char DB_ADDRESS_UNSPENT = 'u';
+
+
+CCoinsViewDB::CCoinsViewDB(size_t nCacheSize, bool fMemory, bool fWipe) : db(GetDataDir() / "chainstate", nCacheSize, fMemory, fWipe, true, DB_PROFILE_CHAINSTATE) 
 {
 }
 
@@ -41,6 +49,23 @@ bool CCoinsViewDB::HaveCoins(const uint256 &txid) const {
     return db.Exists(make_pair(DB_COINS, txid));
 }
 
+bool CCoinsViewDB::GetCoinsSorted(const std::vector<uint256>& vTxids, const leveldb::Snapshot* psnapshot, std::vector<CCoins>& vCoins) const {
+    vCoins.clear();
+    vCoins.resize(vTxids.size());
+
+    // A single iterator reads ahead through neighbouring keys, which sorted lookups benefit from
+    boost::scoped_ptr<CDBIterator> pcursor(db.NewIterator(psnapshot));
+    for (unsigned int i = 0; i < vTxids.size(); i++) {
+        pcursor->Seek(make_pair(DB_COINS, vTxids[i])); // λý׻ĵһ
+        std::pair<char, uint256> key;
+        if (pcursor->Valid() && pcursor->GetKey(key) && key.first == DB_COINS && key.second == vTxids[i]) {
+            if (!pcursor->GetValue(vCoins[i]))
+                return error("%s: unable to read value", __func__);
+        }
+    }
+    return true;
+}
+
 uint256 CCoinsViewDB::GetBestBlock() const {
     uint256 hashBestChain;
     if (!db.Read(DB_BEST_BLOCK, hashBestChain))
@@ -71,7 +96,7 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock) {
     return db.WriteBatch(batch);
 }
 
-CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe) {
+CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe, false, DB_PROFILE_BLOCK_INDEX) {
 }
 
 bool CBlockTreeDB::ReadBlockFileInfo(int nFile, CBlockFileInfo &info) {
@@ -156,13 +181,23 @@ bool CBlockTreeDB::ReadTxIndex(const uint256 &txid, CDiskTxPos &pos) {
     return Read(make_pair(DB_TXINDEX, txid), pos);
 }
 
-bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect) {
+bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >&vect, const CBlockLocator *plocator) {
     CDBBatch batch(&GetObfuscateKey());
     for (std::vector<std::pair<uint256,CDiskTxPos> >::const_iterator it=vect.begin(); it!=vect.end(); it++)
         batch.Write(make_pair(DB_TXINDEX, it->first), it->second);
+    if (plocator)
+        batch.Write(DB_TXINDEX_BEST_BLOCK, *plocator); // ԭӵд
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadTxIndexBestBlock(CBlockLocator &locator) {
+    return Read(DB_TXINDEX_BEST_BLOCK, locator);
+}
+
+bool CBlockTreeDB::WriteTxIndexBestBlock(const CBlockLocator &locator) {
+    return Write(DB_TXINDEX_BEST_BLOCK, locator);
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string &name, bool fValue) {
     return Write(std::make_pair(DB_FLAG, name), fValue ? '1' : '0');
 }
@@ -175,6 +210,228 @@ bool CBlockTreeDB::ReadFlag(const std::string &name, bool &fValue) {
     return true;
 }
 
+CBlockFilterDB::CBlockFilterDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "blockfilter", nCacheSize, fMemory, fWipe, false, DB_PROFILE_BLOCK_FILTER) {
+}
+
+bool CBlockFilterDB::WriteFilter(const uint256 &hashBlock, const std::vector<unsigned char> &vEncodedFilter, const uint256 &hashFilter, const uint256 &hashHeader) {
+    CDBBatch batch(&GetObfuscateKey());
+    batch.Write(make_pair(DB_BLOCK_FILTER, hashBlock), vEncodedFilter);
+    batch.Write(make_pair(DB_BLOCK_FILTER_HEADER, hashBlock), make_pair(hashFilter, hashHeader));
+    return WriteBatch(batch);
+}
+
+bool CBlockFilterDB::ReadFilter(const uint256 &hashBlock, std::vector<unsigned char> &vEncodedFilter) {
+    return Read(make_pair(DB_BLOCK_FILTER, hashBlock), vEncodedFilter);
+}
+
+bool CBlockFilterDB::ReadFilterHeader(const uint256 &hashBlock, uint256 &hashFilter, uint256 &hashHeader) {
+    std::pair<uint256, uint256> entry;
+    if (!Read(make_pair(DB_BLOCK_FILTER_HEADER, hashBlock), entry))
+        return false;
+    hashFilter = entry.first;
+    hashHeader = entry.second;
+    return true;
+}
+
+bool CBlockFilterDB::HaveFilter(const uint256 &hashBlock) {
+    return Exists(make_pair(DB_BLOCK_FILTER_HEADER, hashBlock));
+}
+
+CAddressIndexDB::CAddressIndexDB(size_t nCacheSize, bool fMemory, bool fWipe) : CDBWrapper(GetDataDir() / "addressindex", nCacheSize, fMemory, fWipe, false, DB_PROFILE_ADDRESS_INDEX) {
+}
+
+bool CAddressIndexDB::ReadBestBlock(uint256 &hashBlock) {
+    return Read(DB_BEST_BLOCK, hashBlock);
+}
+
+bool CAddressIndexDB::ConnectBlock(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex, const std::vector<CAddressIndexValue> *pvSpent) {
+    CDBBatch batch(&GetObfuscateKey());
+    if (pindex->pprev) { // the genesis coinbase cannot be spent, so it is not indexed
+        if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+            return error("%s: block and undo data inconsistent", __func__);
+        size_t nSpent = 0; // position of the next input in *pvSpent
+
+        std::map<COutPoint, CAddressIndexValue> mapCreated; // ½ܱĽ׻
+        for (unsigned int i = 0; i < block.vtx.size(); i++) {
+            const CTransaction &tx = block.vtx[i];
+            const uint256 txid = tx.GetHash();
+            if (i > 0) {
+                const CTxUndo &txundo = blockundo.vtxundo[i-1];
+                for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                    const COutPoint &prevout = tx.vin[j].prevout;
+                    const CScript &script = txundo.vprevout[j].txout.scriptPubKey;
+                    CAddressUnspentKey keyUnspent(Hash160(script.begin(), script.end()), prevout.hash, prevout.n);
+                    CAddressIndexValue value; // ѵ
+                    if (pvSpent) {
+                        if (nSpent >= pvSpent->size())
+                            return error("%s: block and spent outputs inconsistent", __func__);
+                        value = (*pvSpent)[nSpent++];
+                    } else {
+                        std::map<COutPoint, CAddressIndexValue>::const_iterator it = mapCreated.find(prevout);
+                        if (it != mapCreated.end())
+                            value = it->second;
+                        else if (!Read(make_pair(DB_ADDRESS_UNSPENT, keyUnspent), value))
+                            return error("%s: spent output %s not indexed", __func__, prevout.ToString());
+                    }
+                    batch.Erase(make_pair(DB_ADDRESS_UNSPENT, keyUnspent));
+                    batch.Write(make_pair(DB_ADDRESS_HISTORY, CAddressHistoryKey(keyUnspent.hashScript, pindex->nHeight, i, txid, j, true)), value);
+                }
+            }
+            for (unsigned int j = 0; j < tx.vout.size(); j++) {
+                const CTxOut &out = tx.vout[j];
+                if (out.scriptPubKey.IsUnspendable())
+                    continue;
+                uint160 hashScript = Hash160(out.scriptPubKey.begin(), out.scriptPubKey.end());
+                CAddressIndexValue value(out.nValue, pindex->nHeight, i == 0);
+                batch.Write(make_pair(DB_ADDRESS_HISTORY, CAddressHistoryKey(hashScript, pindex->nHeight, i, txid, j, false)), value);
+                batch.Write(make_pair(DB_ADDRESS_UNSPENT, CAddressUnspentKey(hashScript, txid, j)), value);
+                if (!pvSpent)
+                    mapCreated[COutPoint(txid, j)] = value;
+            }
+        }
+    }
+    batch.Write(DB_BEST_BLOCK, pindex->GetBlockHash());
+    return WriteBatch(batch);
+}
+
+bool CAddressIndexDB::DisconnectBlock(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex) {
+    CDBBatch batch(&GetObfuscateKey());
+    if (blockundo.vtxundo.size() + 1 != block.vtx.size())
+        return error("%s: block and undo data inconsistent", __func__);
+
+    // Undo transactions in reverse order, so that outputs spent within the block end up erased
+    for (int i = block.vtx.size() - 1; i >= 0; i--) {
+        const CTransaction &tx = block.vtx[i];
+        const uint256 txid = tx.GetHash();
+        for (unsigned int j = 0; j < tx.vout.size(); j++) {
+            const CTxOut &out = tx.vout[j];
+            if (out.scriptPubKey.IsUnspendable())
+                continue;
+            uint160 hashScript = Hash160(out.scriptPubKey.begin(), out.scriptPubKey.end());
+            batch.Erase(make_pair(DB_ADDRESS_HISTORY, CAddressHistoryKey(hashScript, pindex->nHeight, i, txid, j, false)));
+            batch.Erase(make_pair(DB_ADDRESS_UNSPENT, CAddressUnspentKey(hashScript, txid, j)));
+        }
+        if (i > 0) {
+            const CTxUndo &txundo = blockundo.vtxundo[i-1];
+            for (unsigned int j = 0; j < tx.vin.size(); j++) {
+                const CScript &script = txundo.vprevout[j].txout.scriptPubKey;
+                CAddressHistoryKey keySpend(Hash160(script.begin(), script.end()), pindex->nHeight, i, txid, j, true);
+                CAddressIndexValue value; // ָѵ
+                if (!Read(make_pair(DB_ADDRESS_HISTORY, keySpend), value))
+                    return error("%s: spend of %s not indexed", __func__, tx.vin[j].prevout.ToString());
+                batch.Erase(make_pair(DB_ADDRESS_HISTORY, keySpend));
+                batch.Write(make_pair(DB_ADDRESS_UNSPENT, CAddressUnspentKey(keySpend.hashScript, tx.vin[j].prevout.hash, tx.vin[j].prevout.n)), value);
+            }
+        }
+    }
+    batch.Write(DB_BEST_BLOCK, pindex->pprev->GetBlockHash());
+    return WriteBatch(batch);
+}
+
+/**
+ * Read the best block of the index as seen by pcursor's snapshot. An index
+ * that has not indexed any block yet is empty, not an error: hashBestBlock
+ * is set to null.
+ */
+static bool ReadAddressIndexBestBlock(CDBIterator *pcursor, uint256 &hashBestBlock)
+{
+    pcursor->Seek(DB_BEST_BLOCK);
+    char chKey;
+    if (!pcursor->Valid() || !pcursor->GetKey(chKey) || chKey != DB_BEST_BLOCK) {
+        hashBestBlock.SetNull(); // ΪգڽУ
+        return true;
+    }
+    if (!pcursor->GetValue(hashBestBlock))
+        return error("%s: unable to read the best block", __func__);
+    return true;
+}
+
+bool CAddressIndexDB::ReadAddressHistory(const uint160 &hashScript, size_t nSkip, size_t nCount, std::vector<CAddressHistoryEntry> &vEntries, uint256 &hashBestBlock) {
+    vEntries.clear();
+    const leveldb::Snapshot* psnapshot = GetSnapshot(); // ͬһ϶ȡ¼
+    bool fRet;
+    {
+        boost::scoped_ptr<CDBIterator> pcursor(NewIterator(psnapshot));
+        fRet = ReadAddressIndexBestBlock(pcursor.get(), hashBestBlock);
+        CAddressHistoryKey keyStart;
+        keyStart.hashScript = hashScript;
+        for (pcursor->Seek(make_pair(DB_ADDRESS_HISTORY, keyStart)); fRet && pcursor->Valid() && vEntries.size() < nCount; pcursor->Next()) {
+            std::pair<char, CAddressHistoryKey> key;
+            if (!pcursor->GetKey(key) || key.first != DB_ADDRESS_HISTORY || key.second.hashScript != hashScript)
+                break;
+            if (nSkip > 0) { // ¼ؽֵ
+                nSkip--;
+                continue;
+            }
+            vEntries.push_back(CAddressHistoryEntry(key.second, CAddressIndexValue()));
+            if (!pcursor->GetValue(vEntries.back().second))
+                fRet = error("%s: unable to read value", __func__);
+        }
+    }
+    ReleaseSnapshot(psnapshot);
+    return fRet;
+}
+
+bool CAddressIndexDB::ReadAddressUnspent(const uint160 &hashScript, size_t nSkip, size_t nCount, std::vector<CAddressUnspentEntry> &vEntries, uint256 &hashBestBlock) {
+    vEntries.clear();
+    const leveldb::Snapshot* psnapshot = GetSnapshot();
+    bool fRet;
+    {
+        boost::scoped_ptr<CDBIterator> pcursor(NewIterator(psnapshot));
+        fRet = ReadAddressIndexBestBlock(pcursor.get(), hashBestBlock);
+        for (pcursor->Seek(make_pair(DB_ADDRESS_UNSPENT, CAddressUnspentKey(hashScript, uint256(), 0))); fRet && pcursor->Valid() && vEntries.size() < nCount; pcursor->Next()) {
+            std::pair<char, CAddressUnspentKey> key;
+            if (!pcursor->GetKey(key) || key.first != DB_ADDRESS_UNSPENT || key.second.hashScript != hashScript)
+                break;
+            if (nSkip > 0) {
+                nSkip--;
+                continue;
+            }
+            vEntries.push_back(CAddressUnspentEntry(key.second, CAddressIndexValue()));
+            if (!pcursor->GetValue(vEntries.back().second))
+                fRet = error("%s: unable to read value", __func__);
+        }
+    }
+    ReleaseSnapshot(psnapshot);
+    return fRet;
+}
+
+bool CAddressIndexDB::ReadAddressBalance(const uint160 &hashScript, CAmount &nBalance, CAmount &nReceived, size_t &nUnspent, uint256 &hashBestBlock) {
+    nBalance = nReceived = 0;
+    nUnspent = 0;
+    const leveldb::Snapshot* psnapshot = GetSnapshot();
+    bool fRet;
+    {
+        boost::scoped_ptr<CDBIterator> pcursor(NewIterator(psnapshot));
+        fRet = ReadAddressIndexBestBlock(pcursor.get(), hashBestBlock);
+        for (pcursor->Seek(make_pair(DB_ADDRESS_UNSPENT, CAddressUnspentKey(hashScript, uint256(), 0))); fRet && pcursor->Valid(); pcursor->Next()) {
+            std::pair<char, CAddressUnspentKey> key;
+            CAddressIndexValue value;
+            if (!pcursor->GetKey(key) || key.first != DB_ADDRESS_UNSPENT || key.second.hashScript != hashScript)
+                break;
+            if (!pcursor->GetValue(value))
+                fRet = error("%s: unable to read value", __func__);
+            nBalance += value.nValue;
+            nUnspent++;
+        }
+        CAddressHistoryKey keyStart;
+        keyStart.hashScript = hashScript;
+        for (pcursor->Seek(make_pair(DB_ADDRESS_HISTORY, keyStart)); fRet && pcursor->Valid(); pcursor->Next()) {
+            std::pair<char, CAddressHistoryKey> key;
+            CAddressIndexValue value;
+            if (!pcursor->GetKey(key) || key.first != DB_ADDRESS_HISTORY || key.second.hashScript != hashScript)
+                break;
+            if (key.second.fSpending)
+                continue;
+            if (!pcursor->GetValue(value))
+                fRet = error("%s: unable to read value", __func__);
+            nReceived += value.nValue;
+        }
+    }
+    ReleaseSnapshot(psnapshot);
+    return fRet;
+}
+
 bool CBlockTreeDB::LoadBlockIndexGuts()
 {
     boost::scoped_ptr<CDBIterator> pcursor(NewIterator()); // scoped_ptr  auto_ptr ĸĽܸƺ͸ֵתȨ
@@ -6,18 +6,23 @@
 #ifndef BITCOIN_TXDB_H
 #define BITCOIN_TXDB_H
 
+#include "amount.h"
 #include "coins.h"
 #include "dbwrapper.h"
+#include "serialize.h"
+#include "uint256.h"
 
 #include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
+class CBlock;
 class CBlockFileInfo;
 class CBlockIndex;
+class CBlockUndo;
+struct CBlockLocator;
 struct CDiskTxPos;
-class uint256;
 
 //! -dbcache default (MiB)
 static const int64_t nDefaultDbCache = 100;
@@ -39,6 +44,16 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap &mapCoins, const uint256 &hashBlock);
     bool GetStats(CCoinsStats &stats) const;
+    //! See CDBWrapper::GetSnapshot(); must be taken while no writes are in progress (cs_main)
+    const leveldb::Snapshot* GetSnapshot() const { return db.GetSnapshot(); }
+    void ReleaseSnapshot(const leveldb::Snapshot* psnapshot) const { db.ReleaseSnapshot(psnapshot); }
+
+    /**
+     * Read the coins of many transactions at once, as of psnapshot. vTxids
+     * must be sorted, so that the reads walk the database in key order.
+     * Transactions without unspent outputs get pruned coins.
+     */
+    bool GetCoinsSorted(const std::vector<uint256>& vTxids, const leveldb::Snapshot* psnapshot, std::vector<CCoins>& vCoins) const;
 };
 
 /** Access to the block database (blocks/index/) */ // ݿ⣨/blocks/index
@@ -56,10 +71,149 @@ public:
     bool WriteReindexing(bool fReindex); // д־
     bool ReadReindexing(bool &fReindex); // ȡ־
     bool ReadTxIndex(const uint256 &txid, CDiskTxPos &pos);
-    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list);
+    bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> > &list, const CBlockLocator *plocator = NULL); // д뽻ͬʱ
+    bool ReadTxIndexBestBlock(CBlockLocator &locator); // ȡѸǵ
+    bool WriteTxIndexBestBlock(const CBlockLocator &locator);
     bool WriteFlag(const std::string &name, bool fValue);
     bool ReadFlag(const std::string &name, bool &fValue);
     bool LoadBlockIndexGuts(); // 
 };
 
+/**
+ * Access to the compact block filter index (blockfilter/). Filters and
+ * their headers are keyed by block hash, so entries stay valid across
+ * reorganisations.
+ */ // ʽݿ⣨/blockfilter
+class CBlockFilterDB : public CDBWrapper
+{
+public:
+    CBlockFilterDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+private:
+    CBlockFilterDB(const CBlockFilterDB&);
+    void operator=(const CBlockFilterDB&);
+public:
+    bool WriteFilter(const uint256 &hashBlock, const std::vector<unsigned char> &vEncodedFilter, const uint256 &hashFilter, const uint256 &hashHeader); // дͷ
+    bool ReadFilter(const uint256 &hashBlock, std::vector<unsigned char> &vEncodedFilter); // ȡ
+    bool ReadFilterHeader(const uint256 &hashBlock, uint256 &hashFilter, uint256 &hashHeader); // ȡĹϣͷ
+    bool HaveFilter(const uint256 &hashBlock); // ǷиĹ
+};
+
+/**
+ * Key of a funding or spending event in the address index. The script hash
+ * comes first and the height is stored big-endian, so that the events of a
+ * script are adjacent in the database and ordered as in the block chain.
+ */
+struct CAddressHistoryKey
+{
+    uint160 hashScript; //! Hash160 of the scriptPubKey
+    uint32_t nHeight;
+    uint32_t nTxPos;    //! position of the transaction in its block
+    uint256 txid;
+    uint32_t nIndex;    //! output index, or input index of a spend
+    bool fSpending;
+
+    CAddressHistoryKey() : nHeight(0), nTxPos(0), nIndex(0), fSpending(false) {}
+    CAddressHistoryKey(const uint160& hashScriptIn, uint32_t nHeightIn, uint32_t nTxPosIn, const uint256& txidIn, uint32_t nIndexIn, bool fSpendingIn) :
+        hashScript(hashScriptIn), nHeight(nHeightIn), nTxPos(nTxPosIn), txid(txidIn), nIndex(nIndexIn), fSpending(fSpendingIn) {}
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return 20 + 4 + 4 + 32 + 4 + 1;
+    }
+
+    template<typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        hashScript.Serialize(s, nType, nVersion);
+        ser_writedata32be(s, nHeight);
+        ser_writedata32be(s, nTxPos);
+        txid.Serialize(s, nType, nVersion);
+        ser_writedata32be(s, nIndex);
+        ser_writedata8(s, fSpending);
+    }
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        hashScript.Unserialize(s, nType, nVersion);
+        nHeight = ser_readdata32be(s);
+        nTxPos = ser_readdata32be(s);
+        txid.Unserialize(s, nType, nVersion);
+        nIndex = ser_readdata32be(s);
+        fSpending = ser_readdata8(s) != 0;
+    }
+};
+
+/** Key of an unspent output in the address index */
+struct CAddressUnspentKey
+{
+    uint160 hashScript;
+    uint256 txid;
+    uint32_t nIndex;
+
+    CAddressUnspentKey() : nIndex(0) {}
+    CAddressUnspentKey(const uint160& hashScriptIn, const uint256& txidIn, uint32_t nIndexIn) : hashScript(hashScriptIn), txid(txidIn), nIndex(nIndexIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(hashScript);
+        READWRITE(txid);
+        READWRITE(nIndex);
+    }
+};
+
+/** An indexed output; for a spending event, the output that was spent */
+struct CAddressIndexValue
+{
+    CAmount nValue;
+    int nHeight;    //! height of the block that created the output
+    bool fCoinBase;
+
+    CAddressIndexValue() : nValue(0), nHeight(0), fCoinBase(false) {}
+    CAddressIndexValue(CAmount nValueIn, int nHeightIn, bool fCoinBaseIn) : nValue(nValueIn), nHeight(nHeightIn), fCoinBase(fCoinBaseIn) {}
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(nValue);
+        READWRITE(nHeight);
+        READWRITE(fCoinBase);
+    }
+};
+
+typedef std::pair<CAddressHistoryKey, CAddressIndexValue> CAddressHistoryEntry;
+typedef std::pair<CAddressUnspentKey, CAddressIndexValue> CAddressUnspentEntry;
+
+/**
+ * Access to the address index (addressindex/). For every scriptPubKey it
+ * records the outputs paying to it, the inputs spending them and the
+ * outputs still unspent, as of the block returned by ReadBestBlock().
+ * Blocks have to be connected and disconnected in chain order.
+ */ // ʵַݿ⣨/addressindex
+class CAddressIndexDB : public CDBWrapper
+{
+public:
+    CAddressIndexDB(size_t nCacheSize, bool fMemory = false, bool fWipe = false);
+private:
+    CAddressIndexDB(const CAddressIndexDB&);
+    void operator=(const CAddressIndexDB&);
+public:
+    bool ReadBestBlock(uint256 &hashBlock); // ȡ
+    /**
+     * Index a block whose parent is the best block. pvSpent, if given, holds the
+     * outputs the block spends, in input order; otherwise they are read back from
+     * the index.
+     */
+    bool ConnectBlock(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex, const std::vector<CAddressIndexValue> *pvSpent = NULL);
+    bool DisconnectBlock(const CBlock &block, const CBlockUndo &blockundo, const CBlockIndex *pindex); // 
+    /** Read up to nCount events of a script, skipping the first nSkip */
+    bool ReadAddressHistory(const uint160 &hashScript, size_t nSkip, size_t nCount, std::vector<CAddressHistoryEntry> &vEntries, uint256 &hashBestBlock);
+    /** Read up to nCount unspent outputs of a script, skipping the first nSkip */
+    bool ReadAddressUnspent(const uint160 &hashScript, size_t nSkip, size_t nCount, std::vector<CAddressUnspentEntry> &vEntries, uint256 &hashBestBlock);
+    bool ReadAddressBalance(const uint160 &hashScript, CAmount &nBalance, CAmount &nReceived, size_t &nUnspent, uint256 &hashBestBlock); // ͳƽű
+};
+
 #endif // BITCOIN_TXDB_H
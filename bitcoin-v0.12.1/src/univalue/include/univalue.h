@@ -47,7 +47,6 @@ public:
         std::string s(val_);
         setStr(s);
     }
-    ~UniValue() {}
 
     void clear();
 
@@ -134,8 +133,12 @@ private:
     std::string val;                       // numbers are stored as C++ strings
     std::vector<std::string> keys; // б
     std::vector<UniValue> values; // ֵб
+    //! Sorted (key hash, key position) pairs of large parsed objects, see buildKeyIndex()
+    std::vector<std::pair<uint32_t, uint32_t> > keyIndex; // ϣ
 
     int findKey(const std::string& key) const;
+    void buildKeyIndex();
+    void writeValue(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
     void writeArray(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
     void writeObject(unsigned int prettyIndent, unsigned int indentLevel, std::string& s) const;
 
@@ -276,6 +279,9 @@ static inline bool json_isspace(int ch)
     // not reached
 }
 
+/** Objects with at least this many keys get a key index when they are parsed */
+static const unsigned int UNIVALUE_KEY_INDEX_MIN_SIZE = 16;
+
 extern const UniValue NullUniValue;
 
 const UniValue& find_value( const UniValue& obj, const std::string& name); // һ json иݼֵ
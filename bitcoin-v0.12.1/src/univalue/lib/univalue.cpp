@@ -4,6 +4,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <stdint.h>
+#include <algorithm>
 #include <errno.h>
 #include <iomanip>
 #include <limits>
@@ -83,6 +84,7 @@ void UniValue::clear()
     val.clear();
     keys.clear();
     values.clear();
+    keyIndex.clear();
 }
 
 bool UniValue::setNull()
@@ -199,6 +201,7 @@ bool UniValue::pushKV(const std::string& key, const UniValue& val)
 
     keys.push_back(key);
     values.push_back(val);
+    keyIndex.clear();
     return true;
 }
 
@@ -211,12 +214,48 @@ bool UniValue::pushKVs(const UniValue& obj)
         keys.push_back(obj.keys[i]);
         values.push_back(obj.values.at(i));
     }
+    keyIndex.clear();
 
     return true;
 }
 
+static uint32_t hashKey(const std::string& key)
+{
+    // FNV-1a
+    uint32_t hash = 2166136261U;
+    for (unsigned int i = 0; i < key.size(); i++) {
+        hash ^= (unsigned char)key[i];
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+void UniValue::buildKeyIndex()
+{
+    keyIndex.clear();
+    if (keys.size() < UNIVALUE_KEY_INDEX_MIN_SIZE)
+        return;
+
+    keyIndex.reserve(keys.size());
+    for (unsigned int i = 0; i < keys.size(); i++)
+        keyIndex.push_back(std::make_pair(hashKey(keys[i]), (uint32_t) i));
+    // Keys with equal hashes stay in position order, so the first one wins
+    std::sort(keyIndex.begin(), keyIndex.end());
+}
+
 int UniValue::findKey(const std::string& key) const
 {
+    if (!keyIndex.empty() && keyIndex.size() == keys.size()) { // ʱöֲ
+        const uint32_t hash = hashKey(key);
+        std::vector<std::pair<uint32_t, uint32_t> >::const_iterator it =
+            std::lower_bound(keyIndex.begin(), keyIndex.end(), std::make_pair(hash, (uint32_t) 0));
+        for (; it != keyIndex.end() && it->first == hash; ++it) {
+            if (keys[it->second] == key)
+                return (int) it->second;
+        }
+        return -1;
+    }
+
     for (unsigned int i = 0; i < keys.size(); i++) {
         if (keys[i] == key)
             return (int) i;
@@ -279,9 +318,9 @@ const char *uvTypeName(UniValue::VType t)
 
 const UniValue& find_value(const UniValue& obj, const std::string& name)
 {
-    for (unsigned int i = 0; i < obj.keys.size(); i++) //  json Ĺؼб
-        if (obj.keys[i] == name) // ҵָ
-            return obj.values.at(i); // ضӦֵ
+    int index = obj.findKey(name); // ָ
+    if (index >= 0)
+        return obj.values.at(index); // ضӦֵ
 
     return NullUniValue; // 򣬷ؿն
 }
@@ -75,6 +75,7 @@
 #include <boost/algorithm/string/case_conv.hpp> // for to_lower()
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/predicate.hpp> // for startswith() and endswith()
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/foreach.hpp>
@@ -814,6 +815,67 @@ bool SetupNetworking()
     return true; //  WIN32 ϵͳֱӷ true
 }
 
+CParallelWorkers::CParallelWorkers(const Function& fnIn, unsigned int nSharesIn, bool fCallerShareIn) :
+    fn(fnIn), nShares(std::max(nSharesIn, 1U)), fCallerShare(fCallerShareIn), pthreads(new boost::thread_group()), fJoined(false), vErrors(nShares)
+{
+    try {
+        for (unsigned int i = fCallerShare ? 1 : 0; i < nShares; i++)
+            pthreads->create_thread(boost::bind(&CParallelWorkers::RunWorker, this, i));
+    } catch (...) {
+        JoinThreads(); // ߳ʧܣȻ߳
+        delete pthreads;
+        throw;
+    }
+}
+
+CParallelWorkers::~CParallelWorkers()
+{
+    JoinThreads();
+    delete pthreads;
+}
+
+void CParallelWorkers::RunWorker(unsigned int nStart)
+{
+    try {
+        fn(nStart, nShares);
+    } catch (const std::exception& e) {
+        vErrors[nStart] = e.what();
+    } catch (...) {
+        vErrors[nStart] = "unknown exception";
+    }
+}
+
+void CParallelWorkers::RunShare()
+{
+    assert(fCallerShare && !fJoined);
+    fn(0, nShares);
+}
+
+void CParallelWorkers::JoinThreads()
+{
+    if (fJoined)
+        return;
+    boost::this_thread::disable_interruption di; // ߳̿ʹõջϵ
+    pthreads->join_all();
+    fJoined = true;
+}
+
+void CParallelWorkers::Join()
+{
+    JoinThreads();
+    BOOST_FOREACH(const std::string& strError, vErrors) {
+        if (!strError.empty())
+            throw std::runtime_error(strError);
+    }
+}
+
+void ParallelFor(unsigned int nShares, const CParallelWorkers::Function& fn)
+{
+    CParallelWorkers workers(fn, nShares);
+    workers.RunShare();
+    workers.Join();
+}
+
 void SetThreadPriority(int nPriority)
 {
 #ifdef WIN32
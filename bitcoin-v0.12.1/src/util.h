@@ -25,9 +25,14 @@
 #include <vector>
 
 #include <boost/filesystem/path.hpp>
+#include <boost/function.hpp>
 #include <boost/signals2/signal.hpp>
 #include <boost/thread/exceptions.hpp>
 
+namespace boost {
+    class thread_group;
+} // namespace boost
+
 static const bool DEFAULT_LOGTIMEMICROS = false; // ʱ΢룬ĬΪ false
 static const bool DEFAULT_LOGIPS        = false; // ¼ IPsĬϹر
 static const bool DEFAULT_LOGTIMESTAMPS = true; // ¼ʱĬΪ true
@@ -216,6 +221,49 @@ std::string HelpMessageOpt(const std::string& option, const std::string& message
  */
 int GetNumCores();
 
+/**
+ * Runs fn(nStart, nShares) for every nStart below nShares, one share per
+ * thread, so that fn can take every nShares-th item from nStart on. Unless
+ * fCallerShare is false, share 0 is left to the calling thread (RunShare()),
+ * which may also do other work while the threads run.
+ *
+ * The threads are joined by Join(), or by the destructor if an exception
+ * unwinds the caller first, so fn may use data on the caller's stack.
+ * Thread interruption is disabled while joining for the same reason.
+ */ // ڶ߳ϷƬִ fn֤ڵ߷ػ׳쳣ǰȫ߳
+class CParallelWorkers
+{
+public:
+    typedef boost::function<void(unsigned int nStart, unsigned int nStep)> Function;
+
+    CParallelWorkers(const Function& fnIn, unsigned int nSharesIn, bool fCallerShareIn = true);
+    ~CParallelWorkers();
+
+    /** Run share 0 on the calling thread */
+    void RunShare();
+
+    /** Wait for the threads. An exception thrown by one of them is rethrown here as std::runtime_error. */
+    void Join();
+
+private:
+    CParallelWorkers(const CParallelWorkers&);
+    void operator=(const CParallelWorkers&);
+
+    Function fn;
+    unsigned int nShares;
+    bool fCallerShare;
+    boost::thread_group* pthreads;
+    bool fJoined;
+    //! error message of each share, written only by the thread running it
+    std::vector<std::string> vErrors;
+
+    void RunWorker(unsigned int nStart);
+    void JoinThreads();
+};
+
+/** Run fn(nStart, nShares) for every nStart below nShares, share 0 on the calling thread, and wait for all of them */
+void ParallelFor(unsigned int nShares, const CParallelWorkers::Function& fn);
+
 void SetThreadPriority(int nPriority); // ߳ȼ
 void RenameThread(const char* name); // ̺߳
 
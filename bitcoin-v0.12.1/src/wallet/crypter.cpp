@@ -8,8 +8,10 @@
 #include "script/standard.h"
 #include "util.h"
 
+#include <algorithm>
 #include <string>
 #include <vector>
+#include <boost/bind.hpp>
 #include <boost/foreach.hpp>
 #include <openssl/aes.h>
 #include <openssl/evp.h>
@@ -135,6 +137,21 @@ static bool DecryptKey(const CKeyingMaterial& vMasterKey, const std::vector<unsi
     return key.VerifyPubKey(vchPubKey); // ֤ȡ˽Կ빫ԿǷƥ
 }
 
+/** Decrypt every nStep-th key, starting at nStart, until one fails; the outcome is recorded at index nStart */
+static void CheckCryptedKeys(const CKeyingMaterial* pMasterKey, const std::vector<const std::pair<CPubKey, std::vector<unsigned char> >*>* pvKeys, std::vector<char>* pvPass, std::vector<char>* pvFail, unsigned int nStart, unsigned int nStep)
+{
+    for (unsigned int i = nStart; i < pvKeys->size(); i += nStep)
+    {
+        CKey key;
+        if (!DecryptKey(*pMasterKey, (*pvKeys)[i]->second, (*pvKeys)[i]->first, key))
+        {
+            (*pvFail)[nStart] = true;
+            return;
+        }
+        (*pvPass)[nStart] = true;
+    }
+}
+
 bool CCryptoKeyStore::SetCrypted() // ü״̬Ϊ true
 {
     LOCK(cs_KeyStore);
@@ -162,36 +179,50 @@ bool CCryptoKeyStore::Lock()
 
 bool CCryptoKeyStore::Unlock(const CKeyingMaterial& vMasterKeyIn)
 {
+    std::vector<std::pair<CPubKey, std::vector<unsigned char> > > vKeys;
     {
         LOCK(cs_KeyStore);
         if (!SetCrypted())
             return false;
 
-        bool keyPass = false;
-        bool keyFail = false;
+        // One key tells whether the master key is right; each key is // һԿжԿǷȷ
+        // checked against its public key again when it is used // ÿԿʹʱ乫Կ˶
         CryptedKeyMap::const_iterator mi = mapCryptedKeys.begin();
-        for (; mi != mapCryptedKeys.end(); ++mi)
-        {
-            const CPubKey &vchPubKey = (*mi).second.first;
-            const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second;
-            CKey key;
-            if (!DecryptKey(vMasterKeyIn, vchCryptedSecret, vchPubKey, key))
-            {
-                keyFail = true;
-                break;
-            }
-            keyPass = true;
-            if (fDecryptionThoroughlyChecked)
-                break;
-        }
-        if (keyPass && keyFail)
-        {
-            LogPrintf("The wallet is probably corrupted: Some keys decrypt but not all.\n");
-            assert(false);
-        }
-        if (keyFail || !keyPass)
+        if (mi == mapCryptedKeys.end())
+            return false;
+        CKey key;
+        if (!DecryptKey(vMasterKeyIn, (*mi).second.second, (*mi).second.first, key))
             return false;
         vMasterKey = vMasterKeyIn;
+        if (!fDecryptionThoroughlyChecked)
+        {
+            vKeys.reserve(mapCryptedKeys.size());
+            for (; mi != mapCryptedKeys.end(); ++mi)
+                vKeys.push_back((*mi).second);
+        }
+    }
+
+    // The first time, check every key, on several threads // ״νʱ̼߳ȫԿ
+    // and without cs_KeyStore, from copies of the keys
+    std::vector<const std::pair<CPubKey, std::vector<unsigned char> >*> vpKeys;
+    vpKeys.reserve(vKeys.size());
+    for (size_t i = 0; i < vKeys.size(); i++)
+        vpKeys.push_back(&vKeys[i]);
+    const int nThreads = std::max(1, std::min((int)std::min(vpKeys.size(), (size_t)MAX_UNLOCK_CHECK_THREADS), GetNumCores()));
+    std::vector<char> vPass(nThreads, false);
+    std::vector<char> vFail(nThreads, false);
+    if (!vpKeys.empty())
+        ParallelFor(nThreads, boost::bind(&CheckCryptedKeys, &vMasterKeyIn, &vpKeys, &vPass, &vFail, _1, _2));
+    if (std::count(vFail.begin(), vFail.end(), true) > 0)
+    {
+        LogPrintf("The wallet is probably corrupted: Some keys decrypt but not all.\n");
+        LOCK(cs_KeyStore);
+        vMasterKey.clear();
+        return false;
+    }
+    if (!vpKeys.empty())
+    {
+        LOCK(cs_KeyStore);
         fDecryptionThoroughlyChecked = true;
     }
     NotifyStatusChanged(this);
@@ -232,22 +263,35 @@ bool CCryptoKeyStore::AddCryptedKey(const CPubKey &vchPubKey, const std::vector<
     return true;
 }
 
+void CCryptoKeyStore::RemoveKey(const CKeyID &address)
+{
+    LOCK(cs_KeyStore);
+    if (!IsCrypted())
+        mapKeys.erase(address);
+    else
+        mapCryptedKeys.erase(address);
+}
+
 bool CCryptoKeyStore::GetKey(const CKeyID &address, CKey& keyOut) const
 {
+    CKeyingMaterial vMasterKeyCopy;
+    CPubKey vchPubKey;
+    std::vector<unsigned char> vchCryptedSecret;
     {
         LOCK(cs_KeyStore);
         if (!IsCrypted()) // ǰǮδ
             return CBasicKeyStore::GetKey(address, keyOut);
 
         CryptedKeyMap::const_iterator mi = mapCryptedKeys.find(address); // Կ͹Կ˽Կӳбв
-        if (mi != mapCryptedKeys.end()) // ҵ
-        {
-            const CPubKey &vchPubKey = (*mi).second.first; // ȡԿ
-            const std::vector<unsigned char> &vchCryptedSecret = (*mi).second.second; // ȡܵԿ
-            return DecryptKey(vMasterKey, vchCryptedSecret, vchPubKey, keyOut); // ˽Կ
-        }
+        if (mi == mapCryptedKeys.end())
+            return false;
+        vchPubKey = (*mi).second.first; // ȡԿ
+        vchCryptedSecret = (*mi).second.second; // ȡܵԿ
+        vMasterKeyCopy = vMasterKey;
     }
-    return false;
+    // Decrypting and checking the key against its public key is slow, so it
+    // runs unlocked: signing threads would otherwise take turns here
+    return DecryptKey(vMasterKeyCopy, vchCryptedSecret, vchPubKey, keyOut);
 }
 
 bool CCryptoKeyStore::GetPubKey(const CKeyID &address, CPubKey& vchPubKeyOut) const
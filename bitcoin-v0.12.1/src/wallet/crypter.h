@@ -13,6 +13,8 @@ class uint256;
 
 const unsigned int WALLET_CRYPTO_KEY_SIZE = 32; // ǮС
 const unsigned int WALLET_CRYPTO_SALT_SIZE = 8; // ǮֵС
+//! Maximum number of threads checking the crypted keys on the first unlock
+const int MAX_UNLOCK_CHECK_THREADS = 8;
 
 /**
  * Private key encryption is done based on a CMasterKey,
@@ -132,6 +134,9 @@ protected:
 
     bool Unlock(const CKeyingMaterial& vMasterKeyIn);
 
+    //! forget a key that was added but could not be written to the wallet file
+    void RemoveKey(const CKeyID &address); // ƳӵδдǮļԿ
+
 public:
     CCryptoKeyStore() : fUseCrypto(false), fDecryptionThoroughlyChecked(false)
     {
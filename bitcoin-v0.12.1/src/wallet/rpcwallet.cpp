@@ -1414,15 +1414,18 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
     if (!EnsureWalletIsAvailable(fHelp)) // ȷǰǮ
         return NullUniValue;
     
-    if (fHelp || params.size() > 4) // Ϊ 4 
+    if (fHelp || params.size() > 5) // Ϊ 5 
         throw runtime_error( // 
-            "listtransactions ( \"account\" count from includeWatchonly)\n"
+            "listtransactions ( \"account\" count from includeWatchonly before)\n"
             "\nReturns up to 'count' most recent transactions skipping the first 'from' transactions for account 'account'.\n"
             "\nArguments:\n"
             "1. \"account\"    (string, optional) DEPRECATED. The account name. Should be \"*\".\n"
             "2. count          (numeric, optional, default=10) The number of transactions to return\n"
             "3. from           (numeric, optional, default=0) The number of transactions to skip\n"
             "4. includeWatchonly (bool, optional, default=false) Include transactions to watchonly addresses (see 'importaddress')\n"
+            "5. before         (numeric, optional) Start at this orderpos instead of the most recent transaction; 'from' counts\n"
+            "                  from there. For the page before a result, pass the orderpos of its first (oldest) entry, and as\n"
+            "                  'from' the number of entries with that orderpos listed so far.\n"
             "\nResult:\n"
             "[\n"
             "  {\n"
@@ -1455,6 +1458,7 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
             "                                          for 'send' and 'receive' category of transactions.\n"
             "    \"comment\": \"...\",       (string) If a comment is associated with the transaction.\n"
             "    \"label\": \"label\"        (string) A comment for the address/transaction, if any\n"
+            "    \"orderpos\": n,           (numeric) The position of the transaction in the wallet, see 'before'.\n"
             "    \"otheraccount\": \"accountname\",  (string) For the 'move' category of transactions, the account the funds came \n"
             "                                          from (for receiving funds, positive amounts), or went to (for sending funds,\n"
             "                                          negative amounts).\n"
@@ -1468,6 +1472,8 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
             + HelpExampleCli("listtransactions", "") +
             "\nList transactions 100 to 120\n"
             + HelpExampleCli("listtransactions", "\"*\" 20 100") +
+            "\nList the 20 transactions before a page that starts with one entry at orderpos 1000\n"
+            + HelpExampleCli("listtransactions", "\"*\" 20 1 false 1000") +
             "\nAs a json rpc call\n"
             + HelpExampleRpc("listtransactions", "\"*\", 20, 100")
         );
@@ -1493,43 +1499,49 @@ UniValue listtransactions(const UniValue& params, bool fHelp)
     if (nFrom < 0) // ҪĽǸ
         throw JSONRPCError(RPC_INVALID_PARAMETER, "Negative from");
 
-    UniValue ret(UniValue::VARR); // ͵Ľ
-
     const CWallet::TxItems & txOrdered = pwalletMain->wtxOrdered; // ȡĽб
 
-    // iterate backwards until we have nCount items to return: // ֱ nCount Ŀ
-    for (CWallet::TxItems::const_reverse_iterator it = txOrdered.rbegin(); it != txOrdered.rend(); ++it)
+    // Pages further back start at the cursor instead of walking down to it. The
+    // transaction at the cursor is included, as a page may end inside it
+    CWallet::TxItems::const_reverse_iterator itStart = txOrdered.rbegin();
+    if (params.size() > 4)
+        itStart = CWallet::TxItems::const_reverse_iterator(txOrdered.upper_bound(params[4].get_int64()));
+
+    // iterate backwards until we have nCount items to return; the nFrom // ֱ nCount Ŀ
+    // entries before them are listed in short form, only to be counted // ĿֻԼʽгڼ
+    vector<UniValue> arrTmp;
+    for (CWallet::TxItems::const_reverse_iterator it = itStart; it != txOrdered.rend() && (int)arrTmp.size() < nCount; ++it)
     { // Ľб
         CWalletTx *const pwtx = (*it).second.first; // ȡǮ
-        if (pwtx != 0)
-            ListTransactions(*pwtx, strAccount, 0, true, ret, filter); // ȡϢ
         CAccountingEntry *const pacentry = (*it).second.second; // ȡӦ˻Ŀ
+        bool fLong = (nFrom == 0);
+        UniValue entries(UniValue::VARR);
+        if (pwtx != 0)
+            ListTransactions(*pwtx, strAccount, 0, fLong, entries, filter); // ȡϢ
         if (pacentry != 0)
-            AcentryToJSON(*pacentry, strAccount, ret); // ˻ĿתΪ JSON ʽ
+            AcentryToJSON(*pacentry, strAccount, entries); // ˻ĿתΪ JSON ʽ
 
-        if ((int)ret.size() >= (nCount+nFrom)) break; // Сڵ ҪȡĽҪĺͣ
+        if (nFrom >= (int)entries.size()) { // 
+            nFrom -= entries.size();
+            continue;
+        }
+        if (!fLong && pwtx != 0) { // ҳӸýм俪ʼг
+            entries.clear();
+            entries.setArray();
+            ListTransactions(*pwtx, strAccount, 0, true, entries, filter);
+        }
+        for (size_t i = nFrom; i < entries.size() && (int)arrTmp.size() < nCount; i++) {
+            UniValue entry = entries[i];
+            entry.push_back(Pair("orderpos", (*it).first));
+            arrTmp.push_back(entry);
+        }
+        nFrom = 0;
     }
-    // ret is newest to oldest // Ǵµ
-
-    if (nFrom > (int)ret.size()) // ССҪĽ
-        nFrom = ret.size(); // ҪĽڽС
-    if ((nFrom + nCount) > (int)ret.size())
-        nCount = ret.size() - nFrom;
-
-    vector<UniValue> arrTmp = ret.getValues(); // ȡеΪʱ
-
-    vector<UniValue>::iterator first = arrTmp.begin();
-    std::advance(first, nFrom); //  first  nFrom
-    vector<UniValue>::iterator last = arrTmp.begin();
-    std::advance(last, nFrom+nCount); //  last  nFrom+nCount
-
-    if (last != arrTmp.end()) arrTmp.erase(last, arrTmp.end()); // βಿ
-    if (first != arrTmp.begin()) arrTmp.erase(arrTmp.begin(), first); // ͷಿ
+    // arrTmp is newest to oldest // ʱǴµ
 
     std::reverse(arrTmp.begin(), arrTmp.end()); // Return oldest to newest // תΪϵ£бϵ£->
 
-    ret.clear(); // ս
-    ret.setArray(); // Ϊ
+    UniValue ret(UniValue::VARR); // ͵Ľ
     ret.push_backV(arrTmp); // ʱ
 
     return ret; // ؽ
@@ -1688,12 +1700,13 @@ UniValue listsinceblock(const UniValue& params, bool fHelp)
 
     UniValue transactions(UniValue::VARR); // ͵ĽϢ
 
-    for (map<uint256, CWalletTx>::iterator it = pwalletMain->mapWallet.begin(); it != pwalletMain->mapWallet.end(); it++) // Ǯӳб
+    // Only transactions outside the active chain or in its blocks above pindex can be less deep // ֻδָ֮ϵĽȿܸС
+    vector<const CWalletTx*> vWtx;
+    pwalletMain->GetTxsSinceHeight(pindex ? pindex->nHeight : -1, vWtx);
+    BOOST_FOREACH(const CWalletTx* pwtx, vWtx) // ЩǮ
     {
-        CWalletTx tx = (*it).second; // ȡǮ
-
-        if (depth == -1 || tx.GetDepthInMainChain() < depth) // δָ  ýСָ
-            ListTransactions(tx, "*", 0, true, transactions, filter); // ǮΪȡϢ
+        if (depth == -1 || pwtx->GetDepthInMainChain() < depth) // δָ  ýСָ
+            ListTransactions(*pwtx, "*", 0, true, transactions, filter); // ǮΪȡϢ
     }
 
     CBlockIndex *pblockLast = chainActive[chainActive.Height() + 1 - target_confirms]; // ȷΪ 1ȡ
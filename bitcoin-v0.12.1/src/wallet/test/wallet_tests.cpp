@@ -4,6 +4,11 @@
 
 #include "wallet/wallet.h"
 
+#include "chainparams.h"
+#include "main.h"
+#include "script/sign.h"
+
+#include <algorithm>
 #include <set>
 #include <stdint.h>
 #include <utility>
@@ -361,4 +366,417 @@ BOOST_AUTO_TEST_CASE(ApproximateBestSubset)
     BOOST_CHECK_EQUAL(setCoinsRet.size(), 101);
 }
 
+BOOST_AUTO_TEST_CASE(standard_scriptpubkeys)
+{
+    CWallet keystore;
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(false);
+    BOOST_CHECK(keystore.AddKey(key));
+
+    std::vector<CPubKey> vKeys(1, key.GetPubKey());
+    CScript scriptMine = GetScriptForMultisig(1, vKeys);
+    vKeys[0] = keyOther.GetPubKey();
+    CScript scriptOther = GetScriptForMultisig(1, vKeys);
+    BOOST_CHECK(keystore.AddCScript(scriptMine));
+    BOOST_CHECK(keystore.AddCScript(scriptOther));
+    CScript scriptWatched = GetScriptForDestination(CKeyID(uint160(ParseHex("0102030405060708090a0b0c0d0e0f1011121314"))));
+    BOOST_CHECK(keystore.AddWatchOnly(scriptWatched));
+
+    ScriptPubKeySet setScripts;
+    keystore.GetStandardScriptPubKeys(setScripts);
+
+    // For outputs of the standard forms, set membership is IsMine()
+    std::vector<CScript> vScripts;
+    vScripts.push_back(GetScriptForDestination(key.GetPubKey().GetID()));
+    vScripts.push_back(GetScriptForRawPubKey(key.GetPubKey()));
+    vScripts.push_back(GetScriptForDestination(CScriptID(scriptMine)));
+    vScripts.push_back(scriptWatched);
+    vScripts.push_back(GetScriptForDestination(keyOther.GetPubKey().GetID()));
+    vScripts.push_back(GetScriptForRawPubKey(keyOther.GetPubKey()));
+    vScripts.push_back(GetScriptForDestination(CScriptID(scriptOther)));
+    for (unsigned int i = 0; i < vScripts.size(); i++) {
+        BOOST_CHECK_EQUAL(setScripts.count(vScripts[i]) != 0, i < 4);
+        BOOST_CHECK_EQUAL(IsMine(keystore, vScripts[i]) != ISMINE_NO, i < 4);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(coin_selection_candidates)
+{
+    CoinSet setCoinsRet;
+    CAmount nValueRet;
+
+    LOCK(wallet.cs_wallet);
+
+    empty_wallet();
+
+    // Candidates are sorted by decreasing value once, with running totals
+    for (int i = 0; i < 10000; i++)
+        add_coin((i % 100 + 1) * CENT);
+    add_coin(1 * COIN, 3); // too new to be selected
+    CSelectionCandidates candidates;
+    candidates.Set(vCoins, 1, 6);
+    BOOST_CHECK_EQUAL(candidates.vValue.size(), 10000U);
+    BOOST_CHECK_EQUAL(candidates.vTotal[0], 505000 * CENT);
+    for (unsigned int i = 1; i < candidates.vValue.size(); i++)
+        BOOST_CHECK(candidates.vValue[i - 1].first >= candidates.vValue[i].first);
+
+    // and selected from for several targets; an exact subset is found among many coins
+    BOOST_CHECK(wallet.SelectCoinsMinConf(12345 * CENT, candidates, setCoinsRet, nValueRet));
+    BOOST_CHECK_EQUAL(nValueRet, 12345 * CENT);
+    BOOST_CHECK_EQUAL(setCoinsRet.size(), 124U);
+
+    // without one, the stochastic approximation still makes the target
+    BOOST_CHECK(wallet.SelectCoinsMinConf(12345 * CENT + 1, candidates, setCoinsRet, nValueRet));
+    BOOST_CHECK(nValueRet > 12345 * CENT);
+
+    BOOST_CHECK(!wallet.SelectCoinsMinConf(505001 * CENT, candidates, setCoinsRet, nValueRet));
+    empty_wallet();
+}
+
+// Pay nValue from the first output of prevTx to scriptPubKey in a new block, and add the payment to the wallet
+static CTransaction AddPayment(TestChain100Setup& setup, CWallet& wallet, const CKeyStore& keystore, const CTransaction& prevTx, const CScript& scriptPubKey, CAmount nValue)
+{
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(prevTx.GetHash(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = nValue;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+    BOOST_CHECK(SignSignature(keystore, prevTx, tx, 0));
+    CBlock block = setup.CreateAndProcessBlock(std::vector<CMutableTransaction>(1, tx), GetScriptForRawPubKey(setup.coinbaseKey.GetPubKey()));
+    CWalletTx wtx(&wallet, tx);
+    wtx.SetMerkleBranch(block);
+    BOOST_CHECK(wallet.AddToWallet(wtx, true, NULL));
+    return tx;
+}
+
+BOOST_FIXTURE_TEST_CASE(unspent_index, TestChain100Setup)
+{
+    CWallet walletUnspent;
+    LOCK2(cs_main, walletUnspent.cs_wallet);
+    CKey key, keyOther;
+    key.MakeNewKey(true);
+    keyOther.MakeNewKey(true);
+    BOOST_CHECK(walletUnspent.AddKey(key));
+    CBasicKeyStore keystoreCoinbase;
+    BOOST_CHECK(keystoreCoinbase.AddKey(coinbaseKey));
+
+    vector<COutput> vAvailable;
+    walletUnspent.AvailableCoins(vAvailable);
+    BOOST_CHECK(vAvailable.empty());
+
+    // Coins show up as they are received, and go once spent
+    CTransaction tx = AddPayment(*this, walletUnspent, keystoreCoinbase, coinbaseTxns[0], GetScriptForDestination(key.GetPubKey().GetID()), 11 * CENT);
+    walletUnspent.AvailableCoins(vAvailable);
+    BOOST_CHECK_EQUAL(vAvailable.size(), 1U);
+    BOOST_CHECK(vAvailable[0].tx->GetHash() == tx.GetHash());
+    BOOST_CHECK_EQUAL(walletUnspent.GetBalance(), 11 * CENT);
+
+    AddPayment(*this, walletUnspent, walletUnspent, tx, GetScriptForDestination(keyOther.GetPubKey().GetID()), 10 * CENT);
+    walletUnspent.AvailableCoins(vAvailable);
+    BOOST_CHECK(vAvailable.empty());
+    BOOST_CHECK_EQUAL(walletUnspent.GetBalance(), 0);
+
+    // Adding a key makes the earlier outputs paying to it available
+    walletUnspent.AddKey(keyOther);
+    walletUnspent.AvailableCoins(vAvailable);
+    BOOST_CHECK_EQUAL(vAvailable.size(), 1U);
+    BOOST_CHECK_EQUAL(walletUnspent.GetBalance(), 10 * CENT);
+}
+
+BOOST_FIXTURE_TEST_CASE(txs_since_height, TestChain100Setup)
+{
+    CWallet walletHeights;
+    LOCK2(cs_main, walletHeights.cs_wallet);
+    CBasicKeyStore keystoreCoinbase;
+    BOOST_CHECK(keystoreCoinbase.AddKey(coinbaseKey));
+    CScript scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    // Transactions in blocks 101 and 102, and one not in a block
+    CTransaction tx1 = AddPayment(*this, walletHeights, keystoreCoinbase, coinbaseTxns[0], scriptPubKey, 11 * CENT);
+    CTransaction tx2 = AddPayment(*this, walletHeights, keystoreCoinbase, coinbaseTxns[1], scriptPubKey, 12 * CENT);
+    CMutableTransaction tx3;
+    tx3.vin.resize(1);
+    tx3.vin[0].prevout = COutPoint(coinbaseTxns[2].GetHash(), 0);
+    tx3.vout.resize(1);
+    tx3.vout[0].nValue = 13 * CENT;
+    tx3.vout[0].scriptPubKey = scriptPubKey;
+    BOOST_CHECK(walletHeights.AddToWallet(CWalletTx(&walletHeights, tx3), true, NULL));
+
+    // Unconfirmed transactions come first, then the others by height
+    vector<const CWalletTx*> vWtx;
+    walletHeights.GetTxsSinceHeight(-1, vWtx);
+    BOOST_CHECK_EQUAL(vWtx.size(), 3U);
+    BOOST_CHECK(vWtx[0]->GetHash() == CTransaction(tx3).GetHash());
+    BOOST_CHECK(vWtx[1]->GetHash() == tx1.GetHash());
+    BOOST_CHECK(vWtx[2]->GetHash() == tx2.GetHash());
+
+    vWtx.clear();
+    walletHeights.GetTxsSinceHeight(101, vWtx);
+    BOOST_CHECK_EQUAL(vWtx.size(), 2U);
+    BOOST_CHECK(vWtx[0]->GetHash() == CTransaction(tx3).GetHash());
+    BOOST_CHECK(vWtx[1]->GetHash() == tx2.GetHash());
+
+    vWtx.clear();
+    walletHeights.GetTxsSinceHeight(102, vWtx);
+    BOOST_CHECK_EQUAL(vWtx.size(), 1U);
+}
+
+BOOST_FIXTURE_TEST_CASE(balances_cache, TestChain100Setup)
+{
+    CWallet walletBalances;
+    LOCK2(cs_main, walletBalances.cs_wallet);
+    BOOST_CHECK(walletBalances.AddKey(coinbaseKey));
+    CScript scriptPubKey = GetScriptForRawPubKey(coinbaseKey.GetPubKey());
+
+    // The coinbase of block 1 is one block short of maturity
+    CBlock block;
+    BOOST_CHECK(ReadBlockFromDisk(block, chainActive[1], Params().GetConsensus()));
+    CWalletTx wtxCoinbase(&walletBalances, block.vtx[0]);
+    wtxCoinbase.SetMerkleBranch(block);
+    BOOST_CHECK(walletBalances.AddToWallet(wtxCoinbase, true, NULL));
+    CAmount nCoinbase = block.vtx[0].GetValueOut();
+    BOOST_CHECK_EQUAL(walletBalances.GetImmatureBalance(), nCoinbase);
+    BOOST_CHECK_EQUAL(walletBalances.GetBalance(), 0);
+
+    // A payment that is not in a block counts while it is in the mempool
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(coinbaseTxns[1].GetHash(), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = 5 * CENT;
+    tx.vout[0].scriptPubKey = scriptPubKey;
+    BOOST_CHECK(walletBalances.AddToWallet(CWalletTx(&walletBalances, tx), true, NULL));
+    BOOST_CHECK_EQUAL(walletBalances.GetUnconfirmedBalance(), 0);
+
+    TestMemPoolEntryHelper entry;
+    mempool.addUnchecked(tx.GetHash(), entry.FromTx(tx));
+    BOOST_CHECK_EQUAL(walletBalances.GetUnconfirmedBalance(), 5 * CENT);
+    BOOST_CHECK_EQUAL(walletBalances.GetImmatureBalance(), nCoinbase);
+
+    std::list<CTransaction> removed;
+    mempool.remove(tx, removed);
+    BOOST_CHECK_EQUAL(walletBalances.GetUnconfirmedBalance(), 0);
+
+    // A new tip matures the coinbase
+    CreateAndProcessBlock(std::vector<CMutableTransaction>(), scriptPubKey);
+    BOOST_CHECK_EQUAL(walletBalances.GetImmatureBalance(), 0);
+    BOOST_CHECK_EQUAL(walletBalances.GetBalance(), nCoinbase);
+    BOOST_CHECK_EQUAL(walletBalances.GetUnconfirmedBalance(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(generate_new_keys)
+{
+    CWallet walletKeys;
+    LOCK(walletKeys.cs_wallet);
+
+    // Keys made on several threads are all different and added to the wallet
+    vector<CPubKey> vPubKeys;
+    walletKeys.GenerateNewKeys(100, vPubKeys);
+    BOOST_CHECK_EQUAL(vPubKeys.size(), 100U);
+    set<CKeyID> setKeyIDs;
+    BOOST_FOREACH(const CPubKey& pubkey, vPubKeys) {
+        CKey key;
+        BOOST_CHECK(walletKeys.GetKey(pubkey.GetID(), key));
+        BOOST_CHECK(key.GetPubKey() == pubkey);
+        BOOST_CHECK(walletKeys.mapKeyMetadata.count(pubkey.GetID()));
+        setKeyIDs.insert(pubkey.GetID());
+    }
+    BOOST_CHECK_EQUAL(setKeyIDs.size(), 100U);
+}
+
+/** Wallet that refuses new keys after a number of them, to abort a keypool refill */
+class CFailingKeyWallet : public CWallet
+{
+public:
+    int nKeysLeft;
+
+    CFailingKeyWallet(const std::string& strWalletFileIn, int nKeysLeftIn) : CWallet(strWalletFileIn), nKeysLeft(nKeysLeftIn) {}
+
+    bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey)
+    {
+        if (nKeysLeft-- <= 0)
+            return false;
+        return CWallet::AddKeyPubKey(key, pubkey);
+    }
+};
+
+BOOST_AUTO_TEST_CASE(keypool_refill_abort)
+{
+    CFailingKeyWallet walletKeys("wallet_keypool.dat", KEYPOOL_REFILL_BATCH_SIZE + 10);
+    bool fFirstRun;
+    BOOST_CHECK_EQUAL(walletKeys.LoadWallet(fFirstRun), DB_LOAD_OK);
+    LOCK(walletKeys.cs_wallet);
+
+    // The second batch of the refill fails: the first one is committed, the keys of the second are forgotten
+    BOOST_CHECK_THROW(walletKeys.TopUpKeyPool(KEYPOOL_REFILL_BATCH_SIZE + 99), std::runtime_error);
+    BOOST_CHECK_EQUAL(walletKeys.GetKeyPoolSize(), KEYPOOL_REFILL_BATCH_SIZE);
+    set<CKeyID> setKeyIDs;
+    walletKeys.GetKeys(setKeyIDs);
+    BOOST_CHECK_EQUAL(setKeyIDs.size(), KEYPOOL_REFILL_BATCH_SIZE);
+    BOOST_CHECK_EQUAL(walletKeys.mapKeyMetadata.size(), KEYPOOL_REFILL_BATCH_SIZE);
+
+    CWalletDB walletdb("wallet_keypool.dat");
+    CKeyPool keypool;
+    BOOST_FOREACH(int64_t nIndex, walletKeys.setKeyPool) {
+        BOOST_CHECK(walletdb.ReadPool(nIndex, keypool));
+        BOOST_CHECK(walletKeys.HaveKey(keypool.vchPubKey.GetID()));
+    }
+    BOOST_CHECK(!walletdb.ReadPool(KEYPOOL_REFILL_BATCH_SIZE + 1, keypool));
+
+    // Once keys are accepted again, the refill completes
+    walletKeys.nKeysLeft = KEYPOOL_REFILL_BATCH_SIZE;
+    BOOST_CHECK(walletKeys.TopUpKeyPool(KEYPOOL_REFILL_BATCH_SIZE + 99));
+    BOOST_CHECK_EQUAL(walletKeys.GetKeyPoolSize(), KEYPOOL_REFILL_BATCH_SIZE + 100);
+    BOOST_CHECK(walletdb.ReadPool(KEYPOOL_REFILL_BATCH_SIZE + 100, keypool));
+}
+
+/** Key store that lets a test encrypt and unlock it directly */
+class CUnlockTestKeyStore : public CCryptoKeyStore
+{
+public:
+    bool EncryptKeys(CKeyingMaterial& vMasterKeyIn) { return CCryptoKeyStore::EncryptKeys(vMasterKeyIn); }
+    bool Unlock(const CKeyingMaterial& vMasterKeyIn) { return CCryptoKeyStore::Unlock(vMasterKeyIn); }
+};
+
+BOOST_AUTO_TEST_CASE(unlock_checks_all_keys)
+{
+    CKeyingMaterial vMasterKey(WALLET_CRYPTO_KEY_SIZE, 1);
+    CKeyingMaterial vWrongKey(WALLET_CRYPTO_KEY_SIZE, 2);
+    CUnlockTestKeyStore keystore;
+    vector<CPubKey> vPubKeys;
+    for (int i = 0; i < 20; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        vPubKeys.push_back(key.GetPubKey());
+        BOOST_CHECK(keystore.AddKeyPubKey(key, key.GetPubKey()));
+    }
+    BOOST_CHECK(keystore.EncryptKeys(vMasterKey));
+    BOOST_CHECK(keystore.IsLocked());
+
+    // A wrong master key fails on the first key
+    BOOST_CHECK(!keystore.Unlock(vWrongKey));
+    BOOST_CHECK(keystore.IsLocked());
+
+    // Add a key that does not decrypt, after the first one in key order
+    CKeyID firstID = vPubKeys[0].GetID();
+    BOOST_FOREACH(const CPubKey& pubkey, vPubKeys)
+        firstID = std::min(firstID, pubkey.GetID());
+    CPubKey badPubKey;
+    do {
+        CKey key;
+        key.MakeNewKey(true);
+        badPubKey = key.GetPubKey();
+    } while (badPubKey.GetID() < firstID);
+    BOOST_CHECK(keystore.AddCryptedKey(badPubKey, vector<unsigned char>(48, 0x55)));
+
+    // The right master key decrypts the first key, but the full check reports the bad one
+    BOOST_CHECK(!keystore.Unlock(vMasterKey));
+    BOOST_CHECK(keystore.IsLocked());
+    BOOST_FOREACH(const CPubKey& pubkey, vPubKeys) {
+        CKey key;
+        BOOST_CHECK(keystore.HaveKey(pubkey.GetID()));
+        BOOST_CHECK(!keystore.GetKey(pubkey.GetID(), key));
+    }
+    BOOST_CHECK(!keystore.Unlock(vMasterKey));
+
+    // Without the bad key, the wallet unlocks, and later unlocks skip the full check
+    CUnlockTestKeyStore keystoreGood;
+    for (int i = 0; i < 20; i++) {
+        CKey key;
+        key.MakeNewKey(true);
+        BOOST_CHECK(keystoreGood.AddKeyPubKey(key, key.GetPubKey()));
+    }
+    BOOST_CHECK(keystoreGood.EncryptKeys(vMasterKey));
+    BOOST_CHECK(keystoreGood.Unlock(vMasterKey));
+    BOOST_CHECK(!keystoreGood.IsLocked());
+    BOOST_CHECK(keystoreGood.Lock());
+    BOOST_CHECK(keystoreGood.Unlock(vMasterKey));
+}
+
+class CLoadTestWalletDB : public CWalletDB
+{
+public:
+    CLoadTestWalletDB(const string& strFilename) : CWalletDB(strFilename) {}
+
+    template <typename K, typename T>
+    bool WriteRaw(const K& key, const T& value) { return Write(key, value); }
+};
+
+BOOST_AUTO_TEST_CASE(load_wallet_batches)
+{
+    // More records than fit in one batch; every transaction has the same order
+    // position, so wtxOrdered keeps them in the order they were loaded
+    const unsigned int nTxs = WALLET_LOAD_BATCH_SIZE + 1000;
+    vector<uint256> vHashes;
+    {
+        CWalletDB walletdb("wallet_load.dat", "cr+");
+        for (unsigned int i = 0; i < nTxs; i++) {
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].prevout = COutPoint(uint256S("0x01"), i);
+            tx.vout.push_back(CTxOut(i + 1, CScript() << OP_TRUE));
+            CWalletTx wtx(NULL, tx);
+            wtx.nOrderPos = 0;
+            BOOST_CHECK(walletdb.WriteTx(wtx.GetHash(), wtx));
+            vHashes.push_back(wtx.GetHash());
+        }
+    }
+    // Records come out of the database sorted by key, so by hash
+    vector<uint256> vSorted(vHashes);
+    sort(vSorted.begin(), vSorted.end());
+
+    // A transaction stored under a hash that is not its own, in the middle of the first batch
+    uint256 hashCorrupt = vSorted[WALLET_LOAD_BATCH_SIZE / 2];
+    *hashCorrupt.begin() ^= 1;
+    BOOST_CHECK(find(vSorted.begin(), vSorted.end(), hashCorrupt) == vSorted.end());
+    {
+        CMutableTransaction tx;
+        tx.vout.push_back(CTxOut(1, CScript() << OP_TRUE));
+        CWalletDB walletdb("wallet_load.dat");
+        BOOST_CHECK(walletdb.WriteTx(hashCorrupt, CWalletTx(NULL, tx)));
+    }
+
+    // A bad transaction is a noncritical error: all the others load, in order
+    {
+        CWallet walletLoad("wallet_load.dat");
+        bool fFirstRun;
+        BOOST_CHECK_EQUAL(walletLoad.LoadWallet(fFirstRun), DB_NONCRITICAL_ERROR);
+        BOOST_CHECK(GetBoolArg("-rescan", false));
+        mapArgs.erase("-rescan");
+        LOCK(walletLoad.cs_wallet);
+        BOOST_CHECK_EQUAL(walletLoad.mapWallet.size(), nTxs);
+        BOOST_CHECK(!walletLoad.mapWallet.count(hashCorrupt));
+        for (unsigned int i = 0; i < nTxs; i++) {
+            const CWalletTx* wtx = walletLoad.GetWalletTx(vHashes[i]);
+            BOOST_CHECK(wtx && wtx->vout[0].nValue == i + 1);
+        }
+        BOOST_CHECK_EQUAL(walletLoad.wtxOrdered.size(), nTxs);
+        unsigned int nPos = 0;
+        for (CWallet::TxItems::const_iterator it = walletLoad.wtxOrdered.begin(); it != walletLoad.wtxOrdered.end() && nPos < nTxs; ++it, ++nPos)
+            BOOST_CHECK(it->second.first->GetHash() == vSorted[nPos]);
+    }
+
+    // A bad key is still fatal, wherever it is in its batch
+    {
+        CLoadTestWalletDB walletdb("wallet_load.dat");
+        for (int i = 0; i < 100; i++) {
+            CKey key;
+            key.MakeNewKey(true);
+            BOOST_CHECK(walletdb.WriteKey(key.GetPubKey(), key.GetPrivKey(), CKeyMetadata()));
+        }
+        // Old style record without the hash, holding some other private key
+        CKey key, keyOther;
+        key.MakeNewKey(true);
+        keyOther.MakeNewKey(true);
+        BOOST_CHECK(walletdb.WriteRaw(make_pair(string("key"), key.GetPubKey()), keyOther.GetPrivKey()));
+    }
+    {
+        CWallet walletLoad("wallet_load.dat");
+        bool fFirstRun;
+        BOOST_CHECK_EQUAL(walletLoad.LoadWallet(fFirstRun), DB_CORRUPT);
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -11,6 +11,7 @@
 #include "coincontrol.h"
 #include "consensus/consensus.h"
 #include "consensus/validation.h"
+#include "hash.h"
 #include "key.h"
 #include "keystore.h"
 #include "main.h"
@@ -18,6 +19,7 @@
 #include "policy/policy.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
+#include "random.h"
 #include "script/script.h"
 #include "script/sign.h"
 #include "timedata.h"
@@ -26,8 +28,10 @@
 #include "utilmoneystr.h"
 
 #include <assert.h>
+#include <limits>
 
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/thread.hpp>
 
@@ -82,30 +86,66 @@ const CWalletTx* CWallet::GetWalletTx(const uint256& hash) const
     return &(it->second);
 }
 
+void CWallet::GetTxsSinceHeight(int nHeight, std::vector<const CWalletTx*>& vWtx) const
+{
+    AssertLockHeld(cs_wallet); // mapTxsByHeight
+    TxHeights::const_iterator it = mapTxsByHeight.begin();
+    for (; it != mapTxsByHeight.end() && it->first < 0; ++it) // δĽ
+        vWtx.push_back(&mapWallet.find(it->second)->second);
+    for (it = mapTxsByHeight.upper_bound(std::max(nHeight, -1)); it != mapTxsByHeight.end(); ++it)
+        vWtx.push_back(&mapWallet.find(it->second)->second);
+}
+
 CPubKey CWallet::GenerateNewKey()
+{
+    std::vector<CPubKey> vPubKeys;
+    GenerateNewKeys(1, vPubKeys);
+    return vPubKeys[0]; // ضӦĹԿ
+}
+
+/** Make every nStep-th key, starting at nStart, and its public key */
+static void MakeNewKeys(std::vector<CKey>* pvSecrets, std::vector<CPubKey>* pvPubKeys, bool fCompressed, unsigned int nStart, unsigned int nStep)
+{
+    for (unsigned int i = nStart; i < pvSecrets->size(); i += nStep)
+    {
+        CKey& secret = (*pvSecrets)[i];
+        secret.MakeNewKey(fCompressed); // һʼ˽Կע߽磬½Ϊ 1
+        (*pvPubKeys)[i] = secret.GetPubKey(); // ȡ˽ԿӦĹԿԲ߼㷨
+        assert(secret.VerifyPubKey((*pvPubKeys)[i])); // ֤˽ԿԿǷƥ
+    }
+}
+
+void CWallet::GenerateNewKeys(unsigned int nKeys, std::vector<CPubKey>& vPubKeys)
 {
     AssertLockHeld(cs_wallet); // mapKeyMetadata
     bool fCompressed = CanSupportFeature(FEATURE_COMPRPUBKEY); // default to compressed public keys if we want 0.6.0 wallets
 
-    CKey secret; // һ˽Կ
-    secret.MakeNewKey(fCompressed); // һʼ˽Կע߽磬½Ϊ 1
+    // The elliptic curve work is done on several threads; the keys are // Բڶ߳ɣ
+    // encrypted and stored one by one afterwards // ֮ܲ洢Կ
+    std::vector<CKey> vSecrets(nKeys);
+    vPubKeys.assign(nKeys, CPubKey());
+    const int nThreads = std::max(1, std::min(std::min(GetNumCores(), MAX_KEYGEN_THREADS), (int)nKeys));
+    ParallelFor(nThreads, boost::bind(&MakeNewKeys, &vSecrets, &vPubKeys, fCompressed, _1, _2));
 
     // Compressed public keys were introduced in version 0.6.0
     if (fCompressed) // ǷѹԿ0.6.0 
-        SetMinVersion(FEATURE_COMPRPUBKEY);
-
-    CPubKey pubkey = secret.GetPubKey(); // ȡ˽ԿӦĹԿԲ߼㷨
-    assert(secret.VerifyPubKey(pubkey)); // ֤˽ԿԿǷƥ
+        SetMinVersion(FEATURE_COMPRPUBKEY, pwalletdbBatch);
 
     // Create new metadata // Ԫ/м
     int64_t nCreationTime = GetTime(); // ȡǰʱ
-    mapKeyMetadata[pubkey.GetID()] = CKeyMetadata(nCreationTime);
-    if (!nTimeFirstKey || nCreationTime < nTimeFirstKey)
+    if (nKeys > 0 && (!nTimeFirstKey || nCreationTime < nTimeFirstKey))
         nTimeFirstKey = nCreationTime;
 
-    if (!AddKeyPubKey(secret, pubkey))
-        throw std::runtime_error("CWallet::GenerateNewKey(): AddKey failed");
-    return pubkey; // ضӦĹԿ
+    bool fWasStale = fUnspentTxsStale;
+    bool fWasDirty = fBalancesDirty;
+    for (unsigned int i = 0; i < nKeys; i++)
+    {
+        mapKeyMetadata[vPubKeys[i].GetID()] = CKeyMetadata(nCreationTime);
+        if (!AddKeyPubKey(vSecrets[i], vPubKeys[i]))
+            throw std::runtime_error("CWallet::GenerateNewKey(): AddKey failed");
+    }
+    fUnspentTxsStale = fWasStale; // Կκ
+    fBalancesDirty = fWasDirty;
 }
 
 bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
@@ -113,6 +153,8 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     AssertLockHeld(cs_wallet); // mapKeyMetadata
     if (!CCryptoKeyStore::AddKeyPubKey(secret, pubkey))
         return false;
+    fUnspentTxsStale = true; // н׵Լ
+    fBalancesDirty = true;
 
     // check if we need to remove from watch-only
     CScript script;
@@ -126,6 +168,10 @@ bool CWallet::AddKeyPubKey(const CKey& secret, const CPubKey &pubkey)
     if (!fFileBacked)
         return true;
     if (!IsCrypted()) {
+        if (pwalletdbBatch)
+            return pwalletdbBatch->WriteKey(pubkey,
+                                            secret.GetPrivKey(),
+                                            mapKeyMetadata[pubkey.GetID()]);
         return CWalletDB(strWalletFile).WriteKey(pubkey,
                                                  secret.GetPrivKey(),
                                                  mapKeyMetadata[pubkey.GetID()]);
@@ -146,6 +192,10 @@ bool CWallet::AddCryptedKey(const CPubKey &vchPubKey,
             return pwalletdbEncryption->WriteCryptedKey(vchPubKey,
                                                         vchCryptedSecret,
                                                         mapKeyMetadata[vchPubKey.GetID()]);
+        else if (pwalletdbBatch)
+            return pwalletdbBatch->WriteCryptedKey(vchPubKey,
+                                                   vchCryptedSecret,
+                                                   mapKeyMetadata[vchPubKey.GetID()]);
         else
             return CWalletDB(strWalletFile).WriteCryptedKey(vchPubKey,
                                                             vchCryptedSecret,
@@ -173,6 +223,8 @@ bool CWallet::AddCScript(const CScript& redeemScript)
 {
     if (!CCryptoKeyStore::AddCScript(redeemScript))
         return false;
+    fUnspentTxsStale = true;
+    fBalancesDirty = true;
     if (!fFileBacked)
         return true;
     return CWalletDB(strWalletFile).WriteCScript(Hash160(redeemScript), redeemScript);
@@ -198,6 +250,8 @@ bool CWallet::AddWatchOnly(const CScript &dest)
 {
     if (!CCryptoKeyStore::AddWatchOnly(dest)) //  watch-only ַԿ
         return false;
+    fUnspentTxsStale = true;
+    fBalancesDirty = true;
     nTimeFirstKey = 1; // No birthday information for watch-only keys. // watch-only ԿûдʱϢ
     NotifyWatchonlyChanged(true); // ֪ͨ watch-only ַѸı
     if (!fFileBacked)
@@ -473,6 +527,7 @@ bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
 void CWallet::AddToSpends(const COutPoint& outpoint, const uint256& wtxid)
 {
     mapTxSpends.insert(make_pair(outpoint, wtxid));
+    setUnspentTxsToCheck.insert(outpoint.hash); // ѵĽ׿δ
 
     pair<TxSpends::iterator, TxSpends::iterator> range;
     range = mapTxSpends.equal_range(outpoint);
@@ -605,6 +660,25 @@ void CWallet::MarkDirty()
     }
 }
 
+void CWallet::UpdateTxHeight(const CWalletTx& wtx)
+{
+    int nHeight = -1;
+    if (!wtx.hashUnset() && wtx.nIndex != -1) { // ǳͻҷĽ
+        BlockMap::iterator mi = mapBlockIndex.find(wtx.hashBlock);
+        if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second))
+            nHeight = mi->second->nHeight;
+    }
+
+    const uint256& hash = wtx.GetHash();
+    std::map<uint256, TxHeights::iterator>::iterator it = mapTxHeightPos.find(hash);
+    if (it == mapTxHeightPos.end()) {
+        mapTxHeightPos.insert(std::make_pair(hash, mapTxsByHeight.insert(std::make_pair(nHeight, hash))));
+    } else if (it->second->first != nHeight) {
+        mapTxsByHeight.erase(it->second);
+        it->second = mapTxsByHeight.insert(std::make_pair(nHeight, hash));
+    }
+}
+
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb)
 {
     uint256 hash = wtxIn.GetHash();
@@ -615,6 +689,9 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         CWalletTx& wtx = mapWallet[hash];
         wtx.BindWallet(this);
         wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
+        setUnspentTxs.insert(hash);
+        setUnspentTxsToCheck.insert(hash);
+        UpdateTxHeight(wtx);
         AddToSpends(hash);
         BOOST_FOREACH(const CTxIn& txin, wtx.vin) {
             if (mapWallet.count(txin.prevout.hash)) {
@@ -637,6 +714,8 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         {
             wtx.nTimeReceived = GetAdjustedTime();
             wtx.nOrderPos = IncOrderPosNext(pwalletdb);
+            setUnspentTxs.insert(hash); // ½׿Լ
+            setUnspentTxsToCheck.insert(hash);
             wtxOrdered.insert(make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
 
             wtx.nTimeSmart = wtx.nTimeReceived;
@@ -713,6 +792,9 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
             }
         }
 
+        // Also refiles transactions whose block was disconnected
+        UpdateTxHeight(wtx);
+
         //// debug print
         LogPrintf("AddToWallet %s  %s%s\n", wtxIn.GetHash().ToString(), (fInsertedNew ? "new" : ""), (fUpdated ? "update" : ""));
 
@@ -818,6 +900,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             wtx.nIndex = -1;
             wtx.setAbandoned(); // ǮױΪ
             wtx.MarkDirty(); // Ǹýѱ䶯
+            UpdateTxHeight(wtx); // ƳĽ
             wtx.WriteToDisk(&walletdb); // дǮݿ
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them abandoned too // еǮеĽΪ
@@ -832,8 +915,10 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed // ǿ¼㡣
             BOOST_FOREACH(const CTxIn& txin, wtx.vin)
             {
-                if (mapWallet.count(txin.prevout.hash)) // ǰһʽ׵Ǯ
+                if (mapWallet.count(txin.prevout.hash)) { // ǰһʽ׵Ǯ
                     mapWallet[txin.prevout.hash].MarkDirty(); // ѸýӦǮױΪѸı
+                    setUnspentTxs.insert(txin.prevout.hash); // ±Ϊδ
+                }
             }
         }
     }
@@ -880,6 +965,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             wtx.nIndex = -1;
             wtx.hashBlock = hashBlock;
             wtx.MarkDirty();
+            UpdateTxHeight(wtx);
             wtx.WriteToDisk(&walletdb);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them conflicted too
             TxSpends::const_iterator iter = mapTxSpends.lower_bound(COutPoint(now, 0));
@@ -893,8 +979,10 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             // available of the outputs it spends. So force those to be recomputed
             BOOST_FOREACH(const CTxIn& txin, wtx.vin)
             {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    setUnspentTxs.insert(txin.prevout.hash);
+                }
             }
         }
     }
@@ -1176,21 +1264,131 @@ void CWalletTx::GetAccountAmounts(const string& strAccount, CAmount& nReceived,
 }
 
 
+void CWalletTx::MarkDirty()
+{
+    fCreditCached = false;
+    fAvailableCreditCached = false;
+    fWatchDebitCached = false;
+    fWatchCreditCached = false;
+    fAvailableWatchCreditCached = false;
+    fImmatureWatchCreditCached = false;
+    fDebitCached = false;
+    fChangeCached = false;
+    if (pwallet)
+        pwallet->MarkBalancesDirty(); // ǮҲ¼
+}
+
 bool CWalletTx::WriteToDisk(CWalletDB *pwalletdb)
 {
     return pwalletdb->WriteTx(GetHash(), *this);
 }
 
+CScriptHasher::CScriptHasher() : k0(GetRand(std::numeric_limits<uint64_t>::max())), k1(GetRand(std::numeric_limits<uint64_t>::max()))
+{
+}
+
+size_t CScriptHasher::operator()(const CScript& script) const
+{
+    return CSipHasher(k0, k1).Write(script.empty() ? NULL : &script[0], script.size()).Finalize();
+}
+
+void CWallet::GetStandardScriptPubKeys(ScriptPubKeySet& setScripts) const
+{
+    std::set<CKeyID> setKeyIDs;
+    GetKeys(setKeyIDs); // ǮͬȫԿ
+    BOOST_FOREACH(const CKeyID& keyID, setKeyIDs) {
+        setScripts.insert(GetScriptForDestination(keyID)); // P2PKH
+        CPubKey pubkey;
+        if (GetPubKey(keyID, pubkey))
+            setScripts.insert(GetScriptForRawPubKey(pubkey)); // P2PK
+    }
+
+    LOCK(cs_KeyStore);
+    BOOST_FOREACH(const ScriptMap::value_type& item, mapScripts) {
+        if (::IsMine(*this, item.second) == ISMINE_SPENDABLE) // ͬ IsMine  P2SH ж
+            setScripts.insert(GetScriptForDestination(item.first));
+    }
+    setScripts.insert(setWatchOnly.begin(), setWatchOnly.end());
+}
+
+/**
+ * Whether scriptPubKey is in one of the forms covered by
+ * GetStandardScriptPubKeys(), exactly as Solver() recognizes them.
+ */ // ǷΪ P2SHP2PKH  P2PK ʽĽű
+static bool IsStandardScriptPubKey(const CScript& script)
+{
+    if (script.IsPayToScriptHash())
+        return true;
+    if (script.size() == 25) // OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG
+        return script[0] == OP_DUP && script[1] == OP_HASH160 && script[2] == 20 && script[23] == OP_EQUALVERIFY && script[24] == OP_CHECKSIG;
+    if (script.size() == 35 || script.size() == 67) // <pubkey> OP_CHECKSIG
+        return script[0] == script.size() - 2 && script[script.size() - 1] == OP_CHECKSIG;
+    return false;
+}
+
+/** Blocks of a rescan, read and matched against the wallet by reader threads */
+struct CRescanBatch
+{
+    std::vector<CBlockIndex*> vIndex;
+    std::vector<CDiskBlockPos> vBlockPos;
+    std::vector<CBlock> vBlocks;
+    //! per block and transaction: whether one of its outputs is mine
+    std::vector<std::vector<char> > vMatches;
+
+    /** Take up to WALLET_RESCAN_BATCH_SIZE blocks of the active chain from pindex on, and return the block after them */
+    CBlockIndex* Fill(CBlockIndex* pindex)
+    {
+        AssertLockHeld(cs_main);
+        vIndex.clear();
+        vBlockPos.clear();
+        for (; pindex && vIndex.size() < WALLET_RESCAN_BATCH_SIZE; pindex = chainActive.Next(pindex)) {
+            vIndex.push_back(pindex);
+            vBlockPos.push_back(pindex->GetBlockPos());
+        }
+        vBlocks.assign(vIndex.size(), CBlock());
+        vMatches.assign(vIndex.size(), std::vector<char>());
+        return pindex;
+    }
+};
+
+/** Read every nStep-th block of the batch, starting at nStart, and flag the transactions paying to the wallet */
+static void ReadRescanBlocks(const CWallet* pwallet, const ScriptPubKeySet* psetScripts, CRescanBatch* pbatch, unsigned int nStart, unsigned int nStep)
+{
+    const Consensus::Params& consensusParams = Params().GetConsensus();
+    for (unsigned int i = nStart; i < pbatch->vBlockPos.size(); i += nStep) {
+        CBlock& block = pbatch->vBlocks[i];
+        if (!ReadBlockFromDisk(block, pbatch->vBlockPos[i], consensusParams))
+            block.SetNull(); // ͬɨʱһȡʧܵ
+        std::vector<char>& vMatches = pbatch->vMatches[i];
+        vMatches.assign(block.vtx.size(), false);
+        for (unsigned int j = 0; j < block.vtx.size(); j++) {
+            BOOST_FOREACH(const CTxOut& txout, block.vtx[j].vout) {
+                // Scripts of the common forms are looked up, others are solved
+                const CScript& script = txout.scriptPubKey;
+                if (IsStandardScriptPubKey(script) ? psetScripts->count(script) != 0 : ::IsMine(*pwallet, script) != ISMINE_NO) {
+                    vMatches[j] = true;
+                    break;
+                }
+            }
+        }
+    }
+}
+
 /**
  * Scan the block chain (starting in pindexStart) for transactions
  * from or to us. If fUpdate is true, found transactions that already
  * exist in the wallet will be updated.
+ *
+ * Blocks are read in batches by reader threads, which also match their
+ * outputs against the wallet's scriptPubKeys. The readers work on the next
+ * batch while the transactions of the current one are added to the wallet.
  */ // ɨ pindexStart ʼĽס fUpdate Ϊ trueǮѴڵҵĽ׽
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
     int ret = 0; // ֻҪһʣֵͻ +1
     int64_t nNow = GetTime(); // ȡǰʱ
     const CChainParams& chainParams = Params(); // ȡ
+    const int nThreads = std::max(1, std::min(GetNumCores(), MAX_RESCAN_READ_THREADS)); // ߳
 
     CBlockIndex* pindex = pindexStart; // õʼ
     {
@@ -1201,26 +1399,46 @@ int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
         while (pindex && nTimeFirstKey && (pindex->GetBlockTime() < (nTimeFirstKey - 7200))) // ʱǮǰ 2h
             pindex = chainActive.Next(pindex); // 
 
+        ScriptPubKeySet setScripts; // Ǯӵеı׼ʽűɨڼ䲻
+        GetStandardScriptPubKeys(setScripts);
+
         ShowProgress(_("Rescanning..."), 0); // show rescan progress in GUI as dialog or on splashscreen, if -rescan on startup
         double dProgressStart = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false);
         double dProgressTip = Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), chainActive.Tip(), false);
-        while (pindex) // 
-        {
-            if (pindex->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0) // ɨ
-                ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex, false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
 
-            CBlock block;
-            ReadBlockFromDisk(block, pindex, Params().GetConsensus()); // Ӵ϶ȡϢ
-            BOOST_FOREACH(CTransaction& tx, block.vtx) // 齻б
-            {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate)) // һʽ
-                    ret++;
+        CRescanBatch batches[2];
+        int nCurrent = 0;
+        pindex = batches[nCurrent].Fill(pindex);
+        ParallelFor(nThreads, boost::bind(&ReadRescanBlocks, this, &setScripts, &batches[nCurrent], _1, _2));
+        while (!batches[nCurrent].vIndex.empty())
+        {
+            const CRescanBatch& batch = batches[nCurrent];
+            CRescanBatch& batchNext = batches[1 - nCurrent];
+            pindex = batchNext.Fill(pindex); // Ԥһ
+            CParallelWorkers readers(boost::bind(&ReadRescanBlocks, this, &setScripts, &batchNext, _1, _2), nThreads, false); // ͬʱȡһ
+            for (unsigned int i = 0; i < batch.vIndex.size(); i++) {
+                if (batch.vIndex[i]->nHeight % 100 == 0 && dProgressTip - dProgressStart > 0.0) // ɨ
+                    ShowProgress(_("Rescanning..."), std::max(1, std::min(99, (int)((Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), batch.vIndex[i], false) - dProgressStart) / (dProgressTip - dProgressStart) * 100))));
+
+                const CBlock& block = batch.vBlocks[i];
+                for (unsigned int j = 0; j < block.vtx.size(); j++) // 齻б
+                {
+                    // Transactions that neither pay to the wallet, nor are in it, nor spend
+                    // from or conflict with it, would be skipped by AddToWalletIfInvolvingMe
+                    const CTransaction& tx = block.vtx[j];
+                    bool fRelevant = batch.vMatches[i][j] || mapWallet.count(tx.GetHash());
+                    for (unsigned int k = 0; !fRelevant && k < tx.vin.size(); k++)
+                        fRelevant = mapWallet.count(tx.vin[k].prevout.hash) || mapTxSpends.count(tx.vin[k].prevout);
+                    if (fRelevant && AddToWalletIfInvolvingMe(tx, &block, fUpdate)) // һʽ
+                        ret++;
+                }
             }
-            pindex = chainActive.Next(pindex); // ָһ
+            readers.Join();
             if (GetTime() >= nNow + 60) { // ʱ 60s
                 nNow = GetTime(); // ʱ
-                LogPrintf("Still rescanning. At block %d. Progress=%f\n", pindex->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), pindex));
+                LogPrintf("Still rescanning. At block %d. Progress=%f\n", batch.vIndex.back()->nHeight, Checkpoints::GuessVerificationProgress(chainParams.Checkpoints(), batch.vIndex.back()));
             }
+            nCurrent = 1 - nCurrent; // лѶõһ
         }
         ShowProgress(_("Rescanning..."), 100); // hide progress dialog in GUI
     }
@@ -1546,100 +1764,137 @@ void CWallet::ResendWalletTransactions(int64_t nBestBlockTime)
 
 
 
+bool CWallet::HasUnspentOutputs(const CWalletTx& wtx) const
+{
+    if (wtx.IsCoinBase() && wtx.GetBlocksToMaturity() > 0)
+        return true; // δ
+    for (unsigned int i = 0; i < wtx.vout.size(); i++)
+        if (IsMine(wtx.vout[i]) != ISMINE_NO && !IsSpent(wtx.GetHash(), i))
+            return true;
+    return false;
+}
+
+const std::set<uint256>& CWallet::GetUnspentTxs() const
+{
+    AssertLockHeld(cs_main); // GetDepthInMainChain
+    AssertLockHeld(cs_wallet);
+    if (fUnspentTxsStale) {
+        setUnspentTxs.clear();
+        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
+            if (HasUnspentOutputs(it->second))
+                setUnspentTxs.insert(setUnspentTxs.end(), it->first);
+        setUnspentTxsToCheck.clear();
+        fUnspentTxsStale = false;
+        return setUnspentTxs;
+    }
+
+    BOOST_FOREACH(const uint256& hash, setUnspentTxsToCheck) {
+        std::set<uint256>::iterator it = setUnspentTxs.find(hash);
+        if (it == setUnspentTxs.end())
+            continue;
+        std::map<uint256, CWalletTx>::const_iterator mi = mapWallet.find(hash);
+        if (mi == mapWallet.end() || !HasUnspentOutputs(mi->second))
+            setUnspentTxs.erase(it);
+    }
+    setUnspentTxsToCheck.clear();
+    return setUnspentTxs;
+}
+
 /** @defgroup Actions
  *
  * @{
  */
 
 
-CAmount CWallet::GetBalance() const
+/** Add what wtx contributes to the balances, and note if that depends on the mempool */
+static void AddToBalances(const CWalletTx& wtx, CWalletBalances& balances, bool& fUseMempool)
 {
-    CAmount nTotal = 0;
+    int nDepth = wtx.GetDepthInMainChain();
+    if (nDepth == 0)
+        fUseMempool = true; // Ƿȡڴ
+    if (wtx.IsTrusted()) // ý׿ţȷϣ
     {
-        LOCK2(cs_main, cs_wallet); // Ǯ
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        { // Ǯӳ
-            const CWalletTx* pcoin = &(*it).second; // ȡǮ
-            if (pcoin->IsTrusted()) // ý׿ţȷϣ
-                nTotal += pcoin->GetAvailableCredit(); // ȡۼ
+        balances.nBalance += wtx.GetAvailableCredit(); // ȡۼ
+        balances.nWatchOnlyBalance += wtx.GetAvailableWatchOnlyCredit();
+    }
+    else if (nDepth == 0 && wtx.InMempool()) // ýײţδȷϣ  Ϊ 0  ڴУδ
+    {
+        balances.nUnconfirmedBalance += wtx.GetAvailableCredit();
+        balances.nUnconfirmedWatchOnlyBalance += wtx.GetAvailableWatchOnlyCredit();
+    }
+    balances.nImmatureBalance += wtx.GetImmatureCredit();
+    balances.nImmatureWatchOnlyBalance += wtx.GetImmatureWatchOnlyCredit();
+}
+
+CWalletBalances CWallet::GetBalances() const
+{
+    LOCK2(cs_main, cs_wallet); // Ǯ
+    const CBlockIndex* pindexTip = chainActive.Tip();
+    unsigned int nMempoolUpdated = mempool.GetTransactionsUpdated();
+    bool fConfirmedStale = fBalancesDirty || pindexBalances != pindexTip;
+    if (fConfirmedStale || (fBalancesUseMempool && nBalancesMempoolUpdated != nMempoolUpdated))
+    {
+        const std::set<uint256>& setTxs = GetUnspentTxs(); // ཻ׵ĿΪ 0
+        bool fUseMempool = false;
+        if (fConfirmedStale)
+        {
+            balancesConfirmed = CWalletBalances();
+            for (std::set<uint256>::const_iterator it = setTxs.begin(); it != setTxs.end(); ++it)
+            { // δǮ
+                std::map<uint256, TxHeights::iterator>::const_iterator mi = mapTxHeightPos.find(*it);
+                if (mi == mapTxHeightPos.end() || mi->second->first >= 0)
+                    AddToBalances(mapWallet.find(*it)->second, balancesConfirmed, fUseMempool);
+            }
+        }
+
+        // Only the transactions that are not in the active chain can depend on the mempool
+        balancesUnconfirmed = CWalletBalances();
+        std::pair<TxHeights::const_iterator, TxHeights::const_iterator> range = mapTxsByHeight.equal_range(-1);
+        for (TxHeights::const_iterator it = range.first; it != range.second; ++it)
+        {
+            if (setTxs.count(it->second))
+                AddToBalances(mapWallet.find(it->second)->second, balancesUnconfirmed, fUseMempool);
         }
+
+        fBalancesDirty = false;
+        pindexBalances = pindexTip;
+        fBalancesUseMempool = fUseMempool;
+        nBalancesMempoolUpdated = nMempoolUpdated;
     }
 
-    return nTotal; // 
+    CWalletBalances balances = balancesConfirmed;
+    balances += balancesUnconfirmed;
+    return balances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    return GetBalances().nBalance; // 
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        { // Ǯӳб
-            const CWalletTx* pcoin = &(*it).second; // ȡǮ
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool()) // ýײţδȷϣ  Ϊ 0  ڴУδ
-                nTotal += pcoin->GetAvailableCredit(); // ȡۼӿ
-        }
-    }
-    return nTotal; // 
+    return GetBalances().nUnconfirmedBalance;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmatureBalance;
 }
 
 CAmount CWallet::GetWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-
-    return nTotal;
+    return GetBalances().nWatchOnlyBalance;
 }
 
 CAmount CWallet::GetUnconfirmedWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            if (!pcoin->IsTrusted() && pcoin->GetDepthInMainChain() == 0 && pcoin->InMempool())
-                nTotal += pcoin->GetAvailableWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nUnconfirmedWatchOnlyBalance;
 }
 
 CAmount CWallet::GetImmatureWatchOnlyBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        {
-            const CWalletTx* pcoin = &(*it).second;
-            nTotal += pcoin->GetImmatureWatchOnlyCredit();
-        }
-    }
-    return nTotal;
+    return GetBalances().nImmatureWatchOnlyBalance;
 }
 
 void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const CCoinControl *coinControl, bool fIncludeZeroValue) const
@@ -1648,10 +1903,11 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
 
     {
         LOCK2(cs_main, cs_wallet); // Ǯ
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it)
-        { // Ǯӳб
-            const uint256& wtxid = it->first; // ȡǮ
-            const CWalletTx* pcoin = &(*it).second; // ȡǮ
+        const std::set<uint256>& setTxs = GetUnspentTxs(); // ֻЩ׿δѵ
+        for (std::set<uint256>::const_iterator it = setTxs.begin(); it != setTxs.end(); ++it)
+        { // δǮ
+            const uint256& wtxid = *it; // ȡǮ
+            const CWalletTx* pcoin = &mapWallet.find(wtxid)->second; // ȡǮ
 
             if (!CheckFinalTx(*pcoin)) // ս
                 continue; // 
@@ -1674,8 +1930,8 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
             for (unsigned int i = 0; i < pcoin->vout.size(); i++) { // б
                 isminetype mine = IsMine(pcoin->vout[i]); // жϸǷԼ
                 if (!(IsSpent(wtxid, i)) && mine != ISMINE_NO && // δ  Լ 
-                    !IsLockedCoin((*it).first, i) && (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) && // ı   0   0 ֵ־Ϊ true 
-                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected((*it).first, i)))
+                    !IsLockedCoin(wtxid, i) && (pcoin->vout[i].nValue > 0 || fIncludeZeroValue) && // ı   0   0 ֵ־Ϊ true 
+                    (!coinControl || !coinControl->HasSelected() || coinControl->fAllowOtherInputs || coinControl->IsSelected(wtxid, i)))
                         vCoins.push_back(COutput(pcoin, i, nDepth,
                                                  ((mine & ISMINE_SPENDABLE) != ISMINE_NO) ||
                                                   (coinControl && coinControl->fAllowWatchOnly && (mine & ISMINE_WATCH_SOLVABLE) != ISMINE_NO))); // б
@@ -1684,7 +1940,7 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, const
     }
 }
 
-static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > >vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
+static void ApproximateBestSubset(const vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > >& vValue, const CAmount& nTotalLower, const CAmount& nTargetValue,
                                   vector<char>& vfBest, CAmount& nBest, int iterations = 1000)
 {
     vector<char> vfIncluded;
@@ -1740,21 +1996,12 @@ static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*,uns
     }
 }
 
-bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, vector<COutput> vCoins,
-                                 set<pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet) const
+void CSelectionCandidates::Set(const vector<COutput>& vCoinsIn, int nConfMine, int nConfTheirs)
 {
-    setCoinsRet.clear();
-    nValueRet = 0;
-
-    // List of values less than target
-    pair<CAmount, pair<const CWalletTx*,unsigned int> > coinLowestLarger;
-    coinLowestLarger.first = std::numeric_limits<CAmount>::max();
-    coinLowestLarger.second.first = NULL;
-    vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > > vValue;
-    CAmount nTotalLower = 0;
-
-    random_shuffle(vCoins.begin(), vCoins.end(), GetRandInt);
+    vector<COutput> vCoins(vCoinsIn);
+    random_shuffle(vCoins.begin(), vCoins.end(), GetRandInt); // ͬı˳
 
+    vValue.clear();
     BOOST_FOREACH(const COutput &output, vCoins)
     {
         if (!output.fSpendable)
@@ -1765,49 +2012,148 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int
         if (output.nDepth < (pcoin->IsFromMe(ISMINE_ALL) ? nConfMine : nConfTheirs))
             continue;
 
-        int i = output.i;
-        CAmount n = pcoin->vout[i].nValue;
+        vValue.push_back(make_pair(pcoin->vout[output.i].nValue, make_pair(pcoin, (unsigned int)output.i)));
+    }
+    stable_sort(vValue.rbegin(), vValue.rend(), CompareValueOnly());
 
-        pair<CAmount,pair<const CWalletTx*,unsigned int> > coin = make_pair(n,make_pair(pcoin, i));
+    vTotal.assign(vValue.size() + 1, 0);
+    for (size_t i = vValue.size(); i > 0; i--)
+        vTotal[i - 1] = vTotal[i] + vValue[i - 1].first;
+}
 
-        if (n == nTargetValue)
-        {
-            setCoinsRet.insert(coin.second);
-            nValueRet += coin.first;
+const CSelectionCandidates& CCoinSelectionCache::GetCandidates(int nConfMine, int nConfTheirs)
+{
+    std::pair<std::map<std::pair<int, int>, CSelectionCandidates>::iterator, bool> ret = mapCandidates.insert(make_pair(make_pair(nConfMine, nConfTheirs), CSelectionCandidates()));
+    if (ret.second)
+        ret.first->second.Set(vCoins, nConfMine, nConfTheirs);
+    return ret.first->second;
+}
+
+static bool ValueAtLeast(const CSelectionCandidates::CoinValue& coin, CAmount nValue)
+{
+    return coin.first >= nValue;
+}
+
+static bool ValueAbove(const CSelectionCandidates::CoinValue& coin, CAmount nValue)
+{
+    return coin.first > nValue;
+}
+
+/**
+ * Search vValue from nBegin on (sorted by decreasing value, with vTotal the
+ * running totals) for a subset adding up to exactly nTargetValue. Coins are
+ * tried largest first; branches that cannot reach the target are cut, and
+ * coins of the same value as one just left out are skipped.
+ */ // ֧ҽǡõĿֵӼ
+static bool SelectCoinsExact(const vector<CSelectionCandidates::CoinValue>& vValue, const vector<CAmount>& vTotal, size_t nBegin, const CAmount& nTargetValue, vector<size_t>& vSelected)
+{
+    vSelected.clear();
+    CAmount nTotal = 0;
+    size_t i = nBegin;
+    for (unsigned int nTries = 0; nTries < COIN_SELECTION_EXACT_TRIES; nTries++)
+    {
+        if (nTotal == nTargetValue)
             return true;
+        if (i < vValue.size() && nTotal + vTotal[i] >= nTargetValue) {
+            CAmount nValue = vValue[i].first;
+            if (nTotal + nValue <= nTargetValue) { // ѡñ
+                vSelected.push_back(i);
+                nTotal += nValue;
+                i++;
+            } else { // ñҼͬı
+                while (i < vValue.size() && vValue[i].first == nValue)
+                    i++;
+            }
+            continue;
         }
-        else if (n < nTargetValue + MIN_CHANGE)
-        {
-            vValue.push_back(coin);
-            nTotalLower += n;
-        }
-        else if (n < coinLowestLarger.first)
-        {
-            coinLowestLarger = coin;
-        }
+        // Backtrack: leave out the last selected coin instead
+        if (vSelected.empty())
+            return false;
+        size_t nLast = vSelected.back();
+        vSelected.pop_back();
+        nTotal -= vValue[nLast].first;
+        i = nLast + 1;
+        while (i < vValue.size() && vValue[i].first == vValue[nLast].first)
+            i++;
+    }
+    vSelected.clear();
+    return false;
+}
+
+bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, vector<COutput> vCoins,
+                                 set<pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet) const
+{
+    CSelectionCandidates candidates;
+    candidates.Set(vCoins, nConfMine, nConfTheirs);
+    return SelectCoinsMinConf(nTargetValue, candidates, setCoinsRet, nValueRet);
+}
+
+bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, const CSelectionCandidates& candidates,
+                                 set<pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet) const
+{
+    setCoinsRet.clear();
+    nValueRet = 0;
+
+    const vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > >& vCandidates = candidates.vValue;
+
+    // Coins of at least nTargetValue + MIN_CHANGE come first; the last of them is the lowest larger coin
+    size_t nLower = lower_bound(vCandidates.begin(), vCandidates.end(), nTargetValue + MIN_CHANGE, ValueAtLeast) - vCandidates.begin();
+    const pair<CAmount, pair<const CWalletTx*,unsigned int> >* pcoinLowestLarger = nLower > 0 ? &vCandidates[nLower - 1] : NULL;
+
+    size_t nExact = lower_bound(vCandidates.begin() + nLower, vCandidates.end(), nTargetValue, ValueAbove) - vCandidates.begin();
+    if (nExact < vCandidates.size() && vCandidates[nExact].first == nTargetValue)
+    {
+        setCoinsRet.insert(vCandidates[nExact].second);
+        nValueRet += vCandidates[nExact].first;
+        return true;
     }
 
+    // List of values less than target
+    CAmount nTotalLower = candidates.vTotal[nLower];
+
     if (nTotalLower == nTargetValue)
     {
-        for (unsigned int i = 0; i < vValue.size(); ++i)
+        for (size_t i = nLower; i < vCandidates.size(); ++i)
         {
-            setCoinsRet.insert(vValue[i].second);
-            nValueRet += vValue[i].first;
+            setCoinsRet.insert(vCandidates[i].second);
+            nValueRet += vCandidates[i].first;
         }
         return true;
     }
 
     if (nTotalLower < nTargetValue)
     {
-        if (coinLowestLarger.second.first == NULL)
+        if (pcoinLowestLarger == NULL)
             return false;
-        setCoinsRet.insert(coinLowestLarger.second);
-        nValueRet += coinLowestLarger.first;
+        setCoinsRet.insert(pcoinLowestLarger->second);
+        nValueRet += pcoinLowestLarger->first;
         return true;
     }
 
-    // Solve subset sum by stochastic approximation
-    sort(vValue.rbegin(), vValue.rend(), CompareValueOnly());
+    // An exact subset needs no change
+    vector<size_t> vSelected;
+    if (SelectCoinsExact(vCandidates, candidates.vTotal, nLower, nTargetValue, vSelected))
+    {
+        BOOST_FOREACH(size_t i, vSelected)
+        {
+            setCoinsRet.insert(vCandidates[i].second);
+            nValueRet += vCandidates[i].first;
+        }
+        LogPrint("selectcoins", "SelectCoins() exact subset of %d coins: total %s\n", vSelected.size(), FormatMoney(nValueRet));
+        return true;
+    }
+
+    // Solve subset sum by stochastic approximation, among the largest of the
+    // smaller coins that are enough to make the target with change
+    size_t nEnd = vCandidates.size();
+    if (nEnd - nLower > COIN_SELECTION_MAX_SUBSET)
+    {
+        nEnd = nLower + COIN_SELECTION_MAX_SUBSET;
+        while (nEnd < vCandidates.size() && nTotalLower - candidates.vTotal[nEnd] < nTargetValue + MIN_CHANGE)
+            nEnd++;
+    }
+    vector<pair<CAmount, pair<const CWalletTx*,unsigned int> > > vValue(vCandidates.begin() + nLower, vCandidates.begin() + nEnd);
+    nTotalLower -= candidates.vTotal[nEnd];
     vector<char> vfBest;
     CAmount nBest;
 
@@ -1817,11 +2163,11 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int
 
     // If we have a bigger coin and (either the stochastic approximation didn't find a good solution,
     //                                   or the next bigger coin is closer), return the bigger coin
-    if (coinLowestLarger.second.first &&
-        ((nBest != nTargetValue && nBest < nTargetValue + MIN_CHANGE) || coinLowestLarger.first <= nBest))
+    if (pcoinLowestLarger &&
+        ((nBest != nTargetValue && nBest < nTargetValue + MIN_CHANGE) || pcoinLowestLarger->first <= nBest))
     {
-        setCoinsRet.insert(coinLowestLarger.second);
-        nValueRet += coinLowestLarger.first;
+        setCoinsRet.insert(pcoinLowestLarger->second);
+        nValueRet += pcoinLowestLarger->first;
     }
     else {
         for (unsigned int i = 0; i < vValue.size(); i++)
@@ -1841,10 +2187,17 @@ bool CWallet::SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int
     return true;
 }
 
-bool CWallet::SelectCoins(const CAmount& nTargetValue, set<pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl) const
+bool CWallet::SelectCoins(const CAmount& nTargetValue, set<pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl* coinControl, CCoinSelectionCache* pcache) const
 {
-    vector<COutput> vCoins; // б
-    AvailableCoins(vCoins, true, coinControl); // ȡõıҵб
+    CCoinSelectionCache cache; // δ뻺ʱʹ
+    if (!pcache)
+        pcache = &cache;
+    vector<COutput>& vCoins = pcache->vCoins; // б
+    bool fAvailable = pcache->fAvailable; // Ƿѻȡñ
+    if (!fAvailable) {
+        AvailableCoins(vCoins, true, coinControl); // ȡõıҵб
+        pcache->fAvailable = true;
+    }
 
     // coin control -> return all selected outputs (we want all selected to go into the transaction for sure) // ȫѡϣѡеĶ뽻ף
     if (coinControl && coinControl->HasSelected() && !coinControl->fAllowOtherInputs)
@@ -1882,7 +2235,7 @@ bool CWallet::SelectCoins(const CAmount& nTargetValue, set<pair<const CWalletTx*
     }
 
     // remove preset inputs from vCoins
-    for (vector<COutput>::iterator it = vCoins.begin(); it != vCoins.end() && coinControl && coinControl->HasSelected();)
+    for (vector<COutput>::iterator it = vCoins.begin(); !fAvailable && it != vCoins.end() && coinControl && coinControl->HasSelected();)
     {
         if (setPresetCoins.count(make_pair(it->tx, it->i)))
             it = vCoins.erase(it);
@@ -1891,9 +2244,9 @@ bool CWallet::SelectCoins(const CAmount& nTargetValue, set<pair<const CWalletTx*
     }
 
     bool res = nTargetValue <= nValueFromPresetInputs ||
-        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 6, vCoins, setCoinsRet, nValueRet) ||
-        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 1, 1, vCoins, setCoinsRet, nValueRet) ||
-        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, 0, 1, vCoins, setCoinsRet, nValueRet));
+        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, pcache->GetCandidates(1, 6), setCoinsRet, nValueRet) ||
+        SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, pcache->GetCandidates(1, 1), setCoinsRet, nValueRet) ||
+        (bSpendZeroConfChange && SelectCoinsMinConf(nTargetValue - nValueFromPresetInputs, pcache->GetCandidates(0, 1), setCoinsRet, nValueRet));
 
     // because SelectCoinsMinConf clears the setCoinsRet, we now add the possible inputs to the coinset
     setCoinsRet.insert(setPresetCoins.begin(), setPresetCoins.end());
@@ -2011,6 +2364,7 @@ bool CWallet::CreateTransaction(const vector<CRecipient>& vecSend, CWalletTx& wt
         LOCK2(cs_main, cs_wallet); // Ǯ
         {
             nFeeRet = 0;
+            CCoinSelectionCache selectionCache; // ñÿֽ׷Ѽ䱣ֲ
             // Start with no fee and loop until there is enough fee // ʼʱûн׷ѣѭֱ㹻Ľ׷
             while (true)
             {
@@ -2059,7 +2413,7 @@ bool CWallet::CreateTransaction(const vector<CRecipient>& vecSend, CWalletTx& wt
                 // Choose coins to use // 4.ѡҪʹõı
                 set<pair<const CWalletTx*,unsigned int> > setCoins; // ӲҼ
                 CAmount nValueIn = 0; // ¼ѡӲܽ
-                if (!SelectCoins(nValueToSelect, setCoins, nValueIn, coinControl)) // ѡӲ
+                if (!SelectCoins(nValueToSelect, setCoins, nValueIn, coinControl, &selectionCache)) // ѡӲ
                 {
                     strFailReason = _("Insufficient funds");
                     return false; // ʧ
@@ -2160,24 +2514,24 @@ bool CWallet::CreateTransaction(const vector<CRecipient>& vecSend, CWalletTx& wt
                                               std::numeric_limits<unsigned int>::max()-1));
 
                 // Sign // 8.ǩ
-                int nIn = 0; // 
-                CTransaction txNewConst(txNew); // ͨױĽ׹һʲĽ
+                std::vector<CScript> vScriptPubKeys; // 뻨ѵĽűԿ
+                vScriptPubKeys.reserve(setCoins.size());
                 BOOST_FOREACH(const PAIRTYPE(const CWalletTx*,unsigned int)& coin, setCoins) // Ҽ
+                    vScriptPubKeys.push_back(coin.first->vout[coin.second].scriptPubKey); // ȡűԿ
+
+                bool signSuccess = true; // ǩ״̬
+                if (sign) // true ǩ
+                    signSuccess = SignTransaction(*this, txNew, vScriptPubKeys, SIGHASH_ALL); // ߳Ϊȫǩ
+                else
                 {
-                    bool signSuccess; // ǩ״̬
-                    const CScript& scriptPubKey = coin.first->vout[coin.second].scriptPubKey; // ȡűԿ
-                    CScript& scriptSigRes = txNew.vin[nIn].scriptSig; // ȡűǩ
-                    if (sign) // true ǩ
-                        signSuccess = ProduceSignature(TransactionSignatureCreator(this, &txNewConst, nIn, SIGHASH_ALL), scriptPubKey, scriptSigRes); // ǩ
-                    else
-                        signSuccess = ProduceSignature(DummySignatureCreator(this), scriptPubKey, scriptSigRes);
+                    for (unsigned int nIn = 0; nIn < vScriptPubKeys.size() && signSuccess; nIn++) // 
+                        signSuccess = ProduceSignature(DummySignatureCreator(this), vScriptPubKeys[nIn], txNew.vin[nIn].scriptSig);
+                }
 
-                    if (!signSuccess) // ǩʧ
-                    {
-                        strFailReason = _("Signing transaction failed");
-                        return false;
-                    }
-                    nIn++; // ż 1
+                if (!signSuccess) // ǩʧ
+                {
+                    strFailReason = _("Signing transaction failed");
+                    return false;
                 }
 
                 unsigned int nBytes = ::GetSerializeSize(txNew, SER_NETWORK, PROTOCOL_VERSION); // ȡл׵ֽ
@@ -2453,10 +2807,12 @@ bool CWallet::NewKeyPool()
             return false;
 
         int64_t nKeys = max(GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t)0); // ȡԿشС
+        std::vector<CPubKey> vPubKeys;
+        GenerateNewKeys(nKeys, vPubKeys); // Կ
         for (int i = 0; i < nKeys; i++)
         {
             int64_t nIndex = i+1;
-            walletdb.WritePool(nIndex, CKeyPool(GenerateNewKey())); // ԿһдǮݿ
+            walletdb.WritePool(nIndex, CKeyPool(vPubKeys[i])); // ԿһдǮݿ
             setKeyPool.insert(nIndex); // Կ
         }
         LogPrintf("CWallet::NewKeyPool wrote %d new keys\n", nKeys); // ¼дԿĸ
@@ -2481,15 +2837,58 @@ bool CWallet::TopUpKeyPool(unsigned int kpSize)
         else // 
             nTargetSize = max(GetArg("-keypool", DEFAULT_KEYPOOL_SIZE), (int64_t) 0); // Կ׳شСĬ 100
 
+        // Write the new keys and their pool entries in database transactions of up to
+        // KEYPOOL_REFILL_BATCH_SIZE keys, instead of a transaction and a checkpoint for every key.
+        // One transaction for a large refill could run out of Berkeley DB locks.
         while (setKeyPool.size() < (nTargetSize + 1)) // ԿԿʵ nTargetSize + 1 ԿĬΪ 100 + 1  101 
         {
-            int64_t nEnd = 1;
-            if (!setKeyPool.empty()) // ԿΪգΪ 1 Կʼ
-                nEnd = *(--setKeyPool.end()) + 1; // ȡǰԿԿ 1
-            if (!walletdb.WritePool(nEnd, CKeyPool(GenerateNewKey()))) // һԿԲѹԿдǮݿļ
-                throw runtime_error("TopUpKeyPool(): writing generated key failed");
-            setKeyPool.insert(nEnd); // ԿԿؼ
-            LogPrintf("keypool added key %d, size=%u\n", nEnd, setKeyPool.size());
+            unsigned int nKeys = std::min(nTargetSize + 1 - (unsigned int)setKeyPool.size(), KEYPOOL_REFILL_BATCH_SIZE);
+            assert(!pwalletdbBatch);
+            if (!pwalletdbEncryption && walletdb.TxnBegin())
+                pwalletdbBatch = &walletdb;
+
+            std::vector<int64_t> vAdded; // μԿ
+            std::vector<CPubKey> vPubKeys;
+            std::string strError;
+            try {
+                GenerateNewKeys(nKeys, vPubKeys);
+                BOOST_FOREACH(const CPubKey& pubkey, vPubKeys)
+                {
+                    int64_t nEnd = 1;
+                    if (!setKeyPool.empty()) // ԿΪգΪ 1 Կʼ
+                        nEnd = *(--setKeyPool.end()) + 1; // ȡǰԿԿ 1
+                    if (!walletdb.WritePool(nEnd, CKeyPool(pubkey))) { // ѹԿдǮݿļ
+                        strError = "TopUpKeyPool(): writing generated key failed";
+                        break;
+                    }
+                    setKeyPool.insert(nEnd); // ԿԿؼ
+                    vAdded.push_back(nEnd);
+                    LogPrintf("keypool added key %d, size=%u\n", nEnd, setKeyPool.size());
+                }
+            } catch (const std::exception& e) {
+                strError = e.what();
+            }
+
+            if (pwalletdbBatch) {
+                pwalletdbBatch = NULL;
+                if (strError.empty() && !walletdb.TxnCommit())
+                    strError = "TopUpKeyPool(): committing generated keys failed";
+                else if (!strError.empty())
+                    walletdb.TxnAbort();
+                // None of the keys of this batch made it to disk, so none may be handed out. // Կδд̣ٷ䣻
+                // Forget the keys themselves too, or the wallet would count outputs paying to them
+                // as its own until it is restarted. Earlier batches are committed and stay.
+                if (!strError.empty()) {
+                    BOOST_FOREACH(int64_t nIndex, vAdded)
+                        setKeyPool.erase(nIndex);
+                    BOOST_FOREACH(const CPubKey& pubkey, vPubKeys) {
+                        RemoveKey(pubkey.GetID());
+                        mapKeyMetadata.erase(pubkey.GetID());
+                    }
+                }
+            }
+            if (!strError.empty())
+                throw runtime_error(strError);
         }
     }
     return true;
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include <boost/shared_ptr.hpp>
+#include <boost/unordered_set.hpp>
 
 /**
  * Settings
@@ -60,6 +61,32 @@ static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWa
 //! Largest (in bytes) free transaction we're willing to create // ϣֽΪλѽ
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000; // ѽ״С1000B
 static const bool DEFAULT_WALLETBROADCAST = true; // Ǯ׹㲥ĬϿ
+//! Number of blocks read ahead and matched together during a rescan
+static const unsigned int WALLET_RESCAN_BATCH_SIZE = 128;
+//! Maximum number of threads reading blocks during a rescan
+static const int MAX_RESCAN_READ_THREADS = 8;
+//! Maximum number of threads making new keys
+static const int MAX_KEYGEN_THREADS = 8;
+//! Keys written to the wallet database in one transaction when the keypool is refilled
+static const unsigned int KEYPOOL_REFILL_BATCH_SIZE = 1000;
+//! Steps the search for an exact subset of coins may take before giving up
+static const unsigned int COIN_SELECTION_EXACT_TRIES = 100000;
+//! Smaller coins the stochastic search considers, beyond the largest ones that suffice
+static const unsigned int COIN_SELECTION_MAX_SUBSET = 1000;
+
+/** Salted hash of a script, for sets of scriptPubKeys */
+class CScriptHasher
+{
+private:
+    uint64_t k0, k1;
+
+public:
+    CScriptHasher();
+
+    size_t operator()(const CScript& script) const;
+};
+
+typedef boost::unordered_set<CScript, CScriptHasher> ScriptPubKeySet;
 
 class CAccountingEntry;
 class CBlockIndex;
@@ -352,17 +379,7 @@ public:
     }
 
     //! make sure balances are recalculated // ȷ¼
-    void MarkDirty() // ѱ䶯
-    {
-        fCreditCached = false;
-        fAvailableCreditCached = false;
-        fWatchDebitCached = false;
-        fWatchCreditCached = false;
-        fAvailableWatchCreditCached = false;
-        fImmatureWatchCreditCached = false;
-        fDebitCached = false;
-        fChangeCached = false;
-    }
+    void MarkDirty(); // ѱ䶯
 
     void BindWallet(CWallet *pwalletIn)
     {
@@ -425,6 +442,68 @@ public:
     std::string ToString() const;
 };
 
+/**
+ * The coins that may be selected at one confirmation requirement, shuffled
+ * and then sorted by decreasing value, with running totals so that the
+ * coins below a target value and their sum are found by binary search.
+ */ // ӴСĺѡ
+class CSelectionCandidates
+{
+public:
+    typedef std::pair<CAmount, std::pair<const CWalletTx*, unsigned int> > CoinValue;
+
+    std::vector<CoinValue> vValue;
+    //! vTotal[i] is the value of vValue[i] and all smaller coins; vTotal[vValue.size()] is 0
+    std::vector<CAmount> vTotal;
+
+    CSelectionCandidates() : vTotal(1, 0) {}
+
+    /** Take the spendable coins of vCoins with at least nConfMine (if from me) or nConfTheirs confirmations */
+    void Set(const std::vector<COutput>& vCoins, int nConfMine, int nConfTheirs);
+};
+
+/**
+ * Coins available to a transaction being created, and their candidates for
+ * each confirmation requirement, kept across the fee iterations of
+ * CreateTransaction() so that they are listed and sorted once.
+ */ // ڼ仺Ŀñ
+class CCoinSelectionCache
+{
+public:
+    bool fAvailable; // vCoins Ƿ
+    std::vector<COutput> vCoins; // ñңԤ
+    std::map<std::pair<int, int>, CSelectionCandidates> mapCandidates;
+
+    CCoinSelectionCache() : fAvailable(false) {}
+
+    const CSelectionCandidates& GetCandidates(int nConfMine, int nConfTheirs);
+};
+
+/** The balances of a wallet, see CWallet::GetBalances() */
+struct CWalletBalances // Ǯ
+{
+    CAmount nBalance;
+    CAmount nUnconfirmedBalance;
+    CAmount nImmatureBalance;
+    CAmount nWatchOnlyBalance;
+    CAmount nUnconfirmedWatchOnlyBalance;
+    CAmount nImmatureWatchOnlyBalance;
+
+    CWalletBalances() : nBalance(0), nUnconfirmedBalance(0), nImmatureBalance(0),
+        nWatchOnlyBalance(0), nUnconfirmedWatchOnlyBalance(0), nImmatureWatchOnlyBalance(0) {}
+
+    CWalletBalances& operator+=(const CWalletBalances& other)
+    {
+        nBalance += other.nBalance;
+        nUnconfirmedBalance += other.nUnconfirmedBalance;
+        nImmatureBalance += other.nImmatureBalance;
+        nWatchOnlyBalance += other.nWatchOnlyBalance;
+        nUnconfirmedWatchOnlyBalance += other.nUnconfirmedWatchOnlyBalance;
+        nImmatureWatchOnlyBalance += other.nImmatureWatchOnlyBalance;
+        return *this;
+    }
+};
+
 
 
 
@@ -468,9 +547,11 @@ private:
      * all coins from coinControl are selected; Never select unconfirmed coins
      * if they are not ours
      */
-    bool SelectCoins(const CAmount& nTargetValue, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl *coinControl = NULL) const;
+    bool SelectCoins(const CAmount& nTargetValue, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet, const CCoinControl *coinControl = NULL, CCoinSelectionCache* pcache = NULL) const;
 
     CWalletDB *pwalletdbEncryption; // Ǯݿָ
+    //! database with a transaction open that new keys are written through, see TopUpKeyPool()
+    CWalletDB *pwalletdbBatch; // дԿǮݿָ
 
     //! the current wallet version: clients below this version are not able to load the wallet
     int nWalletVersion; // ǰǮ汾ͻ˵ڸð汾ʱܼǮ
@@ -497,6 +578,47 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /**
+     * Wallet transactions that may have unspent outputs of mine (or are
+     * immature coinbases), so that coins and balances need not walk all of
+     * mapWallet. It is a superset: transactions enter when added, and the
+     * ones they spend when they become conflicted or abandoned. Those added
+     * or spent from since the last query are in setUnspentTxsToCheck, and
+     * are dropped by GetUnspentTxs() once they have nothing unspent left.
+     * New keys and scripts may make old outputs mine, so it is then rebuilt.
+     */ // ܺδǮ׼
+    mutable std::set<uint256> setUnspentTxs;
+    mutable std::set<uint256> setUnspentTxsToCheck;
+    mutable bool fUnspentTxsStale; // ´βѯʱҪؽ
+    bool HasUnspentOutputs(const CWalletTx& wtx) const;
+    const std::set<uint256>& GetUnspentTxs() const;
+
+    /**
+     * The balances as of the last GetBalances(), in two parts. That of the
+     * transactions in the active chain holds until a wallet transaction or key
+     * changes or the chain tip moves. That of the other transactions
+     * (mapTxsByHeight at -1) is also recomputed when the mempool changes, if
+     * one of them was not in a block or conflicted.
+     */ // ʱ״̬
+    mutable CWalletBalances balancesConfirmed;
+    mutable CWalletBalances balancesUnconfirmed;
+    mutable bool fBalancesDirty;
+    mutable const CBlockIndex* pindexBalances;
+    mutable bool fBalancesUseMempool;
+    mutable unsigned int nBalancesMempoolUpdated;
+
+    /**
+     * Wallet transactions by the height of the active chain block that
+     * contains them, or -1 if they are not in the active chain (unconfirmed,
+     * conflicted, abandoned or disconnected). Kept up to date by AddToWallet,
+     * which also sees disconnected transactions, and by the functions that
+     * mark transactions conflicted or abandoned.
+     */ // ߶Ǯ
+    typedef std::multimap<int, uint256> TxHeights;
+    TxHeights mapTxsByHeight;
+    std::map<uint256, TxHeights::iterator> mapTxHeightPos; // ڸ߶еλ
+    void UpdateTxHeight(const CWalletTx& wtx);
+
 public:
     /*
      * Main wallet lock.
@@ -543,11 +665,17 @@ public:
         fFileBacked = false;
         nMasterKeyMaxID = 0;
         pwalletdbEncryption = NULL;
+        pwalletdbBatch = NULL;
         nOrderPosNext = 0;
         nNextResend = 0;
         nLastResend = 0;
         nTimeFirstKey = 0;
         fBroadcastTransactions = false;
+        fUnspentTxsStale = true;
+        fBalancesDirty = true;
+        pindexBalances = NULL;
+        fBalancesUseMempool = false;
+        nBalancesMempoolUpdated = 0;
     }
 
     std::map<uint256, CWalletTx> mapWallet; // Ǯӳб < Ǯ>
@@ -570,6 +698,12 @@ public:
 
     const CWalletTx* GetWalletTx(const uint256& hash) const;
 
+    /**
+     * Get the wallet transactions that are not in the active chain, followed
+     * by those in its blocks above nHeight, in height order.
+     */ // ȡδĽ׺͸ָ߶ȵеĽ
+    void GetTxsSinceHeight(int nHeight, std::vector<const CWalletTx*>& vWtx) const;
+
     //! check whether we are allowed to upgrade (or already support) to the named feature
     bool CanSupportFeature(enum WalletFeature wf) { AssertLockHeld(cs_wallet); return nWalletMaxVersion >= wf; } // ǷǱ֧֣֪
 
@@ -585,6 +719,12 @@ public:
      * assembled
      */
     bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet) const;
+    /**
+     * Select from candidates sorted beforehand. A subset adding up to exactly
+     * nTargetValue is searched for first, depth-first and with a bounded
+     * number of steps, before falling back to the stochastic approximation.
+     */
+    bool SelectCoinsMinConf(const CAmount& nTargetValue, const CSelectionCandidates& candidates, std::set<std::pair<const CWalletTx*,unsigned int> >& setCoinsRet, CAmount& nValueRet) const;
 
     bool IsSpent(const uint256& hash, unsigned int n) const;
 
@@ -599,6 +739,8 @@ public:
      * Generate a new key
      */ // Կ
     CPubKey GenerateNewKey(); // һԿ
+    //! Generate nKeys new keys, on several threads if there are many, and add them to the wallet
+    void GenerateNewKeys(unsigned int nKeys, std::vector<CPubKey>& vPubKeys); // Կ
     //! Adds a key to the store, and saves it to disk.
     bool AddKeyPubKey(const CKey& key, const CPubKey &pubkey); // ԿǮػ
     //! Adds a key to the store, without saving it to disk (used by LoadWallet)
@@ -646,10 +788,20 @@ public:
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletDB* pwalletdb);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
+    /**
+     * Get the scriptPubKeys of the pay-to-pubkey, pay-to-pubkey-hash and
+     * pay-to-script-hash outputs that are mine, including watch-only ones.
+     * For outputs of these forms, IsMine() is true exactly for these scripts.
+     */
+    void GetStandardScriptPubKeys(ScriptPubKeySet& setScripts) const;
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false); // ָ鿪ʼɨǮ
     void ReacceptWalletTransactions(); // ٴνǮףѽ׷ڴ
     void ResendWalletTransactions(int64_t nBestBlockTime);
     std::vector<uint256> ResendWalletTransactionsBefore(int64_t nTime); // ·ĳʱǰǮ
+    //! Balances are computed together in one pass and then cached
+    CWalletBalances GetBalances() const; // ȡȫ
+    //! Note that a change to the wallet may change its balances
+    void MarkBalancesDirty() const { fBalancesDirty = true; }
     CAmount GetBalance() const; // ȡǮ
     CAmount GetUnconfirmedBalance() const; // ȡǮδȷϵ
     CAmount GetImmatureBalance() const;
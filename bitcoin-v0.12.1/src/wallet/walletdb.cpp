@@ -15,6 +15,7 @@
 #include "utiltime.h"
 #include "wallet/wallet.h"
 
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/foreach.hpp>
 #include <boost/scoped_ptr.hpp>
@@ -345,112 +346,86 @@ public:
     }
 };
 
-bool
-ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
-             CWalletScanState &wss, string& strType, string& strErr)
+/**
+ * A record read from the wallet database. Transactions and keys are
+ * deserialized and checked by PrepareRecord, which does not touch the
+ * wallet, before the record is added to it by ReadRecord.
+ */
+class CWalletRecord
+{
+public:
+    CDataStream ssKey;
+    CDataStream ssValue;
+    string strType;
+    string strErr;
+    bool fPrepared; //! a transaction or key, or a record whose type could not be read
+    bool fValid; //! the prepared record passed its checks
+
+    //! "tx" records
+    uint256 hash;
+    CWalletTx wtx;
+    bool fUpgraded;
+
+    //! "key" and "wkey" records
+    CPubKey vchPubKey;
+    CKey key;
+
+    CWalletRecord() : ssKey(SER_DISK, CLIENT_VERSION), ssValue(SER_DISK, CLIENT_VERSION), fPrepared(false), fValid(false), fUpgraded(false) {}
+};
+
+static void PrepareRecord(CWalletRecord& rec)
 {
+    rec.fPrepared = true;
     try {
         // Unserialize // л
         // Taking advantage of the fact that pair serialization // лʵ
         // is just the two items serialized one after the other // ֻһһĿ
-        ssKey >> strType; // 
-        if (strType == "name") // ͵ӦֵǮ
+        rec.ssKey >> rec.strType; // 
+        if (rec.strType == "tx")
         {
-            string strAddress;
-            ssKey >> strAddress;
-            ssValue >> pwallet->mapAddressBook[CBitcoinAddress(strAddress).Get()].name;
-        }
-        else if (strType == "purpose")
-        {
-            string strAddress;
-            ssKey >> strAddress;
-            ssValue >> pwallet->mapAddressBook[CBitcoinAddress(strAddress).Get()].purpose;
-        }
-        else if (strType == "tx")
-        {
-            uint256 hash;
-            ssKey >> hash;
-            CWalletTx wtx;
-            ssValue >> wtx;
+            rec.ssKey >> rec.hash;
+            rec.ssValue >> rec.wtx;
             CValidationState state;
-            if (!(CheckTransaction(wtx, state) && (wtx.GetHash() == hash) && state.IsValid()))
-                return false;
+            if (!(CheckTransaction(rec.wtx, state) && (rec.wtx.GetHash() == rec.hash) && state.IsValid()))
+                return;
 
             // Undo serialize changes in 31600
-            if (31404 <= wtx.fTimeReceivedIsTxTime && wtx.fTimeReceivedIsTxTime <= 31703)
+            if (31404 <= rec.wtx.fTimeReceivedIsTxTime && rec.wtx.fTimeReceivedIsTxTime <= 31703)
             {
-                if (!ssValue.empty())
+                if (!rec.ssValue.empty())
                 {
                     char fTmp;
                     char fUnused;
-                    ssValue >> fTmp >> fUnused >> wtx.strFromAccount;
-                    strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
-                                       wtx.fTimeReceivedIsTxTime, fTmp, wtx.strFromAccount, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = fTmp;
+                    rec.ssValue >> fTmp >> fUnused >> rec.wtx.strFromAccount;
+                    rec.strErr = strprintf("LoadWallet() upgrading tx ver=%d %d '%s' %s",
+                                           rec.wtx.fTimeReceivedIsTxTime, fTmp, rec.wtx.strFromAccount, rec.hash.ToString());
+                    rec.wtx.fTimeReceivedIsTxTime = fTmp;
                 }
                 else
                 {
-                    strErr = strprintf("LoadWallet() repairing tx ver=%d %s", wtx.fTimeReceivedIsTxTime, hash.ToString());
-                    wtx.fTimeReceivedIsTxTime = 0;
+                    rec.strErr = strprintf("LoadWallet() repairing tx ver=%d %s", rec.wtx.fTimeReceivedIsTxTime, rec.hash.ToString());
+                    rec.wtx.fTimeReceivedIsTxTime = 0;
                 }
-                wss.vWalletUpgrade.push_back(hash);
+                rec.fUpgraded = true;
             }
-
-            if (wtx.nOrderPos == -1)
-                wss.fAnyUnordered = true;
-
-            pwallet->AddToWallet(wtx, true, NULL);
         }
-        else if (strType == "acentry")
+        else if (rec.strType == "key" || rec.strType == "wkey")
         {
-            string strAccount;
-            ssKey >> strAccount;
-            uint64_t nNumber;
-            ssKey >> nNumber;
-            if (nNumber > nAccountingEntryNumber)
-                nAccountingEntryNumber = nNumber;
-
-            if (!wss.fAnyUnordered)
+            rec.ssKey >> rec.vchPubKey;
+            if (!rec.vchPubKey.IsValid())
             {
-                CAccountingEntry acentry;
-                ssValue >> acentry;
-                if (acentry.nOrderPos == -1)
-                    wss.fAnyUnordered = true;
-            }
-        }
-        else if (strType == "watchs")
-        {
-            CScript script;
-            ssKey >> *(CScriptBase*)(&script);
-            char fYes;
-            ssValue >> fYes;
-            if (fYes == '1')
-                pwallet->LoadWatchOnly(script);
-
-            // Watch-only addresses have no birthday information for now,
-            // so set the wallet birthday to the beginning of time.
-            pwallet->nTimeFirstKey = 1;
-        }
-        else if (strType == "key" || strType == "wkey")
-        {
-            CPubKey vchPubKey;
-            ssKey >> vchPubKey;
-            if (!vchPubKey.IsValid())
-            {
-                strErr = "Error reading wallet database: CPubKey corrupt";
-                return false;
+                rec.strErr = "Error reading wallet database: CPubKey corrupt";
+                return;
             }
-            CKey key;
             CPrivKey pkey;
             uint256 hash;
 
-            if (strType == "key")
+            if (rec.strType == "key")
             {
-                wss.nKeys++;
-                ssValue >> pkey;
+                rec.ssValue >> pkey;
             } else {
                 CWalletKey wkey;
-                ssValue >> wkey;
+                rec.ssValue >> wkey;
                 pkey = wkey.vchPrivKey;
             }
 
@@ -461,7 +436,7 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
             // remaining backwards-compatible.
             try
             {
-                ssValue >> hash;
+                rec.ssValue >> hash;
             }
             catch (...) {}
 
@@ -471,25 +446,110 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
             {
                 // hash pubkey/privkey to accelerate wallet load
                 std::vector<unsigned char> vchKey;
-                vchKey.reserve(vchPubKey.size() + pkey.size());
-                vchKey.insert(vchKey.end(), vchPubKey.begin(), vchPubKey.end());
+                vchKey.reserve(rec.vchPubKey.size() + pkey.size());
+                vchKey.insert(vchKey.end(), rec.vchPubKey.begin(), rec.vchPubKey.end());
                 vchKey.insert(vchKey.end(), pkey.begin(), pkey.end());
 
                 if (Hash(vchKey.begin(), vchKey.end()) != hash)
                 {
-                    strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
-                    return false;
+                    rec.strErr = "Error reading wallet database: CPubKey/CPrivKey corrupt";
+                    return;
                 }
 
                 fSkipCheck = true;
             }
 
-            if (!key.Load(pkey, vchPubKey, fSkipCheck))
+            if (!rec.key.Load(pkey, rec.vchPubKey, fSkipCheck))
             {
-                strErr = "Error reading wallet database: CPrivKey corrupt";
-                return false;
+                rec.strErr = "Error reading wallet database: CPrivKey corrupt";
+                return;
+            }
+        }
+        else
+        {
+            rec.fPrepared = false; // ¼ ReadRecord ȡ
+            return;
+        }
+        rec.fValid = true;
+    } catch (...) {} // лʧ
+}
+
+/** Prepare every nStep-th record of the batch, starting at nStart */
+static void PrepareRecords(vector<CWalletRecord>* pvRecords, unsigned int nStart, unsigned int nStep)
+{
+    for (unsigned int i = nStart; i < pvRecords->size(); i += nStep)
+        PrepareRecord((*pvRecords)[i]);
+}
+
+static bool
+ReadRecord(CWallet* pwallet, CWalletRecord& rec, CWalletScanState &wss)
+{
+    CDataStream& ssKey = rec.ssKey;
+    CDataStream& ssValue = rec.ssValue;
+    const string& strType = rec.strType;
+    string& strErr = rec.strErr;
+
+    if (strType == "key")
+        wss.nKeys++;
+    if (rec.fPrepared && !rec.fValid)
+        return false;
+
+    try {
+        if (strType == "name") // ͵ӦֵǮ
+        {
+            string strAddress;
+            ssKey >> strAddress;
+            ssValue >> pwallet->mapAddressBook[CBitcoinAddress(strAddress).Get()].name;
+        }
+        else if (strType == "purpose")
+        {
+            string strAddress;
+            ssKey >> strAddress;
+            ssValue >> pwallet->mapAddressBook[CBitcoinAddress(strAddress).Get()].purpose;
+        }
+        else if (strType == "tx")
+        {
+            if (rec.fUpgraded)
+                wss.vWalletUpgrade.push_back(rec.hash);
+
+            if (rec.wtx.nOrderPos == -1)
+                wss.fAnyUnordered = true;
+
+            pwallet->AddToWallet(rec.wtx, true, NULL);
+        }
+        else if (strType == "acentry")
+        {
+            string strAccount;
+            ssKey >> strAccount;
+            uint64_t nNumber;
+            ssKey >> nNumber;
+            if (nNumber > nAccountingEntryNumber)
+                nAccountingEntryNumber = nNumber;
+
+            if (!wss.fAnyUnordered)
+            {
+                CAccountingEntry acentry;
+                ssValue >> acentry;
+                if (acentry.nOrderPos == -1)
+                    wss.fAnyUnordered = true;
             }
-            if (!pwallet->LoadKey(key, vchPubKey))
+        }
+        else if (strType == "watchs")
+        {
+            CScript script;
+            ssKey >> *(CScriptBase*)(&script);
+            char fYes;
+            ssValue >> fYes;
+            if (fYes == '1')
+                pwallet->LoadWatchOnly(script);
+
+            // Watch-only addresses have no birthday information for now,
+            // so set the wallet birthday to the beginning of time.
+            pwallet->nTimeFirstKey = 1;
+        }
+        else if (strType == "key" || strType == "wkey")
+        {
+            if (!pwallet->LoadKey(rec.key, rec.vchPubKey))
             {
                 strErr = "Error reading wallet database: LoadKey failed";
                 return false;
@@ -605,6 +665,20 @@ ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
     return true; // ɹ true
 }
 
+bool
+ReadKeyValue(CWallet* pwallet, CDataStream& ssKey, CDataStream& ssValue,
+             CWalletScanState &wss, string& strType, string& strErr)
+{
+    CWalletRecord rec;
+    rec.ssKey = ssKey;
+    rec.ssValue = ssValue;
+    PrepareRecord(rec);
+    bool fOk = ReadRecord(pwallet, rec, wss);
+    strType = rec.strType;
+    strErr = rec.strErr;
+    return fOk;
+}
+
 static bool IsKeyType(string strType)
 {
     return (strType== "key" || strType == "wkey" ||
@@ -636,39 +710,55 @@ DBErrors CWalletDB::LoadWallet(CWallet* pwallet)
             return DB_CORRUPT;
         }
 
-        while (true) // ȡÿһ¼
+        const int nThreads = std::max(1, std::min(GetNumCores(), MAX_WALLET_LOAD_THREADS)); // ߳
+        vector<CWalletRecord> vRecords;
+        bool fMore = true;
+        while (fMore) // ȡÿһ¼
         {
-            // Read next record
-            CDataStream ssKey(SER_DISK, CLIENT_VERSION); // 
-            CDataStream ssValue(SER_DISK, CLIENT_VERSION); // ֵ
-            int ret = ReadAtCursor(pcursor, ssKey, ssValue); // αλûȡһ¼ֵԣ
-            if (ret == DB_NOTFOUND)
-                break;
-            else if (ret != 0) // 0 ʾȡɹ
+            vRecords.clear();
+            while (vRecords.size() < WALLET_LOAD_BATCH_SIZE)
             {
-                LogPrintf("Error reading next record from wallet database\n");
-                return DB_CORRUPT;
+                // Read next record
+                vRecords.push_back(CWalletRecord());
+                CWalletRecord& rec = vRecords.back();
+                int ret = ReadAtCursor(pcursor, rec.ssKey, rec.ssValue); // αλûȡһ¼ֵԣ
+                if (ret == DB_NOTFOUND)
+                {
+                    vRecords.pop_back();
+                    fMore = false;
+                    break;
+                }
+                else if (ret != 0) // 0 ʾȡɹ
+                {
+                    LogPrintf("Error reading next record from wallet database\n");
+                    return DB_CORRUPT;
+                }
             }
 
-            // Try to be tolerant of single corrupt records:
-            string strType, strErr; // ̵һĴ¼
-            if (!ReadKeyValue(pwallet, ssKey, ssValue, wss, strType, strErr)) // ֵǮ
+            // Decode and check the transactions and keys of the batch on several threads // ߳̽벢¼еĽ׺Կ
+            ParallelFor(nThreads, boost::bind(&PrepareRecords, &vRecords, _1, _2));
+
+            BOOST_FOREACH(CWalletRecord& rec, vRecords) // ݿе˳Ǯ
             {
-                // losing keys is considered a catastrophic error, anything else // ʧԿΪԵĴ
-                // we assume the user can live with: // Ǽû
-                if (IsKeyType(strType)) // Կ
-                    result = DB_CORRUPT; // 1 ʾ
-                else
+                // Try to be tolerant of single corrupt records: // ̵һĴ¼
+                if (!ReadRecord(pwallet, rec, wss)) // ֵǮ
                 {
-                    // Leave other errors alone, if we try to fix them we might make things worse.
-                    fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
-                    if (strType == "tx") // һ׼¼
-                        // Rescan if there is a bad transaction record:
-                        SoftSetBoolArg("-rescan", true); // 
+                    // losing keys is considered a catastrophic error, anything else // ʧԿΪԵĴ
+                    // we assume the user can live with: // Ǽû
+                    if (IsKeyType(rec.strType)) // Կ
+                        result = DB_CORRUPT; // 1 ʾ
+                    else
+                    {
+                        // Leave other errors alone, if we try to fix them we might make things worse.
+                        fNoncriticalErrors = true; // ... but do warn the user there is something wrong.
+                        if (rec.strType == "tx") // һ׼¼
+                            // Rescan if there is a bad transaction record:
+                            SoftSetBoolArg("-rescan", true); // 
+                    }
                 }
+                if (!rec.strErr.empty()) // Ƿд
+                    LogPrintf("%s\n", rec.strErr); // ¼
             }
-            if (!strErr.empty()) // Ƿд
-                LogPrintf("%s\n", strErr); // ¼
         }
         pcursor->close(); // رǮݿ
     }
@@ -17,6 +17,10 @@
 #include <vector>
 
 static const bool DEFAULT_FLUSHWALLET = true;
+//! Number of records read from the wallet database and decoded together on load
+static const unsigned int WALLET_LOAD_BATCH_SIZE = 4096;
+//! Maximum number of threads decoding wallet records on load
+static const int MAX_WALLET_LOAD_THREADS = 8;
 
 class CAccount;
 class CAccountingEntry;